@@ -65,10 +65,11 @@
     #endif
 
 #else       /*LV_MEM_CUSTOM*/
-    #define LV_MEM_CUSTOM_INCLUDE <stdlib.h>   /*Header for the dynamic memory function*/
-    #define LV_MEM_CUSTOM_ALLOC   malloc
-    #define LV_MEM_CUSTOM_FREE    free
-    #define LV_MEM_CUSTOM_REALLOC realloc
+    // 经过带标签的分配器，按子系统统计 LVGL 的内存 (mem_tag.h)
+    #define LV_MEM_CUSTOM_INCLUDE "mem_tag.h"   /*Header for the dynamic memory function*/
+    #define LV_MEM_CUSTOM_ALLOC   mem_tag_lv_alloc
+    #define LV_MEM_CUSTOM_FREE    mem_tag_lv_free
+    #define LV_MEM_CUSTOM_REALLOC mem_tag_lv_realloc
 #endif     /*LV_MEM_CUSTOM*/
 
 /*Number of the intermediate memory buffer used during rendering and other internal processing mechanisms.
@@ -672,9 +673,23 @@
 /* JPG + split JPG decoder library.
  * Split JPG is a custom format optimized for embedded systems. */
 #define LV_USE_SJPG 1
+#if LV_USE_SJPG
+    /*Decode the fragments with libjpeg(-turbo) instead of the bundled tjpgd (link with -ljpeg)*/
+    #define LV_SJPG_USE_LIBJPEG 1
+    /*Memory for decoded fragments shared by all SJPG images [bytes] (a 320x240 screen is 150 KB)*/
+    #define LV_SJPG_CACHE_SIZE (256 * 1024)
+    /*Decode the next fragments on worker threads, see `lv_split_jpeg_set_worker()` (needs pthread and LV_MEM_CUSTOM 1)*/
+    #define LV_SJPG_USE_WORKER 1
+#endif
+
+/*Image pack: mmap-ed packs of pre-converted RGB565/RGB565A8 images (tools/imgpack)*/
+#define LV_USE_IMGPACK 1
+
+/*QOI decoder library: lossless, decodes much faster than PNG (tools/png2qoi)*/
+#define LV_USE_QOI 1
 
 /*GIF decoder library*/
-#define LV_USE_GIF 0
+#define LV_USE_GIF 1
 
 /*QR code library*/
 #define LV_USE_QRCODE 0
@@ -695,6 +710,14 @@
         #define LV_FREETYPE_CACHE_FT_FACES 4
         #define LV_FREETYPE_CACHE_FT_SIZES 4
     #endif
+    /*1: FreeType's own allocations (faces, glyph cache) use the functions below instead of malloc*/
+    #define LV_FREETYPE_CUSTOM_MEM 1
+    #if LV_FREETYPE_CUSTOM_MEM
+        #define LV_FREETYPE_MEM_INCLUDE "mem_tag.h"
+        #define LV_FREETYPE_MEM_ALLOC(size)         mem_tag_alloc(MEM_TAG_FONT, size) // 字形缓存记到 font 名下
+        #define LV_FREETYPE_MEM_FREE(p)             mem_tag_free(p)
+        #define LV_FREETYPE_MEM_REALLOC(p, size)    mem_tag_realloc(MEM_TAG_FONT, p, size)
+    #endif
 #endif
 
 /*Tiny TTF library*/
@@ -16,6 +16,11 @@
 #include FT_SIZES_H
 #include FT_IMAGE_H
 #include FT_OUTLINE_H
+#include FT_MODULE_H
+
+#if LV_FREETYPE_CUSTOM_MEM
+    #include LV_FREETYPE_MEM_INCLUDE
+#endif
 
 /*********************
  *      DEFINES
@@ -62,6 +67,13 @@ static bool lv_ft_font_init_nocache(lv_ft_info_t * info);
 static void lv_ft_font_destroy_nocache(lv_font_t * font);
 #endif
 
+static void ft_library_done(void);
+#if LV_FREETYPE_CUSTOM_MEM
+static void * ft_mem_alloc(FT_Memory memory, long size);
+static void ft_mem_free(FT_Memory memory, void * block);
+static void * ft_mem_realloc(FT_Memory memory, long cur_size, long new_size, void * block);
+#endif
+
 static const char * name_refer_save(const char * name);
 static void name_refer_del(const char * name);
 static const char * name_refer_find(const char * name);
@@ -72,10 +84,16 @@ static const char * name_refer_find(const char * name);
 static FT_Library library;
 static lv_ll_t names_ll;
 
+#if LV_FREETYPE_CUSTOM_MEM
+    static struct FT_MemoryRec_ ft_memory = {NULL, ft_mem_alloc, ft_mem_free, ft_mem_realloc};
+#endif
+
 #if LV_FREETYPE_CACHE_SIZE >= 0
     static FTC_Manager cache_manager;
     static FTC_CMapCache cmap_cache;
     static FT_Face current_face = NULL;
+    static uint32_t cache_max_bytes;
+    static bool cache_used;         /*A glyph was looked up since the last flush*/
 
     #if LV_FREETYPE_SBIT_CACHE
         static FTC_SBitCache sbit_cache;
@@ -99,7 +117,15 @@ static lv_ll_t names_ll;
 
 bool lv_freetype_init(uint16_t max_faces, uint16_t max_sizes, uint32_t max_bytes)
 {
+#if LV_FREETYPE_CUSTOM_MEM
+    FT_Error error = FT_New_Library(&ft_memory, &library);
+    if(!error) {
+        FT_Add_Default_Modules(library);
+        FT_Set_Default_Properties(library);
+    }
+#else
     FT_Error error = FT_Init_FreeType(&library);
+#endif
     if(error) {
         LV_LOG_ERROR("init freeType error(%d)", error);
         return false;
@@ -110,8 +136,9 @@ bool lv_freetype_init(uint16_t max_faces, uint16_t max_sizes, uint32_t max_bytes
 #if LV_FREETYPE_CACHE_SIZE >= 0
     error = FTC_Manager_New(library, max_faces, max_sizes,
                             max_bytes, font_face_requester, NULL, &cache_manager);
+    cache_max_bytes = max_bytes ? max_bytes : 200000; /*FreeType's default*/
     if(error) {
-        FT_Done_FreeType(library);
+        ft_library_done();
         LV_LOG_ERROR("Failed to open cache manager");
         return false;
     }
@@ -139,7 +166,7 @@ bool lv_freetype_init(uint16_t max_faces, uint16_t max_sizes, uint32_t max_bytes
     return true;
 Fail:
     FTC_Manager_Done(cache_manager);
-    FT_Done_FreeType(library);
+    ft_library_done();
     return false;
 #else
     LV_UNUSED(max_faces);
@@ -155,7 +182,29 @@ void lv_freetype_destroy(void)
 #if LV_FREETYPE_CACHE_SIZE >= 0
     FTC_Manager_Done(cache_manager);
 #endif
-    FT_Done_FreeType(library);
+    ft_library_done();
+}
+
+size_t lv_freetype_cache_usage(void)
+{
+#if LV_FREETYPE_CACHE_SIZE >= 0
+    return cache_used ? cache_max_bytes : 0;
+#else
+    return 0;
+#endif
+}
+
+void lv_freetype_cache_trim(size_t target)
+{
+#if LV_FREETYPE_CACHE_SIZE >= 0
+    /*The cache can't be shrunk partially: flush the glyphs, sizes and faces*/
+    if(!cache_used || target >= cache_max_bytes) return;
+    FTC_Manager_Reset(cache_manager);
+    current_face = NULL;
+    cache_used = false;
+#else
+    LV_UNUSED(target);
+#endif
 }
 
 bool lv_ft_font_init(lv_ft_info_t * info)
@@ -179,6 +228,36 @@ void lv_ft_font_destroy(lv_font_t * font)
 /**********************
  *   STATIC FUNCTIONS
  **********************/
+
+static void ft_library_done(void)
+{
+#if LV_FREETYPE_CUSTOM_MEM
+    FT_Done_Library(library);   /*`ft_memory` is static, FT_Done_FreeType would free it*/
+#else
+    FT_Done_FreeType(library);
+#endif
+}
+
+#if LV_FREETYPE_CUSTOM_MEM
+static void * ft_mem_alloc(FT_Memory memory, long size)
+{
+    LV_UNUSED(memory);
+    return LV_FREETYPE_MEM_ALLOC((size_t)size);
+}
+
+static void ft_mem_free(FT_Memory memory, void * block)
+{
+    LV_UNUSED(memory);
+    LV_FREETYPE_MEM_FREE(block);
+}
+
+static void * ft_mem_realloc(FT_Memory memory, long cur_size, long new_size, void * block)
+{
+    LV_UNUSED(memory);
+    LV_UNUSED(cur_size);
+    return LV_FREETYPE_MEM_REALLOC(block, (size_t)new_size);
+}
+#endif
 #if LV_FREETYPE_CACHE_SIZE >= 0
 
 static FT_Error font_face_requester(FTC_FaceID face_id,
@@ -258,6 +337,7 @@ static bool get_glyph_dsc_cb_cache(const lv_font_t * font,
     if(FTC_Manager_LookupSize(cache_manager, &scaler, &face_size) != 0) {
         return false;
     }
+    cache_used = true;
 
     FT_Face face = face_size->face;
     FT_UInt charmap_index = FT_Get_Charmap_Index(face->charmap);
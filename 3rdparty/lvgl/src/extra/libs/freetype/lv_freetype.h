@@ -56,6 +56,20 @@ bool lv_freetype_init(uint16_t max_faces, uint16_t max_sizes, uint32_t max_bytes
  */
 void lv_freetype_destroy(void);
 
+/**
+ * Get the memory used by the glyph cache.
+ * FreeType doesn't expose the current size, so it's `max_bytes` once a glyph was rendered, 0 after a flush.
+ * @return size in bytes
+ */
+size_t lv_freetype_cache_usage(void);
+
+/**
+ * Flush the glyph cache if it may hold more than `target` bytes (it can't be shrunk partially).
+ * The glyphs are rendered again on the next draw.
+ * @param target    the size to shrink to, 0: always flush
+ */
+void lv_freetype_cache_trim(size_t target);
+
 /**
  * Creates a font with info parameter specified.
  * @param info See lv_ft_info_t for details.
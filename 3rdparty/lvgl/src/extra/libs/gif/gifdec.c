@@ -2,6 +2,7 @@
 #include "../../../misc/lv_log.h"
 #include "../../../misc/lv_mem.h"
 #include "../../../misc/lv_color.h"
+#include "../../../misc/lv_color_conv.h"
 #if LV_USE_GIF
 
 #include <stdlib.h>
@@ -11,6 +12,17 @@
 #define MIN(A, B) ((A) < (B) ? (A) : (B))
 #define MAX(A, B) ((A) > (B) ? (A) : (B))
 
+/* Bytes per canvas pixel, see gd_GIF.canvas */
+#if LV_COLOR_DEPTH == 32
+#define CANVAS_PX_SIZE 4
+#elif LV_COLOR_DEPTH == 16
+#define CANVAS_PX_SIZE 3
+#else
+#define CANVAS_PX_SIZE 2
+#endif
+
+#define ROW_NONE UINT32_MAX
+
 typedef struct Entry {
     uint16_t length;
     uint16_t prefix;
@@ -23,11 +35,21 @@ typedef struct Table {
     Entry *entries;
 } Table;
 
+/* LZW input: whole data sub-blocks are read at once and consumed through a bit buffer */
+typedef struct Reader {
+    uint8_t block[0xFF];
+    uint8_t len, pos;
+    uint32_t bits;
+    int nbits;
+} Reader;
+
 static gd_GIF *  gif_open(gd_GIF * gif);
 static bool f_gif_open(gd_GIF * gif, const void * path, bool is_file);
 static void f_gif_read(gd_GIF * gif, void * buf, size_t len);
 static int f_gif_seek(gd_GIF * gif, size_t pos, int k);
 static void f_gif_close(gd_GIF * gif);
+static void palette_convert(gd_Palette * pal);
+static void canvas_set(gd_GIF * gif, uint32_t i, uint8_t index, uint8_t opa);
 
 static uint16_t
 read_num(gd_GIF * gif)
@@ -70,8 +92,7 @@ static gd_GIF * gif_open(gd_GIF * gif_base)
     uint8_t sigver[3];
     uint16_t width, height, depth;
     uint8_t fdsz, bgidx, aspect;
-    int i;
-    uint8_t *bgcolor;
+    uint32_t i;
     int gct_sz;
     gd_GIF *gif = NULL;
 
@@ -107,13 +128,7 @@ static gd_GIF * gif_open(gd_GIF * gif_base)
     /* Aspect Ratio */
     f_gif_read(gif_base, &aspect, 1);
     /* Create gd_GIF Structure. */
-#if LV_COLOR_DEPTH == 32
-    gif = lv_mem_alloc(sizeof(gd_GIF) + 5 * width * height);
-#elif LV_COLOR_DEPTH == 16
-    gif = lv_mem_alloc(sizeof(gd_GIF) + 4 * width * height);
-#elif LV_COLOR_DEPTH == 8 || LV_COLOR_DEPTH == 1
-    gif = lv_mem_alloc(sizeof(gd_GIF) + 3 * width * height);
-#endif
+    gif = lv_mem_alloc(sizeof(gd_GIF) + CANVAS_PX_SIZE * width * height);
 
     if (!gif) goto fail;
     memcpy(gif, gif_base, sizeof(gd_GIF));
@@ -123,42 +138,17 @@ static gd_GIF * gif_open(gd_GIF * gif_base)
     /* Read GCT */
     gif->gct.size = gct_sz;
     f_gif_read(gif, gif->gct.colors, 3 * gif->gct.size);
+    palette_convert(&gif->gct);
     gif->palette = &gif->gct;
     gif->bgindex = bgidx;
     gif->canvas = (uint8_t *) &gif[1];
-#if LV_COLOR_DEPTH == 32
-    gif->frame = &gif->canvas[4 * width * height];
-#elif LV_COLOR_DEPTH == 16
-    gif->frame = &gif->canvas[3 * width * height];
-#elif LV_COLOR_DEPTH == 8 || LV_COLOR_DEPTH == 1
-    gif->frame = &gif->canvas[2 * width * height];
+#if LV_COLOR_DEPTH == 16
+    gif->alpha = &gif->canvas[2 * width * height];
 #endif
-    if (gif->bgindex) {
-        memset(gif->frame, gif->bgindex, gif->width * gif->height);
-    }
-    bgcolor = &gif->palette->colors[gif->bgindex*3];
-
-    for (i = 0; i < gif->width * gif->height; i++) {
-#if LV_COLOR_DEPTH == 32
-        gif->canvas[i*4 + 0] = *(bgcolor + 2);
-        gif->canvas[i*4 + 1] = *(bgcolor + 1);
-        gif->canvas[i*4 + 2] = *(bgcolor + 0);
-        gif->canvas[i*4 + 3] = 0xff;
-#elif LV_COLOR_DEPTH == 16
-        lv_color_t c = lv_color_make(*(bgcolor + 0), *(bgcolor + 1), *(bgcolor + 2));
-        gif->canvas[i*3 + 0] = c.full & 0xff;
-        gif->canvas[i*3 + 1] = (c.full >> 8) & 0xff;
-        gif->canvas[i*3 + 2] = 0xff;
-#elif LV_COLOR_DEPTH == 8
-        lv_color_t c = lv_color_make(*(bgcolor + 0), *(bgcolor + 1), *(bgcolor + 2));
-        gif->canvas[i*2 + 0] = c.full;
-        gif->canvas[i*2 + 1] = 0xff;
-#elif LV_COLOR_DEPTH == 1
-        lv_color_t c = lv_color_make(*(bgcolor + 0), *(bgcolor + 1), *(bgcolor + 2));
-        gif->canvas[i*2 + 0] = c.ch.red > 128 ? 1 : 0;
-        gif->canvas[i*2 + 1] = 0xff;
-#endif
-    }
+    gif->backup = NULL;
+    gif->backup_size = 0;
+    for (i = 0; i < (uint32_t) width * height; i++)
+        canvas_set(gif, i, gif->bgindex, 0xff);
     gif->anim_start = f_gif_seek(gif, 0, LV_FS_SEEK_CUR);
     gif->loop_count = -1;
     goto ok;
@@ -335,31 +325,26 @@ add_entry(Table **tablep, uint16_t length, uint16_t prefix, uint8_t suffix)
 }
 
 static uint16_t
-get_key(gd_GIF *gif, int key_size, uint8_t *sub_len, uint8_t *shift, uint8_t *byte)
+get_key(gd_GIF *gif, int key_size, Reader *rd)
 {
-    int bits_read;
-    int rpad;
-    int frag_size;
     uint16_t key;
 
-    key = 0;
-    for (bits_read = 0; bits_read < key_size; bits_read += frag_size) {
-        rpad = (*shift + bits_read) % 8;
-        if (rpad == 0) {
-            /* Update byte. */
-            if (*sub_len == 0) {
-                f_gif_read(gif, sub_len, 1); /* Must be nonzero! */
-                if (*sub_len == 0) return 0x1000;
-            }
-            f_gif_read(gif, byte, 1);
-            (*sub_len)--;
+    while (rd->nbits < key_size) {
+        if (rd->pos == rd->len) {
+            /* Load the next sub-block. */
+            uint8_t len = 0;
+            f_gif_read(gif, &len, 1); /* Must be nonzero! */
+            if (len == 0) return 0x1000;
+            f_gif_read(gif, rd->block, len);
+            rd->len = len;
+            rd->pos = 0;
         }
-        frag_size = MIN(key_size - bits_read, 8 - rpad);
-        key |= ((uint16_t) ((*byte) >> rpad)) << bits_read;
+        rd->bits |= (uint32_t) rd->block[rd->pos++] << rd->nbits;
+        rd->nbits += 8;
     }
-    /* Clear extra bits to the left. */
-    key &= (1 << key_size) - 1;
-    *shift = (*shift + key_size) % 8;
+    key = rd->bits & ((1 << key_size) - 1);
+    rd->bits >>= key_size;
+    rd->nbits -= key_size;
     return key;
 }
 
@@ -373,11 +358,11 @@ interlaced_line_index(int h, int y)
     if (y < p) /* pass 1 */
         return y * 8;
     y -= p;
-    p = (h - 5) / 8 + 1;
+    p = h > 4 ? (h - 5) / 8 + 1 : 0;
     if (y < p) /* pass 2 */
         return y * 8 + 4;
     y -= p;
-    p = (h - 3) / 4 + 1;
+    p = h > 2 ? (h - 3) / 4 + 1 : 0;
     if (y < p) /* pass 3 */
         return y * 4 + 2;
     y -= p;
@@ -385,14 +370,31 @@ interlaced_line_index(int h, int y)
     return y * 2 + 1;
 }
 
-/* Decompress image pixels.
+/* Canvas index of the first pixel of the y-th input line, or ROW_NONE if it's outside the canvas. */
+static uint32_t
+frame_row(gd_GIF *gif, int interlace, int y)
+{
+    uint32_t cy;
+
+    if (y >= gif->fh || gif->fx >= gif->width)
+        return ROW_NONE;
+    cy = gif->fy + (interlace ? interlaced_line_index((int) gif->fh, y) : y);
+    if (cy >= gif->height)
+        return ROW_NONE;
+    return cy * gif->width + gif->fx;
+}
+
+/* Decompress image pixels straight into the canvas, skipping transparent ones.
  * Return 0 on success or -1 on out-of-memory (w.r.t. LZW code table). */
 static int
 read_image_data(gd_GIF *gif, int interlace)
 {
-    uint8_t sub_len, shift, byte;
+    Reader rd;
+    uint8_t byte;
+    uint8_t str[0x1000];
     int init_key_size, key_size, table_is_full=0;
-    int frm_off, frm_size, str_len=0, i, p, x, y;
+    int frm_off, frm_size, str_len=0, i, x, y, clip_w;
+    uint32_t row;
     uint16_t key, clear, stop;
     int ret;
     Table *table;
@@ -405,16 +407,25 @@ read_image_data(gd_GIF *gif, int interlace)
     discard_sub_blocks(gif);
     end = f_gif_seek(gif, 0, LV_FS_SEEK_CUR);
     f_gif_seek(gif, start, LV_FS_SEEK_SET);
+    if (key_size < 1 || key_size > 11) {
+        f_gif_seek(gif, end, LV_FS_SEEK_SET);
+        return 0;
+    }
     clear = 1 << key_size;
     stop = clear + 1;
     table = new_table(key_size);
+    if (!table) return -1;
     key_size++;
     init_key_size = key_size;
-    sub_len = shift = 0;
-    key = get_key(gif, key_size, &sub_len, &shift, &byte); /* clear code */
+    memset(&rd, 0, sizeof(rd));
+    key = get_key(gif, key_size, &rd); /* clear code */
     frm_off = 0;
     ret = 0;
     frm_size = gif->fw*gif->fh;
+    /* Output position in the frame: pixel x of input line y */
+    x = y = 0;
+    clip_w = gif->fx < gif->width ? MIN(gif->fw, gif->width - gif->fx) : 0;
+    row = frame_row(gif, interlace, 0);
     while (frm_off < frm_size) {
         if (key == clear) {
             key_size = init_key_size;
@@ -431,34 +442,114 @@ read_image_data(gd_GIF *gif, int interlace)
                 table_is_full = 1;
             }
         }
-        key = get_key(gif, key_size, &sub_len, &shift, &byte);
+        key = get_key(gif, key_size, &rd);
         if (key == clear) continue;
-        if (key == stop || key == 0x1000) break;
+        if (key == stop || key == 0x1000 || key >= table->nentries) break;
         if (ret == 1) key_size++;
         entry = table->entries[key];
         str_len = entry.length;
-        for (i = 0; i < str_len; i++) {
-            p = frm_off + entry.length - 1;
-            x = p % gif->fw;
-            y = p / gif->fw;
-            if (interlace)
-                y = interlaced_line_index((int) gif->fh, y);
-            gif->frame[(gif->fy + y) * gif->width + gif->fx + x] = entry.suffix;
+        /* The prefix chain yields the string back to front. */
+        for (i = str_len - 1; i >= 0; i--) {
+            str[i] = entry.suffix;
             if (entry.prefix == 0xFFF)
                 break;
             else
                 entry = table->entries[entry.prefix];
         }
+        for (i = 0; i < str_len && row != ROW_NONE; i++) {
+            if (x < clip_w && !(gif->gce.transparency && str[i] == gif->gce.tindex))
+                canvas_set(gif, row + x, str[i], 0xff);
+            if (++x == gif->fw) {
+                x = 0;
+                row = frame_row(gif, interlace, ++y);
+            }
+        }
         frm_off += str_len;
         if (key < table->nentries - 1 && !table_is_full)
             table->entries[table->nentries - 1].suffix = entry.suffix;
     }
     lv_mem_free(table);
-    if (key == stop) f_gif_read(gif, &sub_len, 1); /* Must be zero! */
     f_gif_seek(gif, end, LV_FS_SEEK_SET);
     return 0;
 }
 
+/* Clip the frame rectangle to the canvas. Return false if nothing is left. */
+static bool
+frame_area(gd_GIF *gif, uint16_t *x, uint16_t *y, uint16_t *w, uint16_t *h)
+{
+    if (gif->fx >= gif->width || gif->fy >= gif->height || gif->fw == 0 || gif->fh == 0)
+        return false;
+    *x = gif->fx;
+    *y = gif->fy;
+    *w = MIN(gif->fw, gif->width - gif->fx);
+    *h = MIN(gif->fh, gif->height - gif->fy);
+    return true;
+}
+
+/* Save (or restore) the canvas under the frame for "restore to previous" disposal. */
+static void
+backup_frame_area(gd_GIF *gif, bool restore)
+{
+    uint16_t x, y, w, h, j;
+    uint32_t need, i;
+    uint8_t *p;
+
+    if (!frame_area(gif, &x, &y, &w, &h))
+        return;
+    need = (uint32_t) w * h * CANVAS_PX_SIZE;
+    if (restore) {
+        if (gif->backup_size < need) return;
+    } else if (gif->backup_size < need) {
+        p = lv_mem_realloc(gif->backup, need);
+        if (!p) return;
+        gif->backup = p;
+        gif->backup_size = need;
+    }
+
+    p = gif->backup;
+    for (j = 0; j < h; j++) {
+        i = (uint32_t) (y + j) * gif->width + x;
+#if LV_COLOR_DEPTH == 16
+        if (restore) {
+            memcpy(&gif->canvas[i * 2], p, w * 2);
+            memcpy(&gif->alpha[i], p + w * 2, w);
+        } else {
+            memcpy(p, &gif->canvas[i * 2], w * 2);
+            memcpy(p + w * 2, &gif->alpha[i], w);
+        }
+#else
+        if (restore)
+            memcpy(&gif->canvas[i * CANVAS_PX_SIZE], p, w * CANVAS_PX_SIZE);
+        else
+            memcpy(p, &gif->canvas[i * CANVAS_PX_SIZE], w * CANVAS_PX_SIZE);
+#endif
+        p += w * CANVAS_PX_SIZE;
+    }
+}
+
+/* Grow the dirty area by the frame rectangle. */
+static void
+dirty_add_frame(gd_GIF *gif)
+{
+    uint16_t x, y, w, h, x2, y2;
+
+    if (!frame_area(gif, &x, &y, &w, &h))
+        return;
+    if (gif->dirty_w == 0) {
+        gif->dirty_x = x;
+        gif->dirty_y = y;
+        gif->dirty_w = w;
+        gif->dirty_h = h;
+        return;
+    }
+    x2 = MAX(gif->dirty_x + gif->dirty_w, x + w);
+    y2 = MAX(gif->dirty_y + gif->dirty_h, y + h);
+    gif->dirty_x = MIN(gif->dirty_x, x);
+    gif->dirty_y = MIN(gif->dirty_y, y);
+    gif->dirty_w = x2 - gif->dirty_x;
+    gif->dirty_h = y2 - gif->dirty_y;
+}
+
 /* Read image.
  * Return 0 on success or -1 on out-of-memory (w.r.t. LZW code table). */
 static int
@@ -480,92 +571,82 @@ read_image(gd_GIF *gif)
         /* Read LCT */
         gif->lct.size = 1 << ((fisrz & 0x07) + 1);
         f_gif_read(gif, gif->lct.colors, 3 * gif->lct.size);
+        palette_convert(&gif->lct);
         gif->palette = &gif->lct;
     } else
         gif->palette = &gif->gct;
+    if (gif->gce.disposal == 3)
+        backup_frame_area(gif, false);
+    dirty_add_frame(gif);
     /* Image Data. */
     return read_image_data(gif, interlace);
 }
 
+/* Convert the palette once so frames are rendered with a table lookup. */
 static void
-render_frame_rect(gd_GIF *gif, uint8_t *buffer)
+palette_convert(gd_Palette *pal)
+{
+#if LV_COLOR_DEPTH == 16
+    lv_color_conv_rgb888_to_rgb565((uint8_t *) pal->colors565, pal->colors, pal->size, LV_COLOR_CONV_NATIVE);
+#else
+    LV_UNUSED(pal);
+#endif
+}
+
+/* Set the i-th canvas pixel to a palette color. */
+static inline void
+canvas_set(gd_GIF *gif, uint32_t i, uint8_t index, uint8_t opa)
 {
-    int i, j, k;
-    uint8_t index, *color;
-    i = gif->fy * gif->width + gif->fx;
-    for (j = 0; j < gif->fh; j++) {
-        for (k = 0; k < gif->fw; k++) {
-            index = gif->frame[(gif->fy + j) * gif->width + gif->fx + k];
-            color = &gif->palette->colors[index*3];
-            if (!gif->gce.transparency || index != gif->gce.tindex) {
+#if LV_COLOR_DEPTH == 16
+    ((uint16_t *) gif->canvas)[i] = gif->palette->colors565[index];
+    gif->alpha[i] = opa;
+#else
+    uint8_t *color = &gif->palette->colors[index*3];
 #if LV_COLOR_DEPTH == 32
-                buffer[(i+k)*4 + 0] = *(color + 2);
-                buffer[(i+k)*4 + 1] = *(color + 1);
-                buffer[(i+k)*4 + 2] = *(color + 0);
-                buffer[(i+k)*4 + 3] = 0xFF;
-#elif LV_COLOR_DEPTH == 16
-                lv_color_t c = lv_color_make(*(color + 0), *(color + 1), *(color + 2));
-                buffer[(i+k)*3 + 0] = c.full & 0xff;
-                buffer[(i+k)*3 + 1] = (c.full >> 8) & 0xff;
-                buffer[(i+k)*3 + 2] = 0xff;
+    gif->canvas[i*4 + 0] = *(color + 2);
+    gif->canvas[i*4 + 1] = *(color + 1);
+    gif->canvas[i*4 + 2] = *(color + 0);
+    gif->canvas[i*4 + 3] = opa;
 #elif LV_COLOR_DEPTH == 8
-                lv_color_t c = lv_color_make(*(color + 0), *(color + 1), *(color + 2));
-                buffer[(i+k)*2 + 0] = c.full;
-                buffer[(i+k)*2 + 1] = 0xff;
+    lv_color_t c = lv_color_make(*(color + 0), *(color + 1), *(color + 2));
+    gif->canvas[i*2 + 0] = c.full;
+    gif->canvas[i*2 + 1] = opa;
 #elif LV_COLOR_DEPTH == 1
-                uint8_t b = (*(color + 0)) | (*(color + 1)) | (*(color + 2));
-                buffer[(i+k)*2 + 0] = b > 128 ? 1 : 0;
-                buffer[(i+k)*2 + 1] = 0xff;
+    uint8_t b = (*(color + 0)) | (*(color + 1)) | (*(color + 2));
+    gif->canvas[i*2 + 0] = b > 128 ? 1 : 0;
+    gif->canvas[i*2 + 1] = opa;
+#endif
 #endif
-            }
-        }
-        i += gif->width;
-    }
 }
 
+/* Undo the previous frame as requested by its Graphic Control Extension. */
 static void
-dispose(gd_GIF *gif)
+dispose(gd_GIF *gif, const gd_GCE *gce)
 {
-    int i, j, k;
-    uint8_t *bgcolor;
-    switch (gif->gce.disposal) {
-    case 2: /* Restore to background color. */
-        bgcolor = &gif->palette->colors[gif->bgindex*3];
+    uint16_t x, y, w, h, j, k;
+    uint32_t i;
 
+    switch (gce->disposal) {
+    case 2: /* Restore to background color. */
+        if (!frame_area(gif, &x, &y, &w, &h))
+            break;
         uint8_t opa = 0xff;
-        if(gif->gce.transparency) opa = 0x00;
+        if(gce->transparency) opa = 0x00;
 
-        i = gif->fy * gif->width + gif->fx;
-        for (j = 0; j < gif->fh; j++) {
-            for (k = 0; k < gif->fw; k++) {
-#if LV_COLOR_DEPTH == 32
-                gif->canvas[(i+k)*4 + 0] = *(bgcolor + 2);
-                gif->canvas[(i+k)*4 + 1] = *(bgcolor + 1);
-                gif->canvas[(i+k)*4 + 2] = *(bgcolor + 0);
-                gif->canvas[(i+k)*4 + 3] = opa;
-#elif LV_COLOR_DEPTH == 16
-                lv_color_t c = lv_color_make(*(bgcolor + 0), *(bgcolor + 1), *(bgcolor + 2));
-                gif->canvas[(i+k)*3 + 0] = c.full & 0xff;
-                gif->canvas[(i+k)*3 + 1] = (c.full >> 8) & 0xff;
-                gif->canvas[(i+k)*3 + 2] = opa;
-#elif LV_COLOR_DEPTH == 8
-                lv_color_t c = lv_color_make(*(bgcolor + 0), *(bgcolor + 1), *(bgcolor + 2));
-                gif->canvas[(i+k)*2 + 0] = c.full;
-                gif->canvas[(i+k)*2 + 1] = opa;
-#elif LV_COLOR_DEPTH == 1
-                uint8_t b = (*(bgcolor + 0)) | (*(bgcolor + 1)) | (*(bgcolor + 2));
-                gif->canvas[(i+k)*2 + 0] = b > 128 ? 1 : 0;
-                gif->canvas[(i+k)*2 + 1] = opa;
-#endif
-            }
-            i += gif->width;
+        for (j = 0; j < h; j++) {
+            i = (uint32_t) (y + j) * gif->width + x;
+            for (k = 0; k < w; k++)
+                canvas_set(gif, i + k, gif->bgindex, opa);
         }
+        dirty_add_frame(gif);
         break;
-    case 3: /* Restore to previous, i.e., don't update canvas.*/
+    case 3: /* Restore to previous. */
+        backup_frame_area(gif, true);
+        dirty_add_frame(gif);
         break;
     default:
-        /* Add frame non-transparent pixels to canvas. */
-        render_frame_rect(gif, gif->canvas);
+        /* Leave the frame on the canvas. */
+        break;
     }
 }
 
@@ -574,8 +655,9 @@ int
 gd_get_frame(gd_GIF *gif)
 {
     char sep;
+    gd_GCE prev_gce = gif->gce;
 
-    dispose(gif);
+    gif->dirty_w = gif->dirty_h = 0;
     f_gif_read(gif, &sep, 1);
     while (sep != ',') {
         if (sep == ';') {
@@ -592,26 +674,13 @@ gd_get_frame(gd_GIF *gif)
         else return -1;
         f_gif_read(gif, &sep, 1);
     }
+    /* Dispose only when a new frame follows, the last one stays on the canvas. */
+    dispose(gif, &prev_gce);
     if (read_image(gif) == -1)
         return -1;
     return 1;
 }
 
-void
-gd_render_frame(gd_GIF *gif, uint8_t *buffer)
-{
-//    uint32_t i;
-//    uint32_t j;
-//    for(i = 0, j = 0; i < gif->width * gif->height * 3; i+= 3, j+=4) {
-//        buffer[j + 0] = gif->canvas[i + 2];
-//        buffer[j + 1] = gif->canvas[i + 1];
-//        buffer[j + 2] = gif->canvas[i + 0];
-//        buffer[j + 3] = 0xFF;
-//    }
-//    memcpy(buffer, gif->canvas, gif->width * gif->height * 3);
-    render_frame_rect(gif, buffer);
-}
-
 void
 gd_rewind(gd_GIF *gif)
 {
@@ -623,6 +692,7 @@ void
 gd_close_gif(gd_GIF *gif)
 {
     f_gif_close(gif);
+    lv_mem_free(gif->backup);
     lv_mem_free(gif);
 }
 
@@ -9,6 +9,9 @@
 typedef struct gd_Palette {
     int size;
     uint8_t colors[0x100 * 3];
+#if LV_COLOR_DEPTH == 16
+    uint16_t colors565[0x100];      /* `colors` converted once to the display's format */
+#endif
 } gd_Palette;
 
 typedef struct gd_GCE {
@@ -42,15 +45,22 @@ typedef struct gd_GIF {
     void (*application)(struct gd_GIF *gif, char id[8], char auth[3]);
     uint16_t fx, fy, fw, fh;
     uint8_t bgindex;
-    uint8_t *canvas, *frame;
+    /* LV_COLOR_DEPTH 16: RGB565A8, i.e. width * height colors followed by the alpha plane.
+     * Other depths: LV_IMG_CF_TRUE_COLOR_ALPHA. Frames are decoded into it directly. */
+    uint8_t *canvas;
+#if LV_COLOR_DEPTH == 16
+    uint8_t *alpha;                 /* alpha plane of `canvas` */
+#endif
+    uint8_t *backup;                /* canvas under the current frame if it's disposed with "restore to previous" */
+    uint32_t backup_size;
+    /* Canvas area changed by the last gd_get_frame(), dirty_w == 0 if nothing changed */
+    uint16_t dirty_x, dirty_y, dirty_w, dirty_h;
 } gd_GIF;
 
 gd_GIF * gd_open_gif_file(const char *fname);
 
 gd_GIF * gd_open_gif_data(const void *data);
 
-void gd_render_frame(gd_GIF *gif, uint8_t *buffer);
-
 int gd_get_frame(gd_GIF *gif);
 void gd_rewind(gd_GIF *gif);
 void gd_close_gif(gd_GIF *gif);
@@ -16,6 +16,10 @@
  *********************/
 #define MY_CLASS    &lv_gif_class
 
+/*Like browsers, show frames with a shorter delay (usually 0 or 10 ms) for 100 ms*/
+#define GIF_MIN_DELAY       20
+#define GIF_DEFAULT_DELAY   100
+
 /**********************
  *      TYPEDEFS
  **********************/
@@ -26,6 +30,7 @@
 static void lv_gif_constructor(const lv_obj_class_t * class_p, lv_obj_t * obj);
 static void lv_gif_destructor(const lv_obj_class_t * class_p, lv_obj_t * obj);
 static void next_frame_task_cb(lv_timer_t * t);
+static void invalidate_dirty_area(lv_obj_t * obj);
 
 /**********************
  *  STATIC VARIABLES
@@ -78,19 +83,24 @@ void lv_gif_set_src(lv_obj_t * obj, const void * src)
         return;
     }
 
+    /*The decoder renders the frames right into the canvas*/
     gifobj->imgdsc.data = gifobj->gif->canvas;
     gifobj->imgdsc.header.always_zero = 0;
+#if LV_COLOR_DEPTH == 16
+    gifobj->imgdsc.header.cf = LV_IMG_CF_RGB565A8;
+#else
     gifobj->imgdsc.header.cf = LV_IMG_CF_TRUE_COLOR_ALPHA;
+#endif
     gifobj->imgdsc.header.h = gifobj->gif->height;
     gifobj->imgdsc.header.w = gifobj->gif->width;
+    gifobj->imgdsc.data_size = (uint32_t)gifobj->gif->width * gifobj->gif->height * LV_IMG_PX_SIZE_ALPHA_BYTE;
     gifobj->last_call = lv_tick_get();
 
     lv_img_set_src(obj, &gifobj->imgdsc);
 
     lv_timer_resume(gifobj->timer);
-    lv_timer_reset(gifobj->timer);
-
     next_frame_task_cb(gifobj->timer);
+    lv_timer_reset(gifobj->timer);
 
 }
 
@@ -113,7 +123,7 @@ static void lv_gif_constructor(const lv_obj_class_t * class_p, lv_obj_t * obj)
     lv_gif_t * gifobj = (lv_gif_t *) obj;
 
     gifobj->gif = NULL;
-    gifobj->timer = lv_timer_create(next_frame_task_cb, 10, obj);
+    gifobj->timer = lv_timer_create(next_frame_task_cb, GIF_DEFAULT_DELAY, obj);
     lv_timer_pause(gifobj->timer);
 }
 
@@ -127,27 +137,62 @@ static void lv_gif_destructor(const lv_obj_class_t * class_p, lv_obj_t * obj)
     lv_timer_del(gifobj->timer);
 }
 
+/**
+ * Decode the next frame, then sleep until it has to be replaced.
+ * The timer's period follows the frame delays, so nothing runs between two frames.
+ */
 static void next_frame_task_cb(lv_timer_t * t)
 {
     lv_obj_t * obj = t->user_data;
     lv_gif_t * gifobj = (lv_gif_t *) obj;
-    uint32_t elaps = lv_tick_elaps(gifobj->last_call);
-    if(elaps < gifobj->gif->gce.delay * 10) return;
 
     gifobj->last_call = lv_tick_get();
 
     int has_next = gd_get_frame(gifobj->gif);
     if(has_next == 0) {
-        /*It was the last repeat*/
-        lv_res_t res = lv_event_send(obj, LV_EVENT_READY, NULL);
+        /*It was the last repeat, the last frame stays on the canvas*/
         lv_timer_pause(t);
-        if(res != LV_FS_RES_OK) return;
+        lv_event_send(obj, LV_EVENT_READY, NULL);
+        return;
+    }
+    if(has_next < 0) {
+        LV_LOG_WARN("Invalid frame, stopping");
+        lv_timer_pause(t);
+        return;
     }
-
-    gd_render_frame(gifobj->gif, (uint8_t *)gifobj->imgdsc.data);
 
     lv_img_cache_invalidate_src(lv_img_get_src(obj));
-    lv_obj_invalidate(obj);
+    invalidate_dirty_area(obj);
+
+    uint32_t delay = gifobj->gif->gce.delay * 10;
+    if(delay < GIF_MIN_DELAY) delay = GIF_DEFAULT_DELAY;
+    lv_timer_set_period(t, delay);
+}
+
+/**
+ * Redraw only the part of the canvas changed by the last frame.
+ * Falls back to the whole object if the image is transformed, shifted or tiled.
+ */
+static void invalidate_dirty_area(lv_obj_t * obj)
+{
+    lv_img_t * img = (lv_img_t *) obj;
+    const gd_GIF * gif = ((lv_gif_t *) obj)->gif;
+
+    if(gif->dirty_w == 0 || gif->dirty_h == 0) return;
+
+    if(img->zoom != LV_IMG_ZOOM_NONE || img->angle != 0 || img->offset.x != 0 || img->offset.y != 0 ||
+       lv_obj_get_content_width(obj) != img->w || lv_obj_get_content_height(obj) != img->h) {
+        lv_obj_invalidate(obj);
+        return;
+    }
+
+    lv_coord_t border = lv_obj_get_style_border_width(obj, LV_PART_MAIN);
+    lv_area_t a;
+    a.x1 = obj->coords.x1 + lv_obj_get_style_pad_left(obj, LV_PART_MAIN) + border + gif->dirty_x;
+    a.y1 = obj->coords.y1 + lv_obj_get_style_pad_top(obj, LV_PART_MAIN) + border + gif->dirty_y;
+    a.x2 = a.x1 + gif->dirty_w - 1;
+    a.y2 = a.y1 + gif->dirty_h - 1;
+    lv_obj_invalidate_area(obj, &a);
 }
 
 #endif /*LV_USE_GIF*/
@@ -0,0 +1,428 @@
+/**
+ * @file lv_imgpack.c
+ *
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include "../../../lvgl.h"
+#if LV_USE_IMGPACK
+
+#include "lv_imgpack.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*********************
+ *      DEFINES
+ *********************/
+#define PACK_EXT        ".lvpk/"
+#define PACK_PATH_MAX   256
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+typedef struct {
+    char * path;                        /*Resolved file system path*/
+    const uint8_t * base;               /*Start of the mapping*/
+    size_t size;
+    const lv_imgpack_entry_t * entries;
+    uint16_t count;
+} pack_t;
+
+typedef struct {
+    const lv_imgpack_entry_t * entry;
+    const uint8_t * data;               /*Compressed data of the image in the mapping*/
+    uint8_t * tile_buf;                 /*The last decompressed tile*/
+    int32_t tile_id;                    /*Index of the tile in `tile_buf`, -1: none*/
+} pack_img_t;
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+static lv_res_t decoder_info(struct _lv_img_decoder_t * decoder, const void * src, lv_img_header_t * header);
+static lv_res_t decoder_open(lv_img_decoder_t * dec, lv_img_decoder_dsc_t * dsc);
+static lv_res_t decoder_read_line(lv_img_decoder_t * decoder, lv_img_decoder_dsc_t * dsc, lv_coord_t x, lv_coord_t y,
+                                  lv_coord_t len, uint8_t * buf);
+static void decoder_close(lv_img_decoder_t * dec, lv_img_decoder_dsc_t * dsc);
+static const lv_imgpack_entry_t * find_image(const char * pack_path, uint32_t path_len, const char * name,
+                                             const pack_t ** pack);
+static const lv_imgpack_entry_t * find_image_src(const char * src, const pack_t ** pack);
+static const pack_t * get_pack(const char * pack_path, uint32_t path_len);
+static bool resolve_path(const char * path, uint32_t path_len, char * buf, uint32_t buf_size);
+static bool entry_is_valid(const lv_imgpack_entry_t * e, size_t file_size, const uint8_t * base);
+static uint32_t entry_px_size(const lv_imgpack_entry_t * e);
+static lv_img_cf_t entry_get_cf(const lv_imgpack_entry_t * e);
+static int32_t lz4_decompress(const uint8_t * src, uint32_t src_size, uint8_t * dst, uint32_t dst_size);
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+static lv_ll_t packs_ll;
+
+/**********************
+ *      MACROS
+ **********************/
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+/**
+ * Register the image pack decoder in LVGL
+ */
+void lv_imgpack_init(void)
+{
+    _lv_ll_init(&packs_ll, sizeof(pack_t));
+
+    lv_img_decoder_t * dec = lv_img_decoder_create();
+    lv_img_decoder_set_info_cb(dec, decoder_info);
+    lv_img_decoder_set_open_cb(dec, decoder_open);
+    lv_img_decoder_set_read_line_cb(dec, decoder_read_line);
+    lv_img_decoder_set_close_cb(dec, decoder_close);
+}
+
+lv_res_t lv_imgpack_get_dsc(const char * pack_path, const char * name, lv_img_dsc_t * dsc)
+{
+    const pack_t * pack;
+    const lv_imgpack_entry_t * e = find_image(pack_path, strlen(pack_path), name, &pack);
+    if(e == NULL || e->comp != LV_IMGPACK_COMP_NONE) return LV_RES_INV;
+
+    lv_memset_00(dsc, sizeof(lv_img_dsc_t));
+    dsc->header.cf = entry_get_cf(e);
+    dsc->header.w = e->w;
+    dsc->header.h = e->h;
+    dsc->data_size = e->raw_size;
+    dsc->data = pack->base + e->data_ofs;
+    return LV_RES_OK;
+}
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+/**
+ * Get info about an image in a pack
+ * @param src "<pack path>.lvpk/<name>"
+ * @param header store the info here
+ * @return LV_RES_OK: no error; LV_RES_INV: can't get the info
+ */
+static lv_res_t decoder_info(struct _lv_img_decoder_t * decoder, const void * src, lv_img_header_t * header)
+{
+    LV_UNUSED(decoder);
+    if(lv_img_src_get_type(src) != LV_IMG_SRC_FILE) return LV_RES_INV;
+
+    const pack_t * pack;
+    const lv_imgpack_entry_t * e = find_image_src(src, &pack);
+    if(e == NULL) return LV_RES_INV;
+
+    header->always_zero = 0;
+    header->cf = entry_get_cf(e);
+    header->w = e->w;
+    header->h = e->h;
+    return LV_RES_OK;
+}
+
+/**
+ * Open an image from a pack. Uncompressed images are returned as a pointer into the mapping.
+ * @param dsc decoded image descriptor
+ * @return LV_RES_OK: no error; LV_RES_INV: can't open the image
+ */
+static lv_res_t decoder_open(lv_img_decoder_t * decoder, lv_img_decoder_dsc_t * dsc)
+{
+    LV_UNUSED(decoder);
+    if(dsc->src_type != LV_IMG_SRC_FILE) return LV_RES_INV;
+
+    const pack_t * pack;
+    const lv_imgpack_entry_t * e = find_image_src(dsc->src, &pack);
+    if(e == NULL) return LV_RES_INV;
+
+    if(e->comp == LV_IMGPACK_COMP_NONE) {
+        dsc->img_data = pack->base + e->data_ofs;  /*Zero copy*/
+        return LV_RES_OK;
+    }
+
+    /*Compressed: decompress a tile at a time in `read_line`*/
+    pack_img_t * img = lv_mem_alloc(sizeof(pack_img_t));
+    if(img == NULL) return LV_RES_INV;
+    img->tile_buf = lv_mem_alloc((uint32_t)e->tile_rows * e->w * (entry_px_size(e)));
+    if(img->tile_buf == NULL) {
+        lv_mem_free(img);
+        return LV_RES_INV;
+    }
+    img->entry = e;
+    img->data = pack->base + e->data_ofs;
+    img->tile_id = -1;
+
+    dsc->user_data = img;
+    dsc->img_data = NULL;
+    return LV_RES_OK;
+}
+
+/**
+ * Read a line of a compressed image. RGB565A8 lines are planar too: `len` colors followed by `len` alpha values.
+ */
+static lv_res_t decoder_read_line(lv_img_decoder_t * decoder, lv_img_decoder_dsc_t * dsc, lv_coord_t x, lv_coord_t y,
+                                  lv_coord_t len, uint8_t * buf)
+{
+    LV_UNUSED(decoder);
+    pack_img_t * img = dsc->user_data;
+    if(img == NULL) return LV_RES_INV;
+
+    const lv_imgpack_entry_t * e = img->entry;
+    int32_t tile_id = y / e->tile_rows;
+    uint32_t tile_y = (uint32_t)tile_id * e->tile_rows;
+    uint32_t tile_h = LV_MIN(e->tile_rows, e->h - tile_y);
+    uint32_t px_size = entry_px_size(e);
+
+    if(img->tile_id != tile_id) {
+        const uint32_t * ofs = (const uint32_t *)img->data;
+        int32_t res = lz4_decompress(img->data + ofs[tile_id], ofs[tile_id + 1] - ofs[tile_id],
+                                     img->tile_buf, tile_h * e->w * px_size);
+        if(res != 0) {
+            img->tile_id = -1;
+            LV_LOG_WARN("corrupted tile %d", (int)tile_id);
+            return LV_RES_INV;
+        }
+        img->tile_id = tile_id;
+    }
+
+    uint32_t row = y - tile_y;
+    lv_memcpy(buf, img->tile_buf + (row * e->w + x) * 2, len * 2);
+    if(e->cf == LV_IMGPACK_CF_RGB565A8) {
+        const uint8_t * alpha = img->tile_buf + tile_h * e->w * 2;
+        lv_memcpy(buf + len * 2, alpha + row * e->w + x, len);
+    }
+    return LV_RES_OK;
+}
+
+/**
+ * Free the allocated resources
+ */
+static void decoder_close(lv_img_decoder_t * decoder, lv_img_decoder_dsc_t * dsc)
+{
+    LV_UNUSED(decoder);
+    pack_img_t * img = dsc->user_data;
+    if(img) {
+        lv_mem_free(img->tile_buf);
+        lv_mem_free(img);
+        dsc->user_data = NULL;
+    }
+    dsc->img_data = NULL;   /*Points into the mapping, nothing to free*/
+}
+
+/**
+ * Split "<pack path>.lvpk/<name>" and look up the image
+ */
+static const lv_imgpack_entry_t * find_image_src(const char * src, const pack_t ** pack)
+{
+    const char * ext = strstr(src, PACK_EXT);
+    if(ext == NULL) return NULL;
+
+    uint32_t path_len = ext - src + sizeof(PACK_EXT) - 2;   /*Up to and including "lvpk"*/
+    return find_image(src, path_len, src + path_len + 1, pack);
+}
+
+static const lv_imgpack_entry_t * find_image(const char * pack_path, uint32_t path_len, const char * name,
+                                             const pack_t ** pack)
+{
+    const pack_t * p = get_pack(pack_path, path_len);
+    if(p == NULL) return NULL;
+
+    /*The entries are sorted by name*/
+    int32_t lo = 0;
+    int32_t hi = (int32_t)p->count - 1;
+    while(lo <= hi) {
+        int32_t mid = (lo + hi) / 2;
+        int cmp = strncmp(name, p->entries[mid].name, LV_IMGPACK_NAME_MAX);
+        if(cmp == 0) {
+            *pack = p;
+            return &p->entries[mid];
+        }
+        if(cmp < 0) hi = mid - 1;
+        else lo = mid + 1;
+    }
+    return NULL;
+}
+
+/**
+ * Get a pack from the list of mapped packs or map it now
+ */
+static const pack_t * get_pack(const char * pack_path, uint32_t path_len)
+{
+    char path[PACK_PATH_MAX];
+    if(!resolve_path(pack_path, path_len, path, sizeof(path))) return NULL;
+
+    pack_t * p;
+    _LV_LL_READ(&packs_ll, p) {
+        if(strcmp(p->path, path) == 0) return p;
+    }
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if(fd < 0) return NULL;
+
+    struct stat st;
+    if(fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(lv_imgpack_header_t)) {
+        close(fd);
+        return NULL;
+    }
+
+    size_t size = st.st_size;
+    const uint8_t * base = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);  /*The mapping keeps the file referenced*/
+    if(base == MAP_FAILED) return NULL;
+
+    /*Validate everything once so that drawing doesn't have to*/
+    const lv_imgpack_header_t * hdr = (const lv_imgpack_header_t *)base;
+    bool ok = memcmp(hdr->magic, LV_IMGPACK_MAGIC, 4) == 0 && hdr->version == LV_IMGPACK_VERSION &&
+              hdr->index_ofs % 4 == 0 &&
+              (uint64_t)hdr->index_ofs + (uint64_t)hdr->count * sizeof(lv_imgpack_entry_t) <= size;
+    const lv_imgpack_entry_t * entries = (const lv_imgpack_entry_t *)(base + (ok ? hdr->index_ofs : 0));
+    for(uint32_t i = 0; ok && i < hdr->count; i++) {
+        ok = entry_is_valid(&entries[i], size, base);
+    }
+
+    if(ok) p = _lv_ll_ins_head(&packs_ll);
+    if(p) p->path = lv_mem_alloc(strlen(path) + 1);
+    if(!ok || p == NULL || p->path == NULL) {
+        if(!ok) LV_LOG_WARN("invalid image pack: %s", path);
+        if(p) _lv_ll_remove(&packs_ll, p);
+        lv_mem_free(p);
+        munmap((void *)base, size);
+        return NULL;
+    }
+
+    strcpy(p->path, path);
+    p->base = base;
+    p->size = size;
+    p->entries = entries;
+    p->count = hdr->count;
+    LV_LOG_INFO("mapped %s: %d images", path, (int)p->count);
+    return p;
+}
+
+/**
+ * Turn an LVGL path into a file system path. Only the POSIX driver's letter and absolute paths can be mapped.
+ */
+static bool resolve_path(const char * path, uint32_t path_len, char * buf, uint32_t buf_size)
+{
+    const char * prefix = "";
+    if(path_len >= 2 && path[1] == ':') {
+#if LV_USE_FS_POSIX
+        if(path[0] != LV_FS_POSIX_LETTER) return false;
+        prefix = LV_FS_POSIX_PATH;
+        path += 2;
+        path_len -= 2;
+#else
+        return false;
+#endif
+    }
+
+    uint32_t prefix_len = strlen(prefix);
+    if(prefix_len + path_len + 1 > buf_size) return false;
+    lv_memcpy(buf, prefix, prefix_len);
+    lv_memcpy(buf + prefix_len, path, path_len);
+    buf[prefix_len + path_len] = '\0';
+    return true;
+}
+
+static bool entry_is_valid(const lv_imgpack_entry_t * e, size_t file_size, const uint8_t * base)
+{
+    if(e->name[LV_IMGPACK_NAME_MAX - 1] != '\0') return false;
+    if(e->cf != LV_IMGPACK_CF_RGB565 && e->cf != LV_IMGPACK_CF_RGB565A8) return false;
+    if(e->w == 0 || e->h == 0 || e->w > LV_IMGPACK_SIZE_MAX || e->h > LV_IMGPACK_SIZE_MAX) return false;
+    if(e->data_ofs % 4) return false;
+    if((uint64_t)e->data_ofs + e->data_size > file_size) return false;
+    if(e->raw_size != (uint32_t)e->w * e->h * entry_px_size(e)) return false;
+
+    if(e->comp == LV_IMGPACK_COMP_NONE) return e->data_size == e->raw_size;
+    if(e->comp != LV_IMGPACK_COMP_LZ4 || e->tile_rows == 0) return false;
+
+    uint32_t tile_cnt = (e->h + e->tile_rows - 1) / e->tile_rows;
+    uint32_t table_size = (tile_cnt + 1) * sizeof(uint32_t);
+    if(table_size > e->data_size) return false;
+
+    const uint32_t * ofs = (const uint32_t *)(base + e->data_ofs);
+    if(ofs[0] != table_size || ofs[tile_cnt] != e->data_size) return false;
+    for(uint32_t i = 0; i < tile_cnt; i++) {
+        if(ofs[i + 1] < ofs[i]) return false;
+    }
+    return true;
+}
+
+static uint32_t entry_px_size(const lv_imgpack_entry_t * e)
+{
+    return e->cf == LV_IMGPACK_CF_RGB565A8 ? 3 : 2;
+}
+
+static lv_img_cf_t entry_get_cf(const lv_imgpack_entry_t * e)
+{
+    return e->cf == LV_IMGPACK_CF_RGB565A8 ? LV_IMG_CF_RGB565A8 : LV_IMG_CF_TRUE_COLOR;
+}
+
+/**
+ * Decompress an LZ4 block. Every access is bounds checked so a corrupted file can't write out of `dst`.
+ * @return 0: `dst` was filled completely; -1: corrupted data
+ */
+static int32_t lz4_decompress(const uint8_t * src, uint32_t src_size, uint8_t * dst, uint32_t dst_size)
+{
+    const uint8_t * ip = src;
+    const uint8_t * iend = src + src_size;
+    uint8_t * op = dst;
+    uint8_t * oend = dst + dst_size;
+
+    while(ip < iend) {
+        uint32_t token = *ip++;
+
+        /*Literals*/
+        uint32_t len = token >> 4;
+        if(len == 15) {
+            uint8_t b;
+            do {
+                if(ip >= iend) return -1;
+                b = *ip++;
+                len += b;
+            } while(b == 255);
+        }
+        if(len > (uint32_t)(iend - ip) || len > (uint32_t)(oend - op)) return -1;
+        lv_memcpy(op, ip, len);
+        op += len;
+        ip += len;
+
+        if(ip == iend) break;   /*The last sequence has only literals*/
+
+        /*Match*/
+        if(iend - ip < 2) return -1;
+        uint32_t offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        if(offset == 0 || offset > (uint32_t)(op - dst)) return -1;
+
+        len = token & 0x0F;
+        if(len == 15) {
+            uint8_t b;
+            do {
+                if(ip >= iend) return -1;
+                b = *ip++;
+                len += b;
+            } while(b == 255);
+        }
+        len += 4;
+        if(len > (uint32_t)(oend - op)) return -1;
+
+        const uint8_t * match = op - offset;
+        if(offset >= len) {
+            lv_memcpy(op, match, len);
+            op += len;
+        }
+        else {
+            /*Overlapping match (repeated pattern): copy byte by byte*/
+            while(len--) *op++ = *match++;
+        }
+    }
+
+    return op == oend ? 0 : -1;
+}
+
+#endif /*LV_USE_IMGPACK*/
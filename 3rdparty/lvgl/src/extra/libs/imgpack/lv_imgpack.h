@@ -0,0 +1,63 @@
+/**
+ * @file lv_imgpack.h
+ *
+ */
+
+#ifndef LV_IMGPACK_H
+#define LV_IMGPACK_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include "../../../lv_conf_internal.h"
+#if LV_USE_IMGPACK
+
+#include "../../../draw/lv_img_buf.h"
+#include "lv_imgpack_fmt.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+/**
+ * Register the image pack decoder in LVGL.
+ * An image in a pack is addressed as "<pack path>.lvpk/<name>", e.g. "S:res/ui.lvpk/icon_play".
+ * The pack is mapped into memory on first use and stays mapped.
+ * Uncompressed images are drawn straight from the mapping (no copy, no allocation),
+ * LZ4 compressed ones are decompressed tile by tile while drawing.
+ */
+void lv_imgpack_init(void);
+
+/**
+ * Get an uncompressed image from a pack as a variable image source.
+ * `dsc->data` points into the mapping and stays valid for the lifetime of the program.
+ * @param pack_path path of the pack ("S:..." or an absolute path)
+ * @param name      name of the image in the pack
+ * @param dsc       store the image descriptor here
+ * @return          LV_RES_OK: found; LV_RES_INV: not found, invalid pack or compressed image
+ */
+lv_res_t lv_imgpack_get_dsc(const char * pack_path, const char * name, lv_img_dsc_t * dsc);
+
+/**********************
+ *      MACROS
+ **********************/
+
+#endif /*LV_USE_IMGPACK*/
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /*LV_IMGPACK_H*/
@@ -0,0 +1,69 @@
+/**
+ * @file lv_imgpack_fmt.h
+ * On-disk layout of an image pack (`.lvpk`). Shared by the decoder and the host converter,
+ * so it depends only on <stdint.h>.
+ *
+ * Layout (all fields little endian):
+ *   lv_imgpack_header_t
+ *   lv_imgpack_entry_t[count]       sorted by name (strcmp), binary searchable
+ *   pixel data of each entry        starts on a LV_IMGPACK_ALIGN boundary
+ *
+ * Uncompressed data is exactly what LVGL draws:
+ *   RGB565:   w * h * 2 bytes
+ *   RGB565A8: w * h * 2 bytes of color followed by w * h bytes of alpha
+ *
+ * LZ4 compressed data is split into tiles of `tile_rows` full rows (the last one may be shorter):
+ *   uint32_t ofs[tile_cnt + 1]      offsets relative to the data start, ofs[i + 1] - ofs[i] = size of tile i
+ *   LZ4 blocks                      each tile decompresses to the layout above with `h` = rows of the tile
+ */
+
+#ifndef LV_IMGPACK_FMT_H
+#define LV_IMGPACK_FMT_H
+
+#include <stdint.h>
+
+/*********************
+ *      DEFINES
+ *********************/
+#define LV_IMGPACK_MAGIC        "LVPK"
+#define LV_IMGPACK_VERSION      1
+#define LV_IMGPACK_ALIGN        4096    /*Pixel data is page aligned so it can be used straight from mmap*/
+#define LV_IMGPACK_NAME_MAX     40      /*Including the terminating 0*/
+#define LV_IMGPACK_SIZE_MAX     2047    /*Width and height have 11 bits in lv_img_header_t*/
+
+/*Pixel formats*/
+#define LV_IMGPACK_CF_RGB565    0       /*LV_IMG_CF_TRUE_COLOR with 16 bit color depth*/
+#define LV_IMGPACK_CF_RGB565A8  1       /*LV_IMG_CF_RGB565A8*/
+
+/*Compression*/
+#define LV_IMGPACK_COMP_NONE    0
+#define LV_IMGPACK_COMP_LZ4     1       /*LZ4 block format per tile*/
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+typedef struct {
+    char magic[4];
+    uint16_t version;
+    uint16_t count;         /*Number of entries*/
+    uint32_t index_ofs;     /*Offset of the first lv_imgpack_entry_t*/
+    uint32_t reserved;
+} lv_imgpack_header_t;
+
+typedef struct {
+    char name[LV_IMGPACK_NAME_MAX];
+    uint8_t cf;             /*LV_IMGPACK_CF_...*/
+    uint8_t comp;           /*LV_IMGPACK_COMP_...*/
+    uint16_t tile_rows;     /*Rows per tile if compressed*/
+    uint16_t w;
+    uint16_t h;
+    uint32_t data_ofs;      /*Offset of the pixel data from the start of the file*/
+    uint32_t data_size;     /*Stored size (compressed size incl. the tile table)*/
+    uint32_t raw_size;      /*Size of the decompressed pixel data*/
+    uint32_t reserved;
+} lv_imgpack_entry_t;
+
+typedef char lv_imgpack_header_size_check[sizeof(lv_imgpack_header_t) == 16 ? 1 : -1];
+typedef char lv_imgpack_entry_size_check[sizeof(lv_imgpack_entry_t) == 64 ? 1 : -1];
+
+#endif /*LV_IMGPACK_FMT_H*/
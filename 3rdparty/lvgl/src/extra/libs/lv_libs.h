@@ -19,6 +19,8 @@ extern "C" {
 #include "gif/lv_gif.h"
 #include "qrcode/lv_qrcode.h"
 #include "sjpg/lv_sjpg.h"
+#include "imgpack/lv_imgpack.h"
+#include "qoi/lv_qoi.h"
 #include "freetype/lv_freetype.h"
 #include "rlottie/lv_rlottie.h"
 #include "ffmpeg/lv_ffmpeg.h"
@@ -11,11 +11,15 @@
 
 #include "lv_png.h"
 #include "lodepng.h"
+#include "../../../misc/lv_color_conv.h"
 #include <stdlib.h>
 
 /*********************
  *      DEFINES
  *********************/
+#define PNG_IHDR_END        33  /*Signature + IHDR chunk*/
+#define PNG_COLOR_TYPE_OFS  25  /*Offset of the color type byte in the file*/
+#define PNG_CHUNK_SCAN_MAX  32  /*Max. number of chunks to check for tRNS before giving up*/
 
 /**********************
  *      TYPEDEFS
@@ -27,7 +31,10 @@
 static lv_res_t decoder_info(struct _lv_img_decoder_t * decoder, const void * src, lv_img_header_t * header);
 static lv_res_t decoder_open(lv_img_decoder_t * dec, lv_img_decoder_dsc_t * dsc);
 static void decoder_close(lv_img_decoder_t * dec, lv_img_decoder_dsc_t * dsc);
-static void convert_color_depth(uint8_t * img, uint32_t px_cnt);
+static lv_img_cf_t png_get_cf(uint8_t color_type, bool has_trns);
+static bool file_has_trns(lv_fs_file_t * f);
+static bool data_has_trns(const uint8_t * data, uint32_t data_size);
+static uint8_t * convert_color_depth(uint8_t * img, uint32_t px_cnt, lv_img_header_t * header);
 
 /**********************
  *  STATIC VARIABLES
@@ -72,26 +79,30 @@ static lv_res_t decoder_info(struct _lv_img_decoder_t * decoder, const void * sr
         const char * fn = src;
         if(strcmp(lv_fs_get_ext(fn), "png") == 0) {              /*Check the extension*/
 
-            /* Read the width and height from the file. They have a constant location:
-             * [16..23]: width
-             * [24..27]: height
+            /* Read the signature and the IHDR chunk. They have a constant location:
+             * [16..23]: width and height
+             * [25]: color type
              */
-            uint32_t size[2];
+            uint8_t ihdr[PNG_IHDR_END];
             lv_fs_file_t f;
             lv_fs_res_t res = lv_fs_open(&f, fn, LV_FS_MODE_RD);
             if(res != LV_FS_RES_OK) return LV_RES_INV;
 
-            lv_fs_seek(&f, 16, LV_FS_SEEK_SET);
-
             uint32_t rn;
-            lv_fs_read(&f, &size, 8, &rn);
+            lv_fs_read(&f, ihdr, sizeof(ihdr), &rn);
+            if(rn != sizeof(ihdr)) {
+                lv_fs_close(&f);
+                return LV_RES_INV;
+            }
+
+            bool has_trns = file_has_trns(&f);
             lv_fs_close(&f);
 
-            if(rn != 8) return LV_RES_INV;
+            const uint32_t * size = (const uint32_t *)&ihdr[16];
 
             /*Save the data in the header*/
             header->always_zero = 0;
-            header->cf = LV_IMG_CF_TRUE_COLOR_ALPHA;
+            header->cf = png_get_cf(ihdr[PNG_COLOR_TYPE_OFS], has_trns);
             /*The width and height are stored in Big endian format so convert them to little endian*/
             header->w = (lv_coord_t)((size[0] & 0xff000000) >> 24) + ((size[0] & 0x00ff0000) >> 8);
             header->h = (lv_coord_t)((size[1] & 0xff000000) >> 24) + ((size[1] & 0x00ff0000) >> 8);
@@ -112,6 +123,9 @@ static lv_res_t decoder_info(struct _lv_img_decoder_t * decoder, const void * sr
         if(img_dsc->header.cf) {
             header->cf = img_dsc->header.cf;       /*Save the color format*/
         }
+        else if(data_size >= PNG_IHDR_END) {
+            header->cf = png_get_cf(img_dsc->data[PNG_COLOR_TYPE_OFS], data_has_trns(img_dsc->data, data_size));
+        }
         else {
             header->cf = LV_IMG_CF_TRUE_COLOR_ALPHA;
         }
@@ -181,8 +195,7 @@ static lv_res_t decoder_open(lv_img_decoder_t * decoder, lv_img_decoder_dsc_t *
             }
 
             /*Convert the image to the system's color depth*/
-            convert_color_depth(img_data,  png_width * png_height);
-            dsc->img_data = img_data;
+            dsc->img_data = convert_color_depth(img_data, png_width * png_height, &dsc->header);
             return LV_RES_OK;     /*The image is fully decoded. Return with its pointer*/
         }
     }
@@ -203,9 +216,7 @@ static lv_res_t decoder_open(lv_img_decoder_t * decoder, lv_img_decoder_dsc_t *
         }
 
         /*Convert the image to the system's color depth*/
-        convert_color_depth(img_data,  png_width * png_height);
-
-        dsc->img_data = img_data;
+        dsc->img_data = convert_color_depth(img_data, png_width * png_height, &dsc->header);
         return LV_RES_OK;     /*Return with its pointer*/
     }
 
@@ -225,50 +236,141 @@ static void decoder_close(lv_img_decoder_t * decoder, lv_img_decoder_dsc_t * dsc
 }
 
 /**
- * If the display is not in 32 bit format (ARGB888) then covert the image to the current color depth
+ * Get the color format a PNG will be converted to
+ * @param color_type the color type from the IHDR chunk
+ * @param has_trns true if the image has a tRNS (transparency) chunk
+ * @return `LV_IMG_CF_TRUE_COLOR` if every pixel is opaque, else `LV_IMG_CF_TRUE_COLOR_ALPHA`
+ */
+static lv_img_cf_t png_get_cf(uint8_t color_type, bool has_trns)
+{
+    /*Color type 4: grayscale + alpha, 6: RGBA. The others are opaque unless tRNS is present*/
+    if(color_type == 4 || color_type == 6 || has_trns) return LV_IMG_CF_TRUE_COLOR_ALPHA;
+    return LV_IMG_CF_TRUE_COLOR;
+}
+
+/**
+ * Walk the chunks following IHDR and look for tRNS before the image data
+ * @param f a PNG file, positioned right after the IHDR chunk
+ * @return true if a tRNS chunk was found or the walk was inconclusive
+ */
+static bool file_has_trns(lv_fs_file_t * f)
+{
+    uint32_t pos = PNG_IHDR_END;
+    uint32_t i;
+    for(i = 0; i < PNG_CHUNK_SCAN_MAX; i++) {
+        uint8_t chunk[8];
+        uint32_t rn;
+        if(lv_fs_seek(f, pos, LV_FS_SEEK_SET) != LV_FS_RES_OK) return true;
+        if(lv_fs_read(f, chunk, sizeof(chunk), &rn) != LV_FS_RES_OK || rn != sizeof(chunk)) return true;
+
+        if(memcmp(&chunk[4], "tRNS", 4) == 0) return true;
+        if(memcmp(&chunk[4], "IDAT", 4) == 0 || memcmp(&chunk[4], "IEND", 4) == 0) return false;
+
+        uint32_t len = ((uint32_t)chunk[0] << 24) | ((uint32_t)chunk[1] << 16) | ((uint32_t)chunk[2] << 8) | chunk[3];
+        pos += len + 12;    /*Length, type and CRC*/
+    }
+
+    return true;
+}
+
+/**
+ * Same as `file_has_trns()` but for a PNG stored in a C array
+ * @param data the PNG file data
+ * @param data_size size of `data` in bytes
+ * @return true if a tRNS chunk was found or the walk was inconclusive
+ */
+static bool data_has_trns(const uint8_t * data, uint32_t data_size)
+{
+    uint32_t pos = PNG_IHDR_END;
+    uint32_t i;
+    for(i = 0; i < PNG_CHUNK_SCAN_MAX && pos + 8 <= data_size; i++) {
+        const uint8_t * chunk = &data[pos];
+        if(memcmp(&chunk[4], "tRNS", 4) == 0) return true;
+        if(memcmp(&chunk[4], "IDAT", 4) == 0 || memcmp(&chunk[4], "IEND", 4) == 0) return false;
+
+        uint32_t len = ((uint32_t)chunk[0] << 24) | ((uint32_t)chunk[1] << 16) | ((uint32_t)chunk[2] << 8) | chunk[3];
+        pos += len + 12;
+    }
+
+    return true;
+}
+
+/**
+ * If the display is not in 32 bit format (ARGB888) then covert the image to the current color depth.
+ * Opaque images are stored without the alpha byte so they can be drawn with a plain copy.
  * @param img the ARGB888 image
  * @param px_cnt number of pixels in `img`
+ * @param header the header from `decoder_info()`. If its color format is `LV_IMG_CF_TRUE_COLOR_ALPHA`
+ *               but every pixel turns out to be opaque it's changed to `LV_IMG_CF_TRUE_COLOR`
+ * @return the converted image. It might be reallocated to the smaller size.
  */
-static void convert_color_depth(uint8_t * img, uint32_t px_cnt)
+static uint8_t * convert_color_depth(uint8_t * img, uint32_t px_cnt, lv_img_header_t * header)
 {
-#if LV_COLOR_DEPTH == 32
     lv_color32_t * img_argb = (lv_color32_t *)img;
+    bool opaque = header->cf == LV_IMG_CF_TRUE_COLOR;
+    uint32_t i;
+
+#if LV_COLOR_DEPTH == 32
     lv_color_t c;
     lv_color_t * img_c = (lv_color_t *) img;
-    uint32_t i;
+    uint8_t alpha_and = 0xFF;
+    LV_UNUSED(opaque);
     for(i = 0; i < px_cnt; i++) {
+        alpha_and &= img_argb[i].ch.alpha;
         c = lv_color_make(img_argb[i].ch.red, img_argb[i].ch.green, img_argb[i].ch.blue);
         img_c[i].ch.red = c.ch.blue;
         img_c[i].ch.blue = c.ch.red;
     }
-#elif LV_COLOR_DEPTH == 16
-    lv_color32_t * img_argb = (lv_color32_t *)img;
-    lv_color_t c;
-    uint32_t i;
-    for(i = 0; i < px_cnt; i++) {
-        c = lv_color_make(img_argb[i].ch.blue, img_argb[i].ch.green, img_argb[i].ch.red);
-        img[i * 3 + 2] = img_argb[i].ch.alpha;
-        img[i * 3 + 1] = c.full >> 8;
-        img[i * 3 + 0] = c.full & 0xFF;
+    if(alpha_and == 0xFF) header->cf = LV_IMG_CF_TRUE_COLOR;
+    return img;
+#elif LV_COLOR_DEPTH == 16 || LV_COLOR_DEPTH == 8
+    lv_color_t * img_c = (lv_color_t *)img;
+    uint8_t alpha_and = 0xFF;
+    /*Reading 4 bytes and writing fewer per pixel so the conversion can be done in place*/
+#if LV_COLOR_DEPTH == 16
+    /*lodepng gives R, G, B, A bytes*/
+    LV_UNUSED(img_argb);
+    if(opaque) lv_color_conv_rgba8888_to_rgb565(img, img, px_cnt, LV_COLOR_CONV_NATIVE);
+    else alpha_and = lv_color_conv_rgba8888_to_rgb565_alpha(img, img, px_cnt, LV_COLOR_CONV_NATIVE);
+#else
+    if(opaque) {
+        for(i = 0; i < px_cnt; i++) {
+            img_c[i] = lv_color_make(img_argb[i].ch.blue, img_argb[i].ch.green, img_argb[i].ch.red);
+        }
     }
-#elif LV_COLOR_DEPTH == 8
-    lv_color32_t * img_argb = (lv_color32_t *)img;
-    lv_color_t c;
-    uint32_t i;
-    for(i = 0; i < px_cnt; i++) {
-        c = lv_color_make(img_argb[i].ch.red, img_argb[i].ch.green, img_argb[i].ch.blue);
-        img[i * 2 + 1] = img_argb[i].ch.alpha;
-        img[i * 2 + 0] = c.full;
+    else {
+        for(i = 0; i < px_cnt; i++) {
+            lv_color_t c = lv_color_make(img_argb[i].ch.blue, img_argb[i].ch.green, img_argb[i].ch.red);
+            alpha_and &= img_argb[i].ch.alpha;
+            img[i * LV_IMG_PX_SIZE_ALPHA_BYTE + LV_IMG_PX_SIZE_ALPHA_BYTE - 1] = img_argb[i].ch.alpha;
+            lv_memcpy_small(&img[i * LV_IMG_PX_SIZE_ALPHA_BYTE], &c, sizeof(lv_color_t));
+        }
     }
+#endif
+
+    /*No transparent pixel: drop the alpha bytes*/
+    if(!opaque && alpha_and == 0xFF) {
+        for(i = 0; i < px_cnt; i++) {
+            lv_memcpy_small(&img_c[i], &img[i * LV_IMG_PX_SIZE_ALPHA_BYTE], sizeof(lv_color_t));
+        }
+        opaque = true;
+        header->cf = LV_IMG_CF_TRUE_COLOR;
+    }
+
+    /*Give back the unused end of the ARGB8888 buffer*/
+    uint32_t new_size = px_cnt * (opaque ? sizeof(lv_color_t) : LV_IMG_PX_SIZE_ALPHA_BYTE);
+    uint8_t * img_shrunk = lv_mem_realloc(img, new_size);
+    return img_shrunk ? img_shrunk : img;
 #elif LV_COLOR_DEPTH == 1
-    lv_color32_t * img_argb = (lv_color32_t *)img;
     uint8_t b;
-    uint32_t i;
+    LV_UNUSED(opaque);
     for(i = 0; i < px_cnt; i++) {
         b = img_argb[i].ch.red | img_argb[i].ch.green | img_argb[i].ch.blue;
         img[i * 2 + 1] = img_argb[i].ch.alpha;
         img[i * 2 + 0] = b > 128 ? 1 : 0;
     }
+    header->cf = LV_IMG_CF_TRUE_COLOR_ALPHA;
+    return img;
 #endif
 }
 
@@ -0,0 +1,340 @@
+/**
+ * @file lv_qoi.c
+ * Decoder for the "Quite OK Image" format (https://qoiformat.org).
+ * Lossless like PNG but a single pass with no entropy coding, so it decodes several times faster than lodepng.
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include "../../../lvgl.h"
+#if LV_USE_QOI
+
+#include "lv_qoi.h"
+
+#if LV_COLOR_DEPTH != 16
+    #error "lv_qoi: decodes to RGB565 / RGB565A8, LV_COLOR_DEPTH must be 16"
+#endif
+
+/*********************
+ *      DEFINES
+ *********************/
+#define QOI_OP_INDEX    0x00    /*00xxxxxx*/
+#define QOI_OP_DIFF     0x40    /*01xxxxxx*/
+#define QOI_OP_LUMA     0x80    /*10xxxxxx*/
+#define QOI_OP_RUN      0xC0    /*11xxxxxx*/
+#define QOI_OP_RGB      0xFE    /*11111110*/
+#define QOI_OP_RGBA     0xFF    /*11111111*/
+#define QOI_MASK_2      0xC0
+
+#define QOI_SIZE_MAX    2047    /*Width and height have 11 bits in lv_img_header_t*/
+#define QOI_PIXELS_MAX  400000000u  /*Same limit as the reference implementation*/
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+typedef union {
+    struct {
+        uint8_t r;
+        uint8_t g;
+        uint8_t b;
+        uint8_t a;
+    } ch;
+    uint32_t v;
+} qoi_px_t;
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+static lv_res_t decoder_info(struct _lv_img_decoder_t * decoder, const void * src, lv_img_header_t * header);
+static lv_res_t decoder_open(lv_img_decoder_t * dec, lv_img_decoder_dsc_t * dsc);
+static void decoder_close(lv_img_decoder_t * dec, lv_img_decoder_dsc_t * dsc);
+static lv_res_t header_to_img_header(const lv_qoi_header_t * qoi, lv_img_header_t * header);
+static uint8_t * read_file(const char * fn, uint32_t * size);
+static lv_res_t decode(const uint8_t * data, uint32_t size, lv_color_t * color, uint8_t * alpha, uint8_t * rgba);
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+
+/**********************
+ *      MACROS
+ **********************/
+#define QOI_HASH(px)    (((px).ch.r * 3 + (px).ch.g * 5 + (px).ch.b * 7 + (px).ch.a * 11) & 63)
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+/**
+ * Register the QOI decoder functions in LVGL
+ */
+void lv_qoi_init(void)
+{
+    lv_img_decoder_t * dec = lv_img_decoder_create();
+    lv_img_decoder_set_info_cb(dec, decoder_info);
+    lv_img_decoder_set_open_cb(dec, decoder_open);
+    lv_img_decoder_set_close_cb(dec, decoder_close);
+}
+
+lv_res_t lv_qoi_read_header(const uint8_t * data, uint32_t size, lv_qoi_header_t * header)
+{
+    if(size < LV_QOI_HEADER_SIZE + LV_QOI_END_SIZE) return LV_RES_INV;
+    if(memcmp(data, "qoif", 4) != 0) return LV_RES_INV;
+
+    /*Width and height are big endian*/
+    header->w = ((uint32_t)data[4] << 24) | ((uint32_t)data[5] << 16) | ((uint32_t)data[6] << 8) | data[7];
+    header->h = ((uint32_t)data[8] << 24) | ((uint32_t)data[9] << 16) | ((uint32_t)data[10] << 8) | data[11];
+    header->channels = data[12];
+    header->colorspace = data[13];
+
+    if(header->w == 0 || header->h == 0) return LV_RES_INV;
+    if((uint64_t)header->w * header->h > QOI_PIXELS_MAX) return LV_RES_INV;
+    if(header->channels != 3 && header->channels != 4) return LV_RES_INV;
+    return LV_RES_OK;
+}
+
+lv_res_t lv_qoi_decode_rgb565(const uint8_t * data, uint32_t size, uint8_t * color, uint8_t * alpha)
+{
+    return decode(data, size, (lv_color_t *)color, alpha, NULL);
+}
+
+lv_res_t lv_qoi_decode_rgba8888(const uint8_t * data, uint32_t size, uint8_t * rgba)
+{
+    return decode(data, size, NULL, NULL, rgba);
+}
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+/**
+ * Get info about a QOI image
+ * @param src can be file name or pointer to a C array
+ * @param header store the info here
+ * @return LV_RES_OK: no error; LV_RES_INV: can't get the info
+ */
+static lv_res_t decoder_info(struct _lv_img_decoder_t * decoder, const void * src, lv_img_header_t * header)
+{
+    LV_UNUSED(decoder);
+    lv_img_src_t src_type = lv_img_src_get_type(src);
+    lv_qoi_header_t qoi;
+
+    if(src_type == LV_IMG_SRC_FILE) {
+        const char * fn = src;
+        if(strcmp(lv_fs_get_ext(fn), "qoi") != 0) return LV_RES_INV;
+
+        uint8_t buf[LV_QOI_HEADER_SIZE];
+        lv_fs_file_t f;
+        if(lv_fs_open(&f, fn, LV_FS_MODE_RD) != LV_FS_RES_OK) return LV_RES_INV;
+        uint32_t rn = 0;
+        lv_fs_read(&f, buf, sizeof(buf), &rn);
+        lv_fs_close(&f);
+        if(rn != sizeof(buf)) return LV_RES_INV;
+
+        /*Only the header is available, the size check is done on open*/
+        if(lv_qoi_read_header(buf, LV_QOI_HEADER_SIZE + LV_QOI_END_SIZE, &qoi) != LV_RES_OK) return LV_RES_INV;
+    }
+    else if(src_type == LV_IMG_SRC_VARIABLE) {
+        const lv_img_dsc_t * img_dsc = src;
+        if(img_dsc->data == NULL) return LV_RES_INV;
+        if(lv_qoi_read_header(img_dsc->data, img_dsc->data_size, &qoi) != LV_RES_OK) return LV_RES_INV;
+    }
+    else {
+        return LV_RES_INV;
+    }
+
+    return header_to_img_header(&qoi, header);
+}
+
+/**
+ * Open a QOI image and decode it straight to RGB565 / RGB565A8
+ * @param dsc decoded image descriptor
+ * @return LV_RES_OK: no error; LV_RES_INV: can't open the image
+ */
+static lv_res_t decoder_open(lv_img_decoder_t * decoder, lv_img_decoder_dsc_t * dsc)
+{
+    LV_UNUSED(decoder);
+
+    const uint8_t * data;
+    uint32_t size;
+    uint8_t * file_data = NULL;
+
+    if(dsc->src_type == LV_IMG_SRC_FILE) {
+        if(strcmp(lv_fs_get_ext(dsc->src), "qoi") != 0) return LV_RES_INV;
+        file_data = read_file(dsc->src, &size);
+        if(file_data == NULL) return LV_RES_INV;
+        data = file_data;
+    }
+    else if(dsc->src_type == LV_IMG_SRC_VARIABLE) {
+        const lv_img_dsc_t * img_dsc = dsc->src;
+        data = img_dsc->data;
+        size = img_dsc->data_size;
+    }
+    else {
+        return LV_RES_INV;
+    }
+
+    lv_qoi_header_t qoi;
+    lv_img_header_t header;
+    if(lv_qoi_read_header(data, size, &qoi) != LV_RES_OK || header_to_img_header(&qoi, &header) != LV_RES_OK) {
+        lv_mem_free(file_data);
+        return LV_RES_INV;
+    }
+
+    uint32_t px_cnt = qoi.w * qoi.h;
+    bool has_alpha = qoi.channels == 4;
+    uint8_t * img = lv_mem_alloc(px_cnt * (has_alpha ? LV_IMG_PX_SIZE_ALPHA_BYTE : sizeof(lv_color_t)));
+    if(img == NULL) {
+        lv_mem_free(file_data);
+        return LV_RES_INV;
+    }
+
+    lv_res_t res = decode(data, size, (lv_color_t *)img, has_alpha ? img + px_cnt * sizeof(lv_color_t) : NULL, NULL);
+    lv_mem_free(file_data);
+    if(res != LV_RES_OK) {
+        LV_LOG_WARN("corrupted QOI image");
+        lv_mem_free(img);
+        return LV_RES_INV;
+    }
+
+    dsc->img_data = img;
+    return LV_RES_OK;
+}
+
+/**
+ * Free the allocated resources
+ */
+static void decoder_close(lv_img_decoder_t * decoder, lv_img_decoder_dsc_t * dsc)
+{
+    LV_UNUSED(decoder);
+    if(dsc->img_data) {
+        lv_mem_free((uint8_t *)dsc->img_data);
+        dsc->img_data = NULL;
+    }
+}
+
+static lv_res_t header_to_img_header(const lv_qoi_header_t * qoi, lv_img_header_t * header)
+{
+    if(qoi->w > QOI_SIZE_MAX || qoi->h > QOI_SIZE_MAX) {
+        LV_LOG_WARN("QOI image too large: %dx%d", (int)qoi->w, (int)qoi->h);
+        return LV_RES_INV;
+    }
+
+    header->always_zero = 0;
+    header->cf = qoi->channels == 4 ? LV_IMG_CF_RGB565A8 : LV_IMG_CF_TRUE_COLOR;
+    header->w = qoi->w;
+    header->h = qoi->h;
+    return LV_RES_OK;
+}
+
+static uint8_t * read_file(const char * fn, uint32_t * size)
+{
+    lv_fs_file_t f;
+    if(lv_fs_open(&f, fn, LV_FS_MODE_RD) != LV_FS_RES_OK) return NULL;
+
+    uint8_t * data = NULL;
+    uint32_t file_size = 0;
+    lv_fs_seek(&f, 0, LV_FS_SEEK_END);
+    lv_fs_tell(&f, &file_size);
+    lv_fs_seek(&f, 0, LV_FS_SEEK_SET);
+
+    if(file_size > 0) data = lv_mem_alloc(file_size);
+    if(data) {
+        uint32_t rn = 0;
+        lv_fs_read(&f, data, file_size, &rn);
+        if(rn != file_size) {
+            lv_mem_free(data);
+            data = NULL;
+        }
+    }
+    lv_fs_close(&f);
+
+    *size = file_size;
+    return data;
+}
+
+/**
+ * Decode to either RGB565 (+ optional alpha plane) or RGBA8888.
+ * A run is converted once and written as a fill, so flat UI art is mostly memset speed.
+ */
+static lv_res_t decode(const uint8_t * data, uint32_t size, lv_color_t * color, uint8_t * alpha, uint8_t * rgba)
+{
+    lv_qoi_header_t header;
+    if(lv_qoi_read_header(data, size, &header) != LV_RES_OK) return LV_RES_INV;
+
+    qoi_px_t index[64];
+    lv_memset_00(index, sizeof(index));
+
+    qoi_px_t px;
+    px.v = 0;
+    px.ch.a = 255;
+
+    const uint8_t * p = data + LV_QOI_HEADER_SIZE;
+    const uint8_t * end = data + size - LV_QOI_END_SIZE;
+    uint32_t px_cnt = header.w * header.h;
+    uint32_t i = 0;
+
+    while(i < px_cnt) {
+        if(p >= end) return LV_RES_INV;
+
+        uint32_t b1 = *p++;
+        uint32_t run = 1;
+
+        if(b1 == QOI_OP_RGB) {
+            if(end - p < 3) return LV_RES_INV;
+            px.ch.r = p[0];
+            px.ch.g = p[1];
+            px.ch.b = p[2];
+            p += 3;
+        }
+        else if(b1 == QOI_OP_RGBA) {
+            if(end - p < 4) return LV_RES_INV;
+            px.ch.r = p[0];
+            px.ch.g = p[1];
+            px.ch.b = p[2];
+            px.ch.a = p[3];
+            p += 4;
+        }
+        else if((b1 & QOI_MASK_2) == QOI_OP_INDEX) {
+            px = index[b1];
+        }
+        else if((b1 & QOI_MASK_2) == QOI_OP_DIFF) {
+            px.ch.r += ((b1 >> 4) & 0x03) - 2;
+            px.ch.g += ((b1 >> 2) & 0x03) - 2;
+            px.ch.b += (b1 & 0x03) - 2;
+        }
+        else if((b1 & QOI_MASK_2) == QOI_OP_LUMA) {
+            if(p >= end) return LV_RES_INV;
+            uint32_t b2 = *p++;
+            int32_t vg = (int32_t)(b1 & 0x3F) - 32;
+            px.ch.r += vg - 8 + ((b2 >> 4) & 0x0F);
+            px.ch.g += vg;
+            px.ch.b += vg - 8 + (b2 & 0x0F);
+        }
+        else {
+            run = (b1 & 0x3F) + 1;
+        }
+
+        index[QOI_HASH(px)] = px;
+        if(run > px_cnt - i) run = px_cnt - i;
+
+        if(rgba) {
+            uint8_t * dst = rgba + i * 4;
+            for(uint32_t k = 0; k < run; k++, dst += 4) lv_memcpy_small(dst, &px.v, 4);
+        }
+        else if(run == 1) {
+            color[i] = lv_color_make(px.ch.r, px.ch.g, px.ch.b);
+            if(alpha) alpha[i] = px.ch.a;
+        }
+        else {
+            lv_color_fill(color + i, lv_color_make(px.ch.r, px.ch.g, px.ch.b), run);
+            if(alpha) lv_memset(alpha + i, px.ch.a, run);
+        }
+        i += run;
+    }
+
+    return LV_RES_OK;
+}
+
+#endif /*LV_USE_QOI*/
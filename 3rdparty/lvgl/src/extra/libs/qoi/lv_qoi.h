@@ -0,0 +1,86 @@
+/**
+ * @file lv_qoi.h
+ *
+ */
+
+#ifndef LV_QOI_H
+#define LV_QOI_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include "../../../lv_conf_internal.h"
+#if LV_USE_QOI
+
+#include "../../../misc/lv_types.h"
+#include <stdint.h>
+
+/*********************
+ *      DEFINES
+ *********************/
+#define LV_QOI_HEADER_SIZE  14
+#define LV_QOI_END_SIZE     8
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+typedef struct {
+    uint32_t w;
+    uint32_t h;
+    uint8_t channels;   /*3: RGB, 4: RGBA*/
+    uint8_t colorspace;
+} lv_qoi_header_t;
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+/**
+ * Register the QOI decoder functions in LVGL.
+ * RGB images are decoded to `LV_IMG_CF_TRUE_COLOR`, RGBA images to `LV_IMG_CF_RGB565A8`.
+ */
+void lv_qoi_init(void);
+
+/**
+ * Parse the header of a QOI image
+ * @param data      the file's data (at least `LV_QOI_HEADER_SIZE` bytes)
+ * @param size      size of `data`
+ * @param header    store the result here
+ * @return          LV_RES_OK: valid header; LV_RES_INV: not a QOI image
+ */
+lv_res_t lv_qoi_read_header(const uint8_t * data, uint32_t size, lv_qoi_header_t * header);
+
+/**
+ * Decode a QOI image straight to RGB565 (`lv_color_t`) without an RGBA intermediate.
+ * @param data      the file's data
+ * @param size      size of `data`
+ * @param color     store w * h colors here
+ * @param alpha     store w * h alpha values here (the second plane of `LV_IMG_CF_RGB565A8`), can be NULL
+ * @return          LV_RES_OK: decoded; LV_RES_INV: invalid or truncated data
+ */
+lv_res_t lv_qoi_decode_rgb565(const uint8_t * data, uint32_t size, uint8_t * color, uint8_t * alpha);
+
+/**
+ * Decode a QOI image to RGBA8888
+ * @param data      the file's data
+ * @param size      size of `data`
+ * @param rgba      store w * h * 4 bytes here
+ * @return          LV_RES_OK: decoded; LV_RES_INV: invalid or truncated data
+ */
+lv_res_t lv_qoi_decode_rgba8888(const uint8_t * data, uint32_t size, uint8_t * rgba);
+
+/**********************
+ *      MACROS
+ **********************/
+
+#endif /*LV_USE_QOI*/
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /*LV_QOI_H*/
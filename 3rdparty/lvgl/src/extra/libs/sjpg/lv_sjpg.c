@@ -9,8 +9,8 @@
 /    SJPEG is a custom created modified JPEG file format for small embedded platforms.
 /    It will contain multiple JPEG fragments all embedded into a single file with a custom header.
 /    This makes JPEG decoding easier using any JPEG library. Overall file size will be almost
-/    similar to the parent jpeg file. We can generate sjpeg from any jpeg using a python script
-/    provided along with this project.
+/    similar to the parent jpeg file. We can generate sjpeg from any jpeg using the jpg2sjpg host tool
+/    (`make tools`).
 /                                                                                     (by vinodstanur | 2020 )
 /    SJPEG FILE STRUCTURE
 /    --------------------------------------------------------------------------------------------------------------------------------
@@ -36,9 +36,13 @@
 /----------------------------------------------------------------------------------------------------------------------------------
 /                   JPEG DECODER
 /                   ------------
-/   We are using TJpgDec - Tiny JPEG Decompressor library from ELM-CHAN for decoding each split-jpeg fragments.
-/   The tjpgd.c and tjpgd.h is not modified and those are used as it is. So if any update comes for the tiny-jpeg,
-/   just replace those files with updated files.
+/   Every fragment is a standalone JPEG. With `LV_SJPG_USE_LIBJPEG` the fragments are decoded with libjpeg(-turbo),
+/   otherwise with TJpgDec - Tiny JPEG Decompressor library from ELM-CHAN (tjpgd.c and tjpgd.h are not modified).
+/
+/   Decoded fragments are kept in a cache shared by all SJPG images (LRU, `LV_SJPG_CACHE_SIZE` bytes), so redraws and
+/   areas crossing fragment boundaries do not decode the same fragment again even though the image is reopened for
+/   every draw. If a worker is registered with `lv_split_jpeg_set_worker()` the fragments below the one being drawn
+/   are decoded in parallel on the worker threads.
 /---------------------------------------------------------------------------------------------------------------------------------*/
 
 /*********************
@@ -48,15 +52,39 @@
 #include "../../../lvgl.h"
 #if LV_USE_SJPG
 
-#include "tjpgd.h"
 #include "lv_sjpg.h"
 #include "../../../misc/lv_fs.h"
+#include "../../../misc/lv_color_conv.h"
+
+#if LV_SJPG_USE_LIBJPEG
+#include <stdio.h>
+#include <setjmp.h>
+#include <jpeglib.h>
+#else
+#include "tjpgd.h"
+#endif
+
+#if LV_SJPG_USE_WORKER
+#include <pthread.h>
+#if LV_MEM_CUSTOM == 0
+#error "LV_SJPG_USE_WORKER frees memory on the worker threads and needs a thread-safe allocator (LV_MEM_CUSTOM 1)"
+#endif
+#endif
 
 /*********************
  *      DEFINES
  *********************/
 #define TJPGD_WORKBUFF_SIZE             4096    //Recommended by TJPGD libray
 
+/*Fragments decoded ahead on the worker threads*/
+#define SJPEG_PREFETCH_FRAMES           2
+
+#if LV_BIG_ENDIAN_SYSTEM == 1 || LV_COLOR_16_SWAP == 1
+#define SJPEG_COLOR_CONV_FLAGS          LV_COLOR_CONV_SWAP
+#else
+#define SJPEG_COLOR_CONV_FLAGS          0
+#endif
+
 //NEVER EDIT THESE OFFSET VALUES
 #define SJPEG_VERSION_OFFSET            8
 #define SJPEG_X_RES_OFFSET              14
@@ -65,42 +93,72 @@
 #define SJPEG_BLOCK_WIDTH_OFFSET        20
 #define SJPEG_FRAME_INFO_ARRAY_OFFSET   22
 
+#if LV_SJPG_USE_WORKER
+#define CACHE_LOCK()                    pthread_mutex_lock(&cache_lock)
+#define CACHE_UNLOCK()                  pthread_mutex_unlock(&cache_lock)
+#define CACHE_WAIT()                    pthread_cond_wait(&cache_cond, &cache_lock)
+#define CACHE_SIGNAL()                  pthread_cond_broadcast(&cache_cond)
+#else
+#define CACHE_LOCK()
+#define CACHE_UNLOCK()
+#define CACHE_WAIT()
+#define CACHE_SIGNAL()
+#endif
+
 /**********************
  *      TYPEDEFS
  **********************/
 
-enum io_source_type {
-    SJPEG_IO_SOURCE_C_ARRAY,
-    SJPEG_IO_SOURCE_DISK,
-};
-
+/*Sequential reader over a C array or an opened file*/
 typedef struct {
-    enum io_source_type type;
-    lv_fs_file_t lv_file;
-    uint8_t * img_cache_buff;
-    int img_cache_x_res;
-    int img_cache_y_res;
-    uint8_t * raw_sjpg_data;              //Used when type==SJPEG_IO_SOURCE_C_ARRAY.
-    uint32_t raw_sjpg_data_size;          //Num bytes pointed to by raw_sjpg_data.
-    uint32_t raw_sjpg_data_next_read_pos; //Used for all types.
-} io_source_t;
+    const uint8_t * data;       /*NULL: read from `file`*/
+    uint32_t size;
+    uint32_t pos;
+    lv_fs_file_t * file;
+} src_reader_t;
 
 typedef struct {
-    uint8_t * sjpeg_data;
-    uint32_t sjpeg_data_size;
+    const uint8_t * sjpeg_data;         /*C array source, NULL for files*/
+    uint32_t sjpeg_data_size;           /*size of the C array or the file*/
     int sjpeg_x_res;
     int sjpeg_y_res;
     int sjpeg_total_frames;
     int sjpeg_single_frame_height;
-    int sjpeg_cache_frame_index;
-    uint8_t ** frame_base_array;        //to save base address of each split frames upto sjpeg_total_frames.
-    int * frame_base_offset;            //to save base offset for fseek
-    uint8_t * frame_cache;
-    uint8_t * workb;                    //JPG work buffer for jpeg library
-    JDEC * tjpeg_jd;
-    io_source_t io;
+    uint32_t * frame_offset;            /*start of each fragment, `sjpeg_total_frames + 1` items (the last is the end)*/
+    uint32_t key;                       /*identifies the image in the fragment cache*/
+    int last_frame;                     /*fragment of the previous `read_line`, prefetch starts when it changes*/
+    lv_fs_file_t lv_file;
+    bool file_opened;
 } SJPEG;
 
+typedef enum {
+    FRAG_EMPTY,         /*not decoded yet, the next `read_line` decodes it*/
+    FRAG_QUEUED,        /*waiting for a worker, the UI thread may take it over*/
+    FRAG_DECODING,
+    FRAG_READY,
+    FRAG_FAILED,
+} frag_state_t;
+
+/*A decoded fragment in the cache (guarded by `cache_lock`)*/
+typedef struct {
+    uint32_t key;
+    uint32_t data_size;
+    int frame;
+    frag_state_t state;
+    uint32_t ref_cnt;           /*1 while in the cache + 1 for each pending job*/
+    uint32_t buf_size;
+    lv_color_t * buf;           /*`sjpeg_x_res` x (rows of this fragment)*/
+} frag_entry_t;
+
+/*Fragment decoding handed to a worker*/
+typedef struct {
+    frag_entry_t * entry;
+    uint8_t * data;             /*the compressed fragment*/
+    uint32_t size;
+    int w;
+    int h;
+} frag_job_t;
+
 /**********************
  *  STATIC PROTOTYPES
  **********************/
@@ -109,14 +167,22 @@ static lv_res_t decoder_open(lv_img_decoder_t * decoder, lv_img_decoder_dsc_t *
 static lv_res_t decoder_read_line(lv_img_decoder_t * decoder, lv_img_decoder_dsc_t * dsc, lv_coord_t x, lv_coord_t y,
                                   lv_coord_t len, uint8_t * buf);
 static void decoder_close(lv_img_decoder_t * decoder, lv_img_decoder_dsc_t * dsc);
-static size_t input_func(JDEC * jd, uint8_t * buff, size_t ndata);
+static lv_res_t decode_fragment(const uint8_t * data, uint32_t size, lv_color_t * dst, int w, int h);
 static int is_jpg(const uint8_t * raw_data, size_t len);
 static void lv_sjpg_cleanup(SJPEG * sjpeg);
-static void lv_sjpg_free(SJPEG * sjpeg);
+static void cache_drop(frag_entry_t ** node);
 
 /**********************
  *  STATIC VARIABLES
  **********************/
+static lv_ll_t cache_ll;                /*frag_entry_t, most recently used first*/
+static uint32_t cache_size;             /*bytes of the decoded fragments*/
+
+#if LV_SJPG_USE_WORKER
+static lv_split_jpeg_post_cb_t worker_post_cb;
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cache_cond = PTHREAD_COND_INITIALIZER;
+#endif
 
 /**********************
  *      MACROS
@@ -127,6 +193,8 @@ static void lv_sjpg_free(SJPEG * sjpeg);
  **********************/
 void lv_split_jpeg_init(void)
 {
+    _lv_ll_init(&cache_ll, sizeof(frag_entry_t *));
+
     lv_img_decoder_t * dec = lv_img_decoder_create();
     lv_img_decoder_set_info_cb(dec, decoder_info);
     lv_img_decoder_set_open_cb(dec, decoder_open);
@@ -134,9 +202,98 @@ void lv_split_jpeg_init(void)
     lv_img_decoder_set_read_line_cb(dec, decoder_read_line);
 }
 
+void lv_split_jpeg_set_worker(lv_split_jpeg_post_cb_t post_cb)
+{
+#if LV_SJPG_USE_WORKER
+    worker_post_cb = post_cb;
+#else
+    LV_UNUSED(post_cb);
+#endif
+}
+
+size_t lv_split_jpeg_cache_usage(void)
+{
+    CACHE_LOCK();
+    size_t size = cache_size;
+    CACHE_UNLOCK();
+    return size;
+}
+
+void lv_split_jpeg_cache_trim(size_t target)
+{
+    CACHE_LOCK();
+    frag_entry_t ** node = _lv_ll_get_tail(&cache_ll);
+    while(node && cache_size > target) {
+        frag_entry_t ** prev = _lv_ll_get_prev(&cache_ll, node);
+        if((*node)->state != FRAG_DECODING) cache_drop(node);   /*Queued jobs notice it and quit*/
+        node = prev;
+    }
+    CACHE_UNLOCK();
+}
+
 /**********************
  *   STATIC FUNCTIONS
  **********************/
+
+static uint32_t reader_read(src_reader_t * r, uint8_t * buf, uint32_t len)
+{
+    if(r->data) {
+        uint32_t n = LV_MIN(len, r->size - r->pos);
+        if(buf) lv_memcpy(buf, r->data + r->pos, n);
+        r->pos += n;
+        return n;
+    }
+
+    if(buf == NULL) {
+        r->pos += len;
+        return lv_fs_seek(r->file, r->pos, LV_FS_SEEK_SET) == LV_FS_RES_OK ? len : 0;
+    }
+
+    uint32_t rn = 0;
+    if(lv_fs_read(r->file, buf, len, &rn) != LV_FS_RES_OK) return 0;
+    r->pos += rn;
+    return rn;
+}
+
+/**
+ * Walk the markers of a JPEG until the start of frame to find its size
+ * @param r     reader at the beginning of the JPEG
+ * @return      true: `w` and `h` are set
+ */
+static bool jpg_read_size(src_reader_t * r, int * w, int * h)
+{
+    uint8_t buf[5];
+    if(reader_read(r, buf, 2) != 2 || buf[0] != 0xFF || buf[1] != 0xD8) return false;
+
+    while(1) {
+        /*Find the next marker, skip fill bytes*/
+        do {
+            if(reader_read(r, buf, 1) != 1) return false;
+        } while(buf[0] != 0xFF);
+        do {
+            if(reader_read(r, buf, 1) != 1) return false;
+        } while(buf[0] == 0xFF);
+
+        uint8_t marker = buf[0];
+        if(marker == 0x01 || (marker >= 0xD0 && marker <= 0xD7)) continue;  /*No length*/
+        if(marker == 0xD9 || marker == 0xDA) return false;                  /*EOI/SOS before any SOF*/
+
+        if(reader_read(r, buf, 2) != 2) return false;
+        uint32_t len = (buf[0] << 8) | buf[1];
+        if(len < 2) return false;
+
+        /*SOF0..SOF15 except DHT, JPG and DAC*/
+        if(marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC) {
+            if(reader_read(r, buf, 5) != 5) return false;
+            *h = (buf[1] << 8) | buf[2];
+            *w = (buf[3] << 8) | buf[4];
+            return *w > 0 && *h > 0;
+        }
+
+        if(reader_read(r, NULL, len - 2) != len - 2) return false;
+    }
+}
+
 /**
  * Get info about an SJPG / JPG image
  * @param decoder pointer to the decoder where this function belongs
@@ -153,16 +310,15 @@ static lv_res_t decoder_info(lv_img_decoder_t * decoder, const void * src, lv_im
 
     lv_img_src_t src_type = lv_img_src_get_type(src);          /*Get the source type*/
 
-    lv_res_t ret = LV_RES_OK;
-
     if(src_type == LV_IMG_SRC_VARIABLE) {
         const lv_img_dsc_t * img_dsc = src;
-        uint8_t * raw_sjpeg_data = (uint8_t *)img_dsc->data;
+        const uint8_t * raw_sjpeg_data = img_dsc->data;
         const uint32_t raw_sjpeg_data_size = img_dsc->data_size;
 
-        if(!strncmp((char *)raw_sjpeg_data, "_SJPG__", strlen("_SJPG__"))) {
+        if(raw_sjpeg_data_size >= SJPEG_FRAME_INFO_ARRAY_OFFSET &&
+           !strncmp((char *)raw_sjpeg_data, "_SJPG__", strlen("_SJPG__"))) {
 
-            raw_sjpeg_data += 14; //seek to res info ... refer sjpeg format
+            raw_sjpeg_data += SJPEG_X_RES_OFFSET; //seek to res info ... refer sjpeg format
             header->always_zero = 0;
             header->cf = LV_IMG_CF_RAW;
 
@@ -172,40 +328,19 @@ static lv_res_t decoder_info(lv_img_decoder_t * decoder, const void * src, lv_im
             header->h = *raw_sjpeg_data++;
             header->h |= *raw_sjpeg_data++ << 8;
 
-            return ret;
+            return LV_RES_OK;
 
         }
         else if(is_jpg(raw_sjpeg_data, raw_sjpeg_data_size) == true) {
+            src_reader_t reader = {raw_sjpeg_data, raw_sjpeg_data_size, 0, NULL};
+            int w, h;
+            if(!jpg_read_size(&reader, &w, &h)) return LV_RES_INV;
+
             header->always_zero = 0;
             header->cf = LV_IMG_CF_RAW;
-
-            uint8_t * workb_temp = lv_mem_alloc(TJPGD_WORKBUFF_SIZE);
-            if(!workb_temp) return LV_RES_INV;
-
-            io_source_t io_source_temp;
-            io_source_temp.type = SJPEG_IO_SOURCE_C_ARRAY;
-            io_source_temp.raw_sjpg_data = raw_sjpeg_data;
-            io_source_temp.raw_sjpg_data_size = raw_sjpeg_data_size;
-            io_source_temp.raw_sjpg_data_next_read_pos = 0;
-
-            JDEC jd_tmp;
-
-            JRESULT rc = jd_prepare(&jd_tmp, input_func, workb_temp, (size_t)TJPGD_WORKBUFF_SIZE, &io_source_temp);
-            if(rc == JDR_OK) {
-                header->w = jd_tmp.width;
-                header->h = jd_tmp.height;
-
-            }
-            else {
-                ret = LV_RES_INV;
-                goto end;
-            }
-
-end:
-            lv_mem_free(workb_temp);
-
-            return ret;
-
+            header->w = w;
+            header->h = h;
+            return LV_RES_OK;
         }
     }
     else if(src_type == LV_IMG_SRC_FILE) {
@@ -217,7 +352,7 @@ end:
 
             lv_fs_file_t file;
             lv_fs_res_t res = lv_fs_open(&file, fn, LV_FS_MODE_RD);
-            if(res != LV_FS_RES_OK) return 78;
+            if(res != LV_FS_RES_OK) return LV_RES_INV;
 
             uint32_t rn;
             res = lv_fs_read(&file, buff, 8, &rn);
@@ -227,7 +362,7 @@ end:
             }
 
             if(strcmp((char *)buff, "_SJPG__") == 0) {
-                lv_fs_seek(&file, 14, LV_FS_SEEK_SET);
+                lv_fs_seek(&file, SJPEG_X_RES_OFFSET, LV_FS_SEEK_SET);
                 res = lv_fs_read(&file, buff, 4, &rn);
                 if(res != LV_FS_RES_OK || rn != 4) {
                     lv_fs_close(&file);
@@ -244,34 +379,23 @@ end:
                 return LV_RES_OK;
 
             }
+            lv_fs_close(&file);
         }
         else if(strcmp(lv_fs_get_ext(fn), "jpg") == 0) {
             lv_fs_file_t file;
             lv_fs_res_t res = lv_fs_open(&file, fn, LV_FS_MODE_RD);
-            if(res != LV_FS_RES_OK) return 78;
+            if(res != LV_FS_RES_OK) return LV_RES_INV;
 
-            uint8_t * workb_temp = lv_mem_alloc(TJPGD_WORKBUFF_SIZE);
-            if(!workb_temp) {
-                lv_fs_close(&file);
-                return LV_RES_INV;
-            }
-
-            io_source_t io_source_temp;
-            io_source_temp.type = SJPEG_IO_SOURCE_DISK;
-            io_source_temp.raw_sjpg_data_next_read_pos = 0;
-            io_source_temp.img_cache_buff = NULL;
-            io_source_temp.lv_file = file;
-            JDEC jd_tmp;
-
-            JRESULT rc = jd_prepare(&jd_tmp, input_func, workb_temp, (size_t)TJPGD_WORKBUFF_SIZE, &io_source_temp);
-            lv_mem_free(workb_temp);
+            src_reader_t reader = {NULL, 0, 0, &file};
+            int w, h;
+            bool ok = jpg_read_size(&reader, &w, &h);
             lv_fs_close(&file);
 
-            if(rc == JDR_OK) {
+            if(ok) {
                 header->always_zero = 0;
                 header->cf = LV_IMG_CF_RAW;
-                header->w = jd_tmp.width;
-                header->h = jd_tmp.height;
+                header->w = w;
+                header->h = h;
                 return LV_RES_OK;
             }
         }
@@ -279,59 +403,60 @@ end:
     return LV_RES_INV;
 }
 
-static int img_data_cb(JDEC * jd, void * data, JRECT * rect)
+/**
+ * Hash of the source (file name or C array address) to find the fragments of an image in the cache
+ */
+static uint32_t src_key(const lv_img_decoder_dsc_t * dsc)
 {
-    io_source_t * io = jd->device;
-    uint8_t * cache = io->img_cache_buff;
-    const int xres = io->img_cache_x_res;
-    uint8_t * buf = data;
-    const int INPUT_PIXEL_SIZE = 3;
-    const int row_width = rect->right - rect->left + 1; // Row width in pixels.
-    const int row_size = row_width * INPUT_PIXEL_SIZE;  // Row size (bytes).
-
-    for(int y = rect->top; y <= rect->bottom; y++) {
-        int row_offset = y * xres * INPUT_PIXEL_SIZE + rect->left * INPUT_PIXEL_SIZE;
-        memcpy(cache + row_offset, buf, row_size);
-        buf += row_size;
+    uint32_t h = 2166136261u;   /*FNV-1a*/
+    if(dsc->src_type == LV_IMG_SRC_FILE) {
+        for(const char * p = dsc->src; *p; p++) h = (h ^ (uint8_t)*p) * 16777619u;
     }
-
-    return 1;
+    else {
+        uintptr_t v = (uintptr_t)((const lv_img_dsc_t *)dsc->src)->data;
+        for(uint32_t i = 0; i < sizeof(v); i++) h = (h ^ (uint8_t)(v >> (i * 8))) * 16777619u;
+    }
+    return h;
 }
 
-static size_t input_func(JDEC * jd, uint8_t * buff, size_t ndata)
+/**
+ * Read the SJPG header and the fragment offsets
+ * @param sjpeg     `sjpeg_data`/`sjpeg_data_size` (or `lv_file`) are already set
+ * @param r         reader at the beginning of the data
+ */
+static lv_res_t read_frame_table(SJPEG * sjpeg, src_reader_t * r)
 {
-    io_source_t * io = jd->device;
+    uint8_t buff[SJPEG_FRAME_INFO_ARRAY_OFFSET];
+    if(reader_read(r, buff, sizeof(buff)) != sizeof(buff)) return LV_RES_INV;
 
-    if(!io) return 0;
+    uint8_t * data = buff + SJPEG_X_RES_OFFSET;
+    sjpeg->sjpeg_x_res = *data++;
+    sjpeg->sjpeg_x_res |= *data++ << 8;
 
-    if(io->type == SJPEG_IO_SOURCE_C_ARRAY) {
-        const uint32_t bytes_left = io->raw_sjpg_data_size - io->raw_sjpg_data_next_read_pos;
-        const uint32_t to_read = ndata <= bytes_left ? (uint32_t)ndata : bytes_left;
-        if(to_read == 0)
-            return 0;
-        if(buff) {
-            memcpy(buff, io->raw_sjpg_data + io->raw_sjpg_data_next_read_pos, to_read);
-        }
-        io->raw_sjpg_data_next_read_pos += to_read;
-        return to_read;
+    sjpeg->sjpeg_y_res = *data++;
+    sjpeg->sjpeg_y_res |= *data++ << 8;
+
+    sjpeg->sjpeg_total_frames = *data++;
+    sjpeg->sjpeg_total_frames |= *data++ << 8;
+
+    sjpeg->sjpeg_single_frame_height = *data++;
+    sjpeg->sjpeg_single_frame_height |= *data++ << 8;
+
+    if(sjpeg->sjpeg_x_res == 0 || sjpeg->sjpeg_total_frames == 0 || sjpeg->sjpeg_single_frame_height == 0) {
+        return LV_RES_INV;
     }
-    else if(io->type == SJPEG_IO_SOURCE_DISK) {
 
-        lv_fs_file_t * lv_file_p = &(io->lv_file);
+    sjpeg->frame_offset = lv_mem_alloc(sizeof(uint32_t) * (sjpeg->sjpeg_total_frames + 1));
+    if(!sjpeg->frame_offset) return LV_RES_INV;
 
-        if(buff) {
-            uint32_t rn = 0;
-            lv_fs_read(lv_file_p, buff, (uint32_t)ndata, &rn);
-            return rn;
-        }
-        else {
-            uint32_t pos;
-            lv_fs_tell(lv_file_p, &pos);
-            lv_fs_seek(lv_file_p, (uint32_t)(ndata + pos),  LV_FS_SEEK_SET);
-            return ndata;
-        }
+    sjpeg->frame_offset[0] = SJPEG_FRAME_INFO_ARRAY_OFFSET + sjpeg->sjpeg_total_frames * 2;
+    for(int i = 1; i < sjpeg->sjpeg_total_frames; i++) {
+        if(reader_read(r, buff, 2) != 2) return LV_RES_INV;
+        sjpeg->frame_offset[i] = sjpeg->frame_offset[i - 1] + (buff[0] | (buff[1] << 8));
     }
-    return 0;
+    sjpeg->frame_offset[sjpeg->sjpeg_total_frames] = sjpeg->sjpeg_data_size;
+
+    return sjpeg->frame_offset[sjpeg->sjpeg_total_frames - 1] < sjpeg->sjpeg_data_size ? LV_RES_OK : LV_RES_INV;
 }
 
 /**
@@ -343,364 +468,484 @@ static size_t input_func(JDEC * jd, uint8_t * buff, size_t ndata)
 static lv_res_t decoder_open(lv_img_decoder_t * decoder, lv_img_decoder_dsc_t * dsc)
 {
     LV_UNUSED(decoder);
-    lv_res_t lv_ret = LV_RES_OK;
-
-    if(dsc->src_type == LV_IMG_SRC_VARIABLE) {
-        uint8_t * data;
-        SJPEG * sjpeg = (SJPEG *) dsc->user_data;
-        const uint32_t raw_sjpeg_data_size = ((lv_img_dsc_t *)dsc->src)->data_size;
-        if(sjpeg == NULL) {
-            sjpeg =  lv_mem_alloc(sizeof(SJPEG));
-            if(!sjpeg) return LV_RES_INV;
-
-            memset(sjpeg, 0, sizeof(SJPEG));
-
-            dsc->user_data = sjpeg;
-            sjpeg->sjpeg_data = (uint8_t *)((lv_img_dsc_t *)(dsc->src))->data;
-            sjpeg->sjpeg_data_size = ((lv_img_dsc_t *)(dsc->src))->data_size;
-        }
-
-        if(!strncmp((char *) sjpeg->sjpeg_data, "_SJPG__", strlen("_SJPG__"))) {
 
-            data = sjpeg->sjpeg_data;
-            data += 14;
+    SJPEG * sjpeg = lv_mem_alloc(sizeof(SJPEG));
+    if(!sjpeg) return LV_RES_INV;
+    memset(sjpeg, 0, sizeof(SJPEG));
+    sjpeg->last_frame = -1;
 
-            sjpeg->sjpeg_x_res = *data++;
-            sjpeg->sjpeg_x_res |= *data++ << 8;
+    bool is_sjpg;
+    src_reader_t reader = {NULL, 0, 0, NULL};
 
-            sjpeg->sjpeg_y_res = *data++;
-            sjpeg->sjpeg_y_res |= *data++ << 8;
-
-            sjpeg->sjpeg_total_frames = *data++;
-            sjpeg->sjpeg_total_frames |= *data++ << 8;
-
-            sjpeg->sjpeg_single_frame_height = *data++;
-            sjpeg->sjpeg_single_frame_height |= *data++ << 8;
-
-            sjpeg->frame_base_array = lv_mem_alloc(sizeof(uint8_t *) * sjpeg->sjpeg_total_frames);
-            if(! sjpeg->frame_base_array) {
-                lv_sjpg_cleanup(sjpeg);
-                sjpeg = NULL;
-                return LV_RES_INV;
-            }
-
-            sjpeg->frame_base_offset = NULL;
+    if(dsc->src_type == LV_IMG_SRC_VARIABLE) {
+        const lv_img_dsc_t * img_dsc = dsc->src;
+        sjpeg->sjpeg_data = img_dsc->data;
+        sjpeg->sjpeg_data_size = img_dsc->data_size;
+        reader.data = sjpeg->sjpeg_data;
+        reader.size = sjpeg->sjpeg_data_size;
+
+        is_sjpg = sjpeg->sjpeg_data_size >= SJPEG_FRAME_INFO_ARRAY_OFFSET &&
+                  !strncmp((char *)sjpeg->sjpeg_data, "_SJPG__", strlen("_SJPG__"));
+        if(!is_sjpg && !is_jpg(sjpeg->sjpeg_data, sjpeg->sjpeg_data_size)) {
+            lv_sjpg_cleanup(sjpeg);
+            return LV_RES_INV;
+        }
+    }
+    else if(dsc->src_type == LV_IMG_SRC_FILE) {
+        /* If all fine, then the file will be kept open */
+        const char * fn = dsc->src;
+        is_sjpg = strcmp(lv_fs_get_ext(fn), "sjpg") == 0;
+        if((!is_sjpg && strcmp(lv_fs_get_ext(fn), "jpg") != 0) ||
+           lv_fs_open(&sjpeg->lv_file, fn, LV_FS_MODE_RD) != LV_FS_RES_OK) {
+            lv_sjpg_cleanup(sjpeg);
+            return LV_RES_INV;
+        }
+        sjpeg->file_opened = true;
 
-            uint8_t * img_frame_base = data +  sjpeg->sjpeg_total_frames * 2;
-            sjpeg->frame_base_array[0] = img_frame_base;
+        lv_fs_seek(&sjpeg->lv_file, 0, LV_FS_SEEK_END);
+        lv_fs_tell(&sjpeg->lv_file, &sjpeg->sjpeg_data_size);
+        lv_fs_seek(&sjpeg->lv_file, 0, LV_FS_SEEK_SET);
+        reader.file = &sjpeg->lv_file;
+    }
+    else {
+        lv_sjpg_cleanup(sjpeg);
+        return LV_RES_INV;
+    }
 
-            for(int i = 1; i <  sjpeg->sjpeg_total_frames; i++) {
-                int offset = *data++;
-                offset |= *data++ << 8;
-                sjpeg->frame_base_array[i] = sjpeg->frame_base_array[i - 1] + offset;
-            }
-            sjpeg->sjpeg_cache_frame_index = -1;
-            sjpeg->frame_cache = (void *)lv_mem_alloc(sjpeg->sjpeg_x_res * sjpeg->sjpeg_single_frame_height * 3/*2*/);
-            if(! sjpeg->frame_cache) {
-                lv_sjpg_cleanup(sjpeg);
-                sjpeg = NULL;
-                return LV_RES_INV;
-            }
-            sjpeg->io.img_cache_buff = sjpeg->frame_cache;
-            sjpeg->io.img_cache_x_res = sjpeg->sjpeg_x_res;
-            sjpeg->workb =   lv_mem_alloc(TJPGD_WORKBUFF_SIZE);
-            if(! sjpeg->workb) {
-                lv_sjpg_cleanup(sjpeg);
-                sjpeg = NULL;
-                return LV_RES_INV;
+    lv_res_t res;
+    if(is_sjpg) {
+        char magic[8];
+        res = reader_read(&reader, (uint8_t *)magic, 8) == 8 && strcmp(magic, "_SJPG__") == 0 ? LV_RES_OK : LV_RES_INV;
+        reader.pos = 0;
+        if(reader.file) lv_fs_seek(reader.file, 0, LV_FS_SEEK_SET);
+        if(res == LV_RES_OK) res = read_frame_table(sjpeg, &reader);
+    }
+    else {
+        /*A normal JPG is a single fragment*/
+        res = jpg_read_size(&reader, &sjpeg->sjpeg_x_res, &sjpeg->sjpeg_y_res) ? LV_RES_OK : LV_RES_INV;
+        if(res == LV_RES_OK) {
+            sjpeg->sjpeg_total_frames = 1;
+            sjpeg->sjpeg_single_frame_height = sjpeg->sjpeg_y_res;
+            sjpeg->frame_offset = lv_mem_alloc(sizeof(uint32_t) * 2);
+            if(sjpeg->frame_offset) {
+                sjpeg->frame_offset[0] = 0;
+                sjpeg->frame_offset[1] = sjpeg->sjpeg_data_size;
             }
-
-            sjpeg->tjpeg_jd =   lv_mem_alloc(sizeof(JDEC));
-            if(! sjpeg->tjpeg_jd) {
-                lv_sjpg_cleanup(sjpeg);
-                sjpeg = NULL;
-                return LV_RES_INV;
+            else {
+                res = LV_RES_INV;
             }
-            sjpeg->io.type = SJPEG_IO_SOURCE_C_ARRAY;
-            sjpeg->io.lv_file.file_d = NULL;
-            dsc->img_data = NULL;
-            return lv_ret;
         }
-        else if(is_jpg(sjpeg->sjpeg_data, raw_sjpeg_data_size) == true) {
-
-            uint8_t * workb_temp = lv_mem_alloc(TJPGD_WORKBUFF_SIZE);
-            if(! workb_temp) {
-                lv_sjpg_cleanup(sjpeg);
-                sjpeg = NULL;
-                return LV_RES_INV;
-            }
-            io_source_t io_source_temp;
-            io_source_temp.type = SJPEG_IO_SOURCE_C_ARRAY;
-            io_source_temp.raw_sjpg_data =  sjpeg->sjpeg_data;
-            io_source_temp.raw_sjpg_data_size = sjpeg->sjpeg_data_size;
-            io_source_temp.raw_sjpg_data_next_read_pos = 0;
-
-            JDEC jd_tmp;
-            JRESULT rc = jd_prepare(&jd_tmp, input_func, workb_temp, (size_t)TJPGD_WORKBUFF_SIZE, &io_source_temp);
-            lv_mem_free(workb_temp);
-
-            if(rc == JDR_OK) {
-                sjpeg->sjpeg_x_res = jd_tmp.width;
-                sjpeg->sjpeg_y_res = jd_tmp.height;
-                sjpeg->sjpeg_total_frames = 1;
-                sjpeg->sjpeg_single_frame_height = jd_tmp.height;
-
-                sjpeg->frame_base_array = lv_mem_alloc(sizeof(uint8_t *) * sjpeg->sjpeg_total_frames);
-                if(! sjpeg->frame_base_array) {
-                    lv_sjpg_cleanup(sjpeg);
-                    sjpeg = NULL;
-                    return LV_RES_INV;
-                }
-                sjpeg->frame_base_offset = NULL;
+    }
 
-                uint8_t * img_frame_base = sjpeg->sjpeg_data;
-                sjpeg->frame_base_array[0] = img_frame_base;
+    if(res != LV_RES_OK) {
+        lv_sjpg_cleanup(sjpeg);
+        return LV_RES_INV;
+    }
 
-                sjpeg->sjpeg_cache_frame_index = -1;
-                sjpeg->frame_cache = (void *)lv_mem_alloc(sjpeg->sjpeg_x_res * sjpeg->sjpeg_single_frame_height * 3);
-                if(! sjpeg->frame_cache) {
-                    lv_sjpg_cleanup(sjpeg);
-                    sjpeg = NULL;
-                    return LV_RES_INV;
-                }
+    sjpeg->key = src_key(dsc);
+    dsc->user_data = sjpeg;
+    dsc->img_data = NULL;
+    return LV_RES_OK;
+}
 
-                sjpeg->io.img_cache_buff = sjpeg->frame_cache;
-                sjpeg->io.img_cache_x_res = sjpeg->sjpeg_x_res;
-                sjpeg->workb =   lv_mem_alloc(TJPGD_WORKBUFF_SIZE);
-                if(! sjpeg->workb) {
-                    lv_sjpg_cleanup(sjpeg);
-                    sjpeg = NULL;
-                    return LV_RES_INV;
-                }
+/**********************
+ *   FRAGMENT CACHE
+ **********************/
 
-                sjpeg->tjpeg_jd =   lv_mem_alloc(sizeof(JDEC));
-                if(! sjpeg->tjpeg_jd) {
-                    lv_sjpg_cleanup(sjpeg);
-                    sjpeg = NULL;
-                    return LV_RES_INV;
-                }
+static int frame_rows(const SJPEG * sjpeg, int frame)
+{
+    return LV_MIN(sjpeg->sjpeg_single_frame_height, sjpeg->sjpeg_y_res - frame * sjpeg->sjpeg_single_frame_height);
+}
 
-                sjpeg->io.type = SJPEG_IO_SOURCE_C_ARRAY;
-                sjpeg->io.lv_file.file_d = NULL;
-                dsc->img_data = NULL;
-                return lv_ret;
-            }
-            else {
-                lv_ret = LV_RES_INV;
-                goto end;
-            }
+static void entry_unref(frag_entry_t * e)
+{
+    if(--e->ref_cnt) return;
+    lv_mem_free(e->buf);
+    lv_mem_free(e);
+}
 
-end:
-            lv_mem_free(workb_temp);
+/**
+ * Remove an entry from the cache. A queued job notices it and does nothing.
+ * Must be called with `cache_lock` held.
+ */
+static void cache_drop(frag_entry_t ** node)
+{
+    frag_entry_t * e = *node;
+    _lv_ll_remove(&cache_ll, node);
+    lv_mem_free(node);
+    cache_size -= e->buf_size;
+    if(e->state == FRAG_QUEUED) e->state = FRAG_EMPTY;
+    entry_unref(e);
+}
 
-            return lv_ret;
+static frag_entry_t * cache_find(const SJPEG * sjpeg, int frame)
+{
+    frag_entry_t ** node;
+    _LV_LL_READ(&cache_ll, node) {
+        frag_entry_t * e = *node;
+        if(e->key == sjpeg->key && e->data_size == sjpeg->sjpeg_data_size && e->frame == frame) {
+            _lv_ll_move_before(&cache_ll, node, _lv_ll_get_head(&cache_ll));
+            return e;
         }
     }
-    else if(dsc->src_type == LV_IMG_SRC_FILE) {
-        /* If all fine, then the file will be kept open */
-        const char * fn = dsc->src;
-        uint8_t * data;
+    return NULL;
+}
 
-        if(strcmp(lv_fs_get_ext(fn), "sjpg") == 0) {
+/**
+ * Add an empty entry for a fragment, evict the least recently used ones to keep the cache in `LV_SJPG_CACHE_SIZE`.
+ * A fragment bigger than the whole cache (e.g. a large normal JPG) is still added after evicting everything else.
+ * Must be called with `cache_lock` held.
+ */
+static frag_entry_t * cache_add(const SJPEG * sjpeg, int frame, frag_state_t state)
+{
+    uint32_t buf_size = (uint32_t)sjpeg->sjpeg_x_res * frame_rows(sjpeg, frame) * sizeof(lv_color_t);
+
+    /*Entries being decoded on a worker can't be evicted*/
+    frag_entry_t ** node = _lv_ll_get_tail(&cache_ll);
+    while(node && cache_size + buf_size > LV_SJPG_CACHE_SIZE) {
+        frag_entry_t ** prev = _lv_ll_get_prev(&cache_ll, node);
+        if((*node)->state != FRAG_DECODING) cache_drop(node);
+        node = prev;
+    }
 
-            uint8_t buff[22];
-            memset(buff, 0, sizeof(buff));
+    frag_entry_t * e = lv_mem_alloc(sizeof(frag_entry_t));
+    if(!e) return NULL;
+    e->buf = lv_mem_alloc(buf_size);
+    node = e->buf ? _lv_ll_ins_head(&cache_ll) : NULL;
+    if(!node) {
+        lv_mem_free(e->buf);
+        lv_mem_free(e);
+        return NULL;
+    }
+    *node = e;
+
+    e->key = sjpeg->key;
+    e->data_size = sjpeg->sjpeg_data_size;
+    e->frame = frame;
+    e->state = state;
+    e->ref_cnt = 1;
+    e->buf_size = buf_size;
+    cache_size += buf_size;
+    return e;
+}
 
-            lv_fs_file_t lv_file;
-            lv_fs_res_t res = lv_fs_open(&lv_file, fn, LV_FS_MODE_RD);
-            if(res != LV_FS_RES_OK) {
-                return 78;
-            }
+/**
+ * Read a compressed fragment
+ * @param copy      false: a C array is returned in place, true: always allocate a copy
+ * @return          the data (free it with `lv_mem_free` if `*allocated`), NULL on error
+ */
+static uint8_t * load_fragment(SJPEG * sjpeg, int frame, uint32_t * size, bool copy, bool * allocated)
+{
+    uint32_t start = sjpeg->frame_offset[frame];
+    *size = sjpeg->frame_offset[frame + 1] - start;
+    *allocated = false;
 
-            uint32_t rn;
-            res = lv_fs_read(&lv_file, buff, 22, &rn);
-            if(res != LV_FS_RES_OK || rn != 22) {
-                lv_fs_close(&lv_file);
-                return LV_RES_INV;
-            }
+    if(sjpeg->sjpeg_data && !copy) return (uint8_t *)sjpeg->sjpeg_data + start;
 
-            if(strcmp((char *)buff, "_SJPG__") == 0) {
+    uint8_t * data = lv_mem_alloc(*size);
+    if(!data) return NULL;
+    *allocated = true;
 
-                SJPEG * sjpeg = (SJPEG *) dsc->user_data;
-                if(sjpeg == NULL) {
-                    sjpeg = lv_mem_alloc(sizeof(SJPEG));
+    if(sjpeg->sjpeg_data) {
+        lv_memcpy(data, sjpeg->sjpeg_data + start, *size);
+        return data;
+    }
 
-                    if(! sjpeg) {
-                        lv_fs_close(&lv_file);
-                        return LV_RES_INV;
-                    }
-                    memset(sjpeg, 0, sizeof(SJPEG));
+    uint32_t rn = 0;
+    if(lv_fs_seek(&sjpeg->lv_file, start, LV_FS_SEEK_SET) != LV_FS_RES_OK ||
+       lv_fs_read(&sjpeg->lv_file, data, *size, &rn) != LV_FS_RES_OK || rn != *size) {
+        lv_mem_free(data);
+        return NULL;
+    }
+    return data;
+}
 
-                    dsc->user_data = sjpeg;
-                    sjpeg->sjpeg_data = (uint8_t *)((lv_img_dsc_t *)(dsc->src))->data;
-                    sjpeg->sjpeg_data_size = ((lv_img_dsc_t *)(dsc->src))->data_size;
-                }
-                data = buff;
-                data += 14;
+#if LV_SJPG_USE_WORKER
+static void frag_job_cb(void * p)
+{
+    frag_job_t * job = p;
+    frag_entry_t * e = job->entry;
 
-                sjpeg->sjpeg_x_res = *data++;
-                sjpeg->sjpeg_x_res |= *data++ << 8;
+    CACHE_LOCK();
+    bool run = e->state == FRAG_QUEUED;     /*Not taken over by the UI thread or evicted*/
+    if(run) e->state = FRAG_DECODING;
+    CACHE_UNLOCK();
 
-                sjpeg->sjpeg_y_res = *data++;
-                sjpeg->sjpeg_y_res |= *data++ << 8;
+    lv_res_t res = run ? decode_fragment(job->data, job->size, e->buf, job->w, job->h) : LV_RES_INV;
 
-                sjpeg->sjpeg_total_frames = *data++;
-                sjpeg->sjpeg_total_frames |= *data++ << 8;
+    CACHE_LOCK();
+    if(run) {
+        e->state = res == LV_RES_OK ? FRAG_READY : FRAG_FAILED;
+        CACHE_SIGNAL();
+    }
+    entry_unref(e);
+    CACHE_UNLOCK();
+    lv_mem_free(job->data);
+    lv_mem_free(job);
+}
 
-                sjpeg->sjpeg_single_frame_height = *data++;
-                sjpeg->sjpeg_single_frame_height |= *data++ << 8;
+/**
+ * Release a job that won't run, the fragment is decoded on demand later
+ */
+static void frag_job_drop(void * p)
+{
+    frag_job_t * job = p;
+    frag_entry_t * e = job->entry;
+
+    CACHE_LOCK();
+    if(e->state == FRAG_QUEUED) e->state = FRAG_EMPTY;
+    entry_unref(e);
+    CACHE_UNLOCK();
+    lv_mem_free(job->data);
+    lv_mem_free(job);
+}
 
-                sjpeg->frame_base_array = NULL;//lv_mem_alloc( sizeof(uint8_t *) * sjpeg->sjpeg_total_frames );
-                sjpeg->frame_base_offset = lv_mem_alloc(sizeof(int) * sjpeg->sjpeg_total_frames);
-                if(! sjpeg->frame_base_offset) {
-                    lv_fs_close(&lv_file);
-                    lv_sjpg_cleanup(sjpeg);
-                    return LV_RES_INV;
-                }
-                int img_frame_start_offset = (SJPEG_FRAME_INFO_ARRAY_OFFSET + sjpeg->sjpeg_total_frames * 2);
-                sjpeg->frame_base_offset[0] = img_frame_start_offset; //pointer used to save integer for now...
-
-                for(int i = 1; i <  sjpeg->sjpeg_total_frames; i++) {
-                    res = lv_fs_read(&lv_file, buff, 2, &rn);
-                    if(res != LV_FS_RES_OK || rn != 2) {
-                        lv_fs_close(&lv_file);
-                        return LV_RES_INV;
-                    }
-
-                    data = buff;
-                    int offset = *data++;
-                    offset |= *data++ << 8;
-                    sjpeg->frame_base_offset[i] = sjpeg->frame_base_offset[i - 1] + offset;
-                }
+/**
+ * Queue the fragments after `frame` on the worker threads
+ */
+static void prefetch(SJPEG * sjpeg, int frame)
+{
+    int last = LV_MIN(frame + SJPEG_PREFETCH_FRAMES, sjpeg->sjpeg_total_frames - 1);
+    for(int f = frame + 1; f <= last; f++) {
+        /*Don't evict fragments of this image that may still be on the screen for a prefetch*/
+        uint32_t buf_size = (uint32_t)sjpeg->sjpeg_x_res * frame_rows(sjpeg, f) * sizeof(lv_color_t);
+        if(buf_size * (SJPEG_PREFETCH_FRAMES + 1) > LV_SJPG_CACHE_SIZE) return;
+
+        CACHE_LOCK();
+        frag_entry_t * e = cache_find(sjpeg, f);
+        if(!e) {
+            e = cache_add(sjpeg, f, FRAG_QUEUED);
+            if(e) e->ref_cnt++;
+        }
+        else {
+            e = NULL;
+        }
+        CACHE_UNLOCK();
+        if(!e) continue;
+
+        frag_job_t * job = lv_mem_alloc(sizeof(frag_job_t));
+        bool allocated;
+        if(job) {
+            job->entry = e;
+            job->w = sjpeg->sjpeg_x_res;
+            job->h = frame_rows(sjpeg, f);
+            job->data = load_fragment(sjpeg, f, &job->size, true, &allocated);
+        }
 
-                sjpeg->sjpeg_cache_frame_index = -1; //INVALID AT BEGINNING for a forced compare mismatch at first time.
-                sjpeg->frame_cache = (void *)lv_mem_alloc(sjpeg->sjpeg_x_res * sjpeg->sjpeg_single_frame_height * 3);
-                if(! sjpeg->frame_cache) {
-                    lv_fs_close(&lv_file);
-                    lv_sjpg_cleanup(sjpeg);
-                    return LV_RES_INV;
-                }
-                sjpeg->io.img_cache_buff = sjpeg->frame_cache;
-                sjpeg->io.img_cache_x_res = sjpeg->sjpeg_x_res;
-                sjpeg->workb =   lv_mem_alloc(TJPGD_WORKBUFF_SIZE);
-                if(! sjpeg->workb) {
-                    lv_fs_close(&lv_file);
-                    lv_sjpg_cleanup(sjpeg);
-                    return LV_RES_INV;
-                }
+        if(!job || !job->data) {
+            if(job) lv_mem_free(job->data);
+            lv_mem_free(job);
+            CACHE_LOCK();
+            if(e->state == FRAG_QUEUED) e->state = FRAG_EMPTY;      /*Decoded on demand later*/
+            entry_unref(e);
+            CACHE_UNLOCK();
+        }
+        else if(worker_post_cb(frag_job_cb, frag_job_drop, job) != LV_RES_OK) {
+            frag_job_drop(job);
+        }
+    }
+}
+#endif
 
-                sjpeg->tjpeg_jd =    lv_mem_alloc(sizeof(JDEC));
-                if(! sjpeg->tjpeg_jd) {
-                    lv_fs_close(&lv_file);
-                    lv_sjpg_cleanup(sjpeg);
-                    return LV_RES_INV;
-                }
+/**
+ * Get a decoded fragment, decode it now if it's not cached or still waiting for a worker.
+ * The returned buffer is valid until the next cache operation.
+ */
+static const lv_color_t * get_frame(SJPEG * sjpeg, int frame)
+{
+    CACHE_LOCK();
+    frag_entry_t * e = cache_find(sjpeg, frame);
+    bool decode_now = false;
+    if(e && (e->state == FRAG_QUEUED || e->state == FRAG_EMPTY)) {
+        /*Take it over instead of waiting for the worker (the job sees the state change and quits)*/
+        e->state = FRAG_DECODING;
+        decode_now = true;
+    }
+    else if(!e) {
+        e = cache_add(sjpeg, frame, FRAG_DECODING);
+        decode_now = e != NULL;
+    }
 
-                sjpeg->io.type = SJPEG_IO_SOURCE_DISK;
-                sjpeg->io.lv_file = lv_file;
-                dsc->img_data = NULL;
-                return LV_RES_OK;
-            }
-        }
-        else if(strcmp(lv_fs_get_ext(fn), "jpg") == 0) {
+    while(e && !decode_now && e->state == FRAG_DECODING) {
+        CACHE_WAIT();    /*Being decoded on a worker*/
+    }
+    CACHE_UNLOCK();
+    if(!e) return NULL;
+
+    if(decode_now) {
+        uint32_t size;
+        bool allocated;
+        uint8_t * data = load_fragment(sjpeg, frame, &size, false, &allocated);
+        lv_res_t res = data ? decode_fragment(data, size, e->buf, sjpeg->sjpeg_x_res, frame_rows(sjpeg, frame)) : LV_RES_INV;
+        if(allocated) lv_mem_free(data);
+
+        CACHE_LOCK();
+        e->state = res == LV_RES_OK ? FRAG_READY : FRAG_FAILED;
+        CACHE_SIGNAL();
+        CACHE_UNLOCK();
+    }
 
-            lv_fs_file_t lv_file;
-            lv_fs_res_t res = lv_fs_open(&lv_file, fn, LV_FS_MODE_RD);
-            if(res != LV_FS_RES_OK) {
-                return LV_RES_INV;
-            }
+    return e->state == FRAG_READY ? e->buf : NULL;
+}
 
-            SJPEG * sjpeg = (SJPEG *) dsc->user_data;
-            if(sjpeg == NULL) {
-                sjpeg = lv_mem_alloc(sizeof(SJPEG));
-                if(! sjpeg) {
-                    lv_fs_close(&lv_file);
-                    return LV_RES_INV;
-                }
+/**********************
+ *  FRAGMENT DECODING
+ **********************/
 
-                memset(sjpeg, 0, sizeof(SJPEG));
-                dsc->user_data = sjpeg;
-                sjpeg->sjpeg_data = (uint8_t *)((lv_img_dsc_t *)(dsc->src))->data;
-                sjpeg->sjpeg_data_size = ((lv_img_dsc_t *)(dsc->src))->data_size;
-            }
+static void rgb888_to_color(lv_color_t * dst, const uint8_t * src, uint32_t len)
+{
+#if LV_COLOR_DEPTH == 32
+    for(uint32_t i = 0; i < len; i++) {
+        dst[i] = lv_color_make(src[0], src[1], src[2]);
+        src += 3;
+    }
+#elif LV_COLOR_DEPTH == 16
+    lv_color_conv_rgb888_to_rgb565((uint8_t *)dst, src, len, SJPEG_COLOR_CONV_FLAGS);
+#elif LV_COLOR_DEPTH == 8
+    for(uint32_t i = 0; i < len; i++) {
+        uint8_t col_8bit = (*src++ & 0xC0);
+        col_8bit |= (*src++ & 0xe0) >> 2;
+        col_8bit |= (*src++ & 0xe0) >> 5;
+        dst[i].full = col_8bit;
+    }
+#else
+#error Unsupported LV_COLOR_DEPTH
+#endif
+}
 
-            uint8_t * workb_temp = lv_mem_alloc(TJPGD_WORKBUFF_SIZE);
-            if(! workb_temp) {
-                lv_fs_close(&lv_file);
-                lv_sjpg_cleanup(sjpeg);
-                return LV_RES_INV;
-            }
+/**
+ * Clear the part of a `w` x `h` fragment that a smaller embedded JPEG (`dec_w` x `dec_h`) didn't cover,
+ * the buffer is recycled from the cache and would otherwise show another fragment's pixels
+ */
+static void clear_uncovered(lv_color_t * dst, int w, int h, uint32_t dec_w, uint32_t dec_h)
+{
+    uint32_t rows = LV_MIN(dec_h, (uint32_t)h);
+    if(dec_w < (uint32_t)w) {
+        for(uint32_t y = 0; y < rows; y++) lv_memset_00(dst + y * w + dec_w, (w - dec_w) * sizeof(lv_color_t));
+    }
+    if(rows < (uint32_t)h) lv_memset_00(dst + rows * w, (h - rows) * w * sizeof(lv_color_t));
+}
 
-            io_source_t io_source_temp;
-            io_source_temp.type = SJPEG_IO_SOURCE_DISK;
-            io_source_temp.raw_sjpg_data_next_read_pos = 0;
-            io_source_temp.img_cache_buff = NULL;
-            io_source_temp.lv_file = lv_file;
+#if LV_SJPG_USE_LIBJPEG
 
-            JDEC jd_tmp;
+typedef struct {
+    struct jpeg_error_mgr pub;
+    jmp_buf jump;
+} libjpeg_err_t;
 
-            JRESULT rc = jd_prepare(&jd_tmp, input_func, workb_temp, (size_t)TJPGD_WORKBUFF_SIZE, &io_source_temp);
+static void libjpeg_error_exit(j_common_ptr cinfo)
+{
+    libjpeg_err_t * err = (libjpeg_err_t *)cinfo->err;
+    char msg[JMSG_LENGTH_MAX];
+    err->pub.format_message(cinfo, msg);
+    LV_LOG_WARN("sjpg: %s", msg);
+    longjmp(err->jump, 1);
+}
 
-            lv_mem_free(workb_temp);
+/**
+ * Decode a complete JPEG into `w` x `h` colors (rows/columns outside are dropped, missing ones are cleared)
+ */
+static lv_res_t decode_fragment(const uint8_t * data, uint32_t size, lv_color_t * dst, int w, int h)
+{
+    struct jpeg_decompress_struct cinfo;
+    libjpeg_err_t jerr;
+    uint8_t * volatile row = NULL;
+
+    cinfo.err = jpeg_std_error(&jerr.pub);
+    jerr.pub.error_exit = libjpeg_error_exit;
+    jpeg_create_decompress(&cinfo);
+
+    if(setjmp(jerr.jump)) {
+        jpeg_destroy_decompress(&cinfo);
+        lv_mem_free(row);
+        return LV_RES_INV;
+    }
 
-            if(rc == JDR_OK) {
-                sjpeg->sjpeg_x_res = jd_tmp.width;
-                sjpeg->sjpeg_y_res = jd_tmp.height;
-                sjpeg->sjpeg_total_frames = 1;
-                sjpeg->sjpeg_single_frame_height = jd_tmp.height;
+    jpeg_mem_src(&cinfo, (unsigned char *)data, size);
+    jpeg_read_header(&cinfo, TRUE);
+    cinfo.out_color_space = JCS_RGB;
+    jpeg_start_decompress(&cinfo);
 
-                sjpeg->frame_base_array = NULL;
-                sjpeg->frame_base_offset =  lv_mem_alloc(sizeof(uint8_t *) * sjpeg->sjpeg_total_frames);
-                if(! sjpeg->frame_base_offset) {
-                    lv_fs_close(&lv_file);
-                    lv_sjpg_cleanup(sjpeg);
-                    return LV_RES_INV;
-                }
+    row = lv_mem_alloc(cinfo.output_width * 3);
+    if(!row) longjmp(jerr.jump, 1);
 
-                int img_frame_start_offset = 0;
-                sjpeg->frame_base_offset[0] = img_frame_start_offset;
+    uint32_t out_w = LV_MIN(cinfo.output_width, (uint32_t)w);
+    while(cinfo.output_scanline < cinfo.output_height) {
+        uint32_t y = cinfo.output_scanline;
+        JSAMPROW rows[1] = {row};
+        jpeg_read_scanlines(&cinfo, rows, 1);
+        if(y < (uint32_t)h) rgb888_to_color(dst + y * w, row, out_w);
+    }
 
-                sjpeg->sjpeg_cache_frame_index = -1;
-                sjpeg->frame_cache = (void *)lv_mem_alloc(sjpeg->sjpeg_x_res * sjpeg->sjpeg_single_frame_height * 3);
-                if(! sjpeg->frame_cache) {
-                    lv_fs_close(&lv_file);
-                    lv_sjpg_cleanup(sjpeg);
-                    return LV_RES_INV;
-                }
+    clear_uncovered(dst, w, h, cinfo.output_width, cinfo.output_height);
+    jpeg_finish_decompress(&cinfo);
+    jpeg_destroy_decompress(&cinfo);
+    lv_mem_free(row);
+    return LV_RES_OK;
+}
 
-                sjpeg->io.img_cache_buff = sjpeg->frame_cache;
-                sjpeg->io.img_cache_x_res = sjpeg->sjpeg_x_res;
-                sjpeg->workb =   lv_mem_alloc(TJPGD_WORKBUFF_SIZE);
-                if(! sjpeg->workb) {
-                    lv_fs_close(&lv_file);
-                    lv_sjpg_cleanup(sjpeg);
-                    return LV_RES_INV;
-                }
+#else
 
-                sjpeg->tjpeg_jd =   lv_mem_alloc(sizeof(JDEC));
-                if(! sjpeg->tjpeg_jd) {
-                    lv_fs_close(&lv_file);
-                    lv_sjpg_cleanup(sjpeg);
-                    return LV_RES_INV;
-                }
+typedef struct {
+    const uint8_t * data;
+    uint32_t size;
+    uint32_t pos;
+    lv_color_t * dst;
+    int w;
+    int h;
+} tjpgd_io_t;
 
-                sjpeg->io.type = SJPEG_IO_SOURCE_DISK;
-                sjpeg->io.lv_file = lv_file;
-                dsc->img_data = NULL;
-                return LV_RES_OK;
+static size_t input_func(JDEC * jd, uint8_t * buff, size_t ndata)
+{
+    tjpgd_io_t * io = jd->device;
+    uint32_t n = LV_MIN((uint32_t)ndata, io->size - io->pos);
+    if(buff) lv_memcpy(buff, io->data + io->pos, n);
+    io->pos += n;
+    return n;
+}
 
-            }
-            else {
-                if(dsc->user_data) lv_mem_free(dsc->user_data);
-                lv_fs_close(&lv_file);
-                return  LV_RES_INV;
-            }
+static int img_data_cb(JDEC * jd, void * data, JRECT * rect)
+{
+    tjpgd_io_t * io = jd->device;
+    const uint8_t * buf = data;
+    const int INPUT_PIXEL_SIZE = 3;
+    const int row_width = rect->right - rect->left + 1; // Row width in pixels.
+    const int row_size = row_width * INPUT_PIXEL_SIZE;  // Row size (bytes).
+    const int copy_width = LV_MIN(row_width, io->w - rect->left);
+
+    for(int y = rect->top; y <= rect->bottom && y < io->h; y++) {
+        if(copy_width > 0) rgb888_to_color(io->dst + y * io->w + rect->left, buf, copy_width);
+        buf += row_size;
+    }
+
+    return 1;
+}
+
+/**
+ * Decode a complete JPEG into `w` x `h` colors (rows/columns outside are dropped, missing ones are cleared)
+ */
+static lv_res_t decode_fragment(const uint8_t * data, uint32_t size, lv_color_t * dst, int w, int h)
+{
+    uint8_t * workb = lv_mem_alloc(TJPGD_WORKBUFF_SIZE);
+    JDEC * jd = lv_mem_alloc(sizeof(JDEC));
+    lv_res_t res = LV_RES_INV;
+
+    if(workb && jd) {
+        tjpgd_io_t io = {data, size, 0, dst, w, h};
+        if(jd_prepare(jd, input_func, workb, (size_t)TJPGD_WORKBUFF_SIZE, &io) == JDR_OK &&
+           jd_decomp(jd, img_data_cb, 0) == JDR_OK) {
+            clear_uncovered(dst, w, h, jd->width, jd->height);
+            res = LV_RES_OK;
         }
     }
 
-    return LV_RES_INV;
+    lv_mem_free(jd);
+    lv_mem_free(workb);
+    return res;
 }
 
+#endif /*LV_SJPG_USE_LIBJPEG*/
+
 /**
  * Decode `len` pixels starting from the given `x`, `y` coordinates and store them in `buf`.
  * Required only if the "open" function can't open the whole decoded pixel array. (dsc->img_data == NULL)
@@ -712,146 +957,27 @@ end:
  * @param buf a buffer to store the decoded pixels
  * @return LV_RES_OK: ok; LV_RES_INV: failed
  */
-
 static lv_res_t decoder_read_line(lv_img_decoder_t * decoder, lv_img_decoder_dsc_t * dsc, lv_coord_t x, lv_coord_t y,
                                   lv_coord_t len, uint8_t * buf)
 {
     LV_UNUSED(decoder);
-    if(dsc->src_type == LV_IMG_SRC_VARIABLE) {
-        SJPEG * sjpeg = (SJPEG *) dsc->user_data;
-        JRESULT rc;
-
-        int sjpeg_req_frame_index = y / sjpeg->sjpeg_single_frame_height;
-
-        /*If line not from cache, refresh cache */
-        if(sjpeg_req_frame_index != sjpeg->sjpeg_cache_frame_index) {
-            sjpeg->io.raw_sjpg_data = sjpeg->frame_base_array[ sjpeg_req_frame_index ];
-            if(sjpeg_req_frame_index == (sjpeg->sjpeg_total_frames - 1)) {
-                /*This is the last frame. */
-                const uint32_t frame_offset = (uint32_t)(sjpeg->io.raw_sjpg_data - sjpeg->sjpeg_data);
-                sjpeg->io.raw_sjpg_data_size = sjpeg->sjpeg_data_size - frame_offset;
-            }
-            else {
-                sjpeg->io.raw_sjpg_data_size =
-                    (uint32_t)(sjpeg->frame_base_array[sjpeg_req_frame_index + 1] - sjpeg->io.raw_sjpg_data);
-            }
-            sjpeg->io.raw_sjpg_data_next_read_pos = 0;
-            rc = jd_prepare(sjpeg->tjpeg_jd, input_func, sjpeg->workb, (size_t)TJPGD_WORKBUFF_SIZE, &(sjpeg->io));
-            if(rc != JDR_OK) return LV_RES_INV;
-            rc = jd_decomp(sjpeg->tjpeg_jd, img_data_cb, 0);
-            if(rc != JDR_OK) return LV_RES_INV;
-            sjpeg->sjpeg_cache_frame_index = sjpeg_req_frame_index;
-        }
-
-        int offset = 0;
-        uint8_t * cache = (uint8_t *)sjpeg->frame_cache + x * 3 + (y % sjpeg->sjpeg_single_frame_height) * sjpeg->sjpeg_x_res *
-                          3;
-
-#if  LV_COLOR_DEPTH == 32
-        for(int i = 0; i < len; i++) {
-            buf[offset + 3] = 0xff;
-            buf[offset + 2] = *cache++;
-            buf[offset + 1] = *cache++;
-            buf[offset + 0] = *cache++;
-            offset += 4;
-        }
-
-#elif  LV_COLOR_DEPTH == 16
-
-        for(int i = 0; i < len; i++) {
-            uint16_t col_16bit = (*cache++ & 0xf8) << 8;
-            col_16bit |= (*cache++ & 0xFC) << 3;
-            col_16bit |= (*cache++ >> 3);
-#if  LV_BIG_ENDIAN_SYSTEM == 1 || LV_COLOR_16_SWAP == 1
-            buf[offset++] = col_16bit >> 8;
-            buf[offset++] = col_16bit & 0xff;
-#else
-            buf[offset++] = col_16bit & 0xff;
-            buf[offset++] = col_16bit >> 8;
-#endif // LV_BIG_ENDIAN_SYSTEM
-        }
-
-#elif  LV_COLOR_DEPTH == 8
-
-        for(int i = 0; i < len; i++) {
-            uint8_t col_8bit = (*cache++ & 0xC0);
-            col_8bit |= (*cache++ & 0xe0) >> 2;
-            col_8bit |= (*cache++ & 0xe0) >> 5;
-            buf[offset++] = col_8bit;
-        }
-#else
-#error Unsupported LV_COLOR_DEPTH
-
-#endif // LV_COLOR_DEPTH
-        return LV_RES_OK;
-    }
-    else if(dsc->src_type == LV_IMG_SRC_FILE) {
-        SJPEG * sjpeg = (SJPEG *) dsc->user_data;
-        JRESULT rc;
-        int sjpeg_req_frame_index = y / sjpeg->sjpeg_single_frame_height;
-
-        lv_fs_file_t * lv_file_p = &(sjpeg->io.lv_file);
-        if(!lv_file_p) goto end;
-
-        /*If line not from cache, refresh cache */
-        if(sjpeg_req_frame_index != sjpeg->sjpeg_cache_frame_index) {
-            sjpeg->io.raw_sjpg_data_next_read_pos = (int)(sjpeg->frame_base_offset [ sjpeg_req_frame_index ]);
-            lv_fs_seek(&(sjpeg->io.lv_file), sjpeg->io.raw_sjpg_data_next_read_pos, LV_FS_SEEK_SET);
-
-            rc = jd_prepare(sjpeg->tjpeg_jd, input_func, sjpeg->workb, (size_t)TJPGD_WORKBUFF_SIZE, &(sjpeg->io));
-            if(rc != JDR_OK) return LV_RES_INV;
-
-            rc = jd_decomp(sjpeg->tjpeg_jd, img_data_cb, 0);
-            if(rc != JDR_OK) return LV_RES_INV;
-
-            sjpeg->sjpeg_cache_frame_index = sjpeg_req_frame_index;
-        }
-
-        int offset = 0;
-        uint8_t * cache = (uint8_t *)sjpeg->frame_cache + x * 3 + (y % sjpeg->sjpeg_single_frame_height) * sjpeg->sjpeg_x_res *
-                          3;
-
-#if LV_COLOR_DEPTH == 32
-        for(int i = 0; i < len; i++) {
-            buf[offset + 3] = 0xff;
-            buf[offset + 2] = *cache++;
-            buf[offset + 1] = *cache++;
-            buf[offset + 0] = *cache++;
-            offset += 4;
-        }
-#elif  LV_COLOR_DEPTH == 16
-
-        for(int i = 0; i < len; i++) {
-            uint16_t col_8bit = (*cache++ & 0xf8) << 8;
-            col_8bit |= (*cache++ & 0xFC) << 3;
-            col_8bit |= (*cache++ >> 3);
-#if  LV_BIG_ENDIAN_SYSTEM == 1 || LV_COLOR_16_SWAP == 1
-            buf[offset++] = col_8bit >> 8;
-            buf[offset++] = col_8bit & 0xff;
-#else
-            buf[offset++] = col_8bit & 0xff;
-            buf[offset++] = col_8bit >> 8;
-#endif // LV_BIG_ENDIAN_SYSTEM
-        }
-
-#elif  LV_COLOR_DEPTH == 8
+    SJPEG * sjpeg = (SJPEG *) dsc->user_data;
+    if(!sjpeg || y < 0 || y >= sjpeg->sjpeg_y_res || x < 0 || x + len > sjpeg->sjpeg_x_res) return LV_RES_INV;
 
-        for(int i = 0; i < len; i++) {
-            uint8_t col_8bit = (*cache++ & 0xC0);
-            col_8bit |= (*cache++ & 0xe0) >> 2;
-            col_8bit |= (*cache++ & 0xe0) >> 5;
-            buf[offset++] = col_8bit;
-        }
+    int sjpeg_req_frame_index = y / sjpeg->sjpeg_single_frame_height;
+    const lv_color_t * frame = get_frame(sjpeg, sjpeg_req_frame_index);
+    if(!frame) return LV_RES_INV;
 
-#else
-#error Unsupported LV_COLOR_DEPTH
+    const lv_color_t * cache = frame + (y % sjpeg->sjpeg_single_frame_height) * sjpeg->sjpeg_x_res + x;
+    lv_memcpy(buf, cache, len * sizeof(lv_color_t));
 
-#endif // LV_COLOR_DEPTH
+#if LV_SJPG_USE_WORKER
+    /*Copy first: the prefetch may evict the fragment just read*/
+    if(worker_post_cb && sjpeg_req_frame_index != sjpeg->last_frame) prefetch(sjpeg, sjpeg_req_frame_index);
+#endif
+    sjpeg->last_frame = sjpeg_req_frame_index;
 
-        return LV_RES_OK;
-    }
-end:
-    return LV_RES_INV;
+    return LV_RES_OK;
 }
 
 /**
@@ -862,25 +988,9 @@ end:
 static void decoder_close(lv_img_decoder_t * decoder, lv_img_decoder_dsc_t * dsc)
 {
     LV_UNUSED(decoder);
-    /*Free all allocated data*/
-    SJPEG * sjpeg = (SJPEG *) dsc->user_data;
-    if(!sjpeg) return;
-
-    switch(dsc->src_type) {
-        case LV_IMG_SRC_FILE:
-            if(sjpeg->io.lv_file.file_d) {
-                lv_fs_close(&(sjpeg->io.lv_file));
-            }
-            lv_sjpg_cleanup(sjpeg);
-            break;
-
-        case LV_IMG_SRC_VARIABLE:
-            lv_sjpg_cleanup(sjpeg);
-            break;
-
-        default:
-            ;
-    }
+    /*Free all allocated data. Decoded fragments stay in the cache for the next open*/
+    lv_sjpg_cleanup((SJPEG *) dsc->user_data);
+    dsc->user_data = NULL;
 }
 
 static int is_jpg(const uint8_t * raw_data, size_t len)
@@ -890,20 +1000,12 @@ static int is_jpg(const uint8_t * raw_data, size_t len)
     return memcmp(jpg_signature, raw_data, sizeof(jpg_signature)) == 0;
 }
 
-static void lv_sjpg_free(SJPEG * sjpeg)
-{
-    if(sjpeg->frame_cache) lv_mem_free(sjpeg->frame_cache);
-    if(sjpeg->frame_base_array) lv_mem_free(sjpeg->frame_base_array);
-    if(sjpeg->frame_base_offset) lv_mem_free(sjpeg->frame_base_offset);
-    if(sjpeg->tjpeg_jd) lv_mem_free(sjpeg->tjpeg_jd);
-    if(sjpeg->workb) lv_mem_free(sjpeg->workb);
-}
-
 static void lv_sjpg_cleanup(SJPEG * sjpeg)
 {
     if(! sjpeg) return;
 
-    lv_sjpg_free(sjpeg);
+    if(sjpeg->file_opened) lv_fs_close(&sjpeg->lv_file);
+    if(sjpeg->frame_offset) lv_mem_free(sjpeg->frame_offset);
     lv_mem_free(sjpeg);
 }
 
@@ -24,12 +24,41 @@ extern "C" {
  *      TYPEDEFS
  **********************/
 
+typedef void (*lv_split_jpeg_job_cb_t)(void * job);
+
+/**
+ * Run `job_cb(job)` on a worker thread
+ * @param drop_cb   releases the job instead if it's discarded without running
+ * @return LV_RES_OK: queued (exactly one of `job_cb` and `drop_cb` must be called); LV_RES_INV: not queued
+ */
+typedef lv_res_t (*lv_split_jpeg_post_cb_t)(lv_split_jpeg_job_cb_t job_cb, lv_split_jpeg_job_cb_t drop_cb, void * job);
+
 /**********************
  * GLOBAL PROTOTYPES
  **********************/
 
 void lv_split_jpeg_init(void);
 
+/**
+ * Decode the fragments below the one being drawn on worker threads (needs `LV_SJPG_USE_WORKER`).
+ * The compressed data is read on the calling thread, only the decoding runs on the workers.
+ * @param post_cb   function to queue a job on the worker threads, NULL: decode only on demand
+ */
+void lv_split_jpeg_set_worker(lv_split_jpeg_post_cb_t post_cb);
+
+/**
+ * Get the memory used by the decoded fragments
+ * @return      size in bytes (at most about `LV_SJPG_CACHE_SIZE`)
+ */
+size_t lv_split_jpeg_cache_usage(void);
+
+/**
+ * Evict the least recently used fragments until the cache holds at most `target` bytes.
+ * Fragments being decoded are kept.
+ * @param target    the size to shrink to, 0: drop everything
+ */
+void lv_split_jpeg_cache_trim(size_t target);
+
 /**********************
  *      MACROS
  **********************/
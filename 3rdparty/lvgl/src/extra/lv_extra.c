@@ -78,6 +78,14 @@ void lv_extra_init(void)
     lv_split_jpeg_init();
 #endif
 
+#if LV_USE_IMGPACK
+    lv_imgpack_init();
+#endif
+
+#if LV_USE_QOI
+    lv_qoi_init();
+#endif
+
 #if LV_USE_BMP
     lv_bmp_init();
 #endif
@@ -2151,6 +2151,50 @@
         #define LV_USE_SJPG 0
     #endif
 #endif
+#if LV_USE_SJPG
+    /*Decode the fragments with libjpeg(-turbo) instead of the bundled tjpgd (link with -ljpeg)*/
+    #ifndef LV_SJPG_USE_LIBJPEG
+        #ifdef CONFIG_LV_SJPG_USE_LIBJPEG
+            #define LV_SJPG_USE_LIBJPEG CONFIG_LV_SJPG_USE_LIBJPEG
+        #else
+            #define LV_SJPG_USE_LIBJPEG 0
+        #endif
+    #endif
+    /*Memory for decoded fragments shared by all SJPG images [bytes]*/
+    #ifndef LV_SJPG_CACHE_SIZE
+        #ifdef CONFIG_LV_SJPG_CACHE_SIZE
+            #define LV_SJPG_CACHE_SIZE CONFIG_LV_SJPG_CACHE_SIZE
+        #else
+            #define LV_SJPG_CACHE_SIZE (64 * 1024)
+        #endif
+    #endif
+    /*Decode the next fragments on worker threads, see `lv_split_jpeg_set_worker()` (needs pthread and LV_MEM_CUSTOM 1)*/
+    #ifndef LV_SJPG_USE_WORKER
+        #ifdef CONFIG_LV_SJPG_USE_WORKER
+            #define LV_SJPG_USE_WORKER CONFIG_LV_SJPG_USE_WORKER
+        #else
+            #define LV_SJPG_USE_WORKER 0
+        #endif
+    #endif
+#endif
+
+/*Image pack: mmap-ed packs of pre-converted RGB565/RGB565A8 images (tools/imgpack)*/
+#ifndef LV_USE_IMGPACK
+    #ifdef CONFIG_LV_USE_IMGPACK
+        #define LV_USE_IMGPACK CONFIG_LV_USE_IMGPACK
+    #else
+        #define LV_USE_IMGPACK 0
+    #endif
+#endif
+
+/*QOI decoder library: lossless, decodes much faster than PNG (tools/png2qoi)*/
+#ifndef LV_USE_QOI
+    #ifdef CONFIG_LV_USE_QOI
+        #define LV_USE_QOI CONFIG_LV_USE_QOI
+    #else
+        #define LV_USE_QOI 0
+    #endif
+#endif
 
 /*GIF decoder library*/
 #ifndef LV_USE_GIF
@@ -2215,6 +2259,14 @@
             #endif
         #endif
     #endif
+    /*1: FreeType's own allocations (faces, glyph cache) use the functions below instead of malloc*/
+    #ifndef LV_FREETYPE_CUSTOM_MEM
+        #ifdef CONFIG_LV_FREETYPE_CUSTOM_MEM
+            #define LV_FREETYPE_CUSTOM_MEM CONFIG_LV_FREETYPE_CUSTOM_MEM
+        #else
+            #define LV_FREETYPE_CUSTOM_MEM 0
+        #endif
+    #endif
 #endif
 
 /*Tiny TTF library*/
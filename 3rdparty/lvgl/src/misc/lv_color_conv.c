@@ -0,0 +1,512 @@
+/**
+ * @file lv_color_conv.c
+ *
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include "lv_color_conv.h"
+#include <string.h>
+
+#if LV_COLOR_CONV_USE_NEON
+#include <arm_neon.h>
+#elif LV_COLOR_CONV_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+typedef enum {
+    CONV_MODE_565,          /*2 byte color only*/
+    CONV_MODE_565_ALPHA,    /*3 byte interleaved color + alpha*/
+    CONV_MODE_565A8,        /*Color plane + alpha plane*/
+} conv_mode_t;
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+static uint8_t conv_rgba(uint8_t * dst, uint8_t * dst_alpha, const uint8_t * src, uint32_t px_cnt, uint32_t flags,
+                         conv_mode_t mode);
+static uint8_t scalar_rgba(uint8_t * dst, uint8_t * dst_alpha, const uint8_t * src, uint32_t start, uint32_t px_cnt,
+                           uint32_t flags, conv_mode_t mode);
+static void scalar_rgb(uint8_t * dst, const uint8_t * src, uint32_t start, uint32_t px_cnt, uint32_t flags);
+static void scalar_lerp(uint8_t * dst, const uint8_t * from, const uint8_t * to, uint32_t start, uint32_t px_cnt,
+                        uint16_t mix, uint32_t flags);
+#if LV_COLOR_CONV_USE_NEON
+static uint32_t neon_rgba(uint8_t * dst, uint8_t * dst_alpha, const uint8_t * src, uint32_t px_cnt, uint32_t flags,
+                          conv_mode_t mode, uint8_t * alpha_and);
+static uint32_t neon_rgb(uint8_t * dst, const uint8_t * src, uint32_t px_cnt, uint32_t flags);
+static uint32_t neon_lerp(uint8_t * dst, const uint8_t * from, const uint8_t * to, uint32_t px_cnt, uint16_t mix,
+                          uint32_t flags);
+#elif LV_COLOR_CONV_USE_SSE2
+static uint32_t sse2_rgba(uint8_t * dst, uint8_t * dst_alpha, const uint8_t * src, uint32_t px_cnt, uint32_t flags,
+                          conv_mode_t mode, uint8_t * alpha_and);
+static uint32_t sse2_rgb(uint8_t * dst, const uint8_t * src, uint32_t px_cnt, uint32_t flags);
+static uint32_t sse2_lerp(uint8_t * dst, const uint8_t * from, const uint8_t * to, uint32_t px_cnt, uint16_t mix,
+                          uint32_t flags);
+#endif
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+static bool simd_en = true;
+
+/**********************
+ *      MACROS
+ **********************/
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+uint8_t lv_color_conv_rgba8888_to_rgb565(uint8_t * dst, const uint8_t * src, uint32_t px_cnt, uint32_t flags)
+{
+    return conv_rgba(dst, NULL, src, px_cnt, flags, CONV_MODE_565);
+}
+
+uint8_t lv_color_conv_rgba8888_to_rgb565_alpha(uint8_t * dst, const uint8_t * src, uint32_t px_cnt, uint32_t flags)
+{
+    return conv_rgba(dst, NULL, src, px_cnt, flags, CONV_MODE_565_ALPHA);
+}
+
+uint8_t lv_color_conv_rgba8888_to_rgb565a8(uint8_t * dst_color, uint8_t * dst_alpha, const uint8_t * src,
+                                           uint32_t px_cnt, uint32_t flags)
+{
+    return conv_rgba(dst_color, dst_alpha, src, px_cnt, flags, CONV_MODE_565A8);
+}
+
+void lv_color_conv_rgb888_to_rgb565(uint8_t * dst, const uint8_t * src, uint32_t px_cnt, uint32_t flags)
+{
+    uint32_t done = 0;
+#if LV_COLOR_CONV_USE_NEON
+    if(simd_en) done = neon_rgb(dst, src, px_cnt, flags);
+#elif LV_COLOR_CONV_USE_SSE2
+    if(simd_en) done = sse2_rgb(dst, src, px_cnt, flags);
+#endif
+    scalar_rgb(dst, src, done, px_cnt, flags);
+}
+
+void lv_color_conv_rgb565_lerp(uint8_t * dst, const uint8_t * from, const uint8_t * to, uint32_t px_cnt, uint16_t mix,
+                               uint32_t flags)
+{
+    if(mix > 256) mix = 256;
+
+    uint32_t done = 0;
+#if LV_COLOR_CONV_USE_NEON
+    if(simd_en) done = neon_lerp(dst, from, to, px_cnt, mix, flags);
+#elif LV_COLOR_CONV_USE_SSE2
+    if(simd_en) done = sse2_lerp(dst, from, to, px_cnt, mix, flags);
+#endif
+    scalar_lerp(dst, from, to, done, px_cnt, mix, flags);
+}
+
+void lv_color_conv_set_simd(bool en)
+{
+    simd_en = en;
+}
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+static inline uint16_t pack_565(uint8_t r, uint8_t g, uint8_t b)
+{
+    return (uint16_t)(((r & 0xF8) << 8) | ((g & 0xFC) << 3) | (b >> 3));
+}
+
+static inline void store_565(uint8_t * dst, uint16_t c, uint32_t flags)
+{
+    if(flags & LV_COLOR_CONV_SWAP) {
+        dst[0] = c >> 8;
+        dst[1] = c & 0xFF;
+    }
+    else {
+        dst[0] = c & 0xFF;
+        dst[1] = c >> 8;
+    }
+}
+
+static inline uint16_t load_565(const uint8_t * src, uint32_t flags)
+{
+    if(flags & LV_COLOR_CONV_SWAP) return (uint16_t)((src[0] << 8) | src[1]);
+    else return (uint16_t)((src[1] << 8) | src[0]);
+}
+
+static uint8_t conv_rgba(uint8_t * dst, uint8_t * dst_alpha, const uint8_t * src, uint32_t px_cnt, uint32_t flags,
+                         conv_mode_t mode)
+{
+    uint8_t alpha_and = 0xFF;
+    uint32_t done = 0;
+#if LV_COLOR_CONV_USE_NEON
+    if(simd_en) done = neon_rgba(dst, dst_alpha, src, px_cnt, flags, mode, &alpha_and);
+#elif LV_COLOR_CONV_USE_SSE2
+    if(simd_en) done = sse2_rgba(dst, dst_alpha, src, px_cnt, flags, mode, &alpha_and);
+#endif
+    return alpha_and & scalar_rgba(dst, dst_alpha, src, done, px_cnt, flags, mode);
+}
+
+/**
+ * The scalar reference. The SIMD kernels have to give the same result.
+ * Every pixel is read before it's written, so in place conversion is safe.
+ */
+static uint8_t scalar_rgba(uint8_t * dst, uint8_t * dst_alpha, const uint8_t * src, uint32_t start, uint32_t px_cnt,
+                           uint32_t flags, conv_mode_t mode)
+{
+    uint32_t r_ofs = (flags & LV_COLOR_CONV_BGR) ? 2 : 0;
+    uint32_t b_ofs = 2 - r_ofs;
+    uint8_t alpha_and = 0xFF;
+    uint32_t i;
+    for(i = start; i < px_cnt; i++) {
+        const uint8_t * p = &src[i * 4];
+        uint8_t r = p[r_ofs];
+        uint8_t g = p[1];
+        uint8_t b = p[b_ofs];
+        uint8_t a = p[3];
+        alpha_and &= a;
+
+        if(flags & LV_COLOR_CONV_PREMULT) {
+            r = (uint8_t)((r * a) >> 8);
+            g = (uint8_t)((g * a) >> 8);
+            b = (uint8_t)((b * a) >> 8);
+        }
+
+        uint16_t c = pack_565(r, g, b);
+        switch(mode) {
+            case CONV_MODE_565:
+                store_565(&dst[i * 2], c, flags);
+                break;
+            case CONV_MODE_565_ALPHA:
+                store_565(&dst[i * 3], c, flags);
+                dst[i * 3 + 2] = a;
+                break;
+            case CONV_MODE_565A8:
+                store_565(&dst[i * 2], c, flags);
+                dst_alpha[i] = a;
+                break;
+        }
+    }
+
+    return alpha_and;
+}
+
+static void scalar_rgb(uint8_t * dst, const uint8_t * src, uint32_t start, uint32_t px_cnt, uint32_t flags)
+{
+    uint32_t r_ofs = (flags & LV_COLOR_CONV_BGR) ? 2 : 0;
+    uint32_t b_ofs = 2 - r_ofs;
+    uint32_t i;
+    for(i = start; i < px_cnt; i++) {
+        const uint8_t * p = &src[i * 3];
+        store_565(&dst[i * 2], pack_565(p[r_ofs], p[1], p[b_ofs]), flags);
+    }
+}
+
+/**
+ * The scalar reference of the cross-fade. Each channel is `(from * (256 - mix) + to * mix) >> 8`.
+ */
+static void scalar_lerp(uint8_t * dst, const uint8_t * from, const uint8_t * to, uint32_t start, uint32_t px_cnt,
+                        uint16_t mix, uint32_t flags)
+{
+    uint32_t mix_inv = 256 - mix;
+    uint32_t i;
+    for(i = start; i < px_cnt; i++) {
+        uint32_t a = load_565(&from[i * 2], flags);
+        uint32_t b = load_565(&to[i * 2], flags);
+        uint32_t r = ((a >> 11) * mix_inv + (b >> 11) * mix) >> 8;
+        uint32_t g = (((a >> 5) & 0x3F) * mix_inv + ((b >> 5) & 0x3F) * mix) >> 8;
+        uint32_t bl = ((a & 0x1F) * mix_inv + (b & 0x1F) * mix) >> 8;
+        store_565(&dst[i * 2], (uint16_t)((r << 11) | (g << 5) | bl), flags);
+    }
+}
+
+#if LV_COLOR_CONV_USE_NEON
+
+/*(c * a) >> 8 on 16 lanes*/
+static inline uint8x16_t neon_mul_div256(uint8x16_t c, uint8x16_t a)
+{
+    uint16x8_t lo = vmull_u8(vget_low_u8(c), vget_low_u8(a));
+    uint16x8_t hi = vmull_u8(vget_high_u8(c), vget_high_u8(a));
+    return vcombine_u8(vshrn_n_u16(lo, 8), vshrn_n_u16(hi, 8));
+}
+
+/*Pack 16 pixels into RGB565. val[0] is the byte written first*/
+static inline uint8x16x2_t neon_pack_565(uint8x16_t r, uint8x16_t g, uint8x16_t b, uint32_t flags)
+{
+    uint8x16_t hi = vorrq_u8(vandq_u8(r, vdupq_n_u8(0xF8)), vshrq_n_u8(g, 5));
+    uint8x16_t lo = vorrq_u8(vandq_u8(vshlq_n_u8(g, 3), vdupq_n_u8(0xE0)), vshrq_n_u8(b, 3));
+    uint8x16x2_t c;
+    if(flags & LV_COLOR_CONV_SWAP) {
+        c.val[0] = hi;
+        c.val[1] = lo;
+    }
+    else {
+        c.val[0] = lo;
+        c.val[1] = hi;
+    }
+    return c;
+}
+
+/**
+ * Convert 16 pixels per iteration. A block is fully loaded before it's stored and the output
+ * is never larger than the input so in place conversion is safe.
+ * @return number of converted pixels
+ */
+static uint32_t neon_rgba(uint8_t * dst, uint8_t * dst_alpha, const uint8_t * src, uint32_t px_cnt, uint32_t flags,
+                          conv_mode_t mode, uint8_t * alpha_and)
+{
+    bool bgr = flags & LV_COLOR_CONV_BGR;
+    bool premult = flags & LV_COLOR_CONV_PREMULT;
+    uint8x16_t acc = vdupq_n_u8(0xFF);
+    uint32_t i;
+    for(i = 0; i + 16 <= px_cnt; i += 16) {
+        uint8x16x4_t px = vld4q_u8(&src[i * 4]);
+        uint8x16_t r = bgr ? px.val[2] : px.val[0];
+        uint8x16_t g = px.val[1];
+        uint8x16_t b = bgr ? px.val[0] : px.val[2];
+        uint8x16_t a = px.val[3];
+        acc = vandq_u8(acc, a);
+
+        if(premult) {
+            r = neon_mul_div256(r, a);
+            g = neon_mul_div256(g, a);
+            b = neon_mul_div256(b, a);
+        }
+
+        uint8x16x2_t c = neon_pack_565(r, g, b, flags);
+        if(mode == CONV_MODE_565_ALPHA) {
+            uint8x16x3_t ca;
+            ca.val[0] = c.val[0];
+            ca.val[1] = c.val[1];
+            ca.val[2] = a;
+            vst3q_u8(&dst[i * 3], ca);
+        }
+        else {
+            vst2q_u8(&dst[i * 2], c);
+            if(mode == CONV_MODE_565A8) vst1q_u8(&dst_alpha[i], a);
+        }
+    }
+
+    uint8_t acc_buf[16];
+    uint32_t k;
+    vst1q_u8(acc_buf, acc);
+    for(k = 0; k < 16; k++) *alpha_and &= acc_buf[k];
+
+    return i;
+}
+
+static uint32_t neon_rgb(uint8_t * dst, const uint8_t * src, uint32_t px_cnt, uint32_t flags)
+{
+    bool bgr = flags & LV_COLOR_CONV_BGR;
+    uint32_t i;
+    for(i = 0; i + 16 <= px_cnt; i += 16) {
+        uint8x16x3_t px = vld3q_u8(&src[i * 3]);
+        uint8x16_t r = bgr ? px.val[2] : px.val[0];
+        uint8x16_t b = bgr ? px.val[0] : px.val[2];
+        vst2q_u8(&dst[i * 2], neon_pack_565(r, px.val[1], b, flags));
+    }
+
+    return i;
+}
+
+/**
+ * Cross-fade 8 pixels per iteration on 16 bit lanes. The channel products fit 16 bit (63 * 256).
+ * @return number of processed pixels
+ */
+static uint32_t neon_lerp(uint8_t * dst, const uint8_t * from, const uint8_t * to, uint32_t px_cnt, uint16_t mix,
+                          uint32_t flags)
+{
+    bool swap = flags & LV_COLOR_CONV_SWAP;
+    const uint16x8_t w_to = vdupq_n_u16(mix);
+    const uint16x8_t w_from = vdupq_n_u16(256 - mix);
+    const uint16x8_t m6 = vdupq_n_u16(0x3F);
+    const uint16x8_t m5 = vdupq_n_u16(0x1F);
+    uint32_t i;
+    for(i = 0; i + 8 <= px_cnt; i += 8) {
+        uint8x16_t a8 = vld1q_u8(&from[i * 2]);
+        uint8x16_t b8 = vld1q_u8(&to[i * 2]);
+        if(swap) {
+            a8 = vrev16q_u8(a8);
+            b8 = vrev16q_u8(b8);
+        }
+        uint16x8_t a = vreinterpretq_u16_u8(a8);
+        uint16x8_t b = vreinterpretq_u16_u8(b8);
+
+        uint16x8_t r = vmlaq_u16(vmulq_u16(vshrq_n_u16(a, 11), w_from), vshrq_n_u16(b, 11), w_to);
+        uint16x8_t g = vmlaq_u16(vmulq_u16(vandq_u16(vshrq_n_u16(a, 5), m6), w_from),
+                                 vandq_u16(vshrq_n_u16(b, 5), m6), w_to);
+        uint16x8_t bl = vmlaq_u16(vmulq_u16(vandq_u16(a, m5), w_from), vandq_u16(b, m5), w_to);
+
+        uint16x8_t c = vorrq_u16(vshlq_n_u16(vshrq_n_u16(r, 8), 11), vshlq_n_u16(vshrq_n_u16(g, 8), 5));
+        c = vorrq_u16(c, vshrq_n_u16(bl, 8));
+
+        uint8x16_t c8 = vreinterpretq_u8_u16(c);
+        if(swap) c8 = vrev16q_u8(c8);
+        vst1q_u8(&dst[i * 2], c8);
+    }
+
+    return i;
+}
+
+#elif LV_COLOR_CONV_USE_SSE2
+
+/*(c * a) >> 8 on the color channels of 4 pixels. Alpha is kept.*/
+static inline __m128i sse2_premult(__m128i px)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i a_mask = _mm_set1_epi32((int)0xFF000000);
+    __m128i lo = _mm_unpacklo_epi8(px, zero);
+    __m128i hi = _mm_unpackhi_epi8(px, zero);
+    __m128i a_lo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(lo, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+    __m128i a_hi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(hi, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+    lo = _mm_srli_epi16(_mm_mullo_epi16(lo, a_lo), 8);
+    hi = _mm_srli_epi16(_mm_mullo_epi16(hi, a_hi), 8);
+    __m128i res = _mm_packus_epi16(lo, hi);
+    return _mm_or_si128(_mm_andnot_si128(a_mask, res), _mm_and_si128(a_mask, px));
+}
+
+/*RGB565 of 4 pixels in the lower half of the 32 bit lanes*/
+static inline __m128i sse2_pack_565(__m128i px, uint32_t flags)
+{
+    __m128i r;
+    __m128i b;
+    if(flags & LV_COLOR_CONV_BGR) {
+        r = _mm_and_si128(_mm_srli_epi32(px, 8), _mm_set1_epi32(0xF800));
+        b = _mm_and_si128(_mm_srli_epi32(px, 3), _mm_set1_epi32(0x1F));
+    }
+    else {
+        r = _mm_slli_epi32(_mm_and_si128(px, _mm_set1_epi32(0xF8)), 8);
+        b = _mm_and_si128(_mm_srli_epi32(px, 19), _mm_set1_epi32(0x1F));
+    }
+    __m128i g = _mm_and_si128(_mm_srli_epi32(px, 5), _mm_set1_epi32(0x7E0));
+    return _mm_or_si128(_mm_or_si128(r, g), b);
+}
+
+/*Narrow two vectors of 32 bit lanes holding 16 bit values to 8 x 16 bit*/
+static inline __m128i sse2_narrow_32_16(__m128i v0, __m128i v1)
+{
+    v0 = _mm_srai_epi32(_mm_slli_epi32(v0, 16), 16);
+    v1 = _mm_srai_epi32(_mm_slli_epi32(v1, 16), 16);
+    return _mm_packs_epi32(v0, v1);
+}
+
+static inline __m128i sse2_swap_16(__m128i c)
+{
+    return _mm_or_si128(_mm_slli_epi16(c, 8), _mm_srli_epi16(c, 8));
+}
+
+/**
+ * Convert 8 pixels per iteration. A block is fully loaded before it's stored and the output
+ * is never larger than the input so in place conversion is safe.
+ * @return number of converted pixels
+ */
+static uint32_t sse2_rgba(uint8_t * dst, uint8_t * dst_alpha, const uint8_t * src, uint32_t px_cnt, uint32_t flags,
+                          conv_mode_t mode, uint8_t * alpha_and)
+{
+    __m128i acc = _mm_set1_epi32(-1);
+    uint32_t i;
+    for(i = 0; i + 8 <= px_cnt; i += 8) {
+        __m128i p0 = _mm_loadu_si128((const __m128i *)&src[i * 4]);
+        __m128i p1 = _mm_loadu_si128((const __m128i *)&src[i * 4 + 16]);
+        acc = _mm_and_si128(acc, _mm_and_si128(p0, p1));
+
+        if(flags & LV_COLOR_CONV_PREMULT) {
+            p0 = sse2_premult(p0);
+            p1 = sse2_premult(p1);
+        }
+
+        __m128i c = sse2_narrow_32_16(sse2_pack_565(p0, flags), sse2_pack_565(p1, flags));
+        if(flags & LV_COLOR_CONV_SWAP) c = sse2_swap_16(c);
+
+        __m128i a16 = _mm_packs_epi32(_mm_srli_epi32(p0, 24), _mm_srli_epi32(p1, 24));
+        __m128i a8 = _mm_packus_epi16(a16, a16);
+
+        if(mode == CONV_MODE_565_ALPHA) {
+            /*SSE2 has no byte shuffle so interleave the 3 byte pixels from a buffer*/
+            uint8_t c_buf[16];
+            uint8_t a_buf[16];
+            uint32_t k;
+            _mm_storeu_si128((__m128i *)c_buf, c);
+            _mm_storeu_si128((__m128i *)a_buf, a8);
+            uint8_t * d = &dst[i * 3];
+            for(k = 0; k < 8; k++) {
+                d[k * 3 + 0] = c_buf[k * 2 + 0];
+                d[k * 3 + 1] = c_buf[k * 2 + 1];
+                d[k * 3 + 2] = a_buf[k];
+            }
+        }
+        else {
+            _mm_storeu_si128((__m128i *)&dst[i * 2], c);
+            if(mode == CONV_MODE_565A8) _mm_storel_epi64((__m128i *)&dst_alpha[i], a8);
+        }
+    }
+
+    uint32_t acc_buf[4];
+    uint32_t k;
+    _mm_storeu_si128((__m128i *)acc_buf, acc);
+    for(k = 0; k < 4; k++) *alpha_and &= acc_buf[k] >> 24;
+
+    return i;
+}
+
+static uint32_t sse2_rgb(uint8_t * dst, const uint8_t * src, uint32_t px_cnt, uint32_t flags)
+{
+    uint32_t i;
+    /*The 4 byte loads read the first byte of the next pixel too, so leave at least one more pixel*/
+    for(i = 0; i + 9 <= px_cnt; i += 8) {
+        uint32_t w[8];
+        uint32_t k;
+        for(k = 0; k < 8; k++) memcpy(&w[k], &src[(i + k) * 3], 4);
+
+        __m128i p0 = _mm_loadu_si128((const __m128i *)&w[0]);
+        __m128i p1 = _mm_loadu_si128((const __m128i *)&w[4]);
+        __m128i c = sse2_narrow_32_16(sse2_pack_565(p0, flags), sse2_pack_565(p1, flags));
+        if(flags & LV_COLOR_CONV_SWAP) c = sse2_swap_16(c);
+        _mm_storeu_si128((__m128i *)&dst[i * 2], c);
+    }
+
+    return i;
+}
+
+/**
+ * Cross-fade 8 pixels per iteration on 16 bit lanes. The channel products fit 16 bit (63 * 256).
+ * @return number of processed pixels
+ */
+static uint32_t sse2_lerp(uint8_t * dst, const uint8_t * from, const uint8_t * to, uint32_t px_cnt, uint16_t mix,
+                          uint32_t flags)
+{
+    bool swap = flags & LV_COLOR_CONV_SWAP;
+    const __m128i w_to = _mm_set1_epi16((short)mix);
+    const __m128i w_from = _mm_set1_epi16((short)(256 - mix));
+    const __m128i m6 = _mm_set1_epi16(0x3F);
+    const __m128i m5 = _mm_set1_epi16(0x1F);
+    uint32_t i;
+    for(i = 0; i + 8 <= px_cnt; i += 8) {
+        __m128i a = _mm_loadu_si128((const __m128i *)&from[i * 2]);
+        __m128i b = _mm_loadu_si128((const __m128i *)&to[i * 2]);
+        if(swap) {
+            a = sse2_swap_16(a);
+            b = sse2_swap_16(b);
+        }
+
+        __m128i r = _mm_add_epi16(_mm_mullo_epi16(_mm_srli_epi16(a, 11), w_from),
+                                  _mm_mullo_epi16(_mm_srli_epi16(b, 11), w_to));
+        __m128i g = _mm_add_epi16(_mm_mullo_epi16(_mm_and_si128(_mm_srli_epi16(a, 5), m6), w_from),
+                                  _mm_mullo_epi16(_mm_and_si128(_mm_srli_epi16(b, 5), m6), w_to));
+        __m128i bl = _mm_add_epi16(_mm_mullo_epi16(_mm_and_si128(a, m5), w_from),
+                                   _mm_mullo_epi16(_mm_and_si128(b, m5), w_to));
+
+        __m128i c = _mm_or_si128(_mm_slli_epi16(_mm_srli_epi16(r, 8), 11), _mm_slli_epi16(_mm_srli_epi16(g, 8), 5));
+        c = _mm_or_si128(c, _mm_srli_epi16(bl, 8));
+        if(swap) c = sse2_swap_16(c);
+        _mm_storeu_si128((__m128i *)&dst[i * 2], c);
+    }
+
+    return i;
+}
+
+#endif /*LV_COLOR_CONV_USE_SSE2*/
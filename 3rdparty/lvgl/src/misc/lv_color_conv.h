@@ -0,0 +1,121 @@
+/**
+ * @file lv_color_conv.h
+ * Bulk pixel format conversion used by the image decoders and RGB565 cross-fading.
+ * Every function has a scalar reference implementation and NEON / SSE2 kernels
+ * which give bit-exact results. The kernels are selected at compile time.
+ */
+
+#ifndef LV_COLOR_CONV_H
+#define LV_COLOR_CONV_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include "../lv_conf_internal.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/*********************
+ *      DEFINES
+ *********************/
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define LV_COLOR_CONV_USE_NEON 1
+#else
+#define LV_COLOR_CONV_USE_NEON 0
+#endif
+
+#if !LV_COLOR_CONV_USE_NEON && defined(__SSE2__)
+#define LV_COLOR_CONV_USE_SSE2 1
+#else
+#define LV_COLOR_CONV_USE_SSE2 0
+#endif
+
+/*Conversion flags*/
+#define LV_COLOR_CONV_BGR       0x01    /*The source is B, G, R(, A) in memory instead of R, G, B(, A)*/
+#define LV_COLOR_CONV_SWAP      0x02    /*Write the RGB565 pixels high byte first (LV_COLOR_16_SWAP)*/
+#define LV_COLOR_CONV_PREMULT   0x04    /*Multiply the color channels with the alpha*/
+
+/*The flags to get the memory layout of `lv_color_t`*/
+#if LV_COLOR_16_SWAP
+#define LV_COLOR_CONV_NATIVE    LV_COLOR_CONV_SWAP
+#else
+#define LV_COLOR_CONV_NATIVE    0
+#endif
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+/**
+ * Convert RGBA8888 pixels to RGB565 and drop the alpha channel.
+ * `dst` can be the same as `src` to convert in place.
+ * @param dst       store the 2 byte pixels here
+ * @param src       4 byte pixels
+ * @param px_cnt    number of pixels
+ * @param flags     OR-ed `LV_COLOR_CONV_...` flags
+ * @return          bitwise AND of all alpha values. 0xFF means the image was fully opaque.
+ */
+uint8_t lv_color_conv_rgba8888_to_rgb565(uint8_t * dst, const uint8_t * src, uint32_t px_cnt, uint32_t flags);
+
+/**
+ * Convert RGBA8888 pixels to 3 byte RGB565 + alpha pixels (`LV_IMG_CF_TRUE_COLOR_ALPHA` layout).
+ * `dst` can be the same as `src` to convert in place.
+ * @param dst       store the 3 byte pixels here
+ * @param src       4 byte pixels
+ * @param px_cnt    number of pixels
+ * @param flags     OR-ed `LV_COLOR_CONV_...` flags
+ * @return          bitwise AND of all alpha values. 0xFF means the image was fully opaque.
+ */
+uint8_t lv_color_conv_rgba8888_to_rgb565_alpha(uint8_t * dst, const uint8_t * src, uint32_t px_cnt, uint32_t flags);
+
+/**
+ * Convert RGBA8888 pixels to a planar RGB565 + A8 image (`LV_IMG_CF_RGB565A8` layout).
+ * The destination planes must not overlap `src`.
+ * @param dst_color store the 2 byte color values here
+ * @param dst_alpha store the alpha values here
+ * @param src       4 byte pixels
+ * @param px_cnt    number of pixels
+ * @param flags     OR-ed `LV_COLOR_CONV_...` flags
+ * @return          bitwise AND of all alpha values. 0xFF means the image was fully opaque.
+ */
+uint8_t lv_color_conv_rgba8888_to_rgb565a8(uint8_t * dst_color, uint8_t * dst_alpha, const uint8_t * src,
+                                           uint32_t px_cnt, uint32_t flags);
+
+/**
+ * Convert RGB888 pixels to RGB565. `dst` can be the same as `src` to convert in place.
+ * @param dst       store the 2 byte pixels here
+ * @param src       3 byte pixels
+ * @param px_cnt    number of pixels
+ * @param flags     OR-ed `LV_COLOR_CONV_...` flags. `LV_COLOR_CONV_PREMULT` is ignored.
+ */
+void lv_color_conv_rgb888_to_rgb565(uint8_t * dst, const uint8_t * src, uint32_t px_cnt, uint32_t flags);
+
+/**
+ * Cross-fade two RGB565 images: `from + (to - from) * mix / 256` on every channel.
+ * `dst` can be the same as `from` or `to`.
+ * @param dst       store the 2 byte pixels here
+ * @param from      2 byte pixels shown at `mix == 0`
+ * @param to        2 byte pixels shown at `mix == 256`
+ * @param px_cnt    number of pixels
+ * @param mix       0..256
+ * @param flags     `LV_COLOR_CONV_SWAP` if the pixels are stored high byte first, the other flags are ignored
+ */
+void lv_color_conv_rgb565_lerp(uint8_t * dst, const uint8_t * from, const uint8_t * to, uint32_t px_cnt, uint16_t mix,
+                               uint32_t flags);
+
+/**
+ * Enable or disable the SIMD kernels. Only the scalar reference is used while disabled.
+ * Useful to compare the kernels with the reference.
+ * @param en        true: use the SIMD kernels if available (default)
+ */
+void lv_color_conv_set_simd(bool en);
+
+#ifdef __cplusplus
+} /*extern "C"*/
+#endif
+
+#endif /*LV_COLOR_CONV_H*/
@@ -0,0 +1,88 @@
+#ifndef AUDIO_EQ_H
+#define AUDIO_EQ_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include "miniaudio.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#define AUDIO_EQ_MAX_BANDS    10
+#define AUDIO_EQ_MAX_CHANNELS 8
+
+// 频段类型 (RBJ Audio EQ Cookbook 的二阶滤波器)
+typedef enum
+{
+    AUDIO_EQ_PEAK,       // 峰值: freq 附近提升/衰减，q 越大越窄
+    AUDIO_EQ_LOW_SHELF,  // 低架: freq 以下整体提升/衰减
+    AUDIO_EQ_HIGH_SHELF, // 高架: freq 以上整体提升/衰减
+} audio_eq_type_t;
+
+typedef struct
+{
+    audio_eq_type_t type;
+    float freq;    // 中心 / 转折频率 (Hz)，20 ~ 0.45 * 采样率
+    float gain_db; // -24 ~ +24，0 表示不起作用 (不参与计算)
+    float q;       // 0.1 ~ 10，架式滤波器一般用 0.707
+} audio_eq_band_t;
+
+typedef struct
+{
+    const char *name;
+    float preamp_db; // 提升的频段会让峰值超过 0dBFS，先整体压低
+    uint32_t band_count;
+    audio_eq_band_t bands[AUDIO_EQ_MAX_BANDS];
+} audio_eq_preset_t;
+
+// 运行统计 (音频线程写，任意线程读)
+typedef struct
+{
+    uint64_t frames;      // 处理的帧数
+    uint64_t band_frames; // 各频段实际处理的帧数之和 (0dB 的频段跳过)
+    uint64_t busy_ns;     // 处理耗时 (含前级增益和拷贝)
+} audio_eq_stats_t;
+
+/*
+ * 参数均衡器: 一个节点里串联所有频段 (二阶 IIR，转置直接 II 型)，整段缓冲按频段依次滤波，
+ * 不像一串 ma_peak_node 那样每个频段都经过一次节点图的缓冲和混音
+ * 改参数时音频线程每 64 帧向目标靠近一步 (约 60ms 到位)，换预设、开关都不会有咔哒声
+ * 所有频段都是 0dB 且前级增益为 0dB 时只是一次拷贝
+ */
+
+// 创建并接到 output 上 (频谱监听节点或引擎的输出端点)，之后把声音接到 audio_eq_node()
+// 声道数超过 AUDIO_EQ_MAX_CHANNELS 时失败，返回 0 成功, -1 失败
+int audio_eq_init(ma_engine *engine, ma_node *output);
+
+// 销毁 (连在上面的声音必须已经卸载或改接)
+void audio_eq_uninit(void);
+
+// 作为 ma_node 使用，未创建时为 NULL
+ma_node *audio_eq_node(void);
+
+// 设置频段 (UI 线程)，超出范围的参数会被限制，count 超过 AUDIO_EQ_MAX_BANDS 的部分忽略
+void audio_eq_set_bands(const audio_eq_band_t *bands, uint32_t count, float preamp_db);
+
+// 内置预设: flat, speaker (小喇叭), bass, vocal, treble, loudness
+uint32_t audio_eq_preset_count(void);
+const audio_eq_preset_t *audio_eq_preset(uint32_t index);
+
+// 按名字应用预设，返回 0 成功, -1 没有这个预设 (音乐播放器启动时读环境变量 MUSIC_EQ，例如 MUSIC_EQ=speaker)
+int audio_eq_set_preset(const char *name);
+
+// 当前预设名，用 audio_eq_set_bands 自定义后为 "custom"
+const char *audio_eq_get_preset(void);
+
+// 读取统计 (任意线程)
+void audio_eq_get_stats(audio_eq_stats_t *out);
+
+// 打印当前频段和实测开销 (每个频段处理一秒音频用的 CPU 时间)
+void audio_eq_report(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AUDIO_EQ_H
@@ -0,0 +1,65 @@
+#ifndef AUDIO_OUT_H
+#define AUDIO_OUT_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include "miniaudio.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// 回调耗时直方图的桶数 (按占周期预算的百分比): <10%, <25%, <50%, <75%, <100%, <150%, >=150%
+#define AUDIO_OUT_HIST_BUCKETS 7
+
+// 输出设备参数，0 表示使用 miniaudio 的默认值 (10ms 一个周期、3 个周期)
+typedef struct
+{
+    uint32_t period_frames; // 每个周期的帧数，越小延迟越低、越容易断音
+    uint32_t periods;       // 周期数 (ALSA 缓冲 = period_frames * periods)
+    ma_format format;       // ma_format_f32 或 ma_format_s16 (声卡只支持 s16 时省掉 ALSA plug 层的转换)
+    bool mmap;              // ALSA mmap 访问 (当前的 miniaudio 暂时屏蔽了 mmap，实际模式见 audio_out_report)
+} audio_out_config_t;
+
+// 运行统计 (音频线程写，任意线程读)
+typedef struct
+{
+    uint64_t callbacks; // 回调次数
+    uint64_t frames;    // 输出的总帧数
+    uint64_t xruns;     // ALSA 报告的 underrun 次数 (写入时 EPIPE，已自动恢复)
+    uint64_t late;      // 回调耗时超过本次帧数对应时长的次数
+    uint64_t stalls;    // 两次回调间隔超过整个缓冲时长的次数 (任何后端都必然断音)
+    uint32_t max_us;    // 最长一次回调耗时
+    uint64_t hist[AUDIO_OUT_HIST_BUCKETS];
+} audio_out_stats_t;
+
+// 默认参数: 与 ma_engine_init(NULL, ...) 相同 (f32、mmap、默认周期)
+audio_out_config_t audio_out_config_default(void);
+
+// 用环境变量覆盖参数，不需要重新编译就能在板子上调:
+//   AUDIO_PERIOD_FRAMES=256 AUDIO_PERIODS=3 AUDIO_FORMAT=s16 AUDIO_MMAP=0 ./multimedia
+void audio_out_config_from_env(audio_out_config_t *cfg);
+
+// 打开输出设备 (优先 ALSA，不可用时按 miniaudio 默认顺序选后端)，数据回调从 engine 读取
+// 之后把 audio_out_device() 填到 ma_engine_config.pDevice 再初始化 engine，engine 启动时设备才开始回调
+// 返回 0 成功, -1 失败
+int audio_out_open(const audio_out_config_t *cfg, ma_engine *engine, const ma_allocation_callbacks *alloc);
+
+// 已打开的设备，未打开时为 NULL
+ma_device *audio_out_device(void);
+
+// 关闭设备 (在 ma_engine_uninit 之后调用)
+void audio_out_close(void);
+
+// 读取统计 (任意线程)
+void audio_out_get_stats(audio_out_stats_t *out);
+
+// 打印设备实际参数、xrun 次数和回调耗时分布
+void audio_out_report(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AUDIO_OUT_H
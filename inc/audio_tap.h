@@ -0,0 +1,36 @@
+#ifndef AUDIO_TAP_H
+#define AUDIO_TAP_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include "miniaudio.h"
+#include <stdint.h>
+
+// 环形缓冲的容量 (单声道帧数，2 的幂)，读取一次最多取这么多
+#define AUDIO_TAP_RING_FRAMES 4096
+
+// 音频节点图里的 "监听" 节点: 直通 (不拷贝输出)，同时把混成单声道的样本写进环形缓冲
+// 写入方只有音频线程，不加锁也不等待; 读取方太慢时旧数据直接被覆盖
+typedef struct audio_tap audio_tap_t;
+
+// 创建并接到引擎的输出端点上，之后把声音接到 audio_tap_node() 即可
+audio_tap_t *audio_tap_create(ma_engine *engine);
+
+// 销毁 (连在上面的声音必须已经卸载或改接)
+void audio_tap_destroy(audio_tap_t *tap);
+
+// 作为 ma_node 使用 (ma_node_attach_output_bus 的目标)
+ma_node *audio_tap_node(audio_tap_t *tap);
+
+// 取最近的 n 帧 (UI 线程)，n 不超过 AUDIO_TAP_RING_FRAMES
+// 返回上次读取以来新写入的帧数，为 0 表示暂停或没有声音
+uint32_t audio_tap_read_latest(audio_tap_t *tap, float *out, uint32_t n);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AUDIO_TAP_H
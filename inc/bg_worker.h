@@ -0,0 +1,57 @@
+#ifndef BG_WORKER_H
+#define BG_WORKER_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+
+// 后台线程数 (小核 SoC 上留一个核给 UI 和音频)
+#define BG_WORKER_THREADS 2
+
+// 任务回调; 也用作丢弃回调: 任务没有执行就被丢弃 (bg_worker_deinit) 时调用，释放 arg 持有的资源
+typedef void (*bg_job_cb_t)(void *arg);
+
+// 任务优先级: 高优先级队列清空后才会执行低优先级任务
+typedef enum
+{
+    BG_PRIO_HIGH, // 用户正在等待的结果 (当前可见的缩略图等)
+    BG_PRIO_LOW   // 预取、全量扫描等
+} bg_prio_t;
+
+// 启动后台线程池，并创建唤醒 UI 线程的 eventfd，在 UI 线程中调用
+int bg_worker_init(int thread_cnt);
+
+// 提交后台任务。回调在工作线程中执行，禁止调用任何 LVGL 接口
+// arg 的所有权交给任务: 执行时由 cb 负责，被丢弃时由 drop 负责 (不持有资源时传 NULL)
+// 返回 -1 时任务没有入队，arg 仍归调用者
+int bg_worker_submit(bg_prio_t prio, bg_job_cb_t cb, bg_job_cb_t drop, void *arg);
+
+// 把回调投递到 UI 线程执行 (可在任意线程调用)，arg 的所有权同 bg_worker_submit
+int bg_worker_post_ui(bg_job_cb_t cb, bg_job_cb_t drop, void *arg);
+
+// UI 线程被唤醒时调用的轮询回调，用来取走实时线程放在预分配的无锁队列里的通知
+typedef void (*bg_poll_cb_t)(void *user_data);
+
+// 登记 / 注销轮询回调 (UI 线程)，最多 BG_UI_POLL_MAX 个
+#define BG_UI_POLL_MAX 4
+int bg_worker_add_ui_poll(bg_poll_cb_t cb, void *user_data);
+void bg_worker_remove_ui_poll(bg_poll_cb_t cb, void *user_data);
+
+// 唤醒 UI 线程执行轮询回调 (任意线程，包括音频回调): 只写一次 eventfd，不分配内存也不加锁
+void bg_worker_wake_ui(void);
+
+// 主循环中代替 usleep: 最多睡 timeout_ms，有投递过来的回调或被唤醒时提前醒来，在 UI 线程中执行轮询回调和投递过来的回调
+// 没有投递时不会唤醒 CPU
+void bg_worker_wait_ui(uint32_t timeout_ms);
+
+// 停止线程池，尚未执行的任务和 UI 回调被丢弃 (调用各自的 drop)
+void bg_worker_deinit(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BG_WORKER_H
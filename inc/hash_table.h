@@ -0,0 +1,47 @@
+#ifndef HASH_TABLE_H
+#define HASH_TABLE_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * mmap 索引 (图片头信息、缩略图 pack、歌曲索引、封面 pack) 共用的开放寻址哈希表:
+ * 条目以 uint64_t key (路径哈希, 0 表示空槽) 开头，线性探测，最多探测 probe_max 个槽位。
+ * 条目里的 uint32_t seq 做顺序锁: 奇数表示正在写，只增不减。写入方持有各模块自己的写锁，
+ * 读取方不加锁，读到奇数或前后不一致就当作未命中。
+ */
+
+// 路径的 FNV-1a 64 位哈希，不会返回 0
+uint64_t hash_table_key(const char *path);
+
+// 第 i 次探测的槽位
+uint32_t hash_table_probe(uint64_t key, int i, uint32_t capacity);
+
+// 选写入的槽位: 同一 key 的旧条目 > 空槽 > 探测起点 (覆盖) (调用者持有写锁)
+// free_slot 不为 NULL 时返回是否找到了同一 key 或空槽
+uint32_t hash_table_pick(const void *entries, size_t entry_size, uint32_t capacity, int probe_max, uint64_t key,
+                         bool *free_slot);
+
+// 开始读一个条目: 正在写时返回 false，否则记下 seq
+bool hash_table_read_begin(const uint32_t *seq, uint32_t *start);
+
+// 读完: seq 没有变化 (期间没有写入) 时读到的内容有效
+bool hash_table_read_end(const uint32_t *seq, uint32_t start);
+
+// 开始改写一个条目 (调用者持有写锁)，返回传给 hash_table_write_end 的值
+uint32_t hash_table_write_begin(uint32_t *seq);
+
+// 改写完成
+void hash_table_write_end(uint32_t *seq, uint32_t start);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HASH_TABLE_H
@@ -0,0 +1,52 @@
+#ifndef IMG_CACHE_H
+#define IMG_CACHE_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include "bg_worker.h"
+#include "img_rotate.h"
+#include "lvgl.h"
+#include <stdbool.h>
+
+// 缓存的整图数量 (当前图、预取的下一张和旋转副本, 每张约 150KB)
+#define IMG_CACHE_SIZE 4
+
+// 后台加载完成 (UI 线程)
+typedef void (*img_cache_ready_cb_t)(const char *path, img_rot_t rot, bool ok, void *user_data);
+
+// 设置加载完成回调
+void img_cache_set_ready_cb(img_cache_ready_cb_t cb, void *user_data);
+
+// 查询已解码、已旋转好的 RGB565 图像 (UI 线程)，按路径 + 角度 + mtime 匹配
+// 显示时就是普通的贴图，不需要每帧重新采样
+const lv_img_dsc_t *img_cache_get(const char *path, img_rot_t rot);
+
+// 设置预览就绪回调 (UI 线程)，此时整图还在解码
+void img_cache_set_preview_cb(img_cache_ready_cb_t cb, void *user_data);
+
+// 查询正在解码的图片的低分辨率预览 (EXIF 内嵌缩略图或 1/8 DCT 解码)，整图就绪后作废
+const lv_img_dsc_t *img_cache_get_preview(const char *path, img_rot_t rot);
+
+// 在后台解码并旋转 (JPEG 同时按 EXIF 摆正)，结果适配 max_w x max_h
+// BG_PRIO_HIGH (用户正在等) 时先解码一个预览，并打印首帧和最终耗时
+// 已缓存或正在加载时直接返回 0；之前解码失败过 (格式不支持等) 返回 -1
+int img_cache_request(const char *path, img_rot_t rot, uint16_t max_w, uint16_t max_h, bg_prio_t prio);
+
+// 清空缓存，最近一次 img_cache_get 返回的图 (正在显示) 除外; 正在进行的加载完成后直接丢弃
+void img_cache_clear(void);
+
+// 已解码的整图和预览占用的字节数 (UI 线程)
+size_t img_cache_mem_usage(void);
+
+// 内存紧张时按最久未使用的顺序释放已解码的图片，直到不超过 target 字节 (UI 线程)
+// 最近一次 img_cache_get 返回的图 (正在显示) 和解码中的图不会释放
+void img_cache_trim(size_t target);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // IMG_CACHE_H
@@ -0,0 +1,29 @@
+#ifndef IMG_FADE_H
+#define IMG_FADE_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include "lvgl.h"
+#include <stdint.h>
+
+// 两张 RGB565 图之间的交叉淡化 (幻灯片切换用)
+// 开始前把两张图各自居中贴到 w x h 的黑底画布上，之后每帧只是一次 NEON 线性插值，不走 LVGL 的透明度绘制
+typedef struct img_fade img_fade_t;
+
+// 准备一次淡化, from / to 必须是 LV_IMG_CF_TRUE_COLOR 且不超过 w x h; 失败返回 NULL
+img_fade_t *img_fade_create(const lv_img_dsc_t *from, const lv_img_dsc_t *to, uint16_t w, uint16_t h);
+
+// 计算进度 mix (0: from, 256: to) 的一帧，返回的图像在下一次调用或销毁前有效
+const lv_img_dsc_t *img_fade_step(img_fade_t *fade, uint16_t mix);
+
+// 释放画布
+void img_fade_destroy(img_fade_t *fade);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // IMG_FADE_H
@@ -0,0 +1,48 @@
+#ifndef IMG_LOADER_H
+#define IMG_LOADER_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include "lvgl.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// 解码结果: 连续的 RGB565 像素 (与 lv_color_t 内存布局一致)
+typedef struct
+{
+    uint16_t w;
+    uint16_t h;
+    lv_color_t *data; // w * h 个像素, 用 img_buf_free() 释放
+} img_buf_t;
+
+// 解码图片文件 (JPEG/PNG/QOI, 按魔数识别)，并按比例缩小到 max_w x max_h 以内
+// JPEG 按 EXIF orientation 摆正 (结果尺寸是摆正后的)
+// 不直接使用 LVGL 的解码器和文件系统，可以在后台线程中调用
+// 返回 0 成功, -1 失败
+int img_loader_decode_file(const char *path, uint16_t max_w, uint16_t max_h, img_buf_t *out);
+
+// 同上, 数据来自内存 (例如内嵌的专辑封面)
+int img_loader_decode_mem(const uint8_t *data, size_t size, uint16_t max_w, uint16_t max_h, img_buf_t *out);
+
+// 快速预览 (只支持 JPEG): 优先用 EXIF 内嵌的缩略图，没有时按 1/8 DCT 缩放解码，结果不超过 max_w x max_h
+// 整图解码本身就是 1/8 缩放 (预览不会更快) 或不是 JPEG 时返回 -1
+int img_loader_decode_preview(const char *path, uint16_t max_w, uint16_t max_h, img_buf_t *out);
+
+// 只读取 JPEG 文件头: 原始 (未摆正) 宽高和 EXIF orientation (1~8, 没有时为 1)
+// 返回 0 成功, -1 失败
+int img_loader_jpeg_header(const char *path, uint32_t *w, uint32_t *h, int *orientation);
+
+// 按比例计算 src_w x src_h 缩放到 max_w x max_h 以内的尺寸 (不放大)
+void img_loader_fit_size(uint32_t src_w, uint32_t src_h, uint32_t max_w, uint32_t max_h, uint16_t *out_w, uint16_t *out_h);
+
+// 释放解码结果
+void img_buf_free(img_buf_t *buf);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // IMG_LOADER_H
@@ -0,0 +1,46 @@
+#ifndef IMG_META_H
+#define IMG_META_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include "media_index.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// 索引文件最多记录的图片数量 (每条 40 字节, 约 160KB 稀疏文件)
+#define META_CAPACITY 4096
+
+// 图片头信息
+typedef struct
+{
+    media_type_t format;
+    uint32_t w;          // 原始宽高 (未按 EXIF 摆正)
+    uint32_t h;
+    uint8_t cf;          // LVGL 解码器报告的颜色格式, LV_IMG_CF_UNKNOWN 表示还没有经过 LVGL 的解码器
+    bool has_alpha;
+    uint8_t orientation; // EXIF orientation 1~8, 非 JPEG 为 1
+} img_meta_t;
+
+// 打开 (不存在则创建) 索引文件并 mmap
+// 同时在 LVGL 解码器链的最前面挂一个解码器: lv_img_set_src("S:xxx") 命中索引时不再打开文件，
+// 打开图片时头信息也来自索引，直接交给处理这种格式的解码器，不再逐个尝试
+int img_meta_open(const char *index_path);
+
+// 注销 LVGL 解码器，关闭并把脏页写回
+void img_meta_close(void);
+
+// 只查询索引 (任意线程)。按路径 + mtime + 文件大小匹配，文件改动后自动失效
+bool img_meta_lookup(const char *path, img_meta_t *meta);
+
+// 查询索引，未命中时读取文件头并写入索引 (任意线程)
+// 支持 JPEG/PNG/QOI/SJPG/GIF, 返回 0 成功, -1 失败
+int img_meta_get(const char *path, img_meta_t *meta);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // IMG_META_H
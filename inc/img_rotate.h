@@ -0,0 +1,42 @@
+#ifndef IMG_ROTATE_H
+#define IMG_ROTATE_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include "img_loader.h"
+#include "lvgl.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// 顺时针旋转角度
+typedef enum
+{
+    IMG_ROT_0 = 0,
+    IMG_ROT_90,
+    IMG_ROT_180,
+    IMG_ROT_270,
+    _IMG_ROT_NUM
+} img_rot_t;
+
+// 旋转 RGB565 图像 (分块转置, aarch64 上用 NEON 8x8 转置)
+// 90/270 时 dst 尺寸为 h x w; dst 与 src 不能重叠
+void img_rotate_565(lv_color_t *dst, const lv_color_t *src, uint32_t w, uint32_t h, img_rot_t rot);
+
+// 水平翻转 (原地)
+void img_flip_h_565(lv_color_t *px, uint32_t w, uint32_t h);
+
+// 把 EXIF orientation (1~8) 拆成 "先水平翻转, 再顺时针旋转"
+img_rot_t img_rot_from_exif(int orientation, bool *mirror);
+
+// 对解码结果做翻转和旋转，buf 的像素和尺寸被替换
+// 返回 0 成功, -1 内存不足 (buf 保持不变)
+int img_buf_transform(img_buf_t *buf, img_rot_t rot, bool mirror);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // IMG_ROTATE_H
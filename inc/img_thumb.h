@@ -0,0 +1,37 @@
+#ifndef IMG_THUMB_H
+#define IMG_THUMB_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include "lvgl.h"
+#include <stdbool.h>
+
+// 缩略图尺寸 (4:3, 网格每格 76x58)
+#define THUMB_W 72
+#define THUMB_H 54
+
+// pack 文件最多容纳的缩略图数量 (文件按实际生成的数量增长，每张约 7.6KB)
+#define THUMB_MAX 32768
+
+// 打开 (不存在则创建) 缩略图 pack 文件并 mmap
+int img_thumb_open(const char *pack_path);
+
+// 关闭并把脏页写回
+void img_thumb_close(void);
+
+// 查询缩略图 (UI 线程)。按路径 + mtime + 文件大小匹配
+// 命中时 dsc 直接指向 mmap 中的 RGB565 像素，无需解码，也不分配内存; 这块像素在 img_thumb_close 之前不会被改写
+bool img_thumb_lookup(const char *path, lv_img_dsc_t *dsc);
+
+// 解码原图并生成缩略图写入 pack (在后台线程中调用)
+// 已有有效缩略图时直接返回 0
+int img_thumb_generate(const char *path);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // IMG_THUMB_H
@@ -0,0 +1,68 @@
+#ifndef IMG_TILES_H
+#define IMG_TILES_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include "bg_worker.h"
+#include "lvgl.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// tile 边长 (RGB565, 每块 32KB)
+#define TILE_SIZE 128
+
+// 每张图最多缓存的 tile 数，内存上限与原图分辨率无关 (32 x 32KB = 1MB)
+#define TILE_CACHE_SIZE 32
+
+// 一次请求最多连续的 tile 列数
+#define TILE_BAND_MAX 8
+
+// PNG / QOI 生成金字塔时要整图解码 (峰值约 像素数 x 8 字节)，超过这个像素数的不支持放大 (JPEG 按段解码，不受限制)
+#define TILE_FULL_DECODE_MAX_PX (4u * 1024 * 1024)
+
+// 缩放等级: level k 的尺寸 = 原图 / 2^k (向上取整), level 0 为原始分辨率
+typedef struct img_tiles img_tiles_t;
+
+// 有 tile 解码完成 (UI 线程)
+typedef void (*img_tiles_ready_cb_t)(void *user_data);
+
+// 打开图片 (JPEG/PNG/QOI, 按魔数识别)，只读取头信息; JPEG 的 tile 坐标按 EXIF orientation 摆正
+// 格式不支持或 PNG / QOI 超过 TILE_FULL_DECODE_MAX_PX 时返回 NULL
+img_tiles_t *img_tiles_open(const char *path, img_tiles_ready_cb_t cb, void *user_data);
+
+// 关闭并释放 tile 缓存，仍在解码的任务完成后自动丢弃
+void img_tiles_close(img_tiles_t *t);
+
+// 原图尺寸 (摆正后)
+void img_tiles_get_size(const img_tiles_t *t, uint32_t *w, uint32_t *h);
+
+// level 对应的尺寸
+void img_tiles_level_size(const img_tiles_t *t, int level, uint32_t *w, uint32_t *h);
+
+// 能完整放进 max_w x max_h 的最小 level
+int img_tiles_fit_level(const img_tiles_t *t, uint32_t max_w, uint32_t max_h);
+
+// 请求第 row 行 col0 ~ col1 列的 tile (UI 线程)
+// 缺失的 tile 在后台一次解码整段 (JPEG 只解码这一段扫描线)，完成后回调 cb
+void img_tiles_request(img_tiles_t *t, int level, uint32_t row, uint32_t col0, uint32_t col1, bg_prio_t prio);
+
+// 查询已解码的 tile (UI 线程)，未就绪返回 NULL
+// 返回的描述一直有效，直到该 tile 被淘汰 (请求新 tile 时淘汰最久未用的)
+const lv_img_dsc_t *img_tiles_lookup(img_tiles_t *t, int level, uint32_t col, uint32_t row);
+
+// tile 缓存占用的字节数 (UI 线程)
+size_t img_tiles_mem_usage(const img_tiles_t *t);
+
+// 按最久未用的顺序释放已就绪的 tile，直到占用不超过 target (UI 线程)，正在解码的保留
+// 释放的 tile 之前 lookup 返回的描述随之失效，调用者要重新 lookup (缺失的再 request)
+void img_tiles_trim(img_tiles_t *t, size_t target);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // IMG_TILES_H
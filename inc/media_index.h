@@ -0,0 +1,85 @@
+#ifndef MEDIA_INDEX_H
+#define MEDIA_INDEX_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// --- 文件类型 (按文件头魔数识别，不看后缀) ---
+typedef enum
+{
+    MEDIA_TYPE_UNKNOWN = 0,
+    MEDIA_TYPE_PNG,
+    MEDIA_TYPE_JPEG,
+    MEDIA_TYPE_SJPG,
+    MEDIA_TYPE_GIF,
+    MEDIA_TYPE_QOI,
+    MEDIA_TYPE_MP3,
+    MEDIA_TYPE_WAV,
+    MEDIA_TYPE_FLAC,
+    _MEDIA_TYPE_NUM
+} media_type_t;
+
+#define MEDIA_MASK(t)    (1u << (t))
+#define MEDIA_MASK_IMAGE                                                                                      \
+    (MEDIA_MASK(MEDIA_TYPE_PNG) | MEDIA_MASK(MEDIA_TYPE_JPEG) | MEDIA_MASK(MEDIA_TYPE_SJPG) | MEDIA_MASK(MEDIA_TYPE_GIF) | \
+     MEDIA_MASK(MEDIA_TYPE_QOI))
+#define MEDIA_MASK_AUDIO (MEDIA_MASK(MEDIA_TYPE_MP3) | MEDIA_MASK(MEDIA_TYPE_WAV) | MEDIA_MASK(MEDIA_TYPE_FLAC))
+
+// --- 变化通知 (都在 UI 线程中回调) ---
+typedef enum
+{
+    MEDIA_EVENT_ADDED,    // 新增一个文件, name 有效
+    MEDIA_EVENT_REMOVED,  // 删除一个文件, name 有效 (回调返回后失效)
+    MEDIA_EVENT_UPDATED,  // 一批变化已合并完，索引号可能整体移动
+    MEDIA_EVENT_SCAN_DONE // 首次全量扫描完成
+} media_event_t;
+
+typedef struct media_index media_index_t;
+
+typedef void (*media_index_cb_t)(media_index_t *idx, media_event_t event, const char *name, void *user_data);
+
+// 创建索引并在后台线程中扫描 dir，之后通过 inotify 增量更新
+// 扫描结果分批合并，第一批很快就能显示
+// type_mask: MEDIA_MASK_xxx 的组合
+media_index_t *media_index_create(const char *dir, uint32_t type_mask, media_index_cb_t cb, void *user_data);
+
+// 停止扫描并释放索引
+void media_index_destroy(media_index_t *idx);
+
+// 以下接口只能在 UI 线程调用，索引按自然顺序排序 ("img2" 在 "img10" 前)
+
+// 文件数
+uint32_t media_index_count(const media_index_t *idx);
+
+// 第 i 个文件名 (不含目录)
+const char *media_index_name(const media_index_t *idx, uint32_t i);
+
+// 第 i 个文件的类型
+media_type_t media_index_type(const media_index_t *idx, uint32_t i);
+
+// 按文件名查找，返回索引号，没找到返回 -1
+int media_index_find(const media_index_t *idx, const char *name);
+
+// 扫描目录
+const char *media_index_dir(const media_index_t *idx);
+
+// 首次全量扫描是否还在进行
+bool media_index_is_scanning(const media_index_t *idx);
+
+// 按文件头魔数识别类型 (至少给 12 字节才能认出 WAV)
+media_type_t media_sniff(const uint8_t *head, size_t len);
+
+// 自然顺序比较 (忽略大小写，数字按数值比较)
+int media_natural_cmp(const char *a, const char *b);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MEDIA_INDEX_H
@@ -0,0 +1,69 @@
+#ifndef MEM_BUDGET_H
+#define MEM_BUDGET_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stddef.h>
+
+// 最多登记的缓存数量
+#define MEM_BUDGET_MAX_CACHES 16
+
+// MemAvailable 低于这个值开始按顺序释放缓存 (KB)
+#define MEM_LOW_KB      (64 * 1024)
+// MemAvailable 低于这个值释放所有缓存 (KB)
+#define MEM_CRITICAL_KB (24 * 1024)
+
+// 内存紧张程度
+typedef enum
+{
+    MEM_PRESSURE_NONE,
+    MEM_PRESSURE_MODERATE, // 从最容易重建的缓存开始释放，直到 MemAvailable 回到 MEM_LOW_KB 以上
+    MEM_PRESSURE_CRITICAL  // 所有缓存全部释放
+} mem_pressure_t;
+
+// 释放顺序: 数值小的先释放
+typedef enum
+{
+    MEM_PRIO_PREFETCH, // 预取/预解码的数据，丢掉只是少一次提前准备
+    MEM_PRIO_CACHE,    // 普通的解码结果缓存，丢掉后要重新解码
+    MEM_PRIO_CORE      // 重建代价高的 (字体字形等)，最后才释放
+} mem_prio_t;
+
+// 当前占用的字节数 (UI 线程)
+typedef size_t (*mem_usage_cb_t)(void);
+
+// 释放到不超过 target 字节 (UI 线程)，尽力而为: 正在使用的部分可以保留
+typedef void (*mem_trim_cb_t)(size_t target);
+
+// 启动监控线程: 优先用 PSI 触发器 (/proc/pressure/memory) 等待内存压力事件,
+// 内核不支持时每秒读一次 /proc/meminfo。压力上升时在 UI 线程中按优先级释放缓存
+// 必须在 bg_worker_init() 之后、UI 线程中调用
+int mem_budget_init(void);
+
+// 停止监控线程 (在 bg_worker_deinit() 之前调用)
+void mem_budget_deinit(void);
+
+// 登记缓存 (UI 线程)，name 必须是常量字符串。同名重复登记时更新回调
+// trim_cb 为 NULL 表示只统计占用，不参与释放
+int mem_budget_register(const char *name, mem_prio_t prio, mem_usage_cb_t usage_cb, mem_trim_cb_t trim_cb);
+
+// 注销缓存 (UI 线程)
+void mem_budget_unregister(const char *name);
+
+// 最近一次检测到的内存压力 (任意线程)，可以用来跳过预取等可有可无的工作
+mem_pressure_t mem_budget_pressure(void);
+
+// 立即按 level 释放缓存 (UI 线程)，need 为 MODERATE 时要腾出的字节数
+void mem_budget_trim(mem_pressure_t level, size_t need);
+
+// 打印每个缓存的占用、累计释放量和系统可用内存
+void mem_budget_report(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MEM_BUDGET_H
@@ -0,0 +1,69 @@
+#ifndef MEM_TAG_H
+#define MEM_TAG_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stddef.h>
+
+// 分配大小直方图的桶数: <=16B, <=32B, ... , >256KB
+#define MEM_TAG_HIST_BUCKETS 16
+
+// 内存归属的子系统
+typedef enum
+{
+    MEM_TAG_LVGL,  // LVGL 控件、样式、绘制缓冲等 (lv_mem_alloc 的默认归属)
+    MEM_TAG_IMAGE, // 解码后的图片、tile、淡化画布
+    MEM_TAG_FONT,  // FreeType 的字体和字形缓存
+    MEM_TAG_TEXT,  // 阅读器的正文
+    MEM_TAG_AUDIO, // miniaudio 的解码器和缓冲
+    MEM_TAG_INDEX, // 目录扫描的文件列表
+    MEM_TAG_COUNT
+} mem_tag_t;
+
+// 某个标签的统计
+typedef struct
+{
+    size_t live;   // 当前占用字节数
+    size_t peak;   // 占用峰值
+    size_t allocs; // 累计分配次数
+    size_t frees;  // 累计释放次数
+    size_t hist[MEM_TAG_HIST_BUCKETS];
+} mem_tag_stats_t;
+
+// 带标签的 malloc/calloc/realloc/free (任意线程)
+// 每块多 16 字节的头，统计用原子操作，可以常开
+// 只能用 mem_tag_free 释放，不能与 malloc/free 混用
+void *mem_tag_alloc(mem_tag_t tag, size_t size);
+void *mem_tag_calloc(mem_tag_t tag, size_t n, size_t size);
+// p 不为 NULL 时保留原来的标签
+void *mem_tag_realloc(mem_tag_t tag, void *p, size_t size);
+char *mem_tag_strdup(mem_tag_t tag, const char *s);
+void mem_tag_free(void *p);
+
+// 把当前线程接下来的 lv_mem_alloc 记到 tag 名下 (例如调用 lodepng、lv_label_set_text 前)
+// 返回之前的标签，用完后交给 mem_tag_scope_end 恢复
+mem_tag_t mem_tag_scope_begin(mem_tag_t tag);
+void mem_tag_scope_end(mem_tag_t prev);
+
+// LV_MEM_CUSTOM_ALLOC/FREE/REALLOC: 按当前线程的标签分配 (默认 MEM_TAG_LVGL)
+void *mem_tag_lv_alloc(size_t size);
+void mem_tag_lv_free(void *p);
+void *mem_tag_lv_realloc(void *p, size_t size);
+
+// 读取统计 (任意线程)
+void mem_tag_get_stats(mem_tag_t tag, mem_tag_stats_t *out);
+
+// 打印每个标签的占用、峰值、分配次数和分配大小直方图
+void mem_tag_report(void);
+
+// 退出时调用: 打印仍未释放的内存 (按标签)
+void mem_tag_leak_report(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MEM_TAG_H
@@ -0,0 +1,58 @@
+#ifndef MUSIC_COVER_H
+#define MUSIC_COVER_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include "bg_worker.h"
+#include "lvgl.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+// 封面显示区域 (正方形，按比例缩放到其中)
+#define COVER_SIZE 80
+
+// pack 文件最多容纳的封面数量 (约 13MB 稀疏文件)
+#define COVER_CAPACITY 1024
+
+typedef enum
+{
+    MUSIC_COVER_MISS = 0, // 还没提取过 (或文件已改动)
+    MUSIC_COVER_NONE,     // 提取过，没有内嵌封面
+    MUSIC_COVER_READY,    // dsc 已指向缩放好的封面
+} music_cover_state_t;
+
+// 后台提取完成 (UI 线程)
+typedef void (*music_cover_cb_t)(const char *path, bool ok, void *user_data);
+
+// 打开 (不存在则创建) 封面 pack 文件并 mmap
+int music_cover_open(const char *pack_path);
+
+// 关闭并把脏页写回
+void music_cover_close(void);
+
+// 查询封面 (UI 线程)。按路径 + mtime + 文件大小匹配
+// 命中时把 RGB565 像素从 mmap 拷到 pixels (至少 COVER_SIZE x COVER_SIZE 个像素)，dsc 指向 pixels，无需解码
+// pack 里的槽位之后被后台覆盖也不影响已经拷出来的封面; 拷贝时正好在写则当作未命中
+music_cover_state_t music_cover_lookup(const char *path, lv_img_dsc_t *dsc, lv_color_t *pixels);
+
+// 提取内嵌封面、缩放解码后写入 pack (在后台线程中调用)
+// 没有封面或解码失败也会记下来，之后查询直接返回 MUSIC_COVER_NONE；已有记录时直接返回 0
+int music_cover_generate(const char *path);
+
+// 在后台线程中调用 music_cover_generate，cb 不为 NULL 时把结果送回 UI 线程
+int music_cover_request(const char *path, bg_prio_t prio, music_cover_cb_t cb, void *user_data);
+
+// pack 文件留在内存 (页缓存) 里的字节数 (UI 线程)
+size_t music_cover_mem_usage(void);
+
+// 内存预算的释放回调 (UI 线程): 占用超过 target 时写回脏页，把整个 pack 从内存中丢掉，之后查询时再从文件读回
+void music_cover_trim(size_t target);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MUSIC_COVER_H
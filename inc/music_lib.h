@@ -0,0 +1,89 @@
+#ifndef MUSIC_LIB_H
+#define MUSIC_LIB_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include "media_index.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// 索引文件最多记录的歌曲数 (每条 56 字节) 和字符串区大小，合计约 1.9MB 的稀疏文件
+#define MUSIC_LIB_CAPACITY  16384
+#define MUSIC_LIB_HEAP_SIZE (1024 * 1024)
+
+// 标签字符串的最大长度 (UTF-8, 含结尾的 0)
+#define MUSIC_TAG_LEN 128
+
+// 内嵌封面图片的最大字节数，更大的当作没有封面
+#define MUSIC_COVER_MAX (4 * 1024 * 1024)
+
+// 峰值未知 (标签里没有 REPLAYGAIN_TRACK_PEAK，也还没有分析过)
+#define MUSIC_PEAK_UNKNOWN INT16_MIN
+
+// 音轨增益的来源
+typedef enum
+{
+    MUSIC_GAIN_NONE, // 还没有: 没有 ReplayGain 标签，也还没有分析过
+    MUSIC_GAIN_TAG,  // 标签中的 REPLAYGAIN_TRACK_GAIN (ID3v2 TXXX 帧或 Vorbis comment)
+    MUSIC_GAIN_SCAN, // 响度分析的结果 (见 music_loudness.h)
+} music_gain_source_t;
+
+// 一首歌的信息
+typedef struct
+{
+    media_type_t format;
+    uint32_t duration_ms; // 0 表示未知
+    uint32_t sample_rate;
+    uint16_t bitrate;     // kbps, VBR 为平均码率
+    uint16_t track;       // 音轨号, 0 表示未知
+    uint8_t channels;
+    char title[MUSIC_TAG_LEN]; // 空串表示没有标签
+    char artist[MUSIC_TAG_LEN];
+    char album[MUSIC_TAG_LEN];
+    uint8_t gain_source; // music_gain_source_t
+    int16_t gain_cdb;    // ReplayGain 2.0 音轨增益 (0.01 dB，参考响度 -18 LUFS)
+    int16_t peak_cdb;    // 音轨峰值 (0.01 dBFS，分析得到的是真峰值)，不知道时为 MUSIC_PEAK_UNKNOWN
+} music_info_t;
+
+// 后台读取完成 (UI 线程)，失败时 info 为 NULL
+typedef void (*music_lib_cb_t)(const char *path, const music_info_t *info, void *user_data);
+
+// 打开 (不存在则创建) 索引文件并 mmap，之后查询不需要再打开任何歌曲文件
+int music_lib_open(const char *index_path);
+
+// 关闭并把脏页写回
+void music_lib_close(void);
+
+// 只查询索引，不检查文件是否改动过 (任意线程，不做任何 IO，列表滚动时可以逐行调用)
+bool music_lib_lookup(const char *path, music_info_t *info);
+
+// 按路径 + mtime + 文件大小查询索引，未命中或文件已改动时解析文件并写入索引 (任意线程，会读文件)
+// 支持 MP3 (ID3v1/ID3v2.2~2.4, Xing/Info/VBRI 或按 CBR 估算时长)、FLAC (STREAMINFO + Vorbis comment)、WAV (fmt + LIST/INFO)
+// ReplayGain 只读音轨增益 (ID3v2 的 TXXX 帧、Vorbis comment)，不读专辑增益
+// 返回 0 成功, -1 失败
+int music_lib_get(const char *path, music_info_t *info);
+
+// 写入响度分析的结果 (来源记为 MUSIC_GAIN_SCAN)，索引里还没有这首歌时先解析文件
+// 返回 0 成功, -1 文件不存在或索引没有打开
+int music_lib_set_gain(const char *path, int16_t gain_cdb, int16_t peak_cdb);
+
+// 只解析文件，不读写索引
+int music_lib_probe(const char *path, music_info_t *info);
+
+// 读取内嵌封面的原始数据 (JPEG/PNG): ID3v2 的 APIC/PIC 帧或 FLAC 的 PICTURE 块，有多张时优先取封面类型的
+// 只读标签和元数据块，不读音频数据 (任意线程)。成功时 *data 用 mem_tag_free() 释放
+// 返回 0 成功, -1 没有封面或读取失败
+int music_lib_read_cover(const char *path, uint8_t **data, size_t *size);
+
+// 在后台线程中调用 music_lib_get (低优先级)，cb 不为 NULL 时把结果送回 UI 线程
+int music_lib_request(const char *path, music_lib_cb_t cb, void *user_data);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MUSIC_LIB_H
@@ -0,0 +1,63 @@
+#ifndef MUSIC_LOUDNESS_H
+#define MUSIC_LOUDNESS_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+
+// ReplayGain 2.0 的参考响度: 增益 = 参考响度 - 综合响度
+#define MUSIC_LOUDNESS_REF_LUFS (-18.0f)
+
+// 一首歌的分析结果
+typedef struct
+{
+    float lufs;      // 综合响度 (LUFS)，没有超过绝对门限的块 (静音) 时为 -70
+    float peak_db;   // 真峰值 (dBTP)
+    uint64_t frames; // 分析的帧数
+} music_loudness_t;
+
+// 后台分析的统计
+typedef struct
+{
+    uint32_t scanned;  // 分析完的歌曲数
+    uint32_t skipped;  // 已经有增益 (ReplayGain 标签或分析过) 而跳过的
+    uint32_t failed;   // 无法解码的
+    uint64_t audio_ms; // 分析的音频时长
+    uint64_t busy_ns;  // 解码 + 分析用的时间
+} music_loudness_stats_t;
+
+/*
+ * 响度分析 (ITU-R BS.1770-4 / EBU R128): 用 ma_decoder 按原始采样率和声道解码整首歌，
+ * K 计权后按 400ms 的块 (每 100ms 一块，重叠 75%) 计算能量，经过绝对门限 (-70 LUFS) 和相对门限 (-10 LU)
+ * 得到综合响度; 真峰值在 4 倍过采样 (96kHz 以上 2 倍、192kHz 以上不过采样) 后取最大值
+ * 单声道按双单声道算 (播放时两个喇叭都出声)，5.1 的环绕声道乘 1.41，LFE 不计
+ */
+
+// 分析整首歌 (在调用线程中执行，几秒到十几秒)，返回 0 成功, -1 无法解码
+int music_loudness_scan(const char *path, music_loudness_t *out);
+
+// 响度换算成 ReplayGain 2.0 的音轨增益 (dB)，静音的歌曲为 0
+float music_loudness_gain_db(const music_loudness_t *res);
+
+// 后台分析: 在低优先级后台线程中分段解码 (每段约 10 秒音频，段与段之间让出线程给别的任务)，同一时间只分析一首，
+// 其余的排队 (重复的忽略)。索引里已经有增益 (ReplayGain 标签或分析过) 的歌曲直接跳过，不解码
+// 完成后用 music_lib_set_gain 写进歌曲索引，下次播放这首时生效。返回 0 已加入队列, -1 队列满
+int music_loudness_request(const char *path);
+
+// 丢弃排队的和分析到一半的歌曲 (bg_worker_deinit 之后调用)
+void music_loudness_close(void);
+
+// 读取统计 (任意线程)
+void music_loudness_get_stats(music_loudness_stats_t *out);
+
+// 打印分析过的歌曲数和速度 (音频时长 / 用时)
+void music_loudness_report(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MUSIC_LOUDNESS_H
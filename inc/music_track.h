@@ -0,0 +1,97 @@
+#ifndef MUSIC_TRACK_H
+#define MUSIC_TRACK_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include "miniaudio.h"
+#include <stdint.h>
+
+// 一首歌的数据源: ma_decoder 加一层包装，第一次被音频线程读取时回调 (用来得知链上切到了这一首)
+// 输出统一为 f32 + 引擎的声道数和采样率，链上每一首格式相同，切换时不需要重建转换器
+// 解码线程运行时，每首歌带一个环形缓冲，由解码线程提前解码几秒，音频线程只拷贝，不碰文件也不解码;
+// 缓冲读空时输出静音 (不会阻塞音频线程)。解码线程没有启动时退回到在音频线程中直接解码
+typedef struct music_track music_track_t;
+
+// 解码线程参数
+typedef struct
+{
+    uint32_t buffer_ms; // 每首歌的环形缓冲时长 (48kHz 立体声每秒 375KB)
+    int rt_priority;    // SCHED_FIFO 优先级 (应低于音频输出线程)，0 或没有权限时改用 nice
+    int nice;           // 不用实时调度时的 nice 值
+    int cpu;            // 绑定的 CPU 核，-1 不绑定
+} music_decoder_config_t;
+
+// 解码线程统计
+typedef struct
+{
+    uint64_t underruns;      // 缓冲读空、补了静音的次数
+    uint64_t silence_frames; // 补的静音帧数
+    uint32_t low_water_ms;   // 缓冲第一次填满之后剩余量的最小值，UINT32_MAX 表示还没有数据
+} music_decoder_stats_t;
+
+// 播放链的头: 不产生任何数据，读取时立即跳到链上的第一首
+// ma_sound 始终挂在链头上，播放过的歌曲可以直接释放，不必一直留到停止播放
+typedef struct
+{
+    ma_data_source_base base;
+    ma_uint32 channels;
+    ma_uint32 sample_rate;
+} music_chain_t;
+
+// 默认参数: 3 秒缓冲、SCHED_FIFO 40、不绑核
+music_decoder_config_t music_decoder_config_default(void);
+
+// 用环境变量覆盖参数: AUDIO_BUFFER_MS、AUDIO_DECODE_PRIO、AUDIO_DECODE_NICE、AUDIO_DECODE_CPU
+void music_decoder_config_from_env(music_decoder_config_t *cfg);
+
+// 启动解码线程，之后打开的歌曲使用环形缓冲; 返回 0 成功, -1 失败 (歌曲照常在音频线程中解码)
+int music_decoder_start(const music_decoder_config_t *cfg);
+
+// 停止解码线程 (所有歌曲必须已经关闭)
+void music_decoder_stop(void);
+
+// 读取统计 (任意线程)
+void music_decoder_get_stats(music_decoder_stats_t *out);
+
+// 打印调度方式、缓冲时长、读空次数和缓冲最低水位
+void music_decoder_report(void);
+
+// 某一首开始播放 (音频线程中调用，不要做耗时操作)
+typedef void (*music_track_start_cb_t)(uint32_t id, void *user_data);
+
+// 设置开始播放回调 (对所有歌曲生效)
+void music_track_set_start_cb(music_track_start_cb_t cb, void *user_data);
+
+// 打开文件并读取总长度 (MP3 需要扫描帧头，可以在后台线程中调用)，解码线程运行时先同步解码一小段垫底
+// id 由调用者分配，回调时原样传回; 失败返回 NULL
+music_track_t *music_track_open(const char *path, uint32_t id, ma_uint32 channels, ma_uint32 sample_rate,
+                                const ma_allocation_callbacks *alloc);
+
+// 关闭 (音频线程必须已经不再读取这一首)
+void music_track_close(music_track_t *t);
+
+// 作为 ma_data_source 使用 (ma_data_source_set_next 等)
+ma_data_source *music_track_ds(music_track_t *t);
+
+uint32_t music_track_id(const music_track_t *t);
+
+// 响度归一化的增益 (线性，默认 1)，交给声部之前设置
+// 音频线程读取这一首时直接乘到样本上，无缝衔接时增益和歌曲在同一帧切换，不用等 UI 线程
+void music_track_set_gain(music_track_t *t, float gain);
+
+// 已播放 / 总帧数 (任意线程)
+ma_uint64 music_track_cursor(const music_track_t *t);
+ma_uint64 music_track_length(const music_track_t *t);
+
+// 初始化链头，格式与 music_track_open 的参数一致
+ma_result music_chain_init(music_chain_t *chain, ma_uint32 channels, ma_uint32 sample_rate);
+void music_chain_uninit(music_chain_t *chain);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MUSIC_TRACK_H
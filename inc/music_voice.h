@@ -0,0 +1,63 @@
+#ifndef MUSIC_VOICE_H
+#define MUSIC_VOICE_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include "miniaudio.h"
+#include "music_track.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// 声部数: 交叉淡化时一个淡出、一个淡入
+#define MUSIC_VOICE_COUNT 2
+
+/*
+ * 声部: 一个在引擎初始化时建好的 ma_sound 加它自己的播放链 (chain -> track -> next)
+ * 切歌和交叉淡化只是把歌曲挂到空闲声部上、设定开始/停止时间，不创建也不销毁 ma_sound，过程中没有内存分配。
+ * 空闲的声部不连在节点图上，音频线程不会读它。所有接口只在 UI 线程中调用
+ */
+typedef struct music_voice music_voice_t;
+
+// 声部播放到链的结尾 (音频线程中调用)，seq 为 music_voice_start 返回的序号
+typedef void (*music_voice_end_cb_t)(uint32_t seq, void *user_data);
+
+// 建好所有声部，之后播放时接到 output 上 (频谱监听节点或引擎的输出端点)
+int music_voice_pool_init(ma_engine *engine, ma_node *output, music_voice_end_cb_t end_cb, void *user_data);
+void music_voice_pool_uninit(void);
+
+// 取一个空闲声部，都在用时返回 NULL
+music_voice_t *music_voice_acquire(void);
+
+// 开始播放 t (所有权交给声部)，返回本次播放的序号 (全局递增，不会为 0)
+// start_at: 引擎时间 (帧)，0 表示立即; fade: 从 start_at 开始淡入的帧数，0 表示不淡入
+uint32_t music_voice_start(music_voice_t *v, music_track_t *t, ma_uint64 start_at, ma_uint64 fade);
+
+// 从 fade_at (引擎时间) 开始 fade 帧内淡出到静音，之后停止
+void music_voice_fade_out(music_voice_t *v, ma_uint64 fade_at, ma_uint64 fade);
+
+// 无缝衔接: 把 t 接在当前歌曲后面 (所有权交给声部)
+void music_voice_chain(music_voice_t *v, music_track_t *t);
+
+// 链上的下一首已经开始: 关闭上一首，下一首成为当前歌曲 (它的增益在音频线程读取时已经生效)
+void music_voice_advance(music_voice_t *v);
+
+// 停止并断开 (等音频线程离开后返回)，关闭上面的歌曲，放回池中; v 为 NULL 时什么也不做
+void music_voice_release(music_voice_t *v);
+
+// 当前歌曲 / 接在后面的下一首 (没有时为 NULL)
+music_track_t *music_voice_track(const music_voice_t *v);
+music_track_t *music_voice_next(const music_voice_t *v);
+
+uint32_t music_voice_seq(const music_voice_t *v);
+
+// 已经停止 (到了停止时间) 或者播放到了结尾
+bool music_voice_done(const music_voice_t *v);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MUSIC_VOICE_H
@@ -0,0 +1,89 @@
+#ifndef PLAYLIST_H
+#define PLAYLIST_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// 单条路径的最大长度 (含结尾的 0)，M3U 中更长的行直接跳过
+#define PLAYLIST_PATH_MAX 512
+
+typedef enum
+{
+    PLAYLIST_REPEAT_ALL = 0, // 列表循环
+    PLAYLIST_REPEAT_ONE,     // 单曲循环 (只影响自动切歌，手动切歌照常前进)
+    PLAYLIST_REPEAT_OFF,     // 播完最后一首停止
+    _PLAYLIST_REPEAT_NUM
+} playlist_repeat_t;
+
+/*
+ * 播放列表: 所有路径放在一个字符串池里，每条只占一个 4 字节偏移，不逐条 malloc。
+ * 随机播放不生成乱序数组，播放位置 p 对应的条目由种子确定的可逆置换 (Feistel 网络) 直接算出，
+ * 每步 O(1)、不占内存，种子相同顺序就相同。
+ * 所有接口只在同一个线程 (UI 线程) 中调用。
+ */
+typedef struct playlist playlist_t;
+
+playlist_t *playlist_create(void);
+void playlist_destroy(playlist_t *pl);
+
+// 清空条目，保留播放模式和当前位置 (重建列表后用 playlist_find + playlist_jump 找回当前歌曲)
+void playlist_clear(playlist_t *pl);
+
+// 追加一条，返回条目号，失败返回 -1
+int playlist_add(playlist_t *pl, const char *path);
+
+// 条目数
+uint32_t playlist_count(const playlist_t *pl);
+
+// 第 i 条的路径，下一次 playlist_add/playlist_clear 之前有效
+const char *playlist_path(const playlist_t *pl, uint32_t i);
+
+// 按路径查找 (顺序比较)，返回条目号，没找到返回 -1
+int playlist_find(const playlist_t *pl, const char *path);
+
+// 当前条目，列表为空时返回 -1
+int playlist_current(const playlist_t *pl);
+
+// 把条目 i 设为当前 (随机播放时通过逆置换找到它在播放顺序中的位置)
+void playlist_jump(playlist_t *pl, uint32_t i);
+
+// 从当前位置按播放顺序走 step 步后的条目，不移动当前位置
+// user 为 true 表示用户手动切歌 (单曲循环时也前进)；播放模式为 PLAYLIST_REPEAT_OFF 且走出列表时返回 -1
+int playlist_peek(const playlist_t *pl, int step, bool user);
+
+// 同 playlist_peek，并移动到该条目
+int playlist_step(playlist_t *pl, int step, bool user);
+
+// 随机播放开关，打开时使用给定的种子 (同一种子得到同一顺序)，当前歌曲保持不变
+void playlist_set_shuffle(playlist_t *pl, bool on, uint32_t seed);
+bool playlist_get_shuffle(const playlist_t *pl);
+
+void playlist_set_repeat(playlist_t *pl, playlist_repeat_t mode);
+playlist_repeat_t playlist_get_repeat(const playlist_t *pl);
+
+// 读取 M3U/M3U8 并追加到列表 (跳过注释、#EXTINF 和网络地址，相对路径相对于列表文件所在目录)
+// 返回追加的条数，打不开返回 -1
+int playlist_load_m3u(playlist_t *pl, const char *path);
+
+// 写出 M3U8 (先写临时文件再改名，不会留下写了一半的列表)
+// 返回 0 成功, -1 失败
+int playlist_save_m3u(const playlist_t *pl, const char *path);
+
+// 播放队列: M3U8 + 一行 "#QUEUE:" 注释记录当前位置、随机种子和循环模式，其他播放器会把它当普通列表读
+// follow_dir 由调用者解释 (例如队列是否跟随目录扫描结果)，原样保存
+int playlist_save_queue(const playlist_t *pl, const char *path, bool follow_dir);
+
+// 清空列表后读取播放队列，没有 "#QUEUE:" 行时按普通 M3U 处理 (从第一条开始、播放模式不变, *follow_dir 为 false)
+// 返回条目数，打不开返回 -1
+int playlist_load_queue(playlist_t *pl, const char *path, bool *follow_dir);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PLAYLIST_H
@@ -0,0 +1,44 @@
+#ifndef SPECTRUM_H
+#define SPECTRUM_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+
+// FFT 长度 (实数样本)，48kHz 下约 21ms、频率分辨率约 47Hz
+#define SPECTRUM_FFT_SIZE 1024
+#define SPECTRUM_BINS     (SPECTRUM_FFT_SIZE / 2)
+#define SPECTRUM_MAX_BARS 32
+
+// 显示范围: 低于 -SPECTRUM_FLOOR_DB 的频段显示为 0
+#define SPECTRUM_FLOOR_DB 60
+
+// 1: FFT 用 Q15 定点 (每级右移一位防溢出，动态范围约 70dB，够显示用)，适合没有 FPU 或 FPU 很慢的核
+// 0: 单精度浮点
+// 两种实现都有标量和 NEON 版本，按编译目标自动选择
+#ifndef SPECTRUM_FIXED_POINT
+#define SPECTRUM_FIXED_POINT 0
+#endif
+
+typedef struct spectrum spectrum_t;
+
+// 创建分析器: 频段按对数从 50Hz 分到 16kHz (不超过奈奎斯特频率)
+spectrum_t *spectrum_create(uint32_t sample_rate, uint32_t bars);
+void spectrum_destroy(spectrum_t *s);
+
+// 加 Hann 窗后做实数 FFT，输出每个频点的电平 (dBFS，满幅正弦为 0dB)
+// samples: SPECTRUM_FFT_SIZE 个单声道样本; db: SPECTRUM_BINS 个
+void spectrum_analyze(spectrum_t *s, const float *samples, float *db);
+
+// 计算各频段的显示高度 (0~255): 上升立即跟随，下降按固定速度回落
+// samples 为 NULL 时只回落 (暂停、静音)
+void spectrum_update(spectrum_t *s, const float *samples, uint8_t *levels);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SPECTRUM_H
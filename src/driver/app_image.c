@@ -1,63 +1,224 @@
 #include "app_image.h"
+#include "bg_worker.h"
+#include "img_cache.h"
+#include "img_fade.h"
+#include "img_meta.h"
+#include "img_thumb.h"
+#include "img_tiles.h"
 #include "lv_group.h"
 #include "lvgl.h"
+#include "media_index.h"
+#include "mem_budget.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <dirent.h>
 
 // --- 配置 ---
 #define IMG_DIR_PATH "/root/multimedia_app" // 真实的 Linux 路径用于扫描
 #define LV_FS_PREFIX "S:"                   // LVGL 映射的盘符前缀
 
-#define MAX_FILES     50  // 最大支持图片数
 #define MAX_FNAME_LEN 256 // 文件名最大长度
 
+// 缩略图缓存 (持久化在图片目录下)
+#define THUMB_PACK_PATH IMG_DIR_PATH "/.thumbs.pack"
+
+// 图片头信息索引 (尺寸/格式/方向，lv_img_set_src 不必再打开文件)
+#define META_INDEX_PATH IMG_DIR_PATH "/.meta.idx"
+
+// 网格视图: 4 x 3, 每格放一张 THUMB_W x THUMB_H 的缩略图
+#define GRID_COLS  4
+#define GRID_ROWS  3
+#define GRID_CELLS (GRID_COLS * GRID_ROWS)
+#define CELL_W     (THUMB_W + 4)
+#define CELL_H     (THUMB_H + 4)
+#define CELL_GAP   3
+
+// 单图视图下方留给信息栏的高度
+#define SINGLE_LABEL_H 24
+
+// 缩放浏览: 视口最多覆盖的 tile 数 (320x240 时为 4 x 3)
+#define ZOOM_TILE_OBJS 16
+
+// 幻灯片: LV_KEY_HOME 开始 / 停止，单图视图无操作一段时间后也会自动开始，幻灯片中按任意键停止
+// 每张停留一段时间 (期间后台解码下一张)，切换时交叉淡化; 三个时长的默认值如下，启动时可用环境变量覆盖:
+//   IMAGE_SLIDESHOW_IDLE_MS (0 不自动开始)、IMAGE_SLIDESHOW_DWELL_MS、IMAGE_SLIDESHOW_FADE_MS (0 直接切换)
+#define SLIDESHOW_IDLE_MS  15000
+#define SLIDESHOW_DWELL_MS 5000
+#define SLIDESHOW_FADE_MS  600
+#define SLIDESHOW_TICK_MS  200 // 空闲检测和停留计时的节拍，淡化时按屏幕刷新周期出帧
+
+typedef enum
+{
+    VIEW_GRID,   // 缩略图网格
+    VIEW_SINGLE, // 单张大图
+    VIEW_ZOOM    // 放大浏览 (按 tile 解码)
+} view_mode_t;
+
 // --- 静态变量 ---
-static char file_list[MAX_FILES][MAX_FNAME_LEN];
-static int file_count    = 0;
+static media_index_t *img_index = NULL;     // 后台扫描的图片列表
+static char current_name[MAX_FNAME_LEN] = ""; // 索引变化后用文件名找回当前位置
 static int current_index = 0;
 
 static lv_obj_t *main_cont  = NULL; // 主容器
 static lv_obj_t *img_obj    = NULL; // 图片对象
 static lv_obj_t *label_info = NULL; // 文件名显示
+static img_rot_t view_rot   = IMG_ROT_0; // 单图视图的旋转角度 (切换图片时复位)
+static lv_img_dsc_t single_thumb_dsc;    // 大图解码完成前的占位缩略图
+static lv_obj_t *gif_obj    = NULL;      // GIF 动图 (单图视图中按需创建，离开时删除以停止解码)
+
+static view_mode_t view_mode = VIEW_GRID;
+static lv_obj_t *grid_cont   = NULL;
+static lv_obj_t *grid_cells[GRID_CELLS];
+static lv_obj_t *grid_imgs[GRID_CELLS];
+static lv_img_dsc_t grid_dscs[GRID_CELLS]; // 指向 mmap 中的缩略图像素
+static bool grid_loaded[GRID_CELLS];
+static int grid_page_start = -1; // 当前页第一格对应的文件索引
+
+static lv_obj_t *zoom_cont = NULL;
+static lv_obj_t *zoom_objs[ZOOM_TILE_OBJS];
+static img_tiles_t *zoom_tiles = NULL;
+static int zoom_level          = 0; // 当前 tile level, 0 为原始分辨率
+static int zoom_fit_level      = 0; // 整图放得下视口的 level
+static int32_t zoom_x          = 0; // 视口左上角 (level 坐标)
+static int32_t zoom_y          = 0;
+static int zoom_dir            = 1; // 最近一次平移方向, 用于预取
+
+static lv_timer_t *slide_timer = NULL;
+static bool slide_running      = false;
+static uint32_t slide_start    = 0;    // 当前阶段 (停留 / 淡化) 开始的时刻
+static img_fade_t *slide_fade  = NULL; // 正在淡化到下一张
+static uint32_t slide_idle_ms  = SLIDESHOW_IDLE_MS;
+static uint32_t slide_dwell_ms = SLIDESHOW_DWELL_MS;
+static uint32_t slide_fade_ms  = SLIDESHOW_FADE_MS;
 
 // --- 函数声明 ---
-static void scan_image_dir(void);
 static void load_current_image(void);
+static char *make_full_path(const char *name);
+static void show_grid(void);
+static void set_view_mode(view_mode_t mode);
+static void slide_begin(void);
+static void slide_stop(void);
 static void app_img_event_cb(lv_event_t *e);
 
 /**
- * @brief 扫描目录下的图片文件 (.png)
+ * @brief 单图视图可用的显示区域
  */
-static void scan_image_dir(void)
+static void single_view_size(uint16_t *w, uint16_t *h)
 {
-    DIR *d;
-    struct dirent *dir;
-    file_count = 0;
+    *w = (uint16_t)lv_obj_get_content_width(main_cont);
+    *h = (uint16_t)(lv_obj_get_content_height(main_cont) - SINGLE_LABEL_H);
+}
+
+/**
+ * @brief 单图视图显示原尺寸的图片 (撤销预览的放大)
+ */
+static void set_single_src(const void *src)
+{
+    lv_img_set_zoom(img_obj, LV_IMG_ZOOM_NONE);
+    lv_img_set_src(img_obj, src);
+}
+
+/**
+ * @brief 显示低分辨率预览，用 lv_img 的缩放铺满整图将要占的区域
+ */
+static void show_preview(const lv_img_dsc_t *dsc)
+{
+    uint16_t w, h;
+    single_view_size(&w, &h);
+    uint32_t zoom = LV_MIN((uint32_t)w * LV_IMG_ZOOM_NONE / dsc->header.w, (uint32_t)h * LV_IMG_ZOOM_NONE / dsc->header.h);
+    lv_img_set_src(img_obj, dsc);
+    lv_img_set_zoom(img_obj, (uint16_t)LV_MAX(zoom, LV_IMG_ZOOM_NONE));
+}
 
-    d = opendir(IMG_DIR_PATH);
-    if (d)
+/**
+ * @brief 交给 LVGL 的解码器 (img_loader 不支持的格式，如 SJPG)，不支持旋转
+ */
+static void load_with_lvgl(const char *name)
+{
+    // 拼接完整路径: S:filename.png
+    // 注意：因为你在 lv_conf.h 里设置了 LV_FS_STDIO_PATH 为 "/root/multimedia_app/"
+    // 所以这里只需要文件名即可
+    char path_buf[MAX_FNAME_LEN + 4];
+    snprintf(path_buf, sizeof(path_buf), "%s%s", LV_FS_PREFIX, name);
+
+    printf("Loading: %s\n", path_buf);
+    set_single_src(path_buf);
+}
+
+/**
+ * @brief 用 lv_gif 播放动图
+ * 帧直接解码进 RGB565A8 画布，每帧只重绘变化的区域，帧间隔之间没有任何定时器在跑
+ */
+static void show_gif(const char *name)
+{
+    char path_buf[MAX_FNAME_LEN + 4];
+    snprintf(path_buf, sizeof(path_buf), "%s%s", LV_FS_PREFIX, name);
+
+    if (gif_obj == NULL)
     {
-        while ((dir = readdir(d)) != NULL)
-        {
-            // 跳过 . 和 ..
-            if (strcmp(dir->d_name, ".") == 0 || strcmp(dir->d_name, "..") == 0)
-                continue;
+        gif_obj = lv_gif_create(main_cont);
+        lv_obj_align(gif_obj, LV_ALIGN_CENTER, 0, -10);
+    }
+    lv_obj_add_flag(img_obj, LV_OBJ_FLAG_HIDDEN);
+    set_single_src(LV_SYMBOL_IMAGE); // 释放上一张大图
+    printf("Loading: %s\n", path_buf);
+    lv_gif_set_src(gif_obj, path_buf);
+}
 
-            // 简单的后缀判断 (只作为演示，生产环境可用 strcasestr 忽略大小写)
-            if (strstr(dir->d_name, ".png") || strstr(dir->d_name, ".PNG"))
-            {
-                if (file_count < MAX_FILES)
-                {
-                    snprintf(file_list[file_count], MAX_FNAME_LEN, "%s", dir->d_name);
-                    file_count++;
-                }
-            }
-        }
-        closedir(d);
+/**
+ * @brief 删除动图控件 (停止帧定时器并释放画布)
+ */
+static void close_gif(void)
+{
+    if (gif_obj)
+    {
+        lv_obj_del(gif_obj);
+        gif_obj = NULL;
     }
-    printf("App Image: Found %d images.\n", file_count);
+}
+
+/**
+ * @brief 后台结果是否属于单图视图正在显示的图片 (不是预取的)
+ */
+static bool is_current_view(const char *path, img_rot_t rot)
+{
+    if (main_cont == NULL || view_mode != VIEW_SINGLE || rot != view_rot)
+        return false;
+
+    char *cur   = make_full_path(current_name);
+    bool is_cur = cur && strcmp(cur, path) == 0;
+    free(cur);
+    return is_cur;
+}
+
+/**
+ * @brief 预览解码完成 (UI 线程)，替换缩略图占位
+ */
+static void img_preview_cb(const char *path, img_rot_t rot, bool ok, void *user_data)
+{
+    (void)user_data;
+    if (!ok || !is_current_view(path, rot))
+        return;
+
+    const lv_img_dsc_t *dsc = img_cache_get_preview(path, rot);
+    if (dsc)
+        show_preview(dsc);
+}
+
+/**
+ * @brief 大图解码完成 (UI 线程)
+ */
+static void img_ready_cb(const char *path, img_rot_t rot, bool ok, void *user_data)
+{
+    (void)user_data;
+    if (!is_current_view(path, rot))
+        return;
+
+    const lv_img_dsc_t *dsc = ok ? img_cache_get(path, rot) : NULL;
+    if (dsc)
+        set_single_src(dsc);
+    else
+        load_with_lvgl(current_name);
 }
 
 /**
@@ -65,9 +226,10 @@ static void scan_image_dir(void)
  */
 static void load_current_image(void)
 {
+    int file_count = media_index_count(img_index);
     if (file_count == 0)
     {
-        lv_label_set_text(label_info, "No Images Found!");
+        lv_label_set_text(label_info, media_index_is_scanning(img_index) ? "Scanning..." : "No Images Found!");
         return;
     }
 
@@ -77,19 +239,647 @@ static void load_current_image(void)
     if (current_index >= file_count)
         current_index = 0;
 
-    // 拼接完整路径: S:filename.png
-    // 注意：因为你在 lv_conf.h 里设置了 LV_FS_STDIO_PATH 为 "/root/multimedia_app/"
-    // 所以这里只需要文件名即可
-    char path_buf[128];
-    snprintf(path_buf, sizeof(path_buf), "%s%s", LV_FS_PREFIX, file_list[current_index]);
+    const char *name = media_index_name(img_index, current_index);
+    snprintf(current_name, sizeof(current_name), "%s", name);
+    lv_label_set_text_fmt(label_info, "[%d/%d] %s", current_index + 1, file_count, name);
 
-    printf("Loading: %s\n", path_buf);
+    if (media_index_type(img_index, current_index) == MEDIA_TYPE_GIF)
+    {
+        show_gif(name);
+        return;
+    }
+    close_gif();
+    lv_obj_clear_flag(img_obj, LV_OBJ_FLAG_HIDDEN);
+
+    // 大图从缓存中取已解码、已旋转好的副本，重绘时只是贴图
+    uint16_t w, h;
+    single_view_size(&w, &h);
+    char *path = make_full_path(name);
+    const lv_img_dsc_t *dsc = path ? img_cache_get(path, view_rot) : NULL;
+    if (dsc)
+    {
+        set_single_src(dsc);
+    }
+    else if (path && img_cache_request(path, view_rot, w, h, BG_PRIO_HIGH) == 0)
+    {
+        // 先用缩略图占位，JPEG 的预览 (img_preview_cb) 和整图 (img_ready_cb) 解码完成后依次替换
+        const lv_img_dsc_t *preview = img_cache_get_preview(path, view_rot);
+        if (preview)
+            show_preview(preview);
+        else if (view_rot == IMG_ROT_0 && img_thumb_lookup(path, &single_thumb_dsc))
+            show_preview(&single_thumb_dsc);
+        else
+            set_single_src(LV_SYMBOL_IMAGE);
+    }
+    else
+    {
+        load_with_lvgl(name);
+    }
+    free(path);
+
+    // 预取下一张 (动图不经过缓存)
+    int next_index = (current_index + 1) % file_count;
+    char *next     = make_full_path(media_index_name(img_index, next_index));
+    if (next && media_index_type(img_index, next_index) != MEDIA_TYPE_GIF)
+        img_cache_request(next, IMG_ROT_0, w, h, BG_PRIO_LOW);
+    free(next);
+}
 
-    // 设置图片源
-    lv_img_set_src(img_obj, path_buf);
+/**
+ * @brief 拼接图片的真实路径 (后台线程不经过 LVGL 文件系统)
+ */
+static char *make_full_path(const char *name)
+{
+    size_t len = strlen(IMG_DIR_PATH) + strlen(name) + 2;
+    char *path = malloc(len);
+    if (path)
+        snprintf(path, len, "%s/%s", IMG_DIR_PATH, name);
+    return path;
+}
+
+/**
+ * @brief 缩略图生成完成 (UI 线程)，刷新还在显示占位图标的格子
+ */
+static void thumb_ready_cb(void *arg)
+{
+    (void)arg;
+    if (main_cont == NULL || view_mode != VIEW_GRID)
+        return;
+
+    int file_count = media_index_count(img_index);
+    for (int i = 0; i < GRID_CELLS; i++)
+    {
+        int idx = grid_page_start + i;
+        if (grid_loaded[i] || idx >= file_count)
+            continue;
+
+        char *path = make_full_path(media_index_name(img_index, idx));
+        if (path && img_thumb_lookup(path, &grid_dscs[i]))
+        {
+            lv_img_cache_invalidate_src(&grid_dscs[i]);
+            lv_img_set_src(grid_imgs[i], &grid_dscs[i]);
+            grid_loaded[i] = true;
+        }
+        free(path);
+    }
+}
+
+/**
+ * @brief 后台任务: 生成一张缩略图
+ */
+static void thumb_job(void *arg)
+{
+    char *path = arg;
+    img_thumb_generate(path);
+    free(path);
+    bg_worker_post_ui(thumb_ready_cb, NULL, NULL);
+}
+
+static void request_thumb(const char *name, bg_prio_t prio)
+{
+    // 内存紧张时不提前生成新文件的缩略图，翻到那一页时再按高优先级生成
+    if (prio == BG_PRIO_LOW && mem_budget_pressure() != MEM_PRESSURE_NONE)
+        return;
+
+    char *path = make_full_path(name);
+    if (path && bg_worker_submit(prio, thumb_job, free, path) != 0)
+        free(path);
+}
+
+/**
+ * @brief 显示当前选中项所在的网格页
+ * 已缓存的缩略图直接指向 mmap 数据，缺失的先显示占位图标并提交高优先级生成任务
+ */
+static void show_grid(void)
+{
+    int file_count = media_index_count(img_index);
+    if (file_count == 0)
+    {
+        for (int i = 0; i < GRID_CELLS; i++)
+            lv_obj_add_flag(grid_cells[i], LV_OBJ_FLAG_HIDDEN);
+        grid_page_start = -1;
+        lv_label_set_text(label_info, media_index_is_scanning(img_index) ? "Scanning..." : "No Images Found!");
+        return;
+    }
+
+    if (current_index < 0)
+        current_index = file_count - 1;
+    if (current_index >= file_count)
+        current_index = 0;
+
+    int page_start = current_index / GRID_CELLS * GRID_CELLS;
+    if (page_start != grid_page_start)
+    {
+        grid_page_start = page_start;
+        for (int i = 0; i < GRID_CELLS; i++)
+        {
+            int idx        = page_start + i;
+            grid_loaded[i] = false;
+            if (idx >= file_count)
+            {
+                lv_obj_add_flag(grid_cells[i], LV_OBJ_FLAG_HIDDEN);
+                continue;
+            }
+            lv_obj_clear_flag(grid_cells[i], LV_OBJ_FLAG_HIDDEN);
+
+            const char *name = media_index_name(img_index, idx);
+            char *path       = make_full_path(name);
+            if (path && img_thumb_lookup(path, &grid_dscs[i]))
+            {
+                lv_img_cache_invalidate_src(&grid_dscs[i]);
+                lv_img_set_src(grid_imgs[i], &grid_dscs[i]);
+                grid_loaded[i] = true;
+            }
+            else
+            {
+                lv_img_set_src(grid_imgs[i], LV_SYMBOL_IMAGE);
+                request_thumb(name, BG_PRIO_HIGH);
+            }
+            free(path);
+        }
+    }
+
+    // 选中框
+    for (int i = 0; i < GRID_CELLS; i++)
+    {
+        bool sel = (page_start + i == current_index);
+        lv_obj_set_style_border_color(grid_cells[i], sel ? lv_color_hex(0xFFD700) : lv_color_hex(0x303030), 0);
+    }
+
+    const char *name = media_index_name(img_index, current_index);
+    snprintf(current_name, sizeof(current_name), "%s", name);
+    lv_label_set_text_fmt(label_info, "[%d/%d] %s", current_index + 1, file_count, name);
+}
 
-    // 更新底部文字
-    lv_label_set_text_fmt(label_info, "[%d/%d] %s", current_index + 1, file_count, file_list[current_index]);
+/**
+ * @brief 创建网格视图的格子
+ */
+static void create_grid(void)
+{
+    grid_cont = lv_obj_create(main_cont);
+    lv_obj_set_size(grid_cont, GRID_COLS * (CELL_W + CELL_GAP), GRID_ROWS * (CELL_H + CELL_GAP));
+    lv_obj_align(grid_cont, LV_ALIGN_TOP_MID, 0, 0);
+    lv_obj_set_style_bg_opa(grid_cont, LV_OPA_TRANSP, 0);
+    lv_obj_set_style_border_width(grid_cont, 0, 0);
+    lv_obj_set_style_pad_all(grid_cont, 0, 0);
+    lv_obj_clear_flag(grid_cont, LV_OBJ_FLAG_SCROLLABLE);
+
+    for (int i = 0; i < GRID_CELLS; i++)
+    {
+        lv_obj_t *cell = lv_obj_create(grid_cont);
+        lv_obj_set_size(cell, CELL_W, CELL_H);
+        lv_obj_set_pos(cell, (i % GRID_COLS) * (CELL_W + CELL_GAP), (i / GRID_COLS) * (CELL_H + CELL_GAP));
+        lv_obj_set_style_pad_all(cell, 0, 0);
+        lv_obj_set_style_radius(cell, 0, 0);
+        lv_obj_set_style_border_width(cell, 2, 0);
+        lv_obj_set_style_bg_color(cell, lv_color_hex(0x101010), 0);
+        lv_obj_clear_flag(cell, LV_OBJ_FLAG_SCROLLABLE | LV_OBJ_FLAG_CLICK_FOCUSABLE);
+
+        lv_obj_t *img = lv_img_create(cell);
+        lv_obj_center(img);
+        lv_obj_set_style_text_color(img, lv_color_hex(0x808080), 0); // 占位图标颜色
+
+        grid_cells[i] = cell;
+        grid_imgs[i]  = img;
+    }
+    grid_page_start = -1;
+}
+
+/**
+ * @brief 图片索引变化 (UI 线程)
+ * 新文件排队生成缩略图；每批合并完后按文件名找回当前图片并刷新
+ */
+static void img_index_cb(media_index_t *idx, media_event_t event, const char *name, void *user_data)
+{
+    (void)user_data;
+    if (main_cont == NULL)
+        return;
+
+    switch (event)
+    {
+        case MEDIA_EVENT_ADDED:
+            request_thumb(name, BG_PRIO_LOW);
+            break;
+        case MEDIA_EVENT_REMOVED:
+            break;
+        case MEDIA_EVENT_UPDATED:
+        {
+            int pos = media_index_find(idx, current_name);
+            if (pos >= 0)
+            {
+                current_index = pos;
+            }
+            else if (view_mode != VIEW_GRID && current_name[0])
+            {
+                set_view_mode(VIEW_SINGLE); // 正在看的图片被删了，显示同位置的下一张
+                return;
+            }
+            grid_page_start = -1; // 格子内容可能整体移动
+            if (view_mode == VIEW_GRID)
+                show_grid();
+            else if (view_mode == VIEW_SINGLE)
+                lv_label_set_text_fmt(label_info, "[%d/%d] %s", current_index + 1, (int)media_index_count(idx), current_name);
+            break;
+        }
+        case MEDIA_EVENT_SCAN_DONE:
+            printf("App Image: Found %u images.\n", media_index_count(idx));
+            if (media_index_count(idx) == 0)
+                lv_label_set_text(label_info, "No Images Found!");
+            break;
+    }
+}
+
+/**
+ * @brief 创建放大浏览的视口，tile 用一组 lv_img 拼接
+ */
+static void create_zoom_view(void)
+{
+    zoom_cont = lv_obj_create(main_cont);
+    lv_obj_set_size(zoom_cont, LV_PCT(100), LV_PCT(100));
+    lv_obj_center(zoom_cont);
+    lv_obj_set_style_bg_color(zoom_cont, lv_color_black(), 0);
+    lv_obj_set_style_border_width(zoom_cont, 0, 0);
+    lv_obj_set_style_radius(zoom_cont, 0, 0);
+    lv_obj_set_style_pad_all(zoom_cont, 0, 0);
+    lv_obj_clear_flag(zoom_cont, LV_OBJ_FLAG_SCROLLABLE | LV_OBJ_FLAG_CLICK_FOCUSABLE);
+    lv_obj_add_flag(zoom_cont, LV_OBJ_FLAG_HIDDEN);
+    lv_obj_move_background(zoom_cont); // 信息栏显示在上面
+
+    for (int i = 0; i < ZOOM_TILE_OBJS; i++)
+    {
+        zoom_objs[i] = lv_img_create(zoom_cont);
+        lv_obj_add_flag(zoom_objs[i], LV_OBJ_FLAG_HIDDEN);
+    }
+}
+
+static void zoom_view_size(int32_t *vw, int32_t *vh)
+{
+    *vw = lv_obj_get_content_width(zoom_cont);
+    *vh = lv_obj_get_content_height(zoom_cont);
+}
+
+/**
+ * @brief 请求以 (x, y) 为左上角的视口覆盖的 tile
+ */
+static void zoom_request_view(int32_t x, int32_t y, bg_prio_t prio)
+{
+    int32_t vw, vh;
+    uint32_t lw, lh;
+    zoom_view_size(&vw, &vh);
+    img_tiles_level_size(zoom_tiles, zoom_level, &lw, &lh);
+
+    uint32_t c0 = x / TILE_SIZE;
+    uint32_t c1 = (LV_MIN((uint32_t)(x + vw), lw) - 1) / TILE_SIZE;
+    uint32_t r0 = y / TILE_SIZE;
+    uint32_t r1 = (LV_MIN((uint32_t)(y + vh), lh) - 1) / TILE_SIZE;
+    for (uint32_t r = r0; r <= r1; r++)
+        img_tiles_request(zoom_tiles, zoom_level, r, c0, c1, prio);
+}
+
+/**
+ * @brief 计算按行扫描平移一步后的位置
+ * 每步半屏，到行尾后回到下一行开头，到最后一屏后回到左上角；dir < 0 反向
+ */
+static void zoom_next_pos(int dir, int32_t *x, int32_t *y)
+{
+    int32_t vw, vh;
+    uint32_t lw, lh;
+    zoom_view_size(&vw, &vh);
+    img_tiles_level_size(zoom_tiles, zoom_level, &lw, &lh);
+
+    int32_t max_x = (int32_t)lw > vw ? (int32_t)lw - vw : 0;
+    int32_t max_y = (int32_t)lh > vh ? (int32_t)lh - vh : 0;
+    int32_t nx    = zoom_x;
+    int32_t ny    = zoom_y;
+
+    if (dir > 0)
+    {
+        if (nx < max_x)
+        {
+            nx = LV_MIN(nx + vw / 2, max_x);
+        }
+        else
+        {
+            nx = 0;
+            ny = (ny < max_y) ? LV_MIN(ny + vh / 2, max_y) : 0;
+        }
+    }
+    else
+    {
+        if (nx > 0)
+        {
+            nx = LV_MAX(nx - vw / 2, 0);
+        }
+        else
+        {
+            nx = max_x;
+            ny = (ny > 0) ? LV_MAX(ny - vh / 2, 0) : max_y;
+        }
+    }
+
+    *x = nx;
+    *y = ny;
+}
+
+/**
+ * @brief 显示当前视口: 已缓存的 tile 直接拼接，缺失的提交解码，再预取下一步要用的 tile
+ */
+static void zoom_render(void)
+{
+    int32_t vw, vh;
+    uint32_t lw, lh;
+    zoom_view_size(&vw, &vh);
+    img_tiles_level_size(zoom_tiles, zoom_level, &lw, &lh);
+
+    zoom_request_view(zoom_x, zoom_y, BG_PRIO_HIGH);
+
+    // 图比视口小的方向居中
+    int32_t ofs_x = ((int32_t)lw < vw) ? (vw - (int32_t)lw) / 2 : -zoom_x;
+    int32_t ofs_y = ((int32_t)lh < vh) ? (vh - (int32_t)lh) / 2 : -zoom_y;
+
+    uint32_t c0 = zoom_x / TILE_SIZE;
+    uint32_t c1 = (LV_MIN((uint32_t)(zoom_x + vw), lw) - 1) / TILE_SIZE;
+    uint32_t r0 = zoom_y / TILE_SIZE;
+    uint32_t r1 = (LV_MIN((uint32_t)(zoom_y + vh), lh) - 1) / TILE_SIZE;
+
+    int n = 0;
+    for (uint32_t r = r0; r <= r1; r++)
+    {
+        for (uint32_t c = c0; c <= c1 && n < ZOOM_TILE_OBJS; c++)
+        {
+            const lv_img_dsc_t *dsc = img_tiles_lookup(zoom_tiles, zoom_level, c, r);
+            if (dsc == NULL)
+                continue; // 还在解码，先露出黑色背景
+
+            lv_obj_t *obj = zoom_objs[n++];
+            lv_img_set_src(obj, dsc);
+            lv_obj_set_pos(obj, ofs_x + (int32_t)(c * TILE_SIZE), ofs_y + (int32_t)(r * TILE_SIZE));
+            lv_obj_clear_flag(obj, LV_OBJ_FLAG_HIDDEN);
+        }
+    }
+    for (; n < ZOOM_TILE_OBJS; n++)
+        lv_obj_add_flag(zoom_objs[n], LV_OBJ_FLAG_HIDDEN);
+
+    // 预取下一步平移会看到的 tile (内存紧张时不预取)
+    if (mem_budget_pressure() == MEM_PRESSURE_NONE)
+    {
+        int32_t nx, ny;
+        zoom_next_pos(zoom_dir, &nx, &ny);
+        zoom_request_view(nx, ny, BG_PRIO_LOW);
+    }
+
+    lv_label_set_text_fmt(label_info, "x%d  %s", 1 << (zoom_fit_level - zoom_level), current_name);
+}
+
+/**
+ * @brief tile 解码完成 (UI 线程)
+ */
+static void zoom_tiles_ready_cb(void *user_data)
+{
+    (void)user_data;
+    if (main_cont && view_mode == VIEW_ZOOM)
+        zoom_render();
+}
+
+/**
+ * @brief 切换到 level，保持视口中心不变
+ */
+static void zoom_set_level(int level)
+{
+    int32_t vw, vh;
+    uint32_t lw, lh;
+    zoom_view_size(&vw, &vh);
+    img_tiles_level_size(zoom_tiles, zoom_level, &lw, &lh);
+
+    // 当前中心点, 换算到新 level
+    int64_t cx = zoom_x + LV_MIN(vw, (int32_t)lw) / 2;
+    int64_t cy = zoom_y + LV_MIN(vh, (int32_t)lh) / 2;
+    cx         = (level < zoom_level) ? cx << (zoom_level - level) : cx >> (level - zoom_level);
+    cy         = (level < zoom_level) ? cy << (zoom_level - level) : cy >> (level - zoom_level);
+
+    zoom_level = level;
+    img_tiles_level_size(zoom_tiles, zoom_level, &lw, &lh);
+    zoom_x = (int32_t)LV_CLAMP(0, cx - vw / 2, (int64_t)LV_MAX((int32_t)lw - vw, 0));
+    zoom_y = (int32_t)LV_CLAMP(0, cy - vh / 2, (int64_t)LV_MAX((int32_t)lh - vh, 0));
+}
+
+/**
+ * @brief 打开当前图片的 tile 源，从比整图适配大一级开始
+ */
+static bool zoom_enter(void)
+{
+    char *path = make_full_path(current_name);
+    zoom_tiles = path ? img_tiles_open(path, zoom_tiles_ready_cb, NULL) : NULL;
+    free(path);
+    if (zoom_tiles == NULL)
+        return false;
+
+    int32_t vw, vh;
+    zoom_view_size(&vw, &vh);
+    zoom_fit_level = img_tiles_fit_level(zoom_tiles, vw, vh);
+    if (zoom_fit_level == 0)
+    {
+        // 原图已经能完整显示，不需要放大
+        img_tiles_close(zoom_tiles);
+        zoom_tiles = NULL;
+        return false;
+    }
+
+    zoom_level = zoom_fit_level;
+    zoom_x     = 0;
+    zoom_y     = 0;
+    zoom_dir   = 1;
+    zoom_set_level(zoom_fit_level - 1);
+    return true;
+}
+
+static void zoom_leave(void)
+{
+    img_tiles_close(zoom_tiles); // 释放 tile 缓存
+    zoom_tiles = NULL;
+    for (int i = 0; i < ZOOM_TILE_OBJS; i++)
+    {
+        lv_img_set_src(zoom_objs[i], NULL);
+        lv_obj_add_flag(zoom_objs[i], LV_OBJ_FLAG_HIDDEN);
+    }
+}
+
+/**
+ * @brief 内存预算: 放大浏览的 tile 缓存 (只在放大视图中存在)
+ */
+static size_t zoom_tiles_mem_usage(void)
+{
+    return img_tiles_mem_usage(zoom_tiles);
+}
+
+static void zoom_tiles_trim(size_t target)
+{
+    if (zoom_tiles == NULL)
+        return;
+    img_tiles_trim(zoom_tiles, target);
+    // 屏幕上的 tile 可能刚被释放: 马上重新拼一次，缺的重新解码
+    if (main_cont && view_mode == VIEW_ZOOM)
+        zoom_render();
+}
+
+/**
+ * @brief 在网格视图、单图视图和放大浏览之间切换
+ */
+static void set_view_mode(view_mode_t mode)
+{
+    if (view_mode == VIEW_ZOOM && mode != VIEW_ZOOM)
+        zoom_leave();
+
+    if (mode != VIEW_SINGLE)
+    {
+        slide_stop();
+        close_gif();
+    }
+
+    view_mode = mode;
+    lv_obj_add_flag(grid_cont, LV_OBJ_FLAG_HIDDEN);
+    lv_obj_add_flag(img_obj, LV_OBJ_FLAG_HIDDEN);
+    lv_obj_add_flag(zoom_cont, LV_OBJ_FLAG_HIDDEN);
+
+    if (mode == VIEW_GRID)
+    {
+        lv_obj_clear_flag(grid_cont, LV_OBJ_FLAG_HIDDEN);
+        set_single_src(LV_SYMBOL_IMAGE); // 释放大图
+        show_grid();
+    }
+    else if (mode == VIEW_SINGLE)
+    {
+        lv_obj_clear_flag(img_obj, LV_OBJ_FLAG_HIDDEN);
+        load_current_image();
+    }
+    else
+    {
+        lv_obj_clear_flag(zoom_cont, LV_OBJ_FLAG_HIDDEN);
+        set_single_src(LV_SYMBOL_IMAGE);
+        zoom_render();
+    }
+}
+
+/**
+ * @brief 淡化结束 (或中途停止)：换成缓存里的整图，释放淡化画布
+ */
+static void slide_fade_end(bool advance)
+{
+    if (advance)
+        current_index++;
+    load_current_image(); // 先换掉 img_obj 的图源，再释放画布
+    img_fade_destroy(slide_fade);
+    slide_fade  = NULL;
+    slide_start = lv_tick_get();
+    lv_timer_set_period(slide_timer, SLIDESHOW_TICK_MS);
+}
+
+/**
+ * @brief 停留时间到: 下一张已解码好就开始淡化，还在解码就等下一个节拍
+ */
+static void slide_advance(void)
+{
+    int file_count = media_index_count(img_index);
+    int next       = (current_index + 1) % file_count;
+
+    uint16_t w, h;
+    single_view_size(&w, &h);
+    char *cur_path  = make_full_path(current_name);
+    char *next_path = make_full_path(media_index_name(img_index, next));
+    const lv_img_dsc_t *from = (cur_path && gif_obj == NULL) ? img_cache_get(cur_path, IMG_ROT_0) : NULL;
+    const lv_img_dsc_t *to   = next_path ? img_cache_get(next_path, IMG_ROT_0) : NULL;
+
+    // 下一张还在后台解码 (很大的图) 就等下一个节拍
+    bool waiting = false;
+    if (to == NULL && next_path && media_index_type(img_index, next) != MEDIA_TYPE_GIF)
+        waiting = img_cache_request(next_path, IMG_ROT_0, w, h, BG_PRIO_LOW) == 0;
+
+    if (from && to && slide_fade_ms > 0)
+        slide_fade = img_fade_create(from, to, w, h);
+    free(cur_path);
+    free(next_path);
+
+    if (slide_fade)
+    {
+        // 两张图都已预先贴到画布上，之后每帧只做一次插值
+        slide_start = lv_tick_get();
+        set_single_src(img_fade_step(slide_fade, 0));
+        lv_timer_set_period(slide_timer, LV_DISP_DEF_REFR_PERIOD);
+    }
+    else if (!waiting)
+    {
+        // 动图、LVGL 解码的格式或解码失败的图片直接切换
+        current_index = next;
+        load_current_image();
+        slide_start = lv_tick_get();
+    }
+}
+
+/**
+ * @brief 幻灯片节拍: 空闲检测、停留计时和淡化出帧
+ */
+static void slide_timer_cb(lv_timer_t *t)
+{
+    (void)t;
+    if (view_mode != VIEW_SINGLE || media_index_count(img_index) < 2)
+        return;
+
+    if (!slide_running)
+    {
+        if (slide_idle_ms > 0 && lv_disp_get_inactive_time(NULL) >= slide_idle_ms)
+            slide_begin();
+        return;
+    }
+
+    uint32_t elapsed = lv_tick_elaps(slide_start);
+    if (slide_fade)
+    {
+        if (elapsed >= slide_fade_ms)
+        {
+            slide_fade_end(true);
+        }
+        else
+        {
+            img_fade_step(slide_fade, (uint16_t)(elapsed * 256 / slide_fade_ms));
+            lv_obj_invalidate(img_obj);
+        }
+    }
+    else if (elapsed >= slide_dwell_ms)
+    {
+        slide_advance();
+    }
+}
+
+/**
+ * @brief 开始幻灯片: 从当前这张开始计时，旋转过的图片先转回原方向 (幻灯片按原方向淡化)
+ */
+static void slide_begin(void)
+{
+    if (slide_running || view_mode != VIEW_SINGLE || media_index_count(img_index) < 2)
+        return;
+
+    if (view_rot != IMG_ROT_0)
+    {
+        view_rot = IMG_ROT_0;
+        load_current_image();
+    }
+    slide_running = true;
+    slide_start   = lv_tick_get();
+    printf("App Image: slideshow started (dwell %u ms, fade %u ms)\n", slide_dwell_ms, slide_fade_ms);
+}
+
+/**
+ * @brief 停止幻灯片 (淡化中途停止时回到淡化前的那张)
+ */
+static void slide_stop(void)
+{
+    if (!slide_running)
+        return;
+
+    slide_running = false;
+    if (slide_fade)
+        slide_fade_end(false);
+    printf("App Image: slideshow stopped\n");
 }
 
 /**
@@ -99,9 +889,19 @@ static void close_app(void)
 {
     if (main_cont)
     {
+        slide_stop();
+        lv_timer_del(slide_timer);
+        slide_timer = NULL;
+        media_index_destroy(img_index);
+        img_index = NULL;
+        img_tiles_close(zoom_tiles);
+        zoom_tiles = NULL;
         lv_obj_del(main_cont);
         main_cont = NULL;
         img_obj   = NULL;
+        gif_obj   = NULL;
+        grid_cont = NULL;
+        zoom_cont = NULL;
         // 这里可以添加逻辑返回主菜单
         printf("App Image Closed.\n");
     }
@@ -119,24 +919,101 @@ static void app_img_event_cb(lv_event_t *e)
         uint32_t key = lv_indev_get_key(lv_indev_get_act());
 
         printf("Key pressed: %d\n", key);
+        if (slide_running)
+        {
+            slide_stop(); // 幻灯片中的按键只用来停止
+            return;
+        }
+        if (key == LV_KEY_HOME && view_mode != VIEW_ZOOM)
+        {
+            // 网格视图中先打开选中的图片
+            if (view_mode == VIEW_GRID && media_index_count(img_index) > 0)
+            {
+                view_rot = IMG_ROT_0;
+                set_view_mode(VIEW_SINGLE);
+            }
+            slide_begin();
+            return;
+        }
+
         // --- 核心交互逻辑 ---
+        if (view_mode == VIEW_ZOOM)
+        {
+            switch (key)
+            {
+                case LV_KEY_RIGHT: // 向前平移
+                case LV_KEY_LEFT:  // 向后平移
+                    zoom_dir = (key == LV_KEY_RIGHT) ? 1 : -1;
+                    zoom_next_pos(zoom_dir, &zoom_x, &zoom_y);
+                    zoom_render();
+                    break;
+                case LV_KEY_ENTER: // 再放大一级，已到原始分辨率则回到整图
+                    if (zoom_level > 0)
+                    {
+                        zoom_set_level(zoom_level - 1);
+                        zoom_render();
+                    }
+                    else
+                    {
+                        set_view_mode(VIEW_SINGLE);
+                    }
+                    break;
+                case LV_KEY_ESC:
+                    set_view_mode(VIEW_SINGLE);
+                    break;
+            }
+            return;
+        }
+
         switch (key)
         {
             case LV_KEY_RIGHT: // 对应 Key 1 短按
             case LV_KEY_NEXT:  // 保留兼容
                 current_index++;
-                load_current_image();
+                view_rot = IMG_ROT_0;
+                if (view_mode == VIEW_GRID)
+                    show_grid();
+                else
+                    load_current_image();
                 break;
             case LV_KEY_LEFT: // 对应 Key 1 短按
             case LV_KEY_PREV: // 保留兼容
                 current_index--;
-                load_current_image();
+                view_rot = IMG_ROT_0;
+                if (view_mode == VIEW_GRID)
+                    show_grid();
+                else
+                    load_current_image();
                 break;
             case LV_KEY_ENTER: // 物理 Key 2 短按
-                // 可选：切换全屏或旋转图片
+                if (view_mode == VIEW_GRID && media_index_count(img_index) > 0)
+                {
+                    view_rot = IMG_ROT_0;
+                    set_view_mode(VIEW_SINGLE); // 打开选中的图片
+                }
+                else if (view_mode == VIEW_SINGLE && gif_obj == NULL) // 动图不支持旋转和放大
+                {
+                    // 单图模式: 每按一次顺时针转 90 度，转满一圈后进入放大浏览
+                    if (view_rot != IMG_ROT_270)
+                    {
+                        view_rot = (img_rot_t)(view_rot + 1);
+                        load_current_image();
+                    }
+                    else
+                    {
+                        view_rot = IMG_ROT_0;
+                        if (zoom_enter())
+                            set_view_mode(VIEW_ZOOM);
+                        else
+                            load_current_image();
+                    }
+                }
                 break;
             case LV_KEY_ESC: // 物理 Key 2 长按
-                close_app();
+                if (view_mode == VIEW_SINGLE)
+                    set_view_mode(VIEW_GRID); // 返回网格
+                else
+                    close_app();
                 break;
         }
     }
@@ -147,8 +1024,13 @@ static void app_img_event_cb(lv_event_t *e)
  */
 void app_image_init(void)
 {
-    // 1. 扫描文件
-    scan_image_dir();
+    // 1. 打开缩略图缓存和头信息索引
+    img_thumb_open(THUMB_PACK_PATH);
+    img_meta_open(META_INDEX_PATH);
+    img_cache_set_ready_cb(img_ready_cb, NULL);
+    img_cache_set_preview_cb(img_preview_cb, NULL);
+    mem_budget_register("img_cache", MEM_PRIO_CACHE, img_cache_mem_usage, img_cache_trim);
+    mem_budget_register("img_tiles", MEM_PRIO_CACHE, zoom_tiles_mem_usage, zoom_tiles_trim);
 
     // 2. 创建主容器 (充当窗口)
     main_cont = lv_obj_create(lv_scr_act());
@@ -177,7 +1059,22 @@ void app_image_init(void)
     lv_obj_set_style_text_color(label_info, lv_color_white(), 0);
     lv_label_set_text(label_info, "Loading...");
 
-    // 6. 加载第一张图片
-    current_index = 0;
-    load_current_image();
+    // 6. 缩略图网格 (默认视图) 和放大浏览视口
+    create_grid();
+    create_zoom_view();
+    const char *s;
+    if ((s = getenv("IMAGE_SLIDESHOW_IDLE_MS")) != NULL)
+        slide_idle_ms = (uint32_t)strtoul(s, NULL, 10);
+    if ((s = getenv("IMAGE_SLIDESHOW_DWELL_MS")) != NULL)
+        slide_dwell_ms = (uint32_t)strtoul(s, NULL, 10);
+    if ((s = getenv("IMAGE_SLIDESHOW_FADE_MS")) != NULL)
+        slide_fade_ms = (uint32_t)strtoul(s, NULL, 10);
+    slide_timer = lv_timer_create(slide_timer_cb, SLIDESHOW_TICK_MS, NULL);
+
+    current_index   = 0;
+    current_name[0] = '\0';
+    set_view_mode(VIEW_GRID);
+
+    // 7. 后台扫描目录，结果分批到达后刷新网格并生成缩略图 (已缓存的会直接跳过)
+    img_index = media_index_create(IMG_DIR_PATH, MEDIA_MASK_IMAGE, img_index_cb, NULL);
 }
\ No newline at end of file
@@ -1,29 +1,70 @@
 #define MINIAUDIO_IMPLEMENTATION
 #include "miniaudio.h"
 #include "app_music.h"
+#include "audio_eq.h"
+#include "audio_out.h"
+#include "audio_tap.h"
+#include "bg_worker.h"
 #include "lvgl.h"
+#include "media_index.h"
+#include "mem_budget.h"
+#include "mem_tag.h"
+#include "music_cover.h"
+#include "music_lib.h"
+#include "music_loudness.h"
+#include "music_track.h"
+#include "music_voice.h"
+#include "playlist.h"
+#include "spectrum.h"
+#include <math.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <dirent.h>
+#include <time.h>
 #include <unistd.h>
 
 // --- 配置 ---
-#define MUSIC_DIR_PATH "/root/multimedia_app"
-#define MAX_FILES      50
-#define MAX_FNAME_LEN  256
+#define MUSIC_DIR_PATH   "/root/multimedia_app"
+#define MAX_FNAME_LEN    256
+#define MUSIC_LIB_PATH   MUSIC_DIR_PATH "/.music.idx"   // 歌曲信息索引 (标签、时长)
+#define MUSIC_COVER_PATH MUSIC_DIR_PATH "/.covers.pack" // 缩放好的 RGB565 封面
+#define MUSIC_QUEUE_PATH MUSIC_DIR_PATH "/.queue.m3u8"  // 播放队列和模式 (可以换成自己的 M3U 列表)
+#define BAR_COUNT        24 // 频谱条数
+#define BAR_GAP          2  // 条之间的间隔 (像素)
+#define ARM_AHEAD_MS     1500 // 交叉淡化提前这么久安排下一首 (进度定时器 500ms 一次，留够余量)
 
 // --- 全局变量：音频引擎 ---
 static ma_engine engine;
-static ma_sound sound;
 static bool is_engine_inited = false;
-static bool is_sound_loaded  = false;
+static bool is_paused        = false; // 暂停时整个引擎停下，引擎时钟和安排好的开始/停止时间一起冻结
 static float current_volume  = 0.8f; // 0.0 ~ 1.0
-
-// --- 全局变量：文件列表 ---
-static char file_list[MAX_FILES][MAX_FNAME_LEN];
-static int file_count       = 0;
-static int current_file_idx = 0;
+static audio_tap_t *tap      = NULL; // 所有声音先经过它再到输出端点，给频谱提供样本
+static ma_uint32 sample_rate = 0;    // 引擎 (歌曲) 的采样率
+static ma_uint32 channels    = 0;
+
+// --- 全局变量：声部和切歌 ---
+// 每个声部是一个预先建好的 ma_sound，切歌时不分配内存
+// 不淡化时下一首在后台提前打开并接在当前声部的链上，音频线程读完当前这首后在同一次回调里接着读下一首，中间没有空白
+// 交叉淡化时下一首放到另一个声部，按引擎时钟安排在当前这首结束前 crossfade_ms 开始淡入，当前这首同时淡出
+// (两首都至少有两倍淡化时长时才淡化，否则照常无缝衔接)
+static music_voice_t *cur_voice  = NULL; // 正在播放的
+static music_voice_t *next_voice = NULL; // 已安排好开始时间、还没开始的下一首
+static music_voice_t *old_voice  = NULL; // 正在淡出的上一首，结束后放回池中
+static music_track_t *next_track = NULL; // 预加载好、还没交给声部的下一首 (等到快结束时安排交叉淡化)
+static uint32_t next_id          = 0; // 下一首的歌曲 id，0 表示还没有下一首
+static int next_entry            = -1; // 下一首在队列中的条目号
+static char next_path[PLAYLIST_PATH_MAX];
+static uint32_t crossfade_ms     = 0; // 毫秒，0: 无缝衔接; 启动时读环境变量 MUSIC_CROSSFADE_MS
+static bool normalize            = true; // 按 ReplayGain 增益调整每首歌的音量; 启动时读环境变量 MUSIC_NORMALIZE=0 关闭
+static uint32_t play_gen         = 0; // 每次重新开始播放加一，丢弃过期的预加载
+static uint32_t track_seq        = 0; // 歌曲 id
+
+// --- 全局变量：播放队列 ---
+static media_index_t *music_index = NULL; // 后台扫描的歌曲目录
+static playlist_t *queue          = NULL; // 播放顺序 (随机、循环) 由它决定
+static bool queue_follows_dir     = true; // true: 队列就是扫描到的目录，目录变化时重建; false: 来自 M3U 列表
+static char current_path[PLAYLIST_PATH_MAX] = ""; // 正在播放的歌曲，队列重建后用来找回位置
 
 // --- 全局变量：UI ---
 static lv_obj_t *main_cont        = NULL;
@@ -31,13 +72,131 @@ static lv_obj_t *label_title      = NULL;
 static lv_obj_t *label_time       = NULL;
 static lv_obj_t *slider_progress  = NULL;
 static lv_obj_t *label_btn_icon   = NULL;
+static lv_obj_t *label_mode       = NULL; // 随机、循环模式
+static lv_obj_t *cover_img        = NULL; // 封面，没有时显示音符图标
+static lv_img_dsc_t cover_dsc;            // 指向 cover_pixels
+static lv_color_t cover_pixels[COVER_SIZE * COVER_SIZE]; // 从 pack 拷出来的封面，后台改写 pack 时不会被撕裂
 static lv_timer_t *progress_timer = NULL;
 
+// --- 全局变量：频谱 ---
+static lv_obj_t *spectrum_obj     = NULL;
+static lv_timer_t *spectrum_timer = NULL;
+static spectrum_t *spectrum       = NULL;
+static uint8_t bar_levels[BAR_COUNT]; // 当前显示的高度 0~255
+static float tap_samples[SPECTRUM_FFT_SIZE];
+
 // --- 声明 ---
-static void scan_music_files(void);
 static void app_music_event_cb(lv_event_t *e);
 static void progress_timer_cb(lv_timer_t *timer);
 static void close_app(void);
+static void play_current(void);
+static void preload_next(void);
+
+// miniaudio 的分配 (解码器、资源管理器、混音缓冲) 记到 audio 名下
+static void *audio_malloc(size_t size, void *user_data)
+{
+    (void)user_data;
+    return mem_tag_alloc(MEM_TAG_AUDIO, size);
+}
+
+static void *audio_realloc(void *p, size_t size, void *user_data)
+{
+    (void)user_data;
+    return mem_tag_realloc(MEM_TAG_AUDIO, p, size);
+}
+
+static void audio_free(void *p, void *user_data)
+{
+    (void)user_data;
+    mem_tag_free(p);
+}
+
+// 内存预算: 解码器、每首歌的环形缓冲和混音缓冲都记在 audio 名下，只统计不释放 (释放就断音)
+static size_t audio_mem_usage(void)
+{
+    mem_tag_stats_t st;
+    mem_tag_get_stats(MEM_TAG_AUDIO, &st);
+    return st.live;
+}
+
+// 停止所有声部并关闭上面的歌曲
+static void unload_sound(void)
+{
+    music_voice_release(next_voice); // 返回后音频线程不会再读这个声部上的数据
+    music_voice_release(old_voice);
+    music_voice_release(cur_voice);
+    music_track_close(next_track);
+    next_voice = NULL;
+    old_voice  = NULL;
+    cur_voice  = NULL;
+    next_track = NULL;
+    next_id    = 0;
+    next_entry = -1;
+    play_gen++;
+}
+
+// 音频线程 -> UI 线程的通知: 预分配的单生产者单消费者环形队列，音频线程只写一个槽位再唤醒 UI 线程
+// (bg_worker_post_ui 要分配节点、加锁，不能在音频线程中用)
+#define AUDIO_EVENT_RING 16 // 2 的幂; 每首歌只有一两个事件，UI 线程卡住时满了就丢掉新事件
+
+typedef enum
+{
+    AUDIO_EVENT_TRACK_START, // value: 歌曲 id
+    AUDIO_EVENT_VOICE_END    // value: 声部的序号
+} audio_event_type_t;
+
+typedef struct
+{
+    audio_event_type_t type;
+    uint32_t value;
+} audio_event_t;
+
+static audio_event_t audio_events[AUDIO_EVENT_RING];
+static uint32_t audio_event_head = 0; // 只由音频线程写
+static uint32_t audio_event_tail = 0; // 只由 UI 线程写
+
+static void audio_event_push(audio_event_type_t type, uint32_t value)
+{
+    uint32_t head = __atomic_load_n(&audio_event_head, __ATOMIC_RELAXED);
+    if (head - __atomic_load_n(&audio_event_tail, __ATOMIC_ACQUIRE) >= AUDIO_EVENT_RING)
+        return;
+    audio_events[head % AUDIO_EVENT_RING].type  = type;
+    audio_events[head % AUDIO_EVENT_RING].value = value;
+    __atomic_store_n(&audio_event_head, head + 1, __ATOMIC_RELEASE);
+    bg_worker_wake_ui();
+}
+
+// 链上的某一首开始播放 (音频线程)
+static void on_track_start(uint32_t id, void *user_data)
+{
+    (void)user_data;
+    audio_event_push(AUDIO_EVENT_TRACK_START, id);
+}
+
+// 声部的链播放完 (音频线程): 下一首没来得及接上，或者根本没有下一首
+static void on_voice_end(uint32_t seq, void *user_data)
+{
+    (void)user_data;
+    audio_event_push(AUDIO_EVENT_VOICE_END, seq);
+}
+
+// 取走音频线程的通知 (UI 线程，bg_worker 被唤醒时调用)
+static void track_started_cb(uint32_t id);
+static void sound_end_ui_cb(uint32_t seq);
+static void audio_event_drain(void *user_data)
+{
+    (void)user_data;
+    uint32_t tail = audio_event_tail;
+    while (tail != __atomic_load_n(&audio_event_head, __ATOMIC_ACQUIRE))
+    {
+        audio_event_t ev = audio_events[tail % AUDIO_EVENT_RING];
+        __atomic_store_n(&audio_event_tail, ++tail, __ATOMIC_RELEASE);
+        if (ev.type == AUDIO_EVENT_TRACK_START)
+            track_started_cb(ev.value);
+        else
+            sound_end_ui_cb(ev.value);
+    }
+}
 
 // 音频后端实现
 void app_music_init_backend(void)
@@ -46,99 +205,174 @@ void app_music_init_backend(void)
         return;
 
     ma_result result;
-    // 初始化音频引擎 (自动连接 ALSA/PulseAudio)
-    result = ma_engine_init(NULL, &engine);
+    ma_engine_config config              = ma_engine_config_init();
+    config.allocationCallbacks.onMalloc  = audio_malloc;
+    config.allocationCallbacks.onRealloc = audio_realloc;
+    config.allocationCallbacks.onFree    = audio_free;
+
+    // 输出设备自己打开: 周期、格式可以用环境变量调，回调耗时和 xrun 有统计 (kill -USR1 打印)
+    audio_out_config_t out_cfg = audio_out_config_default();
+    audio_out_config_from_env(&out_cfg);
+    if (audio_out_open(&out_cfg, &engine, &config.allocationCallbacks) != 0)
+        return;
+    // 解码放到单独的线程提前几秒，UI 或后台线程长时间占住 CPU、读卡卡顿时不会断音
+    music_decoder_config_t dec_cfg = music_decoder_config_default();
+    music_decoder_config_from_env(&dec_cfg);
+    if (music_decoder_start(&dec_cfg) != 0)
+        printf("Miniaudio: Decoding in the audio callback.\n");
+    config.pDevice = audio_out_device();
+
+    result = ma_engine_init(&config, &engine);
     if (result != MA_SUCCESS)
     {
         printf("Miniaudio: Failed to initialize audio engine.\n");
+        music_decoder_stop();
+        audio_out_close();
         return;
     }
 
     // 设置音量
     ma_engine_set_volume(&engine, current_volume);
+    sample_rate = ma_engine_get_sample_rate(&engine);
+    channels    = ma_engine_get_channels(&engine);
+    tap         = audio_tap_create(&engine);
+    // 声部 -> 均衡器 -> 频谱监听 -> 输出端点; 均衡器建不起来时声部直接接到监听节点
+    ma_node *out = tap ? audio_tap_node(tap) : ma_engine_get_endpoint(&engine);
+    if (audio_eq_init(&engine, out) == 0)
+        out = audio_eq_node();
+    const char *s = getenv("MUSIC_EQ");
+    if (s != NULL && audio_eq_set_preset(s) != 0)
+        printf("Miniaudio: Unknown MUSIC_EQ=%s\n", s);
+    // 声部一次建好，之后切歌只是换上面的歌曲
+    if (music_voice_pool_init(&engine, out, on_voice_end, NULL) != 0)
+    {
+        audio_eq_uninit();
+        audio_tap_destroy(tap);
+        tap = NULL;
+        ma_engine_uninit(&engine);
+        music_decoder_stop();
+        audio_out_close();
+        return;
+    }
+    bg_worker_add_ui_poll(audio_event_drain, NULL);
+    music_track_set_start_cb(on_track_start, NULL);
+    mem_budget_register("audio", MEM_PRIO_CORE, audio_mem_usage, NULL);
+    if ((s = getenv("MUSIC_CROSSFADE_MS")) != NULL)
+        crossfade_ms = (uint32_t)strtoul(s, NULL, 10);
+    if ((s = getenv("MUSIC_NORMALIZE")) != NULL)
+        normalize = atoi(s) != 0;
     is_engine_inited = true;
     printf("Miniaudio: Engine initialized.\n");
 }
 
+/**
+ * @brief 歌曲的响度归一化增益 (线性): 索引里有 ReplayGain 增益 (标签或分析结果) 时用它，提升后峰值不超过 0dBFS
+ * (标签里只有增益、没有峰值时不限制)
+ * 还没有时返回 1，并排队在后台分析，下次播放这首时生效 (任意线程)
+ */
+static float track_gain(const char *path)
+{
+    music_info_t info;
+    if (!normalize)
+        return 1.0f;
+    if (!music_lib_lookup(path, &info) || info.gain_source == MUSIC_GAIN_NONE)
+    {
+        music_loudness_request(path);
+        return 1.0f;
+    }
+    float db = info.gain_cdb / 100.0f;
+    if (info.peak_cdb != MUSIC_PEAK_UNKNOWN && db > -info.peak_cdb / 100.0f)
+        db = -info.peak_cdb / 100.0f;
+    return powf(10.0f, db / 20.0f);
+}
+
 void music_play_file(const char *path)
 {
     if (!is_engine_inited)
         return;
 
     // 如果已经在播放，先卸载上一首
-    if (is_sound_loaded)
+    unload_sound();
+
+    // 暂停中换歌: 引擎重新跑起来
+    if (is_paused)
     {
-        ma_sound_uninit(&sound);
-        is_sound_loaded = false;
+        ma_engine_start(&engine);
+        is_paused = false;
     }
 
-    // 从文件加载声音 (流式播放，不一次性解压到内存)
-    // MA_SOUND_FLAG_STREAM: 对长音乐必须用流模式，否则内存爆炸
-    ma_result result = ma_sound_init_from_file(&engine, path, MA_SOUND_FLAG_STREAM, NULL, NULL, &sound);
-
-    if (result != MA_SUCCESS)
+    // 流式解码 (不一次性解压到内存)，输出直接转换成引擎的格式，链上的歌曲可以无缝衔接
+    music_track_t *t = music_track_open(path, ++track_seq, channels, sample_rate, &engine.allocationCallbacks);
+    if (t == NULL)
     {
         printf("Miniaudio: Failed to load file: %s\n", path);
         return;
     }
+    music_track_set_gain(t, track_gain(path));
 
-    is_sound_loaded = true;
-    ma_sound_start(&sound); // 立即播放
+    cur_voice = music_voice_acquire(); // 上面全部放回了池中，一定能取到
+    if (cur_voice == NULL)
+    {
+        music_track_close(t);
+        return;
+    }
+    music_voice_start(cur_voice, t, 0, 0); // 立即播放
     printf("Miniaudio: Playing %s\n", path);
 }
 
 void music_pause(void)
 {
-    if (is_sound_loaded)
-        ma_sound_stop(&sound);
+    if (cur_voice == NULL || is_paused)
+        return;
+    ma_engine_stop(&engine);
+    is_paused = true;
 }
 
 void music_resume(void)
 {
-    if (is_sound_loaded)
-        ma_sound_start(&sound);
+    if (cur_voice == NULL || !is_paused)
+        return;
+    ma_engine_start(&engine);
+    is_paused = false;
 }
 
 void music_toggle(void)
 {
-    if (!is_sound_loaded)
+    if (cur_voice == NULL)
         return;
 
-    if (ma_sound_is_playing(&sound))
+    if (is_paused)
     {
-        music_pause();
+        music_resume();
     }
     else
     {
-        music_resume();
+        music_pause();
     }
 }
 
 music_state_t music_get_state(void)
 {
-    if (!is_sound_loaded)
+    if (cur_voice == NULL)
         return MUSIC_STATE_STOPPED;
-    if (ma_sound_is_playing(&sound))
-        return MUSIC_STATE_PLAYING;
-    return MUSIC_STATE_PAUSED;
+    if (is_paused)
+        return MUSIC_STATE_PAUSED;
+    return MUSIC_STATE_PLAYING;
 }
 
+// 时间按正在播放的那一首计算 (声部的游标是整条链的，不能直接用)
 uint32_t music_get_total_time(void)
 {
-    if (!is_sound_loaded)
+    if (cur_voice == NULL || music_voice_track(cur_voice) == NULL)
         return 0;
-    float len_seconds;
-    ma_sound_get_length_in_seconds(&sound, &len_seconds);
-    return (uint32_t)len_seconds;
+    return (uint32_t)(music_track_length(music_voice_track(cur_voice)) / sample_rate);
 }
 
 uint32_t music_get_current_time(void)
 {
-    if (!is_sound_loaded)
+    if (cur_voice == NULL || music_voice_track(cur_voice) == NULL)
         return 0;
-    float cursor_seconds;
-    ma_sound_get_cursor_in_seconds(&sound, &cursor_seconds);
-    return (uint32_t)cursor_seconds;
+    return (uint32_t)(music_track_cursor(music_voice_track(cur_voice)) / sample_rate);
 }
 
 int music_get_progress_permille(void)
@@ -152,76 +386,320 @@ int music_get_progress_permille(void)
 
 void app_music_deinit(void)
 {
-    if (is_sound_loaded)
-    {
-        ma_sound_uninit(&sound);
-        is_sound_loaded = false;
-    }
+    unload_sound();
     if (is_engine_inited)
     {
+        music_track_set_start_cb(NULL, NULL);
+        mem_budget_unregister("audio");
+        music_voice_pool_uninit();
+        bg_worker_remove_ui_poll(audio_event_drain, NULL);
+        audio_event_tail = __atomic_load_n(&audio_event_head, __ATOMIC_ACQUIRE); // 丢掉没取走的通知
+        audio_eq_uninit();
+        audio_tap_destroy(tap);
+        tap = NULL;
         ma_engine_uninit(&engine);
+        is_paused = false;
+        audio_out_close();
+        music_decoder_stop();
         is_engine_inited = false;
     }
 }
 
 // UI 逻辑实现
 
-static void scan_music_files(void)
+/**
+ * @brief 标题: 有标签时显示 "艺术家 - 标题"，否则显示文件名
+ */
+static void set_title_text(const char *path, const music_info_t *info)
 {
-    DIR *d;
-    struct dirent *dir;
-    file_count = 0;
+    if (info && info->title[0] && info->artist[0])
+        lv_label_set_text_fmt(label_title, "%s - %s", info->artist, info->title);
+    else if (info && info->title[0])
+        lv_label_set_text(label_title, info->title);
+    else
+        lv_label_set_text(label_title, strrchr(path, '/') ? strrchr(path, '/') + 1 : path);
+}
 
-    d = opendir(MUSIC_DIR_PATH);
-    if (d)
+static void title_ready_cb(const char *path, const music_info_t *info, void *user_data)
+{
+    (void)user_data;
+    if (main_cont && info && strcmp(path, current_path) == 0)
+        set_title_text(path, info);
+}
+
+// 显示 current_path 的标题，索引里还没有时先显示文件名，后台解析完再更新
+static void show_title(void)
+{
+    music_info_t info;
+    if (music_lib_lookup(current_path, &info))
     {
-        while ((dir = readdir(d)) != NULL)
-        {
-            if (dir->d_type == DT_REG)
-            { // 只看普通文件
-                // 简单判断后缀
-                if (strstr(dir->d_name, ".mp3") || strstr(dir->d_name, ".wav"))
-                {
-                    if (file_count < MAX_FILES)
-                    {
-                        snprintf(file_list[file_count], MAX_FNAME_LEN, "%s", dir->d_name);
-                        file_count++;
-                    }
-                }
-            }
-        }
-        closedir(d);
+        set_title_text(current_path, &info);
+        return;
     }
-    printf("Music App: Found %d songs.\n", file_count);
+    set_title_text(current_path, NULL);
+    music_lib_request(current_path, title_ready_cb, NULL);
+}
+
+static void show_cover(bool request);
+static void cover_ready_cb(const char *path, bool ok, void *user_data)
+{
+    (void)user_data;
+    if (main_cont && ok && strcmp(path, current_path) == 0)
+        show_cover(false);
 }
 
-// 播放当前索引的歌曲
-static void play_current_index(void)
+// 显示 current_path 的封面: pack 里有就拷出来贴图，不用解码
+// 还没提取过时先显示图标，request 为 true 时在后台提取 (用户正在看，高优先级)
+static void show_cover(bool request)
 {
-    if (file_count == 0)
+    music_cover_state_t state = music_cover_lookup(current_path, &cover_dsc, cover_pixels);
+    if (state == MUSIC_COVER_READY)
+    {
+        lv_img_cache_invalidate_src(&cover_dsc);
+        lv_img_set_src(cover_img, &cover_dsc);
         return;
+    }
+    lv_img_set_src(cover_img, LV_SYMBOL_AUDIO);
+    if (state == MUSIC_COVER_MISS && request)
+        music_cover_request(current_path, BG_PRIO_HIGH, cover_ready_cb, NULL);
+}
 
-    // 循环播放逻辑
-    if (current_file_idx >= file_count)
-        current_file_idx = 0;
-    if (current_file_idx < 0)
-        current_file_idx = file_count - 1;
+// 随机、循环模式 (列表循环是默认模式，不显示)
+static void show_mode(void)
+{
+    playlist_repeat_t repeat = playlist_get_repeat(queue);
+    lv_label_set_text_fmt(label_mode, "%s %s", playlist_get_shuffle(queue) ? LV_SYMBOL_SHUFFLE : "",
+                          repeat == PLAYLIST_REPEAT_ONE ? LV_SYMBOL_LOOP "1" : repeat == PLAYLIST_REPEAT_OFF ? "1x" : "");
+}
 
-    char full_path[256];
-    snprintf(full_path, sizeof(full_path), "%s/%s", MUSIC_DIR_PATH, file_list[current_file_idx]);
+/**
+ * @brief 队列变化后找回 current_path: 优先用 hint 处的条目 (列表里有重复路径时不会跳到别的那一条)
+ * 找不到 (被删掉) 时保持原位置，下一曲自然接上
+ */
+static void locate_current(int hint)
+{
+    if (current_path[0] == '\0')
+        return;
+    const char *path = hint >= 0 ? playlist_path(queue, (uint32_t)hint) : NULL;
+    if (path == NULL || strcmp(path, current_path) != 0)
+        hint = playlist_find(queue, current_path);
+    if (hint >= 0)
+        playlist_jump(queue, (uint32_t)hint);
+}
+
+// 播放队列的当前条目
+static void play_current(void)
+{
+    int entry = playlist_current(queue);
+    if (entry < 0)
+        return;
+    snprintf(current_path, sizeof(current_path), "%s", playlist_path(queue, (uint32_t)entry));
 
     // 调用后端播放
-    music_play_file(full_path);
+    music_play_file(current_path);
 
-    // 更新 UI 标题
-    lv_label_set_text(label_title, file_list[current_file_idx]);
+    // 更新 UI 标题和封面
+    show_title();
+    show_cover(true);
     // 更新按钮状态为暂停图标
     lv_label_set_text(label_btn_icon, LV_SYMBOL_PAUSE);
+
+    preload_next();
+}
+
+// 后台预加载下一首
+typedef struct
+{
+    uint32_t gen;
+    uint32_t id;
+    int entry;
+    music_track_t *track;
+    char path[PLAYLIST_PATH_MAX];
+} preload_job_t;
+
+/**
+ * @brief 两首都至少有两倍淡化时长时才交叉淡化，长度未知 (0) 或太短的歌曲无缝衔接
+ */
+static bool can_crossfade(music_track_t *cur, music_track_t *next)
+{
+    ma_uint64 fade = (ma_uint64)crossfade_ms * sample_rate / 1000;
+    return fade > 0 && music_track_length(cur) >= fade * 2 && music_track_length(next) >= fade * 2;
+}
+
+static void preload_done_cb(void *arg)
+{
+    preload_job_t *job = arg;
+    // 期间换了歌或者关闭了播放器: 结果作废
+    if (job->gen != play_gen || cur_voice == NULL || next_id != 0)
+    {
+        music_track_close(job->track);
+        mem_tag_free(job);
+        return;
+    }
+
+    if (job->track)
+    {
+        next_id    = job->id;
+        next_entry = job->entry;
+        memcpy(next_path, job->path, sizeof(next_path));
+        // 交叉淡化等到快结束时由进度定时器安排 (见 arm_next)，否则现在就接到链上
+        if (can_crossfade(music_voice_track(cur_voice), job->track))
+            next_track = job->track;
+        else
+            music_voice_chain(cur_voice, job->track);
+    }
+    mem_tag_free(job);
+}
+
+static void preload_drop(void *arg)
+{
+    preload_job_t *job = arg;
+    music_track_close(job->track);
+    mem_tag_free(job);
+}
+
+static void preload_job(void *arg)
+{
+    preload_job_t *job = arg;
+    // MP3 打开时要扫描整个文件计算长度，放在后台做，不占音频线程
+    job->track = music_track_open(job->path, job->id, channels, sample_rate, &engine.allocationCallbacks);
+    if (job->track)
+        music_track_set_gain(job->track, track_gain(job->path));
+    // 顺便提取下一首的封面，切过去时直接从 pack 里贴图 (内存紧张时不提前做，切过去再提取)
+    if (mem_budget_pressure() == MEM_PRESSURE_NONE)
+        music_cover_generate(job->path);
+    if (bg_worker_post_ui(preload_done_cb, preload_drop, job) != 0)
+        preload_drop(job);
+}
+
+/**
+ * @brief 按播放顺序预加载下一首 (单曲循环时就是这一首，播完最后一首就停时可能没有)
+ * 模式切换只影响之后的选择，已经接上的下一首照常播放，不去和音频线程抢着撤下它
+ */
+static void preload_next(void)
+{
+    int entry = playlist_peek(queue, 1, false);
+    if (cur_voice == NULL || entry < 0)
+        return;
+
+    preload_job_t *job = mem_tag_alloc(MEM_TAG_AUDIO, sizeof(preload_job_t));
+    if (job == NULL)
+        return;
+    job->gen   = play_gen;
+    job->id    = ++track_seq;
+    job->entry = entry;
+    job->track = NULL;
+    snprintf(job->path, sizeof(job->path), "%s", playlist_path(queue, (uint32_t)entry));
+    if (bg_worker_submit(BG_PRIO_LOW, preload_job, preload_drop, job) != 0)
+        mem_tag_free(job);
+}
+
+/**
+ * @brief 安排交叉淡化 (UI 线程，进度定时器中调用)
+ * 按当前这首剩下的帧数算出它在引擎时钟上的结束时间，下一首在结束前 crossfade_ms 开始淡入，当前这首同时淡出到结束
+ * 来不及 (剩下的不够一次淡化，或者没有空闲声部) 时退回无缝衔接
+ */
+static void arm_next(void)
+{
+    music_track_t *cur = music_voice_track(cur_voice);
+    ma_uint64 fade     = (ma_uint64)crossfade_ms * sample_rate / 1000;
+    ma_uint64 len      = music_track_length(cur);
+    ma_uint64 pos      = music_track_cursor(cur);
+    ma_uint64 remain   = len > pos ? len - pos : 0;
+    if (remain > fade + (ma_uint64)ARM_AHEAD_MS * sample_rate / 1000)
+        return; // 还早
+
+    // 上一次淡出的声部早就结束了，先放回池中
+    if (old_voice && music_voice_done(old_voice))
+    {
+        music_voice_release(old_voice);
+        old_voice = NULL;
+    }
+    music_voice_t *v = NULL;
+    if (remain > fade)
+    {
+        v = music_voice_acquire();
+        if (v == NULL && remain > fade + sample_rate)
+            return; // 上一首还在淡出 (歌曲比 ARM_AHEAD_MS 还短时)，下次定时器再试
+    }
+    if (v == NULL)
+    {
+        music_voice_chain(cur_voice, next_track);
+        next_track = NULL;
+        return;
+    }
+
+    ma_uint64 start_at = ma_engine_get_time_in_pcm_frames(&engine) + remain - fade;
+    music_voice_start(v, next_track, start_at, fade);
+    music_voice_fade_out(cur_voice, start_at, fade);
+    next_voice = v;
+    next_track = NULL;
+}
+
+/**
+ * @brief 下一首开始播放 (UI 线程)
+ * 无缝衔接时音频线程已经离开上一首，可以释放它; 交叉淡化时上一首还在淡出，由进度定时器在它停下后回收
+ * 然后更新标题并预加载再下一首
+ */
+static void track_started_cb(uint32_t id)
+{
+    if (id != next_id)
+        return; // 第一首，或者已经换歌
+
+    if (next_voice)
+    {
+        old_voice  = cur_voice;
+        cur_voice  = next_voice;
+        next_voice = NULL;
+    }
+    else
+    {
+        music_voice_advance(cur_voice);
+    }
+    next_id = 0;
+    if (main_cont == NULL)
+        return;
+
+    // 预加载之后队列可能重建过，按路径找回位置
+    memcpy(current_path, next_path, sizeof(current_path));
+    locate_current(next_entry);
+    next_entry = -1;
+    show_title();
+    show_cover(true);
+    preload_next();
+}
+
+/**
+ * @brief 当前声部的链播放完 (UI 线程): 下一首没来得及接上时在这里切歌，会有一小段停顿
+ * 已经换了歌、或者是淡出的上一首、或者下一首已经安排好开始时间时忽略
+ */
+static void sound_end_ui_cb(uint32_t seq)
+{
+    if (main_cont == NULL || cur_voice == NULL || seq != music_voice_seq(cur_voice) || next_voice != NULL)
+        return;
+    if (playlist_step(queue, 1, false) >= 0)
+    {
+        play_current();
+        return;
+    }
+    // 不循环时播完最后一首: 停在这里
+    unload_sound();
+    lv_label_set_text(label_btn_icon, LV_SYMBOL_PLAY);
 }
 
 // 定时器回调：更新进度条和时间
 static void progress_timer_cb(lv_timer_t *timer)
 {
+    (void)timer;
+    // 淡出结束的声部放回池中
+    if (old_voice && music_voice_done(old_voice))
+    {
+        music_voice_release(old_voice);
+        old_voice = NULL;
+    }
+    if (next_track && !is_paused)
+        arm_next();
+
     if (music_get_state() == MUSIC_STATE_PLAYING)
     {
         // 更新 Slider
@@ -235,12 +713,67 @@ static void progress_timer_cb(lv_timer_t *timer)
                               cur / 60, cur % 60,
                               tot / 60, tot % 60);
     }
-    // 自动切歌逻辑（可选）：如果播放结束（当前时间接近总时间且状态停止）
-    else if (is_sound_loaded && !ma_sound_is_playing(&sound) && music_get_current_time() >= music_get_total_time() - 1)
+    // 自动切歌由声部的结束回调和歌曲的开始回调驱动 (见 track_started_cb / sound_end_ui_cb)
+}
+
+/**
+ * @brief 第 b 条频谱高度为 level 时的区域 (绝对坐标)，level 为 0 时返回 false
+ */
+static bool bar_area(int b, uint8_t level, lv_area_t *area)
+{
+    lv_area_t coords;
+    lv_obj_get_coords(spectrum_obj, &coords);
+    lv_coord_t pitch = lv_area_get_width(&coords) / BAR_COUNT;
+    lv_coord_t h     = (lv_coord_t)(level * lv_area_get_height(&coords) / 255);
+    area->x1         = coords.x1 + b * pitch;
+    area->x2         = area->x1 + pitch - BAR_GAP - 1;
+    area->y2         = coords.y2;
+    area->y1         = coords.y2 - h + 1;
+    return h > 0;
+}
+
+static void spectrum_draw_cb(lv_event_t *e)
+{
+    lv_draw_ctx_t *draw_ctx = lv_event_get_draw_ctx(e);
+    lv_draw_rect_dsc_t dsc;
+    lv_draw_rect_dsc_init(&dsc);
+    dsc.bg_color = lv_color_hex(0xFFD700); // 金色
+
+    // 只有被标记为无效的区域会真正重绘 (draw_ctx 的裁剪区)
+    for (int b = 0; b < BAR_COUNT; b++)
     {
-        // 下一曲
-        current_file_idx++;
-        play_current_index();
+        lv_area_t area;
+        if (bar_area(b, bar_levels[b], &area))
+            lv_draw_rect(draw_ctx, &dsc, &area);
+    }
+}
+
+/**
+ * @brief 显示刷新周期: 取最近一帧样本做 FFT，只重绘高度变化的那一段
+ */
+static void spectrum_timer_cb(lv_timer_t *timer)
+{
+    (void)timer;
+    uint8_t levels[BAR_COUNT];
+    uint32_t fresh = audio_tap_read_latest(tap, tap_samples, SPECTRUM_FFT_SIZE);
+    bool playing   = fresh > 0 && music_get_state() == MUSIC_STATE_PLAYING;
+    spectrum_update(spectrum, playing ? tap_samples : NULL, levels);
+
+    for (int b = 0; b < BAR_COUNT; b++)
+    {
+        if (levels[b] == bar_levels[b])
+            continue;
+
+        // 新旧高度之间的那几行: 变高时补上，变矮时擦掉
+        lv_area_t old_area, new_area, dirty;
+        // bar_area 在高度为 0 时 y1 = y2 + 1，正好是 "空条" 的顶
+        bar_area(b, bar_levels[b], &old_area);
+        bar_area(b, levels[b], &new_area);
+        dirty         = new_area;
+        dirty.y1      = LV_MIN(old_area.y1, new_area.y1);
+        dirty.y2      = LV_MAX(old_area.y1, new_area.y1) - 1;
+        bar_levels[b] = levels[b];
+        lv_obj_invalidate_area(spectrum_obj, &dirty);
     }
 }
 
@@ -255,17 +788,30 @@ static void app_music_event_cb(lv_event_t *e)
         switch (key)
         {
             case LV_KEY_RIGHT: // Key 1: 下一曲
-                current_file_idx++;
-                play_current_index();
+                if (playlist_step(queue, 1, true) >= 0)
+                    play_current();
                 break;
 
             case LV_KEY_LEFT: // Key 1 Long: 上一曲
-                current_file_idx--;
-                play_current_index();
+                if (playlist_step(queue, -1, true) >= 0)
+                    play_current();
                 break;
 
-            case LV_KEY_ENTER: // Key 2: 播放/暂停
-                music_toggle();
+            case LV_KEY_UP: // 循环模式: 列表循环 -> 单曲循环 -> 不循环
+                playlist_set_repeat(queue, (playlist_get_repeat(queue) + 1) % _PLAYLIST_REPEAT_NUM);
+                show_mode();
+                break;
+
+            case LV_KEY_DOWN: // 随机播放开关，每次打开换一个种子
+                playlist_set_shuffle(queue, !playlist_get_shuffle(queue), (uint32_t)time(NULL));
+                show_mode();
+                break;
+
+            case LV_KEY_ENTER: // Key 2: 播放/暂停 (不循环的列表播完后从当前这首重新开始)
+                if (music_get_state() == MUSIC_STATE_STOPPED)
+                    play_current();
+                else
+                    music_toggle();
                 if (music_get_state() == MUSIC_STATE_PLAYING)
                     lv_label_set_text(label_btn_icon, LV_SYMBOL_PAUSE);
                 else
@@ -279,6 +825,52 @@ static void app_music_event_cb(lv_event_t *e)
     }
 }
 
+/**
+ * @brief 队列跟随目录时按自然顺序重建，再找回正在播放的歌曲 (1 万首约 1ms)
+ */
+static void rebuild_queue(media_index_t *idx)
+{
+    char path[PLAYLIST_PATH_MAX];
+    uint32_t count = media_index_count(idx);
+    playlist_clear(queue);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        snprintf(path, sizeof(path), "%s/%s", MUSIC_DIR_PATH, media_index_name(idx, i));
+        playlist_add(queue, path);
+    }
+    locate_current(-1);
+}
+
+/**
+ * @brief 歌曲索引变化 (UI 线程)
+ * 新文件排队解析标签; 队列跟随目录时重建队列，还没有在播放时第一批结果到达就开始播放
+ */
+static void music_index_cb(media_index_t *idx, media_event_t event, const char *name, void *user_data)
+{
+    (void)user_data;
+    if (main_cont == NULL)
+        return;
+
+    if (event == MEDIA_EVENT_ADDED)
+    {
+        // 已经在索引里且文件没变时只是一次 stat
+        char full_path[sizeof(MUSIC_DIR_PATH) + MAX_FNAME_LEN];
+        snprintf(full_path, sizeof(full_path), "%s/%s", MUSIC_DIR_PATH, name);
+        music_lib_request(full_path, NULL, NULL);
+    }
+    else if (event == MEDIA_EVENT_UPDATED)
+    {
+        if (queue_follows_dir)
+            rebuild_queue(idx);
+        if (current_path[0] == '\0')
+            play_current(); // 第一批结果到达: 自动播放
+    }
+    else if (event == MEDIA_EVENT_SCAN_DONE)
+    {
+        printf("Music App: Found %u songs.\n", media_index_count(idx));
+    }
+}
+
 static void close_app(void)
 {
     // 停止定时器
@@ -287,6 +879,23 @@ static void close_app(void)
         lv_timer_del(progress_timer);
         progress_timer = NULL;
     }
+    if (spectrum_timer)
+    {
+        lv_timer_del(spectrum_timer);
+        spectrum_timer = NULL;
+    }
+    spectrum_destroy(spectrum);
+    spectrum     = NULL;
+    spectrum_obj = NULL; // 随 main_cont 一起删除
+    cover_img    = NULL;
+    media_index_destroy(music_index);
+    music_index = NULL;
+
+    // 保存队列、当前位置和播放模式，下次打开接着播
+    playlist_save_queue(queue, MUSIC_QUEUE_PATH, queue_follows_dir);
+    playlist_destroy(queue);
+    queue = NULL;
+
     // 停止音乐并清理后端
     app_music_deinit();
 
@@ -304,7 +913,6 @@ void app_music_init(void)
 {
     // 1. 初始化后端
     app_music_init_backend();
-    scan_music_files();
 
     // 2. 创建 UI
     main_cont = lv_obj_create(lv_scr_act());
@@ -321,12 +929,25 @@ void app_music_init(void)
     }
     lv_obj_add_event_cb(main_cont, app_music_event_cb, LV_EVENT_KEY, NULL);
 
-    // 封面 (可以用一个 FontAwesome 音乐图标代替)
-    lv_obj_t *icon = lv_label_create(main_cont);
-    lv_obj_set_style_text_font(icon, &lv_font_montserrat_14, 0); // 假设有大字体，没有就用默认
-    lv_label_set_text(icon, LV_SYMBOL_AUDIO);
-    lv_obj_align(icon, LV_ALIGN_CENTER, 0, -40);
-    lv_obj_set_style_text_color(icon, lv_color_hex(0xFFD700), 0); // 金色
+    // 封面 (没有时显示音符图标)
+    cover_img = lv_img_create(main_cont);
+    lv_img_set_src(cover_img, LV_SYMBOL_AUDIO);
+    lv_obj_set_style_text_color(cover_img, lv_color_hex(0xFFD700), 0); // 金色
+    lv_obj_align(cover_img, LV_ALIGN_CENTER, 0, -40);
+
+    // 频谱放在封面右边 (没有音频引擎时只显示封面)
+    if (tap && (spectrum = spectrum_create(ma_engine_get_sample_rate(&engine), BAR_COUNT)) != NULL)
+    {
+        lv_obj_align(cover_img, LV_ALIGN_CENTER, -100, -50);
+        spectrum_obj = lv_obj_create(main_cont);
+        lv_obj_remove_style_all(spectrum_obj);
+        lv_obj_set_size(spectrum_obj, 192, COVER_SIZE);
+        lv_obj_align(spectrum_obj, LV_ALIGN_CENTER, 44, -50);
+        lv_obj_clear_flag(spectrum_obj, LV_OBJ_FLAG_CLICKABLE | LV_OBJ_FLAG_SCROLLABLE);
+        lv_obj_add_event_cb(spectrum_obj, spectrum_draw_cb, LV_EVENT_DRAW_MAIN, NULL);
+        memset(bar_levels, 0, sizeof(bar_levels));
+        spectrum_timer = lv_timer_create(spectrum_timer_cb, LV_DISP_DEF_REFR_PERIOD, NULL);
+    }
 
     // 歌曲标题
     label_title = lv_label_create(main_cont);
@@ -353,13 +974,27 @@ void app_music_init(void)
     lv_label_set_text(label_btn_icon, LV_SYMBOL_PLAY);
     lv_obj_align(label_btn_icon, LV_ALIGN_BOTTOM_MID, 0, -10);
 
+    label_mode = lv_label_create(main_cont);
+    lv_obj_align(label_mode, LV_ALIGN_TOP_RIGHT, 0, 0);
+    lv_obj_set_style_text_color(label_mode, lv_color_hex(0xAAAAAA), 0);
+
     // 3. 启动定时器 (每500ms更新一次 UI)
     progress_timer = lv_timer_create(progress_timer_cb, 500, NULL);
 
-    // 4. 自动播放第一首
-    if (file_count > 0)
+    // 4. 上次的队列还在时不等扫描，直接从上次的位置接着播；否则第一批扫描结果到达后播放第一首 (见 music_index_cb)
+    //    上次解析过的标签和时长直接从 mmap 的索引里读，不用再打开文件
+    music_lib_open(MUSIC_LIB_PATH);
+    music_cover_open(MUSIC_COVER_PATH);
+    mem_budget_register("cover_pack", MEM_PRIO_CACHE, music_cover_mem_usage, music_cover_trim);
+    current_path[0]   = '\0';
+    queue             = playlist_create();
+    queue_follows_dir = true;
+    bool follow_dir;
+    if (playlist_load_queue(queue, MUSIC_QUEUE_PATH, &follow_dir) > 0)
     {
-        current_file_idx = 0;
-        play_current_index();
+        queue_follows_dir = follow_dir;
+        play_current();
     }
+    show_mode();
+    music_index = media_index_create(MUSIC_DIR_PATH, MEDIA_MASK_AUDIO, music_index_cb, NULL);
 }
\ No newline at end of file
@@ -1,5 +1,6 @@
 #include "app_text.h"
 #include "lvgl.h"
+#include "mem_tag.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -237,8 +238,10 @@ static void render_page(void)
     char display_buf[PAGE_BUF_SIZE];
     process_layout(start_offset, display_buf, &next_page_offset);
 
-    // 3. 更新正文 UI
+    // 3. 更新正文 UI (label 内部复制一份正文，记到 text 名下)
+    mem_tag_t prev = mem_tag_scope_begin(MEM_TAG_TEXT);
     lv_label_set_text(label_body, display_buf);
+    mem_tag_scope_end(prev);
 
     // 4. 更新顶部 Header (进度信息)
     long percent = 0;
@@ -261,7 +264,10 @@ void app_text_init(void)
         font_info.name   = FONT_PATH;
         font_info.weight = FONT_SIZE;
         font_info.style  = FT_FONT_STYLE_NORMAL;
-        if (lv_ft_font_init(&font_info))
+        mem_tag_t prev = mem_tag_scope_begin(MEM_TAG_FONT);
+        bool ok        = lv_ft_font_init(&font_info);
+        mem_tag_scope_end(prev);
+        if (ok)
         {
             my_font = font_info.font;
         }
@@ -0,0 +1,467 @@
+#include "audio_eq.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define SUB_BLOCK  64    // 每这么多帧更新一次平滑中的参数
+#define SMOOTH_K   0.1f  // 每次向目标靠近的比例 (48kHz 下约 60ms 到位)
+#define IDLE_STATE 1e-6f // 0dB 的频段状态衰减到这以下才跳过，避免跳变
+
+typedef struct
+{
+    float b0, b1, b2, a1, a2; // 已经除以 a0
+} coef_t;
+
+typedef struct
+{
+    audio_eq_band_t cur; // 当前参数 (正在向目标平滑)
+    coef_t c;
+    bool active; // 需要参与计算
+    float z1[AUDIO_EQ_MAX_CHANNELS];
+    float z2[AUDIO_EQ_MAX_CHANNELS];
+} band_state_t;
+
+typedef struct
+{
+    ma_node_base base; // 必须是第一个成员
+    ma_uint32 channels;
+    ma_uint32 sample_rate;
+    // 以下只由音频线程使用
+    band_state_t bands[AUDIO_EQ_MAX_BANDS];
+    audio_eq_band_t target[AUDIO_EQ_MAX_BANDS];
+    uint32_t target_count;
+    float target_preamp_db;
+    float preamp_db;
+    float preamp; // 线性增益，按帧渐变
+    uint32_t seen_seq;
+} eq_node_t;
+
+// --- 静态变量 ---
+static eq_node_t eq;
+static bool is_inited = false;
+static audio_eq_stats_t stats;
+
+// UI 线程写、音频线程读的参数 (seqlock: seq 为奇数时正在写，音频线程这次不取，下一段再试)
+static audio_eq_band_t pending[AUDIO_EQ_MAX_BANDS];
+static uint32_t pending_count  = 0;
+static float pending_preamp    = 0.0f;
+static uint32_t pending_seq    = 0;
+static const char *preset_name = "flat";
+
+static const audio_eq_preset_t presets[] = {
+    {"flat", 0.0f, 0, {{0}}},
+    // 小喇叭: 150Hz 以下本来就放不出来，硬推只会破音，衰减掉; 稍微补一点 250Hz 的 "厚度" 和高频
+    {"speaker",
+     -3.0f,
+     5,
+     {{AUDIO_EQ_LOW_SHELF, 120.0f, -9.0f, 0.707f},
+      {AUDIO_EQ_PEAK, 250.0f, 3.0f, 1.0f},
+      {AUDIO_EQ_PEAK, 1000.0f, -1.0f, 1.0f},
+      {AUDIO_EQ_PEAK, 3500.0f, -2.0f, 2.0f},
+      {AUDIO_EQ_HIGH_SHELF, 8000.0f, 3.0f, 0.707f}}},
+    {"bass", -6.0f, 2, {{AUDIO_EQ_LOW_SHELF, 100.0f, 6.0f, 0.707f}, {AUDIO_EQ_PEAK, 250.0f, 2.0f, 1.0f}}},
+    {"vocal",
+     -4.0f,
+     4,
+     {{AUDIO_EQ_LOW_SHELF, 150.0f, -3.0f, 0.707f},
+      {AUDIO_EQ_PEAK, 1000.0f, 2.0f, 1.0f},
+      {AUDIO_EQ_PEAK, 3000.0f, 4.0f, 1.2f},
+      {AUDIO_EQ_HIGH_SHELF, 10000.0f, -1.0f, 0.707f}}},
+    {"treble", -6.0f, 2, {{AUDIO_EQ_PEAK, 3000.0f, 2.0f, 1.0f}, {AUDIO_EQ_HIGH_SHELF, 6000.0f, 6.0f, 0.707f}}},
+    {"loudness",
+     -6.0f,
+     3,
+     {{AUDIO_EQ_LOW_SHELF, 100.0f, 6.0f, 0.707f},
+      {AUDIO_EQ_PEAK, 1000.0f, -2.0f, 0.8f},
+      {AUDIO_EQ_HIGH_SHELF, 10000.0f, 4.0f, 0.707f}}},
+};
+
+#define PRESET_COUNT (sizeof(presets) / sizeof(presets[0]))
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static float clampf(float v, float lo, float hi)
+{
+    return v < lo ? lo : v > hi ? hi : v;
+}
+
+/**
+ * @brief RBJ Audio EQ Cookbook 系数，gain 为 0dB 时三种类型都是恒等 (b = a)
+ */
+static void calc_coef(const audio_eq_band_t *b, ma_uint32 sample_rate, coef_t *c)
+{
+    float A     = powf(10.0f, b->gain_db / 40.0f);
+    float w0    = 2.0f * (float)M_PI * fminf(b->freq, 0.45f * sample_rate) / sample_rate;
+    float cw    = cosf(w0);
+    float alpha = sinf(w0) / (2.0f * b->q);
+    float b0, b1, b2, a0, a1, a2;
+
+    if (b->type == AUDIO_EQ_PEAK)
+    {
+        b0 = 1.0f + alpha * A;
+        b1 = -2.0f * cw;
+        b2 = 1.0f - alpha * A;
+        a0 = 1.0f + alpha / A;
+        a1 = -2.0f * cw;
+        a2 = 1.0f - alpha / A;
+    }
+    else
+    {
+        float sa = 2.0f * sqrtf(A) * alpha;
+        float s  = b->type == AUDIO_EQ_LOW_SHELF ? 1.0f : -1.0f; // 高架: 公式里 cos 项的符号相反
+        b0       = A * ((A + 1) - s * (A - 1) * cw + sa);
+        b1       = s * 2 * A * ((A - 1) - s * (A + 1) * cw);
+        b2       = A * ((A + 1) - s * (A - 1) * cw - sa);
+        a0       = (A + 1) + s * (A - 1) * cw + sa;
+        a1       = -s * 2 * ((A - 1) + s * (A + 1) * cw);
+        a2       = (A + 1) + s * (A - 1) * cw - sa;
+    }
+    c->b0 = b0 / a0;
+    c->b1 = b1 / a0;
+    c->b2 = b2 / a0;
+    c->a1 = a1 / a0;
+    c->a2 = a2 / a0;
+}
+
+// 对数域 (频率、Q) 平滑一步，接近时直接到位
+static bool smooth_ratio(float *cur, float target)
+{
+    if (*cur == target)
+        return false;
+    float r = target / *cur;
+    if (r > 0.999f && r < 1.001f)
+        *cur = target;
+    else
+        *cur *= powf(r, SMOOTH_K);
+    return true;
+}
+
+static bool smooth_db(float *cur, float target)
+{
+    if (*cur == target)
+        return false;
+    float d = target - *cur;
+    if (fabsf(d) < 0.01f)
+        *cur = target;
+    else
+        *cur += d * SMOOTH_K;
+    return true;
+}
+
+/**
+ * @brief 音频线程: 取 UI 线程的新参数 (写到一半时这次不取)
+ */
+static void fetch_params(void)
+{
+    uint32_t seq = __atomic_load_n(&pending_seq, __ATOMIC_ACQUIRE);
+    if (seq == eq.seen_seq || (seq & 1))
+        return;
+    audio_eq_band_t bands[AUDIO_EQ_MAX_BANDS];
+    uint32_t count = pending_count;
+    float preamp   = pending_preamp;
+    memcpy(bands, pending, sizeof(bands));
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&pending_seq, __ATOMIC_RELAXED) != seq)
+        return;
+    memcpy(eq.target, bands, sizeof(bands));
+    eq.target_count     = count;
+    eq.target_preamp_db = preamp;
+    eq.seen_seq         = seq;
+}
+
+/**
+ * @brief 音频线程: 每个频段向目标走一步
+ * 类型不同时先把增益降到 0dB (此时滤波器是恒等的)，再换类型、频率和 Q，然后升到目标增益
+ * 多出来的频段 (预设的频段数变少) 也是降到 0dB 后停用
+ */
+static void update_bands(void)
+{
+    for (int i = 0; i < AUDIO_EQ_MAX_BANDS; i++)
+    {
+        band_state_t *b          = &eq.bands[i];
+        const audio_eq_band_t *t = &eq.target[i];
+        bool used                = (uint32_t)i < eq.target_count;
+
+        if (used && b->cur.gain_db == 0.0f)
+        {
+            // 0dB 时可以直接换形状，不会有跳变
+            b->cur.type = t->type;
+            b->cur.freq = t->freq;
+            b->cur.q    = t->q;
+        }
+
+        float goal   = used && b->cur.type == t->type ? t->gain_db : 0.0f;
+        bool changed = smooth_db(&b->cur.gain_db, goal);
+        if (used && b->cur.type == t->type)
+        {
+            changed |= smooth_ratio(&b->cur.freq, t->freq);
+            changed |= smooth_ratio(&b->cur.q, t->q);
+        }
+        if (changed)
+            calc_coef(&b->cur, eq.sample_rate, &b->c);
+
+        if (b->cur.gain_db != 0.0f)
+        {
+            if (!b->active)
+            {
+                memset(b->z1, 0, sizeof(b->z1));
+                memset(b->z2, 0, sizeof(b->z2));
+            }
+            b->active = true;
+        }
+        else if (b->active)
+        {
+            // 恒等滤波器里残留的状态还会输出一点，衰减完再停
+            float m = 0;
+            for (ma_uint32 ch = 0; ch < eq.channels; ch++)
+                m = fmaxf(m, fmaxf(fabsf(b->z1[ch]), fabsf(b->z2[ch])));
+            b->active = m > IDLE_STATE;
+        }
+    }
+}
+
+/**
+ * @brief 音频线程: 一个频段原地处理 n 帧 (交错格式)
+ */
+static void run_band(band_state_t *b, float *buf, ma_uint32 n, ma_uint32 channels)
+{
+    const coef_t c = b->c;
+    if (channels == 2)
+    {
+        float l1 = b->z1[0], l2 = b->z2[0], r1 = b->z1[1], r2 = b->z2[1];
+        for (ma_uint32 i = 0; i < n; i++)
+        {
+            float xl       = buf[i * 2];
+            float xr       = buf[i * 2 + 1];
+            float yl       = c.b0 * xl + l1;
+            float yr       = c.b0 * xr + r1;
+            l1             = c.b1 * xl - c.a1 * yl + l2;
+            r1             = c.b1 * xr - c.a1 * yr + r2;
+            l2             = c.b2 * xl - c.a2 * yl;
+            r2             = c.b2 * xr - c.a2 * yr;
+            buf[i * 2]     = yl;
+            buf[i * 2 + 1] = yr;
+        }
+        b->z1[0] = l1;
+        b->z2[0] = l2;
+        b->z1[1] = r1;
+        b->z2[1] = r2;
+    }
+    else
+    {
+        for (ma_uint32 ch = 0; ch < channels; ch++)
+        {
+            float z1 = b->z1[ch], z2 = b->z2[ch];
+            for (ma_uint32 i = 0; i < n; i++)
+            {
+                float x                = buf[i * channels + ch];
+                float y                = c.b0 * x + z1;
+                z1                     = c.b1 * x - c.a1 * y + z2;
+                z2                     = c.b2 * x - c.a2 * y;
+                buf[i * channels + ch] = y;
+            }
+            b->z1[ch] = z1;
+            b->z2[ch] = z2;
+        }
+    }
+    // 静音时状态会衰减成非规格化数，在没有 flush-to-zero 的 CPU 上很慢
+    for (ma_uint32 ch = 0; ch < channels; ch++)
+    {
+        if (fabsf(b->z1[ch]) < 1e-15f)
+            b->z1[ch] = 0;
+        if (fabsf(b->z2[ch]) < 1e-15f)
+            b->z2[ch] = 0;
+    }
+}
+
+static void eq_process(ma_node *node, const float **frames_in, ma_uint32 *frame_count_in, float **frames_out,
+                       ma_uint32 *frame_count_out)
+{
+    (void)node;
+    (void)frame_count_in;
+    uint64_t start       = now_ns();
+    const float *in      = frames_in[0];
+    float *out           = frames_out[0];
+    ma_uint32 total      = *frame_count_out;
+    ma_uint32 ch         = eq.channels;
+    uint64_t band_frames = 0;
+
+    fetch_params();
+    for (ma_uint32 done = 0; done < total;)
+    {
+        ma_uint32 n = total - done < SUB_BLOCK ? total - done : SUB_BLOCK;
+        update_bands();
+        smooth_db(&eq.preamp_db, eq.target_preamp_db);
+
+        // 前级增益: 在这一小段内线性渐变到新值
+        const float *src = in + (size_t)done * ch;
+        float *dst       = out + (size_t)done * ch;
+        float g0         = eq.preamp;
+        float g1         = eq.preamp_db == 0.0f ? 1.0f : powf(10.0f, eq.preamp_db / 20.0f);
+        if (g0 == 1.0f && g1 == 1.0f)
+        {
+            memcpy(dst, src, (size_t)n * ch * sizeof(float));
+        }
+        else
+        {
+            float step = (g1 - g0) / n;
+            for (ma_uint32 i = 0; i < n; i++)
+            {
+                float g = g0 + step * (i + 1);
+                for (ma_uint32 c = 0; c < ch; c++)
+                    dst[i * ch + c] = src[i * ch + c] * g;
+            }
+        }
+        eq.preamp = g1;
+
+        for (int b = 0; b < AUDIO_EQ_MAX_BANDS; b++)
+        {
+            if (!eq.bands[b].active)
+                continue;
+            run_band(&eq.bands[b], dst, n, ch);
+            band_frames += n;
+        }
+        done += n;
+    }
+
+    __atomic_fetch_add(&stats.frames, total, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&stats.band_frames, band_frames, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&stats.busy_ns, now_ns() - start, __ATOMIC_RELAXED);
+}
+
+static ma_node_vtable eq_vtable = {
+    eq_process, NULL, 1, 1, 0,
+};
+
+int audio_eq_init(ma_engine *engine, ma_node *output)
+{
+    if (is_inited)
+        return 0;
+    if (ma_engine_get_channels(engine) > AUDIO_EQ_MAX_CHANNELS)
+        return -1;
+
+    memset(&eq, 0, sizeof(eq));
+    eq.channels    = ma_engine_get_channels(engine);
+    eq.sample_rate = ma_engine_get_sample_rate(engine);
+    eq.preamp      = 1.0f;
+    for (int i = 0; i < AUDIO_EQ_MAX_BANDS; i++)
+    {
+        eq.bands[i].cur = (audio_eq_band_t){AUDIO_EQ_PEAK, 1000.0f, 0.0f, 1.0f};
+        calc_coef(&eq.bands[i].cur, eq.sample_rate, &eq.bands[i].c);
+    }
+    eq.seen_seq = ~0u; // 奇数，第一次处理时一定会取参数 (可能在创建之前就设置了预设)
+
+    ma_node_config config  = ma_node_config_init();
+    config.vtable          = &eq_vtable;
+    config.pInputChannels  = &eq.channels;
+    config.pOutputChannels = &eq.channels;
+    if (ma_node_init(ma_engine_get_node_graph(engine), &config, NULL, &eq.base) != MA_SUCCESS)
+        return -1;
+    ma_node_attach_output_bus(&eq.base, 0, output, 0);
+    memset(&stats, 0, sizeof(stats));
+    is_inited = true;
+    return 0;
+}
+
+void audio_eq_uninit(void)
+{
+    if (!is_inited)
+        return;
+    ma_node_uninit(&eq.base, NULL); // 同时从图上断开
+    is_inited = false;
+}
+
+ma_node *audio_eq_node(void)
+{
+    return is_inited ? &eq.base : NULL;
+}
+
+void audio_eq_set_bands(const audio_eq_band_t *bands, uint32_t count, float preamp_db)
+{
+    if (count > AUDIO_EQ_MAX_BANDS)
+        count = AUDIO_EQ_MAX_BANDS;
+    float nyq = (eq.sample_rate ? eq.sample_rate : 48000) * 0.45f;
+
+    __atomic_store_n(&pending_seq, pending_seq + 1, __ATOMIC_RELAXED); // 奇数: 正在写
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        pending[i]         = bands[i];
+        pending[i].freq    = clampf(bands[i].freq, 20.0f, nyq);
+        pending[i].gain_db = clampf(bands[i].gain_db, -24.0f, 24.0f);
+        pending[i].q       = clampf(bands[i].q, 0.1f, 10.0f);
+    }
+    pending_count  = count;
+    pending_preamp = clampf(preamp_db, -24.0f, 12.0f);
+    __atomic_store_n(&pending_seq, pending_seq + 1, __ATOMIC_RELEASE);
+    preset_name = "custom";
+}
+
+uint32_t audio_eq_preset_count(void)
+{
+    return PRESET_COUNT;
+}
+
+const audio_eq_preset_t *audio_eq_preset(uint32_t index)
+{
+    return index < PRESET_COUNT ? &presets[index] : NULL;
+}
+
+int audio_eq_set_preset(const char *name)
+{
+    for (uint32_t i = 0; i < PRESET_COUNT; i++)
+    {
+        if (strcmp(presets[i].name, name) == 0)
+        {
+            audio_eq_set_bands(presets[i].bands, presets[i].band_count, presets[i].preamp_db);
+            preset_name = presets[i].name;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+const char *audio_eq_get_preset(void)
+{
+    return preset_name;
+}
+
+void audio_eq_get_stats(audio_eq_stats_t *out)
+{
+    out->frames      = __atomic_load_n(&stats.frames, __ATOMIC_RELAXED);
+    out->band_frames = __atomic_load_n(&stats.band_frames, __ATOMIC_RELAXED);
+    out->busy_ns     = __atomic_load_n(&stats.busy_ns, __ATOMIC_RELAXED);
+}
+
+void audio_eq_report(void)
+{
+    if (!is_inited)
+    {
+        printf("EQ: not created\n");
+        return;
+    }
+
+    printf("EQ: preset %s, preamp %.1f dB\n", preset_name, pending_preamp);
+    static const char *type_names[] = {"peak", "lowshelf", "highshelf"};
+    for (uint32_t i = 0; i < pending_count; i++)
+        printf("    %-9s %7.0f Hz %+5.1f dB Q %.2f\n", type_names[pending[i].type], pending[i].freq,
+               pending[i].gain_db, pending[i].q);
+
+    // 开销: 每秒音频 (eq.sample_rate 帧) 的处理时间; 按频段平均时包含了拷贝和前级增益，频段少时偏高
+    audio_eq_stats_t s;
+    audio_eq_get_stats(&s);
+    if (s.frames == 0)
+        return;
+    double audio_s = (double)s.frames / eq.sample_rate;
+    printf("EQ: %.1f s audio, %.0f us CPU per second", audio_s, s.busy_ns / 1000.0 / audio_s);
+    if (s.band_frames > 0)
+        printf(", %.0f us per band per second (%.2f%% CPU)", s.busy_ns / 1000.0 / ((double)s.band_frames / eq.sample_rate),
+               s.busy_ns / 1e7 / ((double)s.band_frames / eq.sample_rate));
+    printf("\n");
+}
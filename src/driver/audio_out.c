@@ -0,0 +1,257 @@
+#include "audio_out.h"
+#include "mem_tag.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define SCRATCH_FRAMES 512 // s16 输出时先按块混成 f32 再转换
+
+// --- 静态变量 ---
+static ma_context context;
+static ma_device device;
+static bool is_opened         = false;
+static float *scratch         = NULL; // SCRATCH_FRAMES * 声道数
+static uint64_t buffer_ns     = 0;    // 整个缓冲的时长，回调间隔超过它就必然断音
+static uint64_t last_start_ns = 0;
+static audio_out_stats_t stats; // 只由音频线程写 (relaxed)，读取方逐项原子读
+
+static const uint32_t hist_limits[AUDIO_OUT_HIST_BUCKETS - 1] = {10, 25, 50, 75, 100, 150}; // 百分比上限
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void stat_add(uint64_t *v, uint64_t n)
+{
+    __atomic_fetch_add(v, n, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief 音频线程: 记录一次回调的耗时，frames 帧对应的时长就是这次回调的预算
+ */
+static void record(uint64_t start, uint64_t end, ma_uint32 frames)
+{
+    uint64_t dur    = end - start;
+    uint64_t budget = (uint64_t)frames * 1000000000ULL / device.sampleRate;
+    uint64_t pct    = budget ? dur * 100 / budget : 0;
+
+    int b = 0;
+    while (b < AUDIO_OUT_HIST_BUCKETS - 1 && pct >= hist_limits[b])
+        b++;
+    stat_add(&stats.hist[b], 1);
+    stat_add(&stats.callbacks, 1);
+    stat_add(&stats.frames, frames);
+    if (dur > budget)
+        stat_add(&stats.late, 1);
+    if (last_start_ns && start - last_start_ns > buffer_ns)
+        stat_add(&stats.stalls, 1);
+    last_start_ns = start;
+
+    uint32_t us = (uint32_t)(dur / 1000);
+    if (us > __atomic_load_n(&stats.max_us, __ATOMIC_RELAXED))
+        __atomic_store_n(&stats.max_us, us, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief 音频线程: 从 engine 混音输出，s16 设备先混成 f32 再转换
+ */
+static void data_cb(ma_device *dev, void *output, const void *input, ma_uint32 frame_count)
+{
+    (void)input;
+    uint64_t start    = now_ns();
+    ma_engine *engine = dev->pUserData;
+
+    if (dev->playback.format == ma_format_f32)
+    {
+        ma_engine_read_pcm_frames(engine, output, frame_count, NULL);
+    }
+    else
+    {
+        ma_uint32 ch   = dev->playback.channels;
+        ma_int16 *out  = output;
+        ma_uint32 done = 0;
+        while (done < frame_count)
+        {
+            ma_uint32 n = frame_count - done;
+            if (n > SCRATCH_FRAMES)
+                n = SCRATCH_FRAMES;
+            ma_uint64 got = 0;
+            ma_engine_read_pcm_frames(engine, scratch, n, &got);
+            if (got < n)
+                memset(scratch + got * ch, 0, (size_t)(n - got) * ch * sizeof(float));
+            ma_pcm_f32_to_s16(out + (size_t)done * ch, scratch, (ma_uint64)n * ch, ma_dither_mode_none);
+            done += n;
+        }
+    }
+
+    record(start, now_ns(), frame_count);
+}
+
+/**
+ * @brief 设备 (重新) 启动: 暂停时引擎停掉了设备，恢复后的第一次回调不算断音
+ */
+static void notify_cb(const ma_device_notification *n)
+{
+    if (n->type == ma_device_notification_type_started)
+        __atomic_store_n(&last_start_ns, 0, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief ALSA 后端遇到 underrun 时只记一条 debug 日志然后自己恢复，这里靠它计数
+ */
+static void log_cb(void *user_data, ma_uint32 level, const char *message)
+{
+    (void)user_data;
+    if (level == MA_LOG_LEVEL_DEBUG && strncmp(message, "EPIPE (write)", 13) == 0)
+        stat_add(&stats.xruns, 1);
+}
+
+audio_out_config_t audio_out_config_default(void)
+{
+    audio_out_config_t cfg = {0};
+    cfg.format             = ma_format_f32;
+    cfg.mmap               = true;
+    return cfg;
+}
+
+void audio_out_config_from_env(audio_out_config_t *cfg)
+{
+    const char *s;
+    if ((s = getenv("AUDIO_PERIOD_FRAMES")) != NULL)
+        cfg->period_frames = (uint32_t)strtoul(s, NULL, 10);
+    if ((s = getenv("AUDIO_PERIODS")) != NULL)
+        cfg->periods = (uint32_t)strtoul(s, NULL, 10);
+    if ((s = getenv("AUDIO_FORMAT")) != NULL)
+    {
+        if (strcmp(s, "s16") == 0)
+            cfg->format = ma_format_s16;
+        else if (strcmp(s, "f32") == 0)
+            cfg->format = ma_format_f32;
+        else
+            printf("Audio: Unknown AUDIO_FORMAT=%s (s16 or f32)\n", s);
+    }
+    if ((s = getenv("AUDIO_MMAP")) != NULL)
+        cfg->mmap = atoi(s) != 0;
+}
+
+int audio_out_open(const audio_out_config_t *cfg, ma_engine *engine, const ma_allocation_callbacks *alloc)
+{
+    if (is_opened)
+        return 0;
+
+    // 板子上只有 ALSA；桌面上 PulseAudio 多一层缓冲，延迟和 xrun 统计都不准，也优先 ALSA
+    ma_backend backends[]        = {ma_backend_alsa};
+    ma_context_config ctx_conf   = ma_context_config_init();
+    ctx_conf.allocationCallbacks = *alloc;
+    ctx_conf.threadPriority      = ma_thread_priority_realtime; // SCHED_FIFO 最高，高于解码线程; 没有权限时为普通线程
+    if (ma_context_init(backends, 1, &ctx_conf, &context) != MA_SUCCESS &&
+        ma_context_init(NULL, 0, &ctx_conf, &context) != MA_SUCCESS)
+    {
+        printf("Audio: No usable backend.\n");
+        return -1;
+    }
+    ma_log_register_callback(ma_context_get_log(&context), ma_log_callback_init(log_cb, NULL));
+
+    ma_device_config dev_conf     = ma_device_config_init(ma_device_type_playback);
+    dev_conf.playback.format      = cfg->format == ma_format_s16 ? ma_format_s16 : ma_format_f32;
+    dev_conf.periodSizeInFrames   = cfg->period_frames;
+    dev_conf.periods              = cfg->periods;
+    dev_conf.alsa.noMMap          = !cfg->mmap;
+    dev_conf.dataCallback         = data_cb;
+    dev_conf.notificationCallback = notify_cb;
+    dev_conf.pUserData            = engine;
+    if (ma_device_init(&context, &dev_conf, &device) != MA_SUCCESS)
+    {
+        printf("Audio: Failed to open playback device.\n");
+        ma_context_uninit(&context);
+        return -1;
+    }
+
+    if (device.playback.format == ma_format_s16)
+    {
+        scratch = mem_tag_alloc(MEM_TAG_AUDIO, SCRATCH_FRAMES * device.playback.channels * sizeof(float));
+        if (scratch == NULL)
+        {
+            ma_device_uninit(&device);
+            ma_context_uninit(&context);
+            return -1;
+        }
+    }
+
+    buffer_ns = (uint64_t)device.playback.internalPeriodSizeInFrames * device.playback.internalPeriods *
+                1000000000ULL / device.playback.internalSampleRate;
+    last_start_ns = 0;
+    memset(&stats, 0, sizeof(stats));
+    is_opened = true;
+    return 0;
+}
+
+ma_device *audio_out_device(void)
+{
+    return is_opened ? &device : NULL;
+}
+
+void audio_out_close(void)
+{
+    if (!is_opened)
+        return;
+    ma_device_uninit(&device);
+    ma_context_uninit(&context);
+    mem_tag_free(scratch);
+    scratch   = NULL;
+    is_opened = false;
+}
+
+void audio_out_get_stats(audio_out_stats_t *out)
+{
+    out->callbacks = __atomic_load_n(&stats.callbacks, __ATOMIC_RELAXED);
+    out->frames    = __atomic_load_n(&stats.frames, __ATOMIC_RELAXED);
+    out->xruns     = __atomic_load_n(&stats.xruns, __ATOMIC_RELAXED);
+    out->late      = __atomic_load_n(&stats.late, __ATOMIC_RELAXED);
+    out->stalls    = __atomic_load_n(&stats.stalls, __ATOMIC_RELAXED);
+    out->max_us    = __atomic_load_n(&stats.max_us, __ATOMIC_RELAXED);
+    for (int b = 0; b < AUDIO_OUT_HIST_BUCKETS; b++)
+        out->hist[b] = __atomic_load_n(&stats.hist[b], __ATOMIC_RELAXED);
+}
+
+void audio_out_report(void)
+{
+    if (!is_opened)
+    {
+        printf("Audio: device not opened\n");
+        return;
+    }
+
+    ma_uint32 rate   = device.playback.internalSampleRate;
+    ma_uint32 period = device.playback.internalPeriodSizeInFrames;
+    printf("Audio: %s, %s x%u @ %u Hz (client %s), period %u frames (%.1f ms) x%u, %s\n",
+           ma_get_backend_name(context.backend), ma_get_format_name(device.playback.internalFormat),
+           device.playback.internalChannels, rate, ma_get_format_name(device.playback.format), period,
+           period * 1000.0 / rate, device.playback.internalPeriods,
+           context.backend == ma_backend_alsa ? (device.alsa.isUsingMMapPlayback ? "mmap" : "rw") : "-");
+
+    audio_out_stats_t s;
+    audio_out_get_stats(&s);
+    printf("Audio: %llu callbacks, %llu frames, %llu xruns, %llu late, %llu stalls, max %u us\n",
+           (unsigned long long)s.callbacks, (unsigned long long)s.frames, (unsigned long long)s.xruns,
+           (unsigned long long)s.late, (unsigned long long)s.stalls, s.max_us);
+
+    // 直方图: 回调耗时占预算的百分比，只打印有数据的桶
+    printf("Audio: callback time / budget\n");
+    for (int b = 0; b < AUDIO_OUT_HIST_BUCKETS; b++)
+    {
+        if (s.hist[b] == 0)
+            continue;
+        char label[16];
+        if (b == AUDIO_OUT_HIST_BUCKETS - 1)
+            snprintf(label, sizeof(label), ">=%u%%", hist_limits[b - 1]);
+        else
+            snprintf(label, sizeof(label), "<%u%%", hist_limits[b]);
+        printf("         %-8s %10llu %5.1f%%\n", label, (unsigned long long)s.hist[b],
+               s.callbacks ? s.hist[b] * 100.0 / s.callbacks : 0.0);
+    }
+}
@@ -0,0 +1,107 @@
+#include "audio_tap.h"
+#include "mem_tag.h"
+#include <string.h>
+
+#define RING_MASK (AUDIO_TAP_RING_FRAMES - 1)
+
+struct audio_tap
+{
+    ma_node_base base; // 必须是第一个成员
+    ma_uint32 channels;
+    uint32_t write_pos; // 只由音频线程写 (release)，UI 线程读 (acquire)
+    uint32_t read_pos;  // 只由 UI 线程使用
+    float ring[AUDIO_TAP_RING_FRAMES];
+};
+
+/**
+ * @brief 音频线程: 直通节点的输出就是输入，这里只抄一份单声道样本
+ * 每帧一次加法和一次存储，与解码、混音相比可以忽略
+ */
+static void tap_process(ma_node *node, const float **frames_in, ma_uint32 *frame_count_in, float **frames_out,
+                        ma_uint32 *frame_count_out)
+{
+    (void)frames_out;
+    (void)frame_count_in;
+    audio_tap_t *tap = (audio_tap_t *)node;
+    const float *in  = frames_in[0];
+    ma_uint32 n      = *frame_count_out;
+    ma_uint32 ch     = tap->channels;
+    uint32_t pos     = tap->write_pos;
+
+    if (ch == 2)
+    {
+        for (ma_uint32 i = 0; i < n; i++)
+            tap->ring[(pos + i) & RING_MASK] = (in[i * 2] + in[i * 2 + 1]) * 0.5f;
+    }
+    else
+    {
+        float scale = 1.0f / ch;
+        for (ma_uint32 i = 0; i < n; i++)
+        {
+            float sum = 0;
+            for (ma_uint32 c = 0; c < ch; c++)
+                sum += in[i * ch + c];
+            tap->ring[(pos + i) & RING_MASK] = sum * scale;
+        }
+    }
+    __atomic_store_n(&tap->write_pos, pos + n, __ATOMIC_RELEASE);
+}
+
+static ma_node_vtable tap_vtable = {
+    tap_process, NULL, 1, 1, MA_NODE_FLAG_PASSTHROUGH,
+};
+
+audio_tap_t *audio_tap_create(ma_engine *engine)
+{
+    audio_tap_t *tap = mem_tag_calloc(MEM_TAG_AUDIO, 1, sizeof(audio_tap_t));
+    if (tap == NULL)
+        return NULL;
+
+    ma_node_graph *graph      = ma_engine_get_node_graph(engine);
+    tap->channels             = ma_engine_get_channels(engine);
+    ma_node_config config     = ma_node_config_init();
+    config.vtable             = &tap_vtable;
+    config.pInputChannels     = &tap->channels;
+    config.pOutputChannels    = &tap->channels;
+    if (ma_node_init(graph, &config, NULL, &tap->base) != MA_SUCCESS)
+    {
+        mem_tag_free(tap);
+        return NULL;
+    }
+    ma_node_attach_output_bus(&tap->base, 0, ma_engine_get_endpoint(engine), 0);
+    return tap;
+}
+
+void audio_tap_destroy(audio_tap_t *tap)
+{
+    if (tap == NULL)
+        return;
+    ma_node_uninit(&tap->base, NULL); // 同时从图上断开
+    mem_tag_free(tap);
+}
+
+ma_node *audio_tap_node(audio_tap_t *tap)
+{
+    return &tap->base;
+}
+
+uint32_t audio_tap_read_latest(audio_tap_t *tap, float *out, uint32_t n)
+{
+    uint32_t pos   = __atomic_load_n(&tap->write_pos, __ATOMIC_ACQUIRE);
+    uint32_t fresh = pos - tap->read_pos;
+    tap->read_pos  = pos;
+
+    // 最多分两段拷贝; 拷贝期间音频线程最多再写一个周期，离 n 帧之前的位置还很远
+    uint32_t start = (pos - n) & RING_MASK;
+    uint32_t first = AUDIO_TAP_RING_FRAMES - start;
+    if (first >= n)
+    {
+        memcpy(out, &tap->ring[start], n * sizeof(float));
+    }
+    else
+    {
+        memcpy(out, &tap->ring[start], first * sizeof(float));
+        memcpy(out + first, tap->ring, (n - first) * sizeof(float));
+    }
+    return fresh;
+}
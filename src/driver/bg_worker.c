@@ -0,0 +1,297 @@
+#include "bg_worker.h"
+#include <poll.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#define MAX_THREADS     4
+
+// --- 任务节点 ---
+typedef struct bg_job
+{
+    bg_job_cb_t cb;
+    bg_job_cb_t drop; // 没有执行就被丢弃时释放 arg, 可为 NULL
+    void *arg;
+    struct bg_job *next;
+} bg_job_t;
+
+typedef struct
+{
+    bg_job_t *head;
+    bg_job_t *tail;
+} job_queue_t;
+
+// --- 静态变量 ---
+static pthread_t threads[MAX_THREADS];
+static int thread_count = 0;
+static bool stopping    = false;
+
+static pthread_mutex_t job_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t job_cond  = PTHREAD_COND_INITIALIZER;
+static job_queue_t job_queues[2]; // 按 bg_prio_t 索引
+
+static pthread_mutex_t ui_lock = PTHREAD_MUTEX_INITIALIZER;
+static job_queue_t ui_queue;
+static int ui_fd = -1; // eventfd: UI 队列由空变为非空时写入，唤醒睡在 bg_worker_wait_ui 中的主循环
+
+// 轮询回调 (只在 UI 线程中读写)
+typedef struct
+{
+    bg_poll_cb_t cb;
+    void *user_data;
+} ui_poll_t;
+static ui_poll_t ui_polls[BG_UI_POLL_MAX];
+static int ui_poll_count = 0;
+
+static void queue_push(job_queue_t *q, bg_job_t *job)
+{
+    job->next = NULL;
+    if (q->tail)
+        q->tail->next = job;
+    else
+        q->head = job;
+    q->tail = job;
+}
+
+static bg_job_t *queue_pop(job_queue_t *q)
+{
+    bg_job_t *job = q->head;
+    if (job)
+    {
+        q->head = job->next;
+        if (q->head == NULL)
+            q->tail = NULL;
+    }
+    return job;
+}
+
+static void queue_drop(job_queue_t *q)
+{
+    bg_job_t *job;
+    while ((job = queue_pop(q)) != NULL)
+    {
+        if (job->drop)
+            job->drop(job->arg);
+        free(job);
+    }
+}
+
+static bg_job_t *job_new(bg_job_cb_t cb, bg_job_cb_t drop, void *arg)
+{
+    bg_job_t *job = malloc(sizeof(bg_job_t));
+    if (job)
+    {
+        job->cb   = cb;
+        job->drop = drop;
+        job->arg  = arg;
+    }
+    return job;
+}
+
+/**
+ * @brief 工作线程主循环
+ */
+static void *worker_main(void *param)
+{
+    (void)param;
+
+    pthread_mutex_lock(&job_lock);
+    while (!stopping)
+    {
+        bg_job_t *job = queue_pop(&job_queues[BG_PRIO_HIGH]);
+        if (job == NULL)
+            job = queue_pop(&job_queues[BG_PRIO_LOW]);
+
+        if (job == NULL)
+        {
+            pthread_cond_wait(&job_cond, &job_lock);
+            continue;
+        }
+
+        pthread_mutex_unlock(&job_lock);
+        job->cb(job->arg);
+        free(job);
+        pthread_mutex_lock(&job_lock);
+    }
+    pthread_mutex_unlock(&job_lock);
+
+    return NULL;
+}
+
+/**
+ * @brief 在 UI 线程中执行投递过来的回调
+ */
+static void ui_run(void)
+{
+    // 先清 eventfd 再取队列: 之后投递的回调会重新写入，不会漏掉
+    uint64_t cnt;
+    if (read(ui_fd, &cnt, sizeof(cnt)) != sizeof(cnt))
+        return;
+
+    for (int i = 0; i < ui_poll_count; i++)
+        ui_polls[i].cb(ui_polls[i].user_data);
+
+    // 一次取走整个队列，执行时不持锁
+    pthread_mutex_lock(&ui_lock);
+    bg_job_t *job = ui_queue.head;
+    ui_queue.head = ui_queue.tail = NULL;
+    pthread_mutex_unlock(&ui_lock);
+
+    while (job)
+    {
+        bg_job_t *next = job->next;
+        job->cb(job->arg);
+        free(job);
+        job = next;
+    }
+}
+
+int bg_worker_init(int thread_cnt)
+{
+    if (thread_count > 0)
+        return 0;
+
+    if (thread_cnt < 1)
+        thread_cnt = 1;
+    if (thread_cnt > MAX_THREADS)
+        thread_cnt = MAX_THREADS;
+
+    stopping = false;
+    for (int i = 0; i < thread_cnt; i++)
+    {
+        if (pthread_create(&threads[i], NULL, worker_main, NULL) != 0)
+        {
+            printf("Worker: Failed to create thread %d.\n", i);
+            break;
+        }
+        thread_count++;
+    }
+
+    if (thread_count == 0)
+        return -1;
+
+    ui_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (ui_fd < 0)
+        printf("Worker: Failed to create eventfd, UI callbacks are lost.\n");
+    printf("Worker: %d threads started.\n", thread_count);
+    return 0;
+}
+
+int bg_worker_submit(bg_prio_t prio, bg_job_cb_t cb, bg_job_cb_t drop, void *arg)
+{
+    if (thread_count == 0)
+        return -1;
+
+    bg_job_t *job = job_new(cb, drop, arg);
+    if (job == NULL)
+        return -1;
+
+    pthread_mutex_lock(&job_lock);
+    queue_push(&job_queues[prio], job);
+    pthread_cond_signal(&job_cond);
+    pthread_mutex_unlock(&job_lock);
+    return 0;
+}
+
+int bg_worker_post_ui(bg_job_cb_t cb, bg_job_cb_t drop, void *arg)
+{
+    if (ui_fd < 0)
+        return -1;
+
+    bg_job_t *job = job_new(cb, drop, arg);
+    if (job == NULL)
+        return -1;
+
+    pthread_mutex_lock(&ui_lock);
+    bool wake = ui_queue.head == NULL;
+    queue_push(&ui_queue, job);
+    pthread_mutex_unlock(&ui_lock);
+
+    // 队列本来就不空时 UI 线程已经被唤醒过，还没来得及取
+    if (wake)
+    {
+        uint64_t one = 1;
+        if (write(ui_fd, &one, sizeof(one)) != sizeof(one))
+            printf("Worker: Failed to wake the UI thread.\n");
+    }
+    return 0;
+}
+
+int bg_worker_add_ui_poll(bg_poll_cb_t cb, void *user_data)
+{
+    if (ui_poll_count >= BG_UI_POLL_MAX)
+        return -1;
+    ui_polls[ui_poll_count].cb        = cb;
+    ui_polls[ui_poll_count].user_data = user_data;
+    ui_poll_count++;
+    return 0;
+}
+
+void bg_worker_remove_ui_poll(bg_poll_cb_t cb, void *user_data)
+{
+    for (int i = 0; i < ui_poll_count; i++)
+    {
+        if (ui_polls[i].cb == cb && ui_polls[i].user_data == user_data)
+        {
+            ui_polls[i] = ui_polls[--ui_poll_count];
+            return;
+        }
+    }
+}
+
+void bg_worker_wake_ui(void)
+{
+    if (ui_fd < 0)
+        return;
+    // eventfd 计数累加，UI 线程还没醒时多次唤醒合并成一次; 可能在音频回调中，失败也不打印
+    uint64_t one = 1;
+    ssize_t n    = write(ui_fd, &one, sizeof(one));
+    (void)n;
+}
+
+void bg_worker_wait_ui(uint32_t timeout_ms)
+{
+    if (ui_fd < 0)
+    {
+        usleep(timeout_ms * 1000);
+        return;
+    }
+
+    struct pollfd pfd = {.fd = ui_fd, .events = POLLIN};
+    if (poll(&pfd, 1, (int)timeout_ms) > 0 && (pfd.revents & POLLIN))
+        ui_run();
+}
+
+void bg_worker_deinit(void)
+{
+    if (thread_count == 0)
+        return;
+
+    pthread_mutex_lock(&job_lock);
+    stopping = true;
+    pthread_cond_broadcast(&job_cond);
+    pthread_mutex_unlock(&job_lock);
+
+    for (int i = 0; i < thread_count; i++)
+        pthread_join(threads[i], NULL);
+    thread_count = 0;
+
+    pthread_mutex_lock(&job_lock);
+    queue_drop(&job_queues[BG_PRIO_HIGH]);
+    queue_drop(&job_queues[BG_PRIO_LOW]);
+    pthread_mutex_unlock(&job_lock);
+
+    pthread_mutex_lock(&ui_lock);
+    queue_drop(&ui_queue);
+    pthread_mutex_unlock(&ui_lock);
+
+    if (ui_fd >= 0)
+    {
+        close(ui_fd);
+        ui_fd = -1;
+    }
+    printf("Worker: stopped.\n");
+}
@@ -0,0 +1,73 @@
+#include "hash_table.h"
+
+uint64_t hash_table_key(const char *path)
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+    while (*path)
+    {
+        h ^= (uint8_t)*path++;
+        h *= 0x100000001b3ULL;
+    }
+    return h ? h : 1; // 0 留给空槽
+}
+
+uint32_t hash_table_probe(uint64_t key, int i, uint32_t capacity)
+{
+    return (uint32_t)((key + (uint64_t)i) % capacity);
+}
+
+uint32_t hash_table_pick(const void *entries, size_t entry_size, uint32_t capacity, int probe_max, uint64_t key,
+                         bool *free_slot)
+{
+    const uint8_t *base = entries;
+    bool found          = false;
+    uint32_t slot       = hash_table_probe(key, 0, capacity);
+
+    for (int i = 0; i < probe_max && !found; i++)
+    {
+        uint32_t idx = hash_table_probe(key, i, capacity);
+        if (*(const uint64_t *)(base + (size_t)idx * entry_size) == key)
+        {
+            slot  = idx;
+            found = true;
+        }
+    }
+    for (int i = 0; i < probe_max && !found; i++)
+    {
+        uint32_t idx = hash_table_probe(key, i, capacity);
+        if (*(const uint64_t *)(base + (size_t)idx * entry_size) == 0)
+        {
+            slot  = idx;
+            found = true;
+        }
+    }
+
+    if (free_slot)
+        *free_slot = found;
+    return slot;
+}
+
+bool hash_table_read_begin(const uint32_t *seq, uint32_t *start)
+{
+    *start = __atomic_load_n(seq, __ATOMIC_ACQUIRE);
+    return (*start & 1) == 0;
+}
+
+bool hash_table_read_end(const uint32_t *seq, uint32_t start)
+{
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(seq, __ATOMIC_RELAXED) == start;
+}
+
+uint32_t hash_table_write_begin(uint32_t *seq)
+{
+    uint32_t start = *seq | 1; // 标记为写入中
+    __atomic_store_n(seq, start, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    return start;
+}
+
+void hash_table_write_end(uint32_t *seq, uint32_t start)
+{
+    __atomic_store_n(seq, start + 1, __ATOMIC_RELEASE);
+}
@@ -0,0 +1,353 @@
+#include "img_cache.h"
+#include "mem_tag.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+typedef enum
+{
+    SLOT_EMPTY,
+    SLOT_PENDING, // 后台解码中，不能淘汰
+    SLOT_READY,
+    SLOT_FAILED // 解码失败，记住结果避免反复重试
+} slot_state_t;
+
+typedef struct
+{
+    char *path;
+    img_rot_t rot;
+    slot_state_t state;
+    uint32_t gen; // 每次复用加一，丢弃过期的结果
+    uint32_t last_use;
+    int64_t mtime;
+    img_buf_t buf;
+    lv_img_dsc_t dsc;
+    img_buf_t preview; // 整图解码完成前的低分辨率预览
+    lv_img_dsc_t preview_dsc;
+    bool timed;            // 提交了预览任务: 分别统计首帧 (预览) 和最终耗时
+    uint32_t request_tick; // 请求时刻 (lv_tick)
+} cache_slot_t;
+
+typedef struct
+{
+    cache_slot_t *slot;
+    uint32_t gen;
+    char *path;
+    img_rot_t rot;
+    uint16_t max_w;
+    uint16_t max_h;
+    int64_t mtime;
+    bool preview; // 预览任务
+    img_buf_t buf;
+    int res;
+} load_job_t;
+
+// --- 静态变量 (只在 UI 线程访问) ---
+static cache_slot_t slots[IMG_CACHE_SIZE];
+static uint32_t tick = 0;
+static img_cache_ready_cb_t ready_cb;
+static void *ready_user_data;
+static img_cache_ready_cb_t preview_cb;
+static void *preview_user_data;
+static cache_slot_t *shown; // 最近一次 img_cache_get 返回的图，可能正挂在 lv_img 上，释放内存时保留
+
+static void slot_reset(cache_slot_t *s)
+{
+    img_buf_free(&s->buf);
+    img_buf_free(&s->preview);
+    mem_tag_free(s->path);
+    s->path  = NULL;
+    s->state = SLOT_EMPTY;
+    s->gen++;
+}
+
+static cache_slot_t *find_slot(const char *path, img_rot_t rot)
+{
+    for (int i = 0; i < IMG_CACHE_SIZE; i++)
+    {
+        cache_slot_t *s = &slots[i];
+        if (s->state != SLOT_EMPTY && s->rot == rot && strcmp(s->path, path) == 0)
+            return s;
+    }
+    return NULL;
+}
+
+/**
+ * @brief 空槽 > 失败的槽 > 最久未使用的已就绪槽 (正在显示的除外)
+ */
+static cache_slot_t *alloc_slot(void)
+{
+    cache_slot_t *victim = NULL;
+    for (int i = 0; i < IMG_CACHE_SIZE; i++)
+    {
+        cache_slot_t *s = &slots[i];
+        if (s->state == SLOT_EMPTY)
+            return s;
+        if (s->state == SLOT_FAILED)
+            victim = s;
+        else if (s->state == SLOT_READY && s != shown && (victim == NULL || (victim->state == SLOT_READY && s->last_use < victim->last_use)))
+            victim = s;
+    }
+    if (victim)
+        slot_reset(victim);
+    return victim;
+}
+
+static void set_dsc(lv_img_dsc_t *dsc, const img_buf_t *buf)
+{
+    memset(dsc, 0, sizeof(lv_img_dsc_t));
+    dsc->header.cf = LV_IMG_CF_TRUE_COLOR;
+    dsc->header.w  = buf->w;
+    dsc->header.h  = buf->h;
+    dsc->data_size = (uint32_t)buf->w * buf->h * sizeof(lv_color_t);
+    dsc->data      = (const uint8_t *)buf->data;
+}
+
+/**
+ * @brief 预览解码完成: 整图还没好时保存并通知 UI
+ */
+static void preview_done(load_job_t *job)
+{
+    cache_slot_t *s = job->slot;
+    if (s->gen != job->gen || s->state != SLOT_PENDING || job->res != 0)
+        return;
+
+    img_buf_free(&s->preview);
+    s->preview    = job->buf;
+    job->buf.data = NULL; // 所有权已转移
+    set_dsc(&s->preview_dsc, &s->preview);
+    printf("Img Cache: %s first pixel after %u ms (preview %ux%u)\n", job->path, lv_tick_elaps(s->request_tick),
+           s->preview.w, s->preview.h);
+
+    if (preview_cb)
+        preview_cb(job->path, job->rot, true, preview_user_data);
+}
+
+static void load_done_cb(void *arg)
+{
+    load_job_t *job = arg;
+    cache_slot_t *s = job->slot;
+    bool ok         = job->res == 0;
+
+    if (job->preview)
+    {
+        preview_done(job);
+    }
+    else if (s->gen == job->gen)
+    {
+        img_buf_free(&s->preview);
+        if (ok)
+        {
+            s->buf   = job->buf;
+            s->mtime = job->mtime;
+            s->state = SLOT_READY;
+            set_dsc(&s->dsc, &s->buf);
+            job->buf.data = NULL; // 所有权已转移
+        }
+        else
+        {
+            s->state = SLOT_FAILED;
+        }
+
+        if (s->timed)
+        {
+            printf("Img Cache: %s final after %u ms\n", job->path, lv_tick_elaps(s->request_tick));
+            s->timed = false;
+        }
+
+        if (ready_cb)
+            ready_cb(job->path, job->rot, ok, ready_user_data);
+    }
+
+    img_buf_free(&job->buf);
+    mem_tag_free(job->path);
+    mem_tag_free(job);
+}
+
+static void load_drop(void *arg)
+{
+    load_job_t *job = arg;
+    img_buf_free(&job->buf);
+    mem_tag_free(job->path);
+    mem_tag_free(job);
+}
+
+/**
+ * @brief 后台任务: 解码并旋转
+ */
+static void load_job(void *arg)
+{
+    load_job_t *job = arg;
+
+    struct stat st;
+    job->res = -1;
+    if (stat(job->path, &st) == 0)
+    {
+        job->mtime = st.st_mtime;
+
+        // 转 90/270 度时按交换后的宽高解码，旋转后正好适配
+        bool swap    = (job->rot == IMG_ROT_90 || job->rot == IMG_ROT_270);
+        uint16_t w   = swap ? job->max_h : job->max_w;
+        uint16_t h   = swap ? job->max_w : job->max_h;
+        job->res     = job->preview ? img_loader_decode_preview(job->path, w, h, &job->buf)
+                                    : img_loader_decode_file(job->path, w, h, &job->buf);
+        if (job->res == 0 && job->rot != IMG_ROT_0)
+            job->res = img_buf_transform(&job->buf, job->rot, false);
+    }
+
+    if (bg_worker_post_ui(load_done_cb, load_drop, job) != 0)
+        load_drop(job);
+}
+
+void img_cache_set_ready_cb(img_cache_ready_cb_t cb, void *user_data)
+{
+    ready_cb        = cb;
+    ready_user_data = user_data;
+}
+
+void img_cache_set_preview_cb(img_cache_ready_cb_t cb, void *user_data)
+{
+    preview_cb        = cb;
+    preview_user_data = user_data;
+}
+
+const lv_img_dsc_t *img_cache_get_preview(const char *path, img_rot_t rot)
+{
+    cache_slot_t *s = find_slot(path, rot);
+    if (s == NULL || s->state != SLOT_PENDING || s->preview.data == NULL)
+        return NULL;
+    return &s->preview_dsc;
+}
+
+/**
+ * @brief 提交一个解码任务, preview 为 true 时只解码预览
+ */
+static int submit_job(cache_slot_t *s, const char *path, uint16_t max_w, uint16_t max_h, bool preview, bg_prio_t prio)
+{
+    load_job_t *job = mem_tag_calloc(MEM_TAG_IMAGE, 1, sizeof(load_job_t));
+    char *job_path  = mem_tag_strdup(MEM_TAG_IMAGE, path);
+    if (job == NULL || job_path == NULL)
+    {
+        mem_tag_free(job);
+        mem_tag_free(job_path);
+        return -1;
+    }
+
+    job->slot    = s;
+    job->gen     = s->gen;
+    job->path    = job_path;
+    job->rot     = s->rot;
+    job->max_w   = max_w;
+    job->max_h   = max_h;
+    job->preview = preview;
+    if (bg_worker_submit(prio, load_job, load_drop, job) != 0)
+    {
+        mem_tag_free(job->path);
+        mem_tag_free(job);
+        return -1;
+    }
+    return 0;
+}
+
+const lv_img_dsc_t *img_cache_get(const char *path, img_rot_t rot)
+{
+    cache_slot_t *s = find_slot(path, rot);
+    if (s == NULL || s->state != SLOT_READY)
+        return NULL;
+
+    // 文件被替换后作废
+    struct stat st;
+    if (stat(path, &st) != 0 || (int64_t)st.st_mtime != s->mtime)
+    {
+        slot_reset(s);
+        return NULL;
+    }
+
+    s->last_use = ++tick;
+    shown       = s;
+    return &s->dsc;
+}
+
+int img_cache_request(const char *path, img_rot_t rot, uint16_t max_w, uint16_t max_h, bg_prio_t prio)
+{
+    cache_slot_t *s = find_slot(path, rot);
+    if (s)
+    {
+        s->last_use = ++tick;
+        return (s->state == SLOT_FAILED) ? -1 : 0;
+    }
+
+    s = alloc_slot();
+    if (s == NULL)
+        return -1; // 全部在加载中或正在显示
+
+    s->path = mem_tag_strdup(MEM_TAG_IMAGE, path);
+    if (s->path == NULL)
+    {
+        slot_reset(s);
+        return -1;
+    }
+
+    s->rot          = rot;
+    s->state        = SLOT_PENDING;
+    s->last_use     = ++tick;
+    s->request_tick = lv_tick_get();
+
+    // 用户正在等的图片: 预览排在整图前面，两个 worker 同时开工，预览很快就能先显示出来
+    s->timed = prio == BG_PRIO_HIGH && submit_job(s, path, max_w, max_h, true, prio) == 0;
+
+    if (submit_job(s, path, max_w, max_h, false, prio) != 0)
+    {
+        slot_reset(s);
+        return -1;
+    }
+    return 0;
+}
+
+void img_cache_clear(void)
+{
+    for (int i = 0; i < IMG_CACHE_SIZE; i++)
+    {
+        if (&slots[i] != shown)
+            slot_reset(&slots[i]);
+    }
+}
+
+static size_t buf_bytes(const img_buf_t *buf)
+{
+    return buf->data ? (size_t)buf->w * buf->h * sizeof(lv_color_t) : 0;
+}
+
+static size_t slot_bytes(const cache_slot_t *s)
+{
+    return buf_bytes(&s->buf) + buf_bytes(&s->preview);
+}
+
+size_t img_cache_mem_usage(void)
+{
+    size_t total = 0;
+    for (int i = 0; i < IMG_CACHE_SIZE; i++)
+        total += slot_bytes(&slots[i]);
+    return total;
+}
+
+void img_cache_trim(size_t target)
+{
+    size_t usage = img_cache_mem_usage();
+    while (usage > target)
+    {
+        // 最久未使用的已就绪槽; 解码中的槽由工作线程写入，不能动
+        cache_slot_t *victim = NULL;
+        for (int i = 0; i < IMG_CACHE_SIZE; i++)
+        {
+            cache_slot_t *s = &slots[i];
+            if (s->state == SLOT_READY && s != shown && (victim == NULL || s->last_use < victim->last_use))
+                victim = s;
+        }
+        if (victim == NULL)
+            break;
+        usage -= slot_bytes(victim);
+        slot_reset(victim);
+    }
+}
@@ -0,0 +1,91 @@
+#include "img_fade.h"
+#include "lv_color_conv.h"
+#include "mem_tag.h"
+#include <stdlib.h>
+#include <string.h>
+
+struct img_fade
+{
+    uint16_t w;
+    uint16_t h;
+    lv_area_t area;   // 两张图覆盖的区域 (外面都是黑色，不用插值)
+    lv_color_t *from; // 预先贴好的两张画布
+    lv_color_t *to;
+    lv_color_t *out; // 显示用的画布
+    lv_img_dsc_t dsc;
+};
+
+/**
+ * @brief 把 src 居中贴到黑底画布上，返回贴图区域
+ */
+static void place(lv_color_t *canvas, uint16_t w, uint16_t h, const lv_img_dsc_t *src, lv_area_t *area)
+{
+    uint16_t sw = src->header.w;
+    uint16_t sh = src->header.h;
+    area->x1    = (w - sw) / 2;
+    area->y1    = (h - sh) / 2;
+    area->x2    = area->x1 + sw - 1;
+    area->y2    = area->y1 + sh - 1;
+
+    memset(canvas, 0, (size_t)w * h * sizeof(lv_color_t));
+    const lv_color_t *px = (const lv_color_t *)src->data;
+    for (uint16_t y = 0; y < sh; y++)
+        memcpy(&canvas[(area->y1 + y) * w + area->x1], &px[y * sw], sw * sizeof(lv_color_t));
+}
+
+img_fade_t *img_fade_create(const lv_img_dsc_t *from, const lv_img_dsc_t *to, uint16_t w, uint16_t h)
+{
+    if (from->header.cf != LV_IMG_CF_TRUE_COLOR || to->header.cf != LV_IMG_CF_TRUE_COLOR || from->header.w > w ||
+        from->header.h > h || to->header.w > w || to->header.h > h)
+        return NULL;
+
+    img_fade_t *fade = mem_tag_calloc(MEM_TAG_IMAGE, 1, sizeof(img_fade_t));
+    size_t size      = (size_t)w * h * sizeof(lv_color_t);
+    if (fade == NULL || (fade->from = mem_tag_alloc(MEM_TAG_IMAGE, size)) == NULL || (fade->to = mem_tag_alloc(MEM_TAG_IMAGE, size)) == NULL ||
+        (fade->out = mem_tag_alloc(MEM_TAG_IMAGE, size)) == NULL)
+    {
+        img_fade_destroy(fade);
+        return NULL;
+    }
+
+    lv_area_t a_from, a_to;
+    place(fade->from, w, h, from, &a_from);
+    place(fade->to, w, h, to, &a_to);
+    _lv_area_join(&fade->area, &a_from, &a_to);
+    memcpy(fade->out, fade->from, size);
+
+    fade->w             = w;
+    fade->h             = h;
+    fade->dsc.header.cf = LV_IMG_CF_TRUE_COLOR;
+    fade->dsc.header.w  = w;
+    fade->dsc.header.h  = h;
+    fade->dsc.data_size = size;
+    fade->dsc.data      = (const uint8_t *)fade->out;
+    return fade;
+}
+
+const lv_img_dsc_t *img_fade_step(img_fade_t *fade, uint16_t mix)
+{
+    // 两张图的区域以外在两张画布上都是黑色，只插值覆盖区域内的行段
+    uint32_t x1  = fade->area.x1;
+    uint32_t len = lv_area_get_width(&fade->area);
+    for (int32_t y = fade->area.y1; y <= fade->area.y2; y++)
+    {
+        uint32_t ofs = y * fade->w + x1;
+        lv_color_conv_rgb565_lerp((uint8_t *)&fade->out[ofs], (const uint8_t *)&fade->from[ofs],
+                                  (const uint8_t *)&fade->to[ofs], len, mix, LV_COLOR_CONV_NATIVE);
+    }
+    lv_img_cache_invalidate_src(&fade->dsc);
+    return &fade->dsc;
+}
+
+void img_fade_destroy(img_fade_t *fade)
+{
+    if (fade == NULL)
+        return;
+    lv_img_cache_invalidate_src(&fade->dsc);
+    mem_tag_free(fade->from);
+    mem_tag_free(fade->to);
+    mem_tag_free(fade->out);
+    mem_tag_free(fade);
+}
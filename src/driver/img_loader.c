@@ -0,0 +1,524 @@
+#include "img_loader.h"
+#include "img_rotate.h"
+#include "lv_color_conv.h"
+#include "lodepng.h"
+#include "mem_tag.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+#include <jpeglib.h>
+
+// --- libjpeg 错误处理: 出错时跳回调用处，而不是 exit() ---
+typedef struct
+{
+    struct jpeg_error_mgr pub;
+    jmp_buf jump;
+} jpeg_err_t;
+
+static void jpeg_error_exit(j_common_ptr cinfo)
+{
+    jpeg_err_t *err = (jpeg_err_t *)cinfo->err;
+    char msg[JMSG_LENGTH_MAX];
+    err->pub.format_message(cinfo, msg);
+    printf("Img Loader: JPEG error: %s\n", msg);
+    longjmp(err->jump, 1);
+}
+
+void img_loader_fit_size(uint32_t src_w, uint32_t src_h, uint32_t max_w, uint32_t max_h, uint16_t *out_w, uint16_t *out_h)
+{
+    uint32_t w = src_w;
+    uint32_t h = src_h;
+
+    // 只缩小不放大
+    if (w > max_w || h > max_h)
+    {
+        // 比较 max_w / src_w 与 max_h / src_h, 取较小的比例
+        if ((uint64_t)max_w * src_h <= (uint64_t)max_h * src_w)
+        {
+            w = max_w;
+            h = (uint32_t)((uint64_t)src_h * max_w / src_w);
+        }
+        else
+        {
+            h = max_h;
+            w = (uint32_t)((uint64_t)src_w * max_h / src_h);
+        }
+    }
+
+    *out_w = w ? w : 1;
+    *out_h = h ? h : 1;
+}
+
+/**
+ * @brief 区域平均缩小 (box filter)，bpp 为每像素字节数
+ */
+static void box_scale(const uint8_t *src, uint32_t sw, uint32_t sh, uint8_t *dst, uint32_t dw, uint32_t dh, uint32_t bpp)
+{
+    for (uint32_t dy = 0; dy < dh; dy++)
+    {
+        uint32_t y0 = dy * sh / dh;
+        uint32_t y1 = (dy + 1) * sh / dh;
+        if (y1 <= y0)
+            y1 = y0 + 1;
+
+        for (uint32_t dx = 0; dx < dw; dx++)
+        {
+            uint32_t x0 = dx * sw / dw;
+            uint32_t x1 = (dx + 1) * sw / dw;
+            if (x1 <= x0)
+                x1 = x0 + 1;
+
+            uint32_t sum[4] = {0};
+            for (uint32_t y = y0; y < y1; y++)
+            {
+                const uint8_t *p = &src[(y * sw + x0) * bpp];
+                for (uint32_t x = x0; x < x1; x++)
+                {
+                    for (uint32_t c = 0; c < bpp; c++)
+                        sum[c] += *p++;
+                }
+            }
+
+            uint32_t cnt = (y1 - y0) * (x1 - x0);
+            for (uint32_t c = 0; c < bpp; c++)
+                *dst++ = (uint8_t)(sum[c] / cnt);
+        }
+    }
+}
+
+/**
+ * @brief 把 RGB888/RGBA8888 图像缩放并转换成 RGB565
+ * 带 alpha 的图像与黑色背景混合 (即预乘 alpha)
+ */
+static int finish_rgb(const uint8_t *src, uint32_t sw, uint32_t sh, uint32_t bpp, uint16_t max_w, uint16_t max_h, img_buf_t *out)
+{
+    uint16_t dw, dh;
+    img_loader_fit_size(sw, sh, max_w, max_h, &dw, &dh);
+
+    // 缩放结果与 565 输出共用一块内存 (转换可以原地进行)
+    uint8_t *buf = mem_tag_alloc(MEM_TAG_IMAGE, (size_t)dw * dh * bpp);
+    if (buf == NULL)
+        return -1;
+
+    if (dw == sw && dh == sh)
+        memcpy(buf, src, (size_t)dw * dh * bpp);
+    else
+        box_scale(src, sw, sh, buf, dw, dh, bpp);
+
+    if (bpp == 4)
+        lv_color_conv_rgba8888_to_rgb565(buf, buf, (uint32_t)dw * dh, LV_COLOR_CONV_NATIVE | LV_COLOR_CONV_PREMULT);
+    else
+        lv_color_conv_rgb888_to_rgb565(buf, buf, (uint32_t)dw * dh, LV_COLOR_CONV_NATIVE);
+
+    lv_color_t *shrunk = mem_tag_realloc(MEM_TAG_IMAGE, buf, (size_t)dw * dh * sizeof(lv_color_t));
+    out->data = shrunk ? shrunk : (lv_color_t *)buf;
+    out->w    = dw;
+    out->h    = dh;
+    return 0;
+}
+
+static uint32_t exif_u32(const uint8_t *p, bool le)
+{
+    return le ? (p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24))
+              : (((uint32_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3]);
+}
+
+static uint16_t exif_u16(const uint8_t *p, bool le)
+{
+    return le ? (uint16_t)(p[0] | (p[1] << 8)) : (uint16_t)((p[0] << 8) | p[1]);
+}
+
+/**
+ * @brief 找到 APP1 (Exif) 中的 TIFF 数据 (需要先 jpeg_save_markers)
+ */
+static const uint8_t *exif_tiff(struct jpeg_decompress_struct *cinfo, uint32_t *len, bool *le)
+{
+    for (jpeg_saved_marker_ptr m = cinfo->marker_list; m; m = m->next)
+    {
+        if (m->marker != JPEG_APP0 + 1 || m->data_length < 14 || memcmp(m->data, "Exif\0\0", 6) != 0)
+            continue;
+
+        // TIFF 头: 字节序 + 第一个 IFD 的偏移
+        *len = m->data_length - 6;
+        *le  = m->data[6] == 'I';
+        return m->data + 6;
+    }
+    return NULL;
+}
+
+/**
+ * @brief 检查 TIFF 数据中 ifd 处的 IFD，返回条目数 (截断到数据内放得下的条目)，偏移越界时返回 0
+ * 偏移和计数都来自文件，比较时只用减法，不会回绕
+ */
+static uint32_t exif_ifd_count(const uint8_t *tiff, uint32_t len, uint32_t ifd, bool le)
+{
+    if (ifd > len - 2)
+        return 0;
+    uint32_t cnt = exif_u16(tiff + ifd, le);
+    uint32_t fit = (len - ifd - 2) / 12;
+    return LV_MIN(cnt, fit);
+}
+
+/**
+ * @brief 在 IFD 中查找标签，取出 SHORT / LONG 类型的值
+ * @return 找到返回 true
+ */
+static bool exif_ifd_find(const uint8_t *tiff, uint32_t len, uint32_t ifd, bool le, uint16_t tag, uint32_t *value)
+{
+    uint32_t cnt = exif_ifd_count(tiff, len, ifd, le);
+    for (uint32_t i = 0; i < cnt; i++)
+    {
+        const uint8_t *e = tiff + ifd + 2 + i * 12;
+        if (exif_u16(e, le) != tag)
+            continue;
+
+        uint16_t type = exif_u16(e + 2, le);
+        if (type == 3) // SHORT
+            *value = exif_u16(e + 8, le);
+        else if (type == 4) // LONG
+            *value = exif_u32(e + 8, le);
+        else
+            return false;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief 从 APP1 (Exif) 中读取 orientation 标签 (0x0112)，没有时返回 1
+ */
+static int exif_orientation(struct jpeg_decompress_struct *cinfo)
+{
+    uint32_t len;
+    bool le;
+    const uint8_t *tiff = exif_tiff(cinfo, &len, &le);
+    if (tiff == NULL)
+        return 1;
+
+    uint32_t v;
+    if (!exif_ifd_find(tiff, len, exif_u32(tiff + 4, le), le, 0x0112, &v))
+        return 1;
+    return (v >= 1 && v <= 8) ? (int)v : 1;
+}
+
+/**
+ * @brief IFD 之后的下一个 IFD 的偏移，没有或越界时返回 0
+ */
+static uint32_t exif_ifd_next(const uint8_t *tiff, uint32_t len, uint32_t ifd, bool le)
+{
+    if (ifd > len - 2)
+        return 0;
+    uint32_t end = exif_u16(tiff + ifd, le) * 12; // 条目结束处相对于 ifd + 2 的偏移
+    if (end > len - ifd - 2 || 4 > len - ifd - 2 - end)
+        return 0;
+    return exif_u32(tiff + ifd + 2 + end, le);
+}
+
+/**
+ * @brief 找到 EXIF 内嵌的 JPEG 缩略图 (IFD1 的 0x0201 偏移 / 0x0202 长度)
+ */
+static const uint8_t *exif_thumbnail(struct jpeg_decompress_struct *cinfo, uint32_t *size)
+{
+    uint32_t len;
+    bool le;
+    const uint8_t *tiff = exif_tiff(cinfo, &len, &le);
+    if (tiff == NULL)
+        return NULL;
+
+    // IFD0 之后紧跟着 IFD1 的偏移
+    uint32_t ifd = exif_ifd_next(tiff, len, exif_u32(tiff + 4, le), le);
+    uint32_t ofs, n;
+    if (ifd == 0 || !exif_ifd_find(tiff, len, ifd, le, 0x0201, &ofs) || !exif_ifd_find(tiff, len, ifd, le, 0x0202, &n))
+        return NULL;
+    if (ofs == 0 || n == 0 || ofs > len || n > len - ofs)
+        return NULL;
+
+    *size = n;
+    return tiff + ofs;
+}
+
+/**
+ * @brief 用 libjpeg 解码，利用 DCT 缩放 (1/2, 1/4, 1/8) 直接得到接近目标尺寸的图像
+ * preview: 优先用 EXIF 内嵌缩略图，否则固定按 1/8 解码；整图本来就按 1/8 解码时没有意义，返回 -1
+ */
+static int decode_jpeg(struct jpeg_decompress_struct *cinfo, jpeg_err_t *jerr, uint16_t max_w, uint16_t max_h, bool preview,
+                       img_buf_t *out)
+{
+    uint8_t *volatile rgb = NULL;
+
+    if (setjmp(jerr->jump))
+    {
+        mem_tag_free(rgb);
+        return -1;
+    }
+
+    jpeg_save_markers(cinfo, JPEG_APP0 + 1, 0xFFFF);
+    jpeg_read_header(cinfo, TRUE);
+
+    // 按 EXIF 方向摆正: 需要转 90/270 度时先按交换后的宽高适配
+    bool mirror;
+    img_rot_t rot  = img_rot_from_exif(exif_orientation(cinfo), &mirror);
+    bool swap      = rot == IMG_ROT_90 || rot == IMG_ROT_270;
+    uint16_t fit_w = swap ? max_h : max_w;
+    uint16_t fit_h = swap ? max_w : max_h;
+
+    // 目标尺寸, 然后选能保证不小于目标的最大缩放分母
+    uint16_t tw, th;
+    img_loader_fit_size(cinfo->image_width, cinfo->image_height, fit_w, fit_h, &tw, &th);
+    cinfo->scale_num   = 1;
+    cinfo->scale_denom = 1;
+    for (unsigned int denom = 8; denom > 1; denom /= 2)
+    {
+        if (cinfo->image_width / denom >= tw && cinfo->image_height / denom >= th)
+        {
+            cinfo->scale_denom = denom;
+            break;
+        }
+    }
+
+    if (preview)
+    {
+        if (cinfo->scale_denom == 8)
+            return -1;
+
+        uint32_t thumb_size;
+        const uint8_t *thumb = exif_thumbnail(cinfo, &thumb_size);
+        if (thumb && img_loader_decode_mem(thumb, thumb_size, fit_w, fit_h, out) == 0)
+        {
+            if (rot != IMG_ROT_0 || mirror)
+                img_buf_transform(out, rot, mirror);
+            return 0;
+        }
+        cinfo->scale_denom = 8;
+    }
+    cinfo->out_color_space = JCS_RGB;
+    cinfo->dct_method      = JDCT_IFAST;
+
+    jpeg_start_decompress(cinfo);
+
+    uint32_t w = cinfo->output_width;
+    uint32_t h = cinfo->output_height;
+    rgb        = mem_tag_alloc(MEM_TAG_IMAGE, (size_t)w * h * 3);
+    if (rgb == NULL)
+    {
+        jpeg_abort_decompress(cinfo);
+        return -1;
+    }
+
+    while (cinfo->output_scanline < h)
+    {
+        JSAMPROW row = (JSAMPROW)&rgb[(size_t)cinfo->output_scanline * w * 3];
+        jpeg_read_scanlines(cinfo, &row, 1);
+    }
+    jpeg_finish_decompress(cinfo);
+
+    int res = finish_rgb(rgb, w, h, 3, fit_w, fit_h, out);
+    mem_tag_free(rgb);
+    if (res == 0 && (rot != IMG_ROT_0 || mirror))
+        img_buf_transform(out, rot, mirror);
+    return res;
+}
+
+static int decode_png(const uint8_t *data, size_t size, uint16_t max_w, uint16_t max_h, img_buf_t *out)
+{
+    unsigned char *rgba = NULL;
+    unsigned w, h;
+    // lodepng 用 lv_mem_alloc 分配，记到 image 名下
+    mem_tag_t prev = mem_tag_scope_begin(MEM_TAG_IMAGE);
+    unsigned error = lodepng_decode32(&rgba, &w, &h, data, size);
+    mem_tag_scope_end(prev);
+    if (error)
+    {
+        printf("Img Loader: PNG error %u: %s\n", error, lodepng_error_text(error));
+        if (rgba)
+            lv_mem_free(rgba);
+        return -1;
+    }
+
+    int res = finish_rgb(rgba, w, h, 4, max_w, max_h, out);
+    lv_mem_free(rgba);
+    return res;
+}
+
+/**
+ * @brief QOI: 不透明且不需要缩小时直接解码成 RGB565，否则经 RGBA8888 缩放
+ */
+static int decode_qoi(const uint8_t *data, size_t size, uint16_t max_w, uint16_t max_h, img_buf_t *out)
+{
+    lv_qoi_header_t qoi;
+    if (lv_qoi_read_header(data, size, &qoi) != LV_RES_OK)
+        return -1;
+
+    uint16_t dw, dh;
+    img_loader_fit_size(qoi.w, qoi.h, max_w, max_h, &dw, &dh);
+    if (qoi.channels == 3 && dw == qoi.w && dh == qoi.h)
+    {
+        out->data = mem_tag_alloc(MEM_TAG_IMAGE, (size_t)dw * dh * sizeof(lv_color_t));
+        if (out->data == NULL || lv_qoi_decode_rgb565(data, size, (uint8_t *)out->data, NULL) != LV_RES_OK)
+        {
+            printf("Img Loader: QOI data corrupted\n");
+            img_buf_free(out);
+            return -1;
+        }
+        out->w = dw;
+        out->h = dh;
+        return 0;
+    }
+
+    uint8_t *rgba = mem_tag_alloc(MEM_TAG_IMAGE, (size_t)qoi.w * qoi.h * 4);
+    int res       = -1;
+    if (rgba && lv_qoi_decode_rgba8888(data, size, rgba) == LV_RES_OK)
+        res = finish_rgb(rgba, qoi.w, qoi.h, 4, max_w, max_h, out);
+    mem_tag_free(rgba);
+    return res;
+}
+
+static bool is_jpeg(const uint8_t *magic, size_t len)
+{
+    return len >= 2 && magic[0] == 0xFF && magic[1] == 0xD8;
+}
+
+static bool is_png(const uint8_t *magic, size_t len)
+{
+    return len >= 4 && magic[0] == 0x89 && magic[1] == 'P' && magic[2] == 'N' && magic[3] == 'G';
+}
+
+static bool is_qoi(const uint8_t *magic, size_t len)
+{
+    return len >= 4 && memcmp(magic, "qoif", 4) == 0;
+}
+
+int img_loader_decode_mem(const uint8_t *data, size_t size, uint16_t max_w, uint16_t max_h, img_buf_t *out)
+{
+    memset(out, 0, sizeof(img_buf_t));
+
+    if (is_png(data, size))
+        return decode_png(data, size, max_w, max_h, out);
+
+    if (is_qoi(data, size))
+        return decode_qoi(data, size, max_w, max_h, out);
+
+    if (is_jpeg(data, size))
+    {
+        struct jpeg_decompress_struct cinfo;
+        jpeg_err_t jerr;
+        cinfo.err           = jpeg_std_error(&jerr.pub);
+        jerr.pub.error_exit = jpeg_error_exit;
+        jpeg_create_decompress(&cinfo);
+        jpeg_mem_src(&cinfo, (unsigned char *)data, size);
+        int res = decode_jpeg(&cinfo, &jerr, max_w, max_h, false, out);
+        jpeg_destroy_decompress(&cinfo);
+        return res;
+    }
+
+    return -1;
+}
+
+int img_loader_decode_file(const char *path, uint16_t max_w, uint16_t max_h, img_buf_t *out)
+{
+    memset(out, 0, sizeof(img_buf_t));
+
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL)
+        return -1;
+
+    uint8_t magic[4];
+    size_t magic_len = fread(magic, 1, sizeof(magic), fp);
+    rewind(fp);
+
+    int res = -1;
+    if (is_jpeg(magic, magic_len))
+    {
+        // JPEG 边读边解码，不需要把整个文件读进内存
+        struct jpeg_decompress_struct cinfo;
+        jpeg_err_t jerr;
+        cinfo.err           = jpeg_std_error(&jerr.pub);
+        jerr.pub.error_exit = jpeg_error_exit;
+        jpeg_create_decompress(&cinfo);
+        jpeg_stdio_src(&cinfo, fp);
+        res = decode_jpeg(&cinfo, &jerr, max_w, max_h, false, out);
+        jpeg_destroy_decompress(&cinfo);
+    }
+    else if (is_png(magic, magic_len) || is_qoi(magic, magic_len))
+    {
+        fseek(fp, 0, SEEK_END);
+        long size = ftell(fp);
+        rewind(fp);
+
+        uint8_t *data = (size > 0) ? mem_tag_alloc(MEM_TAG_IMAGE, size) : NULL;
+        if (data && fread(data, 1, size, fp) == (size_t)size)
+            res = is_png(magic, magic_len) ? decode_png(data, size, max_w, max_h, out) : decode_qoi(data, size, max_w, max_h, out);
+        mem_tag_free(data);
+    }
+
+    fclose(fp);
+    if (res != 0)
+        printf("Img Loader: Failed to decode %s\n", path);
+    return res;
+}
+
+int img_loader_decode_preview(const char *path, uint16_t max_w, uint16_t max_h, img_buf_t *out)
+{
+    memset(out, 0, sizeof(img_buf_t));
+
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL)
+        return -1;
+
+    uint8_t magic[2];
+    size_t magic_len = fread(magic, 1, sizeof(magic), fp);
+    rewind(fp);
+
+    int res = -1;
+    if (is_jpeg(magic, magic_len))
+    {
+        struct jpeg_decompress_struct cinfo;
+        jpeg_err_t jerr;
+        cinfo.err           = jpeg_std_error(&jerr.pub);
+        jerr.pub.error_exit = jpeg_error_exit;
+        jpeg_create_decompress(&cinfo);
+        jpeg_stdio_src(&cinfo, fp);
+        res = decode_jpeg(&cinfo, &jerr, max_w, max_h, true, out);
+        jpeg_destroy_decompress(&cinfo);
+    }
+
+    fclose(fp);
+    return res;
+}
+
+int img_loader_jpeg_header(const char *path, uint32_t *w, uint32_t *h, int *orientation)
+{
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL)
+        return -1;
+
+    struct jpeg_decompress_struct cinfo;
+    jpeg_err_t jerr;
+    cinfo.err           = jpeg_std_error(&jerr.pub);
+    jerr.pub.error_exit = jpeg_error_exit;
+    jpeg_create_decompress(&cinfo);
+
+    int res = -1;
+    if (setjmp(jerr.jump) == 0)
+    {
+        // jpeg_read_header 读到 SOS 为止，不解码任何扫描数据
+        jpeg_stdio_src(&cinfo, fp);
+        jpeg_save_markers(&cinfo, JPEG_APP0 + 1, 0xFFFF);
+        jpeg_read_header(&cinfo, TRUE);
+        *w           = cinfo.image_width;
+        *h           = cinfo.image_height;
+        *orientation = exif_orientation(&cinfo);
+        res          = 0;
+    }
+    jpeg_destroy_decompress(&cinfo);
+    fclose(fp);
+    return res;
+}
+
+void img_buf_free(img_buf_t *buf)
+{
+    mem_tag_free(buf->data);
+    buf->data = NULL;
+    buf->w = buf->h = 0;
+}
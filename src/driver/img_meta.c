@@ -0,0 +1,441 @@
+#include "img_meta.h"
+#include "hash_table.h"
+#include "img_loader.h"
+#include "lvgl.h"
+#include "lv_gc.h"
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+ * 索引文件布局:
+ *   [index_header_t][meta_entry_t x META_CAPACITY]
+ * 条目用开放寻址哈希表存放 (hash_table.h，与缩略图 pack 相同)，按路径哈希 + mtime + 文件大小匹配。
+ *
+ * LVGL 打开图片 (lv_img_decoder_open) 时会把每个真正的解码器的 info_cb 再问一遍，它们都要读文件头。
+ * 这里的解码器也提供 open_cb: 命中索引时头信息直接来自索引，再把打开转交给处理这种格式的解码器，
+ * 不再逐个询问。格式到解码器的对应在本次运行中第一次遇到这种格式时由询问结果得到。
+ */
+
+#define INDEX_MAGIC   0x4154454D // "META"
+#define INDEX_VERSION 1
+#define PROBE_MAX     8    // 最多探测的槽位数
+#define HEAD_LEN      1024 // 读取的文件头长度 (PNG 的 tRNS 一般在 PLTE 之后，IDAT 之前)
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t capacity;
+    uint32_t reserved;
+} index_header_t;
+
+typedef struct
+{
+    uint64_t key;   // 路径哈希, 0 表示空槽
+    int64_t mtime;  // 源文件修改时间
+    uint64_t size;  // 源文件大小
+    uint32_t w;
+    uint32_t h;
+    uint8_t format; // media_type_t
+    uint8_t cf;     // lv_img_cf_t, 0 表示未知
+    uint8_t has_alpha;
+    uint8_t orientation;
+    uint32_t seq;   // 奇数: 写入中, 偶数: 稳定 (只增不减)
+} meta_entry_t;
+
+// --- 静态变量 ---
+static int index_fd                   = -1;
+static uint8_t *index_base            = NULL;
+static size_t index_size              = 0;
+static meta_entry_t *entries          = NULL;
+static lv_img_decoder_t *meta_decoder = NULL;
+static pthread_mutex_t write_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// --- LVGL 解码器 (UI 线程) ---
+static lv_img_decoder_t *format_decoders[_MEDIA_TYPE_NUM]; // 处理每种格式的解码器，第一次询问时记下
+static lv_img_decoder_t *open_decoder;                     // 最近一次 info_cb 选出的解码器，open_cb 转交给它
+static media_type_t open_format;                           // 以及它对应的格式和 src
+static char open_src[PATH_MAX];
+
+/**
+ * @brief 在 seq 一致的前提下判断条目是否与 key/mtime/size 匹配，匹配时复制出内容
+ */
+static bool entry_matches(meta_entry_t *e, uint64_t key, const struct stat *st, img_meta_t *meta)
+{
+    uint32_t seq;
+    if (!hash_table_read_begin(&e->seq, &seq))
+        return false;
+
+    bool match        = e->key == key && e->mtime == (int64_t)st->st_mtime && e->size == (uint64_t)st->st_size;
+    meta->format      = (media_type_t)e->format;
+    meta->w           = e->w;
+    meta->h           = e->h;
+    meta->cf          = e->cf;
+    meta->has_alpha   = e->has_alpha;
+    meta->orientation = e->orientation;
+
+    return match && hash_table_read_end(&e->seq, seq);
+}
+
+static bool lookup_stat(const char *path, const struct stat *st, img_meta_t *meta)
+{
+    if (index_base == NULL)
+        return false;
+
+    uint64_t key = hash_table_key(path);
+    for (int i = 0; i < PROBE_MAX; i++)
+    {
+        if (entry_matches(&entries[hash_table_probe(key, i, META_CAPACITY)], key, st, meta))
+            return true;
+    }
+    return false;
+}
+
+static void store(const char *path, const struct stat *st, const img_meta_t *meta)
+{
+    if (index_base == NULL)
+        return;
+
+    uint64_t key = hash_table_key(path);
+    pthread_mutex_lock(&write_lock);
+
+    meta_entry_t *e = &entries[hash_table_pick(entries, sizeof(meta_entry_t), META_CAPACITY, PROBE_MAX, key, NULL)];
+    uint32_t seq    = hash_table_write_begin(&e->seq);
+    e->key          = key;
+    e->mtime        = st->st_mtime;
+    e->size         = st->st_size;
+    e->w            = meta->w;
+    e->h            = meta->h;
+    e->format       = (uint8_t)meta->format;
+    e->cf           = meta->cf;
+    e->has_alpha    = meta->has_alpha;
+    e->orientation  = meta->orientation;
+    hash_table_write_end(&e->seq, seq);
+
+    pthread_mutex_unlock(&write_lock);
+}
+
+static uint32_t be32(const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static uint16_t le16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+/**
+ * @brief PNG: IHDR 的颜色类型带 alpha，或者在 IDAT 之前出现 tRNS
+ */
+static bool png_has_alpha(const uint8_t *head, size_t n)
+{
+    uint8_t color_type = head[25];
+    if (color_type == 4 || color_type == 6)
+        return true;
+
+    size_t ofs = 8;
+    while (ofs + 8 <= n)
+    {
+        const uint8_t *type = head + ofs + 4;
+        if (memcmp(type, "tRNS", 4) == 0)
+            return true;
+        if (memcmp(type, "IDAT", 4) == 0)
+            break;
+        ofs += 12 + (size_t)be32(head + ofs);
+    }
+    return false;
+}
+
+/**
+ * @brief 只读取文件头得到尺寸等信息，不解码
+ */
+static int probe(const char *path, img_meta_t *meta)
+{
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL)
+        return -1;
+
+    uint8_t head[HEAD_LEN];
+    size_t n = fread(head, 1, sizeof(head), fp);
+    fclose(fp);
+
+    memset(meta, 0, sizeof(img_meta_t));
+    meta->format      = media_sniff(head, n);
+    meta->orientation = 1;
+
+    switch (meta->format)
+    {
+    case MEDIA_TYPE_PNG:
+        if (n < 33)
+            return -1;
+        meta->w         = be32(head + 16);
+        meta->h         = be32(head + 20);
+        meta->has_alpha = png_has_alpha(head, n);
+        break;
+    case MEDIA_TYPE_QOI:
+        if (n < 14)
+            return -1;
+        meta->w         = be32(head + 4);
+        meta->h         = be32(head + 8);
+        meta->has_alpha = head[12] == 4;
+        break;
+    case MEDIA_TYPE_GIF:
+        if (n < 10)
+            return -1;
+        meta->w         = le16(head + 6);
+        meta->h         = le16(head + 8);
+        meta->has_alpha = true; // 逐帧的透明色只有解码时才知道，lv_gif 的画布总是带 alpha
+        break;
+    case MEDIA_TYPE_SJPG:
+        if (n < 18)
+            return -1;
+        meta->w = le16(head + 14);
+        meta->h = le16(head + 16);
+        break;
+    case MEDIA_TYPE_JPEG:
+    {
+        int orientation;
+        if (img_loader_jpeg_header(path, &meta->w, &meta->h, &orientation) != 0)
+            return -1;
+        meta->orientation = (uint8_t)orientation;
+        break;
+    }
+    default:
+        return -1;
+    }
+
+    return (meta->w > 0 && meta->h > 0) ? 0 : -1;
+}
+
+// =============================================================
+// LVGL 解码器: 头信息来自索引，打开时转交给真正的解码器
+// =============================================================
+
+/**
+ * @brief "S:xxx" 换成真实路径
+ */
+static bool lvgl_real_path(const char *src, char *buf, size_t size)
+{
+#if LV_USE_FS_POSIX
+    if (src[0] == LV_FS_POSIX_LETTER && src[1] == ':')
+        return (size_t)snprintf(buf, size, "%s%s", LV_FS_POSIX_PATH, src + 2) < size;
+#endif
+    return false;
+}
+
+/**
+ * @brief 依次询问后面的解码器，返回第一个认得这张图的 (会读文件头)
+ */
+static lv_img_decoder_t *ask_decoders(lv_img_decoder_t *self, const void *src, lv_img_header_t *header)
+{
+    lv_img_decoder_t *d;
+    _LV_LL_READ(&LV_GC_ROOT(_lv_img_decoder_ll), d)
+    {
+        if (d == self || d->info_cb == NULL || d->open_cb == NULL)
+            continue;
+        if (d->info_cb(d, src, header) == LV_RES_OK)
+            return d;
+    }
+    return NULL;
+}
+
+/**
+ * @brief 记下 src 由哪个解码器打开 (NULL: 格式本次运行还没见过，打开时再问)
+ */
+static void set_open_decoder(const char *src, media_type_t format, lv_img_decoder_t *d)
+{
+    open_decoder = d;
+    open_format  = format;
+    if ((size_t)snprintf(open_src, sizeof(open_src), "%s", src) >= sizeof(open_src))
+        open_src[0] = '\0';
+}
+
+static lv_res_t meta_info_cb(lv_img_decoder_t *decoder, const void *src, lv_img_header_t *header)
+{
+    open_src[0] = '\0';
+    if (lv_img_src_get_type(src) != LV_IMG_SRC_FILE)
+        return LV_RES_INV;
+
+    char path[PATH_MAX];
+    struct stat st;
+    if (!lvgl_real_path(src, path, sizeof(path)) || stat(path, &st) != 0)
+        return LV_RES_INV;
+
+    img_meta_t meta;
+    bool known = lookup_stat(path, &st, &meta);
+    if (known && meta.cf != LV_IMG_CF_UNKNOWN)
+    {
+        header->always_zero = 0;
+        header->cf          = meta.cf;
+        header->w           = meta.w;
+        header->h           = meta.h;
+        set_open_decoder(src, meta.format, meta.format < _MEDIA_TYPE_NUM ? format_decoders[meta.format] : NULL);
+        return LV_RES_OK;
+    }
+
+    // 未命中: 交给后面的解码器读文件头，把结果记下来
+    lv_img_decoder_t *d = ask_decoders(decoder, src, header);
+    if (d == NULL)
+        return LV_RES_INV;
+
+    if (!known && probe(path, &meta) != 0)
+    {
+        // 格式未知 (例如 imgpack 的图片)，只记 LVGL 给出的信息
+        memset(&meta, 0, sizeof(meta));
+        meta.w           = header->w;
+        meta.h           = header->h;
+        meta.has_alpha   = lv_img_cf_has_alpha(header->cf);
+        meta.orientation = 1;
+    }
+    if (meta.format != MEDIA_TYPE_UNKNOWN && meta.format < _MEDIA_TYPE_NUM)
+        format_decoders[meta.format] = d;
+    set_open_decoder(src, meta.format, d);
+
+    // 解码器给出的尺寸与文件头不一致 (被解码器裁剪过) 时不缓存 cf，下次仍然交给解码器
+    if (meta.w == header->w && meta.h == header->h)
+    {
+        meta.cf = header->cf;
+        store(path, &st, &meta);
+    }
+    return LV_RES_OK;
+}
+
+/**
+ * @brief 紧跟在 meta_info_cb 之后调用 (lv_img_decoder_open)，dsc->header 已经是索引里的头信息
+ * 直接交给处理这种格式的解码器打开; 失败时返回 LV_RES_INV，LVGL 接着按原来的方式逐个尝试
+ */
+static lv_res_t meta_open_cb(lv_img_decoder_t *decoder, lv_img_decoder_dsc_t *dsc)
+{
+    if (dsc->src_type != LV_IMG_SRC_FILE || open_src[0] == '\0' || strcmp(dsc->src, open_src) != 0)
+        return LV_RES_INV;
+
+    lv_img_decoder_t *d = open_decoder;
+    if (d == NULL)
+    {
+        // 索引命中，但这种格式本次运行还是第一次打开: 问一次由哪个解码器处理
+        lv_img_header_t header;
+        d = ask_decoders(decoder, dsc->src, &header);
+        if (d == NULL)
+            return LV_RES_INV;
+        if (open_format != MEDIA_TYPE_UNKNOWN && open_format < _MEDIA_TYPE_NUM)
+            format_decoders[open_format] = d;
+    }
+
+    // 之后的 read_line / close 由它处理
+    dsc->decoder = d;
+    return d->open_cb(d, dsc);
+}
+
+// =============================================================
+// 公共接口
+// =============================================================
+
+int img_meta_open(const char *index_path)
+{
+    if (index_base)
+        return 0;
+
+    size_t total = sizeof(index_header_t) + META_CAPACITY * sizeof(meta_entry_t);
+
+    index_fd = open(index_path, O_RDWR | O_CREAT, 0644);
+    if (index_fd < 0)
+    {
+        perror("Meta: cannot open index file");
+        return -1;
+    }
+
+    struct stat st;
+    fstat(index_fd, &st);
+    bool fresh = (size_t)st.st_size != total;
+    if (fresh && (ftruncate(index_fd, 0) != 0 || ftruncate(index_fd, total) != 0))
+    {
+        perror("Meta: cannot resize index file");
+        close(index_fd);
+        index_fd = -1;
+        return -1;
+    }
+
+    index_base = mmap(NULL, total, PROT_READ | PROT_WRITE, MAP_SHARED, index_fd, 0);
+    if (index_base == MAP_FAILED)
+    {
+        perror("Meta: mmap failed");
+        index_base = NULL;
+        close(index_fd);
+        index_fd = -1;
+        return -1;
+    }
+    index_size = total;
+
+    index_header_t *hdr = (index_header_t *)index_base;
+    entries             = (meta_entry_t *)(index_base + sizeof(index_header_t));
+
+    if (fresh || hdr->magic != INDEX_MAGIC || hdr->version != INDEX_VERSION || hdr->capacity != META_CAPACITY)
+    {
+        memset(entries, 0, META_CAPACITY * sizeof(meta_entry_t));
+        hdr->magic    = INDEX_MAGIC;
+        hdr->version  = INDEX_VERSION;
+        hdr->capacity = META_CAPACITY;
+        printf("Meta: New index %s\n", index_path);
+    }
+
+    // 后创建的解码器在链表最前面，先于所有真正的解码器被询问
+    meta_decoder = lv_img_decoder_create();
+    if (meta_decoder)
+    {
+        lv_img_decoder_set_info_cb(meta_decoder, meta_info_cb);
+        lv_img_decoder_set_open_cb(meta_decoder, meta_open_cb);
+    }
+
+    return 0;
+}
+
+void img_meta_close(void)
+{
+    if (meta_decoder)
+    {
+        lv_img_decoder_delete(meta_decoder);
+        meta_decoder = NULL;
+        memset(format_decoders, 0, sizeof(format_decoders));
+        open_decoder = NULL;
+        open_src[0]  = '\0';
+    }
+    if (index_base)
+    {
+        msync(index_base, index_size, MS_SYNC);
+        munmap(index_base, index_size);
+        index_base = NULL;
+        entries    = NULL;
+    }
+    if (index_fd >= 0)
+    {
+        close(index_fd);
+        index_fd = -1;
+    }
+}
+
+bool img_meta_lookup(const char *path, img_meta_t *meta)
+{
+    struct stat st;
+    return stat(path, &st) == 0 && lookup_stat(path, &st, meta);
+}
+
+int img_meta_get(const char *path, img_meta_t *meta)
+{
+    struct stat st;
+    if (stat(path, &st) != 0)
+        return -1;
+    if (lookup_stat(path, &st, meta))
+        return 0;
+
+    if (probe(path, meta) != 0)
+        return -1;
+    store(path, &st, meta);
+    return 0;
+}
@@ -0,0 +1,224 @@
+#include "img_rotate.h"
+#include "lv_color_conv.h"
+#include "mem_tag.h"
+#include <stdlib.h>
+#include <string.h>
+
+#if LV_COLOR_CONV_USE_NEON
+#include <arm_neon.h>
+#endif
+
+/*
+ * 90/270 度旋转就是转置再翻转一个方向。按 BLOCK x BLOCK 分块处理，
+ * 一块的源行和目标行都留在 L1 里；块内用 8x8 的转置核 (NEON 下为 3 轮 vtrn)。
+ */
+
+#define BLOCK 32 // 32x32x2 字节 = 2KB, 源块 + 目标块远小于 L1
+
+/**
+ * @brief 一个像素的目标位置
+ */
+static inline void scalar_rotate_px(uint16_t *dst, const uint16_t *src, uint32_t w, uint32_t h, img_rot_t rot,
+                                    uint32_t x, uint32_t y)
+{
+    uint16_t c = src[y * w + x];
+    switch (rot)
+    {
+        case IMG_ROT_90:
+            dst[x * h + (h - 1 - y)] = c;
+            break;
+        case IMG_ROT_270:
+            dst[(w - 1 - x) * h + y] = c;
+            break;
+        default:
+            break;
+    }
+}
+
+#if LV_COLOR_CONV_USE_NEON
+/**
+ * @brief 8x8 转置: 读 src 的 8 行 8 列, 结果 o[k] 为第 k 列
+ */
+static inline void neon_transpose_8x8(const uint16_t *src, uint32_t stride, uint16x8_t o[8])
+{
+    uint16x8x2_t t01 = vtrnq_u16(vld1q_u16(src + 0 * stride), vld1q_u16(src + 1 * stride));
+    uint16x8x2_t t23 = vtrnq_u16(vld1q_u16(src + 2 * stride), vld1q_u16(src + 3 * stride));
+    uint16x8x2_t t45 = vtrnq_u16(vld1q_u16(src + 4 * stride), vld1q_u16(src + 5 * stride));
+    uint16x8x2_t t67 = vtrnq_u16(vld1q_u16(src + 6 * stride), vld1q_u16(src + 7 * stride));
+
+    uint32x4x2_t u02 = vtrnq_u32(vreinterpretq_u32_u16(t01.val[0]), vreinterpretq_u32_u16(t23.val[0]));
+    uint32x4x2_t u13 = vtrnq_u32(vreinterpretq_u32_u16(t01.val[1]), vreinterpretq_u32_u16(t23.val[1]));
+    uint32x4x2_t u46 = vtrnq_u32(vreinterpretq_u32_u16(t45.val[0]), vreinterpretq_u32_u16(t67.val[0]));
+    uint32x4x2_t u57 = vtrnq_u32(vreinterpretq_u32_u16(t45.val[1]), vreinterpretq_u32_u16(t67.val[1]));
+
+    uint16x8_t a0 = vreinterpretq_u16_u32(u02.val[0]);
+    uint16x8_t a1 = vreinterpretq_u16_u32(u13.val[0]);
+    uint16x8_t a2 = vreinterpretq_u16_u32(u02.val[1]);
+    uint16x8_t a3 = vreinterpretq_u16_u32(u13.val[1]);
+    uint16x8_t b0 = vreinterpretq_u16_u32(u46.val[0]);
+    uint16x8_t b1 = vreinterpretq_u16_u32(u57.val[0]);
+    uint16x8_t b2 = vreinterpretq_u16_u32(u46.val[1]);
+    uint16x8_t b3 = vreinterpretq_u16_u32(u57.val[1]);
+
+    o[0] = vcombine_u16(vget_low_u16(a0), vget_low_u16(b0));
+    o[1] = vcombine_u16(vget_low_u16(a1), vget_low_u16(b1));
+    o[2] = vcombine_u16(vget_low_u16(a2), vget_low_u16(b2));
+    o[3] = vcombine_u16(vget_low_u16(a3), vget_low_u16(b3));
+    o[4] = vcombine_u16(vget_high_u16(a0), vget_high_u16(b0));
+    o[5] = vcombine_u16(vget_high_u16(a1), vget_high_u16(b1));
+    o[6] = vcombine_u16(vget_high_u16(a2), vget_high_u16(b2));
+    o[7] = vcombine_u16(vget_high_u16(a3), vget_high_u16(b3));
+}
+
+static inline uint16x8_t neon_reverse(uint16x8_t v)
+{
+    v = vrev64q_u16(v);
+    return vcombine_u16(vget_high_u16(v), vget_low_u16(v));
+}
+#endif
+
+/**
+ * @brief 旋转一块 [x0, x1) x [y0, y1)
+ */
+static void rotate_block(uint16_t *dst, const uint16_t *src, uint32_t w, uint32_t h, img_rot_t rot,
+                         uint32_t x0, uint32_t x1, uint32_t y0, uint32_t y1)
+{
+    uint32_t y = y0;
+
+#if LV_COLOR_CONV_USE_NEON
+    for (; y + 8 <= y1; y += 8)
+    {
+        uint32_t x = x0;
+        for (; x + 8 <= x1; x += 8)
+        {
+            uint16x8_t col[8];
+            neon_transpose_8x8(&src[y * w + x], w, col);
+            for (int k = 0; k < 8; k++)
+            {
+                if (rot == IMG_ROT_90)
+                    vst1q_u16(&dst[(x + k) * h + (h - 8 - y)], neon_reverse(col[k]));
+                else
+                    vst1q_u16(&dst[(w - 1 - x - k) * h + y], col[k]);
+            }
+        }
+        for (uint32_t yy = y; yy < y + 8; yy++)
+        {
+            for (uint32_t xx = x; xx < x1; xx++)
+                scalar_rotate_px(dst, src, w, h, rot, xx, yy);
+        }
+    }
+#endif
+
+    for (; y < y1; y++)
+    {
+        for (uint32_t x = x0; x < x1; x++)
+            scalar_rotate_px(dst, src, w, h, rot, x, y);
+    }
+}
+
+static void rotate_180(uint16_t *dst, const uint16_t *src, uint32_t w, uint32_t h)
+{
+    for (uint32_t y = 0; y < h; y++)
+    {
+        const uint16_t *s = &src[y * w];
+        uint16_t *d       = &dst[(h - 1 - y) * w + w];
+        uint32_t x        = 0;
+#if LV_COLOR_CONV_USE_NEON
+        for (; x + 8 <= w; x += 8)
+        {
+            d -= 8;
+            vst1q_u16(d, neon_reverse(vld1q_u16(s + x)));
+        }
+#endif
+        for (; x < w; x++)
+            *--d = s[x];
+    }
+}
+
+void img_rotate_565(lv_color_t *dst, const lv_color_t *src, uint32_t w, uint32_t h, img_rot_t rot)
+{
+    uint16_t *d       = (uint16_t *)dst;
+    const uint16_t *s = (const uint16_t *)src;
+
+    switch (rot)
+    {
+        case IMG_ROT_0:
+            memcpy(d, s, (size_t)w * h * 2);
+            break;
+        case IMG_ROT_180:
+            rotate_180(d, s, w, h);
+            break;
+        case IMG_ROT_90:
+        case IMG_ROT_270:
+            for (uint32_t by = 0; by < h; by += BLOCK)
+            {
+                for (uint32_t bx = 0; bx < w; bx += BLOCK)
+                    rotate_block(d, s, w, h, rot, bx, LV_MIN(bx + BLOCK, w), by, LV_MIN(by + BLOCK, h));
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+void img_flip_h_565(lv_color_t *px, uint32_t w, uint32_t h)
+{
+    for (uint32_t y = 0; y < h; y++)
+    {
+        lv_color_t *l = &px[y * w];
+        lv_color_t *r = l + w - 1;
+        while (l < r)
+        {
+            lv_color_t c = *l;
+            *l++         = *r;
+            *r--         = c;
+        }
+    }
+}
+
+img_rot_t img_rot_from_exif(int orientation, bool *mirror)
+{
+    // 2/4/5/7 带镜像: 先水平翻转, 再旋转
+    *mirror = (orientation == 2 || orientation == 4 || orientation == 5 || orientation == 7);
+    switch (orientation)
+    {
+        case 3:
+        case 4:
+            return IMG_ROT_180;
+        case 6:
+        case 7:
+            return IMG_ROT_90;
+        case 5:
+        case 8:
+            return IMG_ROT_270;
+        default:
+            return IMG_ROT_0;
+    }
+}
+
+int img_buf_transform(img_buf_t *buf, img_rot_t rot, bool mirror)
+{
+    if (mirror)
+        img_flip_h_565(buf->data, buf->w, buf->h);
+    if (rot == IMG_ROT_0)
+        return 0;
+
+    lv_color_t *out = mem_tag_alloc(MEM_TAG_IMAGE, (size_t)buf->w * buf->h * sizeof(lv_color_t));
+    if (out == NULL)
+    {
+        if (mirror)
+            img_flip_h_565(buf->data, buf->w, buf->h); // 恢复
+        return -1;
+    }
+
+    img_rotate_565(out, buf->data, buf->w, buf->h, rot);
+    mem_tag_free(buf->data);
+    buf->data = out;
+    if (rot != IMG_ROT_180)
+    {
+        uint16_t t = buf->w;
+        buf->w     = buf->h;
+        buf->h     = t;
+    }
+    return 0;
+}
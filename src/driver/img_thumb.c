@@ -0,0 +1,408 @@
+#include "img_thumb.h"
+#include "hash_table.h"
+#include "img_loader.h"
+#include "mem_tag.h"
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+ * pack 文件布局:
+ *   [pack_header_t][pack_entry_t x THUMB_TABLE_MAX] ... 页对齐 ... [tile x tile_count]
+ * 条目用开放寻址哈希表存放 (hash_table.h)，只用前 capacity 个槽位，装填率超过一半时翻倍 (槽位区是稀疏的，没用到的不占磁盘)。
+ * 条目里记着 tile 编号。写入方 (后台线程) 用 seq 做顺序锁: 奇数表示正在写，读取方 (UI 线程) 读到奇数或前后不一致就当作未命中。
+ *
+ * tile 只追加不改写 (写时复制): 重新生成或者挤掉别的条目时，新缩略图写进新追加的 tile，再把条目指过去，
+ * 旧 tile 原样留着。UI 拿到的指针在 pack 打开期间一直有效，屏幕上的缩略图不会被写到一半。
+ * 整个文件的地址空间在打开时一次预留 (PROT_NONE)，文件变长时在原地接着映射，已有的指针不会移动。
+ * 不再被引用的 tile 在下次打开时整理掉 (那时 UI 还没有拿到指针)。
+ */
+
+#define PACK_MAGIC      0x424D4854 // "THMB"
+#define PACK_VERSION    2
+#define PROBE_MAX       16    // 最多探测的槽位数 (线性探测，装填率 0.5 时 8 个常常不够)
+#define THUMB_TABLE_MIN 2048  // 新建时的槽位数
+#define THUMB_TABLE_MAX (THUMB_MAX * 2)
+#define TILE_CHUNK      256   // 文件每次增长的 tile 数 (约 2MB)
+#define TILE_BYTES      (THUMB_W * THUMB_H * sizeof(lv_color_t))
+#define PAGE_ALIGN(x)   (((x) + 4095) & ~(size_t)4095)
+#define TILES_OFS       PAGE_ALIGN(sizeof(pack_header_t) + THUMB_TABLE_MAX * sizeof(pack_entry_t))
+#define FILE_SIZE(n)    PAGE_ALIGN(TILES_OFS + (size_t)(n) * TILE_BYTES)
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t version;
+    uint16_t tile_w;
+    uint16_t tile_h;
+    uint32_t capacity;   // 哈希表在用的槽位数 (只在 write_lock 下增大)
+    uint32_t used;       // 有效条目数
+    uint32_t tile_count; // 已追加的 tile 数 (含不再被引用的)
+} pack_header_t;
+
+typedef struct
+{
+    uint64_t key;   // 路径哈希, 0 表示空槽
+    int64_t mtime;  // 源文件修改时间
+    uint64_t size;  // 源文件大小
+    uint32_t tile;  // tile 编号
+    uint16_t w;     // 缩略图实际尺寸 (<= THUMB_W x THUMB_H)
+    uint16_t h;
+    uint32_t seq;   // 奇数: 写入中, 偶数: 稳定 (只增不减)
+    uint32_t reserved;
+} pack_entry_t;
+
+// --- 静态变量 ---
+static int pack_fd           = -1;
+static uint8_t *pack_base    = NULL;
+static size_t pack_reserved  = 0; // 预留的地址空间
+static size_t pack_mapped    = 0; // 其中已映射到文件的部分
+static pack_header_t *hdr    = NULL;
+static pack_entry_t *entries = NULL;
+static uint8_t *tiles        = NULL;
+static pthread_mutex_t write_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief 在 seq 一致的前提下判断条目是否与 key/mtime/size 匹配
+ */
+static bool entry_matches(pack_entry_t *e, uint64_t key, const struct stat *st, uint32_t *tile, uint16_t *w, uint16_t *h)
+{
+    uint32_t seq;
+    if (!hash_table_read_begin(&e->seq, &seq))
+        return false;
+
+    bool match = e->key == key && e->mtime == (int64_t)st->st_mtime && e->size == (uint64_t)st->st_size;
+    *tile      = e->tile;
+    *w         = e->w;
+    *h         = e->h;
+
+    return match && hash_table_read_end(&e->seq, seq);
+}
+
+/**
+ * @brief 查找有效条目，返回 tile 编号，未命中返回 -1
+ * 表正在扩容时可能未命中，只是多排一次生成任务 (生成前会再查一次)
+ */
+static int find_entry(uint64_t key, const struct stat *st, uint16_t *w, uint16_t *h)
+{
+    uint32_t capacity = __atomic_load_n(&hdr->capacity, __ATOMIC_ACQUIRE);
+    uint32_t tile;
+    for (int i = 0; i < PROBE_MAX; i++)
+    {
+        if (entry_matches(&entries[hash_table_probe(key, i, capacity)], key, st, &tile, w, h) &&
+            tile < __atomic_load_n(&hdr->tile_count, __ATOMIC_RELAXED))
+            return (int)tile;
+    }
+    return -1;
+}
+
+/**
+ * @brief 写入一个条目 (调用者持有 write_lock)
+ */
+static void write_entry(pack_entry_t *e, const pack_entry_t *src)
+{
+    uint32_t seq = hash_table_write_begin(&e->seq);
+    e->key       = src->key;
+    e->mtime     = src->mtime;
+    e->size      = src->size;
+    e->tile      = src->tile;
+    e->w         = src->w;
+    e->h         = src->h;
+    hash_table_write_end(&e->seq, seq);
+}
+
+/**
+ * @brief 选槽位 (调用者持有 write_lock)，free_slot 返回是否找到了同一路径或空槽
+ */
+static uint32_t pick_slot(uint64_t key, uint32_t capacity, bool *free_slot)
+{
+    return hash_table_pick(entries, sizeof(pack_entry_t), capacity, PROBE_MAX, key, free_slot);
+}
+
+/**
+ * @brief 哈希表槽位数翻倍并重新插入所有条目 (调用者持有 write_lock)
+ * 旧条目先按顺序锁清空再插入，搬移期间读取方可能未命中，但不会读到写了一半的条目
+ */
+static void grow_table_locked(void)
+{
+    uint32_t old_cap = hdr->capacity;
+    uint32_t new_cap = old_cap * 2 < THUMB_TABLE_MAX ? old_cap * 2 : THUMB_TABLE_MAX;
+    uint32_t n       = 0;
+    for (uint32_t i = 0; i < old_cap; i++)
+        n += entries[i].key != 0;
+
+    pack_entry_t *saved = mem_tag_alloc(MEM_TAG_INDEX, (size_t)n * sizeof(pack_entry_t) + 1);
+    if (saved == NULL)
+        return;
+    n = 0;
+    for (uint32_t i = 0; i < old_cap; i++)
+    {
+        if (entries[i].key != 0)
+            saved[n++] = entries[i];
+    }
+
+    __atomic_store_n(&hdr->capacity, new_cap, __ATOMIC_RELEASE);
+    pack_entry_t empty = {0};
+    for (uint32_t i = 0; i < old_cap; i++)
+    {
+        if (entries[i].key != 0)
+            write_entry(&entries[i], &empty);
+    }
+
+    bool free_slot;
+    hdr->used = 0;
+    for (uint32_t i = 0; i < n; i++)
+    {
+        pack_entry_t *e = &entries[pick_slot(saved[i].key, new_cap, &free_slot)];
+        hdr->used += e->key == 0;
+        write_entry(e, &saved[i]);
+    }
+
+    mem_tag_free(saved);
+    printf("Thumb: table grown to %u slots (%u thumbnails)\n", new_cap, hdr->used);
+}
+
+/**
+ * @brief 把文件和映射扩大到至少能放下 count 个 tile (调用者持有 write_lock 或还在 open 中)
+ * 新的部分映射到预留地址空间里原来的位置，已有的映射不动
+ */
+static int map_tiles(uint32_t count)
+{
+    uint32_t chunks = (count + TILE_CHUNK - 1) / TILE_CHUNK;
+    size_t size     = FILE_SIZE((size_t)chunks * TILE_CHUNK);
+    if (size > pack_reserved)
+        size = pack_reserved;
+    if (size <= pack_mapped)
+        return 0;
+
+    struct stat st;
+    if (fstat(pack_fd, &st) != 0 || ((size_t)st.st_size < size && ftruncate(pack_fd, size) != 0))
+    {
+        perror("Thumb: cannot resize pack file");
+        return -1;
+    }
+    if (mmap(pack_base + pack_mapped, size - pack_mapped, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, pack_fd,
+             pack_mapped) == MAP_FAILED)
+    {
+        perror("Thumb: mmap failed");
+        return -1;
+    }
+    pack_mapped = size;
+    return 0;
+}
+
+static int cmp_tile(const void *a, const void *b)
+{
+    uint32_t ta = entries[*(const uint32_t *)a].tile, tb = entries[*(const uint32_t *)b].tile;
+    return (ta > tb) - (ta < tb);
+}
+
+/**
+ * @brief 打开时整理: 把还被引用的 tile 按原顺序往前挪，截掉文件末尾 (UI 还没有拿到指针)
+ */
+static void compact_tiles(void)
+{
+    uint32_t *order = mem_tag_alloc(MEM_TAG_INDEX, (size_t)hdr->capacity * sizeof(uint32_t));
+    if (order == NULL)
+        return;
+
+    // 指向文件外的条目 (上次没写完) 直接丢掉
+    pack_entry_t empty = {0};
+    uint32_t n         = 0;
+    for (uint32_t i = 0; i < hdr->capacity; i++)
+    {
+        if (entries[i].key != 0 && entries[i].tile < hdr->tile_count)
+            order[n++] = i;
+        else if (entries[i].key != 0)
+            write_entry(&entries[i], &empty);
+    }
+    hdr->used = n;
+    qsort(order, n, sizeof(uint32_t), cmp_tile);
+
+    uint32_t before = hdr->tile_count;
+    for (uint32_t i = 0; i < n; i++)
+    {
+        pack_entry_t *e = &entries[order[i]];
+        if (e->tile != i)
+            memmove(&tiles[(size_t)i * TILE_BYTES], &tiles[(size_t)e->tile * TILE_BYTES], TILE_BYTES);
+        e->tile = i;
+    }
+    hdr->tile_count = n;
+    mem_tag_free(order);
+
+    // 末尾不再需要的部分换回预留的空映射，再截短文件
+    uint32_t chunks = (n + TILE_CHUNK - 1) / TILE_CHUNK;
+    size_t size     = FILE_SIZE((size_t)chunks * TILE_CHUNK);
+    if (size < pack_mapped &&
+        mmap(pack_base + size, pack_mapped - size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED, -1, 0) != MAP_FAILED)
+    {
+        pack_mapped = size;
+        if (ftruncate(pack_fd, size) != 0)
+            perror("Thumb: cannot shrink pack file");
+    }
+    printf("Thumb: compacted %u -> %u tiles\n", before, n);
+}
+
+int img_thumb_open(const char *pack_path)
+{
+    if (pack_base)
+        return 0;
+
+    pack_fd = open(pack_path, O_RDWR | O_CREAT, 0644);
+    if (pack_fd < 0)
+    {
+        perror("Thumb: cannot open pack file");
+        return -1;
+    }
+
+    // 先读文件头检查，不匹配就清空重建 (槽位区是稀疏的，没用到的不占磁盘)
+    struct stat st;
+    pack_header_t head;
+    bool fresh = fstat(pack_fd, &st) != 0 || pread(pack_fd, &head, sizeof(head), 0) != sizeof(head) ||
+                 head.magic != PACK_MAGIC || head.version != PACK_VERSION || head.tile_w != THUMB_W || head.tile_h != THUMB_H ||
+                 head.capacity < THUMB_TABLE_MIN || head.capacity > THUMB_TABLE_MAX || head.used > head.capacity ||
+                 head.tile_count > THUMB_MAX || (size_t)st.st_size < FILE_SIZE(head.tile_count);
+    if (fresh)
+    {
+        memset(&head, 0, sizeof(head));
+        head.magic    = PACK_MAGIC;
+        head.version  = PACK_VERSION;
+        head.tile_w   = THUMB_W;
+        head.tile_h   = THUMB_H;
+        head.capacity = THUMB_TABLE_MIN;
+        if (ftruncate(pack_fd, 0) != 0 || ftruncate(pack_fd, TILES_OFS) != 0 || pwrite(pack_fd, &head, sizeof(head), 0) != sizeof(head))
+        {
+            perror("Thumb: cannot reset pack file");
+            close(pack_fd);
+            pack_fd = -1;
+            return -1;
+        }
+        printf("Thumb: New pack %s\n", pack_path);
+    }
+
+    // 预留能放下 THUMB_MAX 个 tile 的地址空间，再把文件现有的部分映射到开头
+    pack_reserved = FILE_SIZE(THUMB_MAX);
+    pack_base     = mmap(NULL, pack_reserved, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (pack_base == MAP_FAILED)
+    {
+        perror("Thumb: cannot reserve address space");
+        pack_base = NULL;
+        close(pack_fd);
+        pack_fd = -1;
+        return -1;
+    }
+    hdr     = (pack_header_t *)pack_base;
+    entries = (pack_entry_t *)(pack_base + sizeof(pack_header_t));
+    tiles   = pack_base + TILES_OFS;
+    if (map_tiles(head.tile_count) != 0)
+    {
+        img_thumb_close();
+        return -1;
+    }
+
+    // 不再被引用的 tile 比有效的还多时整理一次
+    uint32_t garbage = hdr->tile_count - hdr->used;
+    if (garbage >= TILE_CHUNK && garbage > hdr->used)
+        compact_tiles();
+
+    return 0;
+}
+
+void img_thumb_close(void)
+{
+    if (pack_base)
+    {
+        msync(pack_base, pack_mapped, MS_SYNC);
+        munmap(pack_base, pack_reserved);
+        pack_base   = NULL;
+        pack_mapped = 0;
+        hdr         = NULL;
+        entries     = NULL;
+        tiles       = NULL;
+    }
+    if (pack_fd >= 0)
+    {
+        close(pack_fd);
+        pack_fd = -1;
+    }
+}
+
+bool img_thumb_lookup(const char *path, lv_img_dsc_t *dsc)
+{
+    if (pack_base == NULL)
+        return false;
+
+    struct stat st;
+    if (stat(path, &st) != 0)
+        return false;
+
+    uint16_t w, h;
+    int tile = find_entry(hash_table_key(path), &st, &w, &h);
+    if (tile < 0)
+        return false;
+
+    memset(dsc, 0, sizeof(lv_img_dsc_t));
+    dsc->header.cf = LV_IMG_CF_TRUE_COLOR;
+    dsc->header.w  = w;
+    dsc->header.h  = h;
+    dsc->data_size = (uint32_t)w * h * sizeof(lv_color_t);
+    dsc->data      = &tiles[(size_t)tile * TILE_BYTES];
+    return true;
+}
+
+int img_thumb_generate(const char *path)
+{
+    if (pack_base == NULL)
+        return -1;
+
+    struct stat st;
+    if (stat(path, &st) != 0)
+        return -1;
+
+    uint64_t key = hash_table_key(path);
+    uint16_t w, h;
+    if (find_entry(key, &st, &w, &h) >= 0)
+        return 0;
+
+    img_buf_t img;
+    if (img_loader_decode_file(path, THUMB_W, THUMB_H, &img) != 0)
+        return -1;
+
+    pthread_mutex_lock(&write_lock);
+
+    // 新缩略图总是写进新追加的 tile，条目指过去之前没有人能看到它
+    int res = -1;
+    if (hdr->tile_count >= THUMB_MAX)
+    {
+        printf("Thumb: pack full (%u tiles), %s skipped\n", hdr->tile_count, path);
+    }
+    else if (map_tiles(hdr->tile_count + 1) == 0)
+    {
+        pack_entry_t entry = {.key = key, .mtime = st.st_mtime, .size = st.st_size, .tile = hdr->tile_count, .w = img.w, .h = img.h};
+        memcpy(&tiles[(size_t)entry.tile * TILE_BYTES], img.data, (size_t)img.w * img.h * sizeof(lv_color_t));
+        __atomic_store_n(&hdr->tile_count, entry.tile + 1, __ATOMIC_RELAXED);
+
+        // 装填率超过一半或者探测范围内没有空槽时先扩容
+        bool free_slot;
+        uint32_t slot = pick_slot(key, hdr->capacity, &free_slot);
+        if ((!free_slot || (hdr->used + 1) * 2 > hdr->capacity) && hdr->capacity < THUMB_TABLE_MAX)
+        {
+            grow_table_locked();
+            slot = pick_slot(key, hdr->capacity, &free_slot);
+        }
+        if (entries[slot].key == 0)
+            hdr->used++;
+        write_entry(&entries[slot], &entry);
+        res = 0;
+    }
+
+    pthread_mutex_unlock(&write_lock);
+
+    img_buf_free(&img);
+    return res;
+}
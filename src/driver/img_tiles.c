@@ -0,0 +1,810 @@
+#define _GNU_SOURCE // O_TMPFILE
+#include "img_tiles.h"
+#include "img_meta.h"
+#include "lv_color_conv.h"
+#include "lodepng.h"
+#include "mem_tag.h"
+#include <fcntl.h>
+#include <pthread.h>
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <jpeglib.h>
+
+/*
+ * JPEG: 每个任务重新打开文件，用 DCT 缩放 (1/1 ~ 1/8) 得到接近目标 level 的分辨率，
+ *       再用 jpeg_crop_scanline / jpeg_skip_scanlines 只输出这一段 tile 覆盖的像素。
+ *       tile 坐标是按 EXIF orientation 摆正后的，先换算成原始方向的矩形，解码后逐像素按方向取样。
+ * PNG:  无法局部解码，第一次需要时整图解码一次，把各 level 的 RGB565 平面写入临时文件，
+ *       之后按行 pread 出 tile。常驻内存只有 tile 缓存。
+ *       临时文件建在图片所在目录 (/tmp 常常是 tmpfs，会占内存)。
+ *       整图解码的峰值内存约为像素数 x 8 字节 (lodepng 的解压缓冲 + RGBA)，所以超过 TILE_FULL_DECODE_MAX_PX
+ *       的图片不支持放大 (img_tiles_open 返回 NULL)，不做流式解码。
+ * QOI:  同 PNG。
+ */
+
+#define LEVEL_MAX     16
+#define JPEG_DCT_MAX  3 // libjpeg 最多缩小到 1/8
+
+typedef enum
+{
+    SRC_JPEG,
+    SRC_PNG,
+    SRC_QOI
+} src_type_t;
+
+typedef enum
+{
+    SLOT_EMPTY,
+    SLOT_PENDING, // 后台正在写入 buf，不能淘汰
+    SLOT_READY
+} slot_state_t;
+
+typedef struct
+{
+    uint8_t state;
+    int8_t level;
+    uint16_t col;
+    uint16_t row;
+    uint32_t last_use;
+    lv_img_dsc_t dsc;
+    lv_color_t *buf; // TILE_SIZE * TILE_SIZE
+} tile_slot_t;
+
+struct img_tiles
+{
+    char *path;
+    src_type_t type;
+    uint32_t w; // 摆正后的尺寸
+    uint32_t h;
+    uint8_t orientation; // EXIF orientation 1~8 (只有 JPEG 不是 1)
+    int level_cnt;
+    img_tiles_ready_cb_t cb;
+    void *user_data;
+
+    // --- UI 线程数据 ---
+    tile_slot_t slots[TILE_CACHE_SIZE];
+    uint32_t tick;
+    bool closed;
+    int refcnt; // 打开者 + 未完成的任务
+
+    // --- PNG 金字塔 (后台线程) ---
+    pthread_mutex_t pyr_lock;
+    bool pyr_built;
+    int pyr_fd;
+    uint64_t pyr_ofs[LEVEL_MAX];
+};
+
+// 一段连续 tile 的解码任务
+typedef struct
+{
+    img_tiles_t *t;
+    int level;
+    uint32_t row;
+    uint32_t col0;
+    uint32_t col1;
+    tile_slot_t *slots[TILE_BAND_MAX]; // 对应 col0 + i, NULL 表示不需要
+    bool ok;
+} band_job_t;
+
+// --- libjpeg 错误处理 ---
+typedef struct
+{
+    struct jpeg_error_mgr pub;
+    jmp_buf jump;
+} jpeg_err_t;
+
+static void jpeg_error_exit(j_common_ptr cinfo)
+{
+    jpeg_err_t *err = (jpeg_err_t *)cinfo->err;
+    char msg[JMSG_LENGTH_MAX];
+    err->pub.format_message(cinfo, msg);
+    printf("Img Tiles: JPEG error: %s\n", msg);
+    longjmp(err->jump, 1);
+}
+
+static uint32_t div_ceil_pow2(uint32_t v, int k)
+{
+    return (v + (1u << k) - 1) >> k;
+}
+
+/*
+ * 摆正后的坐标 (X, Y) 换算到原始方向: x = cx + X * xx + Y * xy, y = cy + X * yx + Y * yy
+ * cx / cy 在系数为负的方向上取原始图的最后一列 / 行。与 img_rot_from_exif 的 "先翻转再旋转" 一致
+ */
+static const int8_t orient_map[9][4] = {
+    {1, 0, 0, 1},   // 0: 无效, 按 1 处理
+    {1, 0, 0, 1},   // 1: 正常
+    {-1, 0, 0, 1},  // 2: 水平翻转
+    {-1, 0, 0, -1}, // 3: 旋转 180
+    {1, 0, 0, -1},  // 4: 垂直翻转
+    {0, 1, 1, 0},   // 5: 沿主对角线转置
+    {0, 1, -1, 0},  // 6: 顺时针 90
+    {0, -1, -1, 0}, // 7: 沿副对角线转置
+    {0, -1, 1, 0},  // 8: 顺时针 270
+};
+
+/**
+ * @brief 摆正后的点换算到原始方向 (rw x rh 为原始方向的尺寸)
+ */
+static void to_raw(const int8_t *m, uint32_t rw, uint32_t rh, int64_t X, int64_t Y, int64_t *x, int64_t *y)
+{
+    *x = ((m[0] < 0 || m[1] < 0) ? (int64_t)rw - 1 : 0) + X * m[0] + Y * m[1];
+    *y = ((m[2] < 0 || m[3] < 0) ? (int64_t)rh - 1 : 0) + X * m[2] + Y * m[3];
+}
+
+static void tile_size(const img_tiles_t *t, int level, uint32_t col, uint32_t row, uint32_t *tw, uint32_t *th)
+{
+    uint32_t lw, lh;
+    img_tiles_level_size(t, level, &lw, &lh);
+    *tw = LV_MIN(TILE_SIZE, lw - col * TILE_SIZE);
+    *th = LV_MIN(TILE_SIZE, lh - row * TILE_SIZE);
+}
+
+static void tiles_unref(img_tiles_t *t)
+{
+    if (__atomic_sub_fetch(&t->refcnt, 1, __ATOMIC_ACQ_REL) != 0)
+        return;
+
+    for (int i = 0; i < TILE_CACHE_SIZE; i++)
+        mem_tag_free(t->slots[i].buf);
+    if (t->pyr_fd >= 0)
+        close(t->pyr_fd);
+    pthread_mutex_destroy(&t->pyr_lock);
+    mem_tag_free(t->path);
+    mem_tag_free(t);
+}
+
+// =============================================================
+// JPEG: 按段解码
+// =============================================================
+
+/**
+ * @brief 从解码出的一段 RGB888 中按方向取样，f x f 块平均后转换成一个 RGB565 tile
+ * band 的宽高 band_w x band_h 是 DCT 输出像素，x0 / y0 是 tile 左上角 (摆正后) 对应的原始方向的 level 坐标 (相对于段的起点)
+ */
+static void band_to_tile(const uint8_t *band, uint32_t stride, uint32_t band_w, uint32_t band_h, uint32_t f,
+                         const int8_t *m, int64_t x0, int64_t y0, lv_color_t *dst, uint32_t tw, uint32_t th, uint8_t *row_buf)
+{
+    for (uint32_t ty = 0; ty < th; ty++)
+    {
+        const uint8_t *line = row_buf;
+        if (f == 1 && m[0] == 1 && m[1] == 0)
+        {
+            line = &band[((size_t)(y0 + (int64_t)ty * m[3]) * stride + x0) * 3]; // 不需要换方向: 直接转换这一行
+        }
+        else
+        {
+            for (uint32_t tx = 0; tx < tw; tx++)
+            {
+                int64_t x   = x0 + (int64_t)tx * m[0] + (int64_t)ty * m[1];
+                int64_t y   = y0 + (int64_t)tx * m[2] + (int64_t)ty * m[3];
+                uint32_t sx = (uint32_t)x * f, sy = (uint32_t)y * f;
+                uint32_t ex = LV_MIN(sx + f, band_w), ey = LV_MIN(sy + f, band_h);
+                uint32_t sum[3] = {0};
+                for (uint32_t by = sy; by < ey; by++)
+                {
+                    const uint8_t *p = &band[((size_t)by * stride + sx) * 3];
+                    for (uint32_t bx = sx; bx < ex; bx++, p += 3)
+                    {
+                        sum[0] += p[0];
+                        sum[1] += p[1];
+                        sum[2] += p[2];
+                    }
+                }
+                uint32_t cnt        = (ey - sy) * (ex - sx);
+                row_buf[tx * 3 + 0] = (uint8_t)(sum[0] / cnt);
+                row_buf[tx * 3 + 1] = (uint8_t)(sum[1] / cnt);
+                row_buf[tx * 3 + 2] = (uint8_t)(sum[2] / cnt);
+            }
+        }
+        lv_color_conv_rgb888_to_rgb565((uint8_t *)&dst[ty * tw], line, tw, LV_COLOR_CONV_NATIVE);
+    }
+}
+
+static bool decode_jpeg_band(band_job_t *job)
+{
+    img_tiles_t *t = job->t;
+    FILE *fp       = fopen(t->path, "rb");
+    if (fp == NULL)
+        return false;
+
+    struct jpeg_decompress_struct cinfo;
+    jpeg_err_t jerr;
+    uint8_t *volatile band    = NULL;
+    uint8_t *volatile row_buf = NULL;
+
+    cinfo.err           = jpeg_std_error(&jerr.pub);
+    jerr.pub.error_exit = jpeg_error_exit;
+    jpeg_create_decompress(&cinfo);
+
+    if (setjmp(jerr.jump))
+    {
+        mem_tag_free(band);
+        mem_tag_free(row_buf);
+        jpeg_destroy_decompress(&cinfo);
+        fclose(fp);
+        return false;
+    }
+
+    jpeg_stdio_src(&cinfo, fp);
+    jpeg_read_header(&cinfo, TRUE);
+
+    // DCT 缩放做前 3 级，剩下的用 f x f 区域平均
+    int dct    = LV_MIN(job->level, JPEG_DCT_MAX);
+    uint32_t f = 1u << (job->level - dct);
+
+    cinfo.scale_num       = 1;
+    cinfo.scale_denom     = 1u << dct;
+    cinfo.out_color_space = JCS_RGB;
+    cinfo.dct_method      = JDCT_IFAST;
+    jpeg_start_decompress(&cinfo);
+
+    // 本段 (摆正后) 的两个角换算到原始方向，得到要解码的 level 矩形 [rx0, rx1) x [ry0, ry1)
+    const int8_t *m = orient_map[t->orientation <= 8 ? t->orientation : 1];
+    uint32_t lw, lh, rw, rh, tw, th;
+    img_tiles_level_size(t, job->level, &lw, &lh);
+    rw = m[0] ? lw : lh;
+    rh = m[0] ? lh : lw;
+    tile_size(t, job->level, job->col1, job->row, &tw, &th);
+    int64_t ax, ay, bx, by;
+    to_raw(m, rw, rh, job->col0 * TILE_SIZE, job->row * TILE_SIZE, &ax, &ay);
+    to_raw(m, rw, rh, job->col1 * TILE_SIZE + tw - 1, job->row * TILE_SIZE + th - 1, &bx, &by);
+    uint32_t rx0 = (uint32_t)LV_MIN(ax, bx), rx1 = (uint32_t)LV_MAX(ax, bx) + 1;
+    uint32_t ry0 = (uint32_t)LV_MIN(ay, by), ry1 = (uint32_t)LV_MAX(ay, by) + 1;
+
+    // 在 DCT 输出坐标中的范围
+    uint32_t x0 = rx0 * f;
+    uint32_t x1 = LV_MIN(rx1 * f, cinfo.output_width);
+    uint32_t y0 = ry0 * f;
+    uint32_t y1 = LV_MIN(ry1 * f, cinfo.output_height);
+
+    // 裁剪起点会被对齐到 iMCU 边界，lead 为多出来的左侧像素
+    JDIMENSION crop_x = x0;
+    JDIMENSION crop_w = x1 - x0;
+    jpeg_crop_scanline(&cinfo, &crop_x, &crop_w);
+    uint32_t lead   = x0 - crop_x;
+    uint32_t stride = cinfo.output_width;
+
+    if (y0 > 0)
+        jpeg_skip_scanlines(&cinfo, y0);
+
+    band    = mem_tag_alloc(MEM_TAG_IMAGE, (size_t)stride * (y1 - y0) * 3);
+    row_buf = mem_tag_alloc(MEM_TAG_IMAGE, TILE_SIZE * 3);
+    if (band == NULL || row_buf == NULL)
+        longjmp(jerr.jump, 1);
+
+    while (cinfo.output_scanline < y1)
+    {
+        JSAMPROW row = (JSAMPROW)&band[(size_t)(cinfo.output_scanline - y0) * stride * 3];
+        jpeg_read_scanlines(&cinfo, &row, 1);
+    }
+    jpeg_abort_decompress(&cinfo);
+
+    // 从 lead 开始才是 rx0 那一列
+    for (uint32_t c = job->col0; c <= job->col1; c++)
+    {
+        tile_slot_t *slot = job->slots[c - job->col0];
+        if (slot == NULL)
+            continue;
+
+        tile_size(t, job->level, c, job->row, &tw, &th);
+        to_raw(m, rw, rh, c * TILE_SIZE, job->row * TILE_SIZE, &ax, &ay);
+        band_to_tile(&band[(size_t)lead * 3], stride, x1 - x0, y1 - y0, f, m, ax - rx0, ay - ry0, slot->buf, tw, th, row_buf);
+    }
+
+    mem_tag_free(band);
+    mem_tag_free(row_buf);
+    jpeg_destroy_decompress(&cinfo);
+    fclose(fp);
+    return true;
+}
+
+// =============================================================
+// PNG / QOI: 整图解码一次，生成金字塔
+// =============================================================
+
+/**
+ * @brief RGB565 平面 2x2 平均缩小，可以原地进行
+ */
+static void halve_565(uint16_t *px, uint32_t w, uint32_t h, uint32_t nw, uint32_t nh)
+{
+    for (uint32_t y = 0; y < nh; y++)
+    {
+        for (uint32_t x = 0; x < nw; x++)
+        {
+            uint32_t r = 0, g = 0, b = 0, cnt = 0;
+            for (uint32_t sy = y * 2; sy < LV_MIN(y * 2 + 2, h); sy++)
+            {
+                for (uint32_t sx = x * 2; sx < LV_MIN(x * 2 + 2, w); sx++)
+                {
+                    uint16_t c = px[sy * w + sx];
+#if LV_COLOR_16_SWAP
+                    c = (uint16_t)((c >> 8) | (c << 8));
+#endif
+                    r += c >> 11;
+                    g += (c >> 5) & 0x3F;
+                    b += c & 0x1F;
+                    cnt++;
+                }
+            }
+            uint16_t c = (uint16_t)(((r / cnt) << 11) | ((g / cnt) << 5) | (b / cnt));
+#if LV_COLOR_16_SWAP
+            c = (uint16_t)((c >> 8) | (c << 8));
+#endif
+            px[y * nw + x] = c;
+        }
+    }
+}
+
+/**
+ * @brief 在图片所在目录创建匿名临时文件
+ */
+static int open_tmp_near(const char *path)
+{
+    char dir[256];
+    const char *slash = strrchr(path, '/');
+    if (slash == NULL)
+        snprintf(dir, sizeof(dir), ".");
+    else
+        snprintf(dir, sizeof(dir), "%.*s", (int)(slash - path), path);
+
+    int fd = open(dir, O_TMPFILE | O_RDWR | O_CLOEXEC, 0600);
+    if (fd < 0)
+    {
+        FILE *fp = tmpfile(); // 文件系统不支持 O_TMPFILE
+        if (fp)
+        {
+            fd = dup(fileno(fp));
+            fclose(fp);
+        }
+    }
+    return fd;
+}
+
+static bool build_pyramid(img_tiles_t *t)
+{
+    FILE *fp = fopen(t->path, "rb");
+    if (fp == NULL)
+        return false;
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    rewind(fp);
+
+    uint8_t *data = (size > 0) ? mem_tag_alloc(MEM_TAG_IMAGE, size) : NULL;
+    bool ok       = data && fread(data, 1, size, fp) == (size_t)size;
+    fclose(fp);
+
+    // 整图 RGBA 用 lv_mem_alloc 分配 (与 lodepng 一致)，记到 image 名下
+    mem_tag_t prev      = mem_tag_scope_begin(MEM_TAG_IMAGE);
+    unsigned char *rgba = NULL;
+    unsigned w = 0, h = 0;
+    if (ok && t->type == SRC_QOI)
+    {
+        lv_qoi_header_t qoi;
+        ok   = lv_qoi_read_header(data, size, &qoi) == LV_RES_OK && qoi.w == t->w && qoi.h == t->h;
+        rgba = ok ? lv_mem_alloc((size_t)t->w * t->h * 4) : NULL;
+        ok   = rgba && lv_qoi_decode_rgba8888(data, size, rgba) == LV_RES_OK;
+        w    = t->w;
+        h    = t->h;
+    }
+    else if (ok)
+    {
+        ok = lodepng_decode32(&rgba, &w, &h, data, size) == 0 && w == t->w && h == t->h;
+    }
+    mem_tag_scope_end(prev);
+    mem_tag_free(data);
+
+    if (ok)
+        t->pyr_fd = open_tmp_near(t->path);
+    if (ok && t->pyr_fd >= 0)
+    {
+        // 带 alpha 的与黑色背景混合，原地转换成 RGB565
+        lv_color_conv_rgba8888_to_rgb565(rgba, rgba, w * h, LV_COLOR_CONV_NATIVE | LV_COLOR_CONV_PREMULT);
+        uint16_t *px = (uint16_t *)rgba;
+        uint64_t ofs = 0;
+        for (int k = 0; k < t->level_cnt && ok; k++)
+        {
+            uint32_t lw, lh;
+            img_tiles_level_size(t, k, &lw, &lh);
+            if (k > 0)
+            {
+                uint32_t pw, ph;
+                img_tiles_level_size(t, k - 1, &pw, &ph);
+                halve_565(px, pw, ph, lw, lh);
+            }
+            size_t bytes  = (size_t)lw * lh * 2;
+            t->pyr_ofs[k] = ofs;
+            ok            = pwrite(t->pyr_fd, px, bytes, (off_t)ofs) == (ssize_t)bytes;
+            ofs += bytes;
+        }
+    }
+    else
+    {
+        ok = false;
+    }
+
+    if (rgba)
+        lv_mem_free(rgba);
+    return ok;
+}
+
+static bool decode_png_band(band_job_t *job)
+{
+    img_tiles_t *t = job->t;
+
+    pthread_mutex_lock(&t->pyr_lock);
+    if (!t->pyr_built)
+    {
+        t->pyr_built = true;
+        if (!build_pyramid(t))
+        {
+            printf("Img Tiles: Failed to build pyramid for %s\n", t->path);
+            if (t->pyr_fd >= 0)
+            {
+                close(t->pyr_fd);
+                t->pyr_fd = -1;
+            }
+        }
+    }
+    pthread_mutex_unlock(&t->pyr_lock);
+
+    int fd = t->pyr_fd;
+    if (fd < 0)
+        return false;
+    uint32_t lw, lh;
+    img_tiles_level_size(t, job->level, &lw, &lh);
+
+    for (uint32_t c = job->col0; c <= job->col1; c++)
+    {
+        tile_slot_t *slot = job->slots[c - job->col0];
+        if (slot == NULL)
+            continue;
+
+        uint32_t tw, th;
+        tile_size(t, job->level, c, job->row, &tw, &th);
+        for (uint32_t ty = 0; ty < th; ty++)
+        {
+            uint64_t ofs = t->pyr_ofs[job->level] + (((uint64_t)(job->row * TILE_SIZE + ty) * lw) + c * TILE_SIZE) * 2;
+            if (pread(fd, &slot->buf[ty * tw], tw * 2, (off_t)ofs) != (ssize_t)(tw * 2))
+                return false;
+        }
+    }
+    return true;
+}
+
+// =============================================================
+// 任务
+// =============================================================
+
+static void band_done_cb(void *arg)
+{
+    band_job_t *job = arg;
+    img_tiles_t *t  = job->t;
+
+    for (uint32_t i = 0; i <= job->col1 - job->col0; i++)
+    {
+        if (job->slots[i])
+            job->slots[i]->state = job->ok ? SLOT_READY : SLOT_EMPTY;
+    }
+
+    if (!t->closed && job->ok && t->cb)
+        t->cb(t->user_data);
+
+    mem_tag_free(job);
+    tiles_unref(t);
+}
+
+/**
+ * @brief 任务被丢弃: slot 会一直处于 PENDING，只能等关闭时释放
+ */
+static void band_drop(void *arg)
+{
+    band_job_t *job = arg;
+    img_tiles_t *t  = job->t;
+    mem_tag_free(job);
+    tiles_unref(t);
+}
+
+static void band_job(void *arg)
+{
+    band_job_t *job = arg;
+    img_tiles_t *t  = job->t;
+
+    // 已关闭就不再解码
+    if (!__atomic_load_n(&t->closed, __ATOMIC_ACQUIRE))
+        job->ok = (t->type == SRC_JPEG) ? decode_jpeg_band(job) : decode_png_band(job);
+
+    if (bg_worker_post_ui(band_done_cb, band_drop, job) != 0)
+        band_drop(job);
+}
+
+// =============================================================
+// 公共接口
+// =============================================================
+
+/**
+ * @brief 尺寸和格式来自图片头信息索引，命中时不用打开文件
+ */
+static bool read_header(img_tiles_t *t)
+{
+    img_meta_t meta;
+    if (img_meta_get(t->path, &meta) != 0)
+        return false;
+
+    switch (meta.format)
+    {
+    case MEDIA_TYPE_JPEG:
+        t->type = SRC_JPEG;
+        break;
+    case MEDIA_TYPE_PNG:
+        t->type = SRC_PNG;
+        break;
+    case MEDIA_TYPE_QOI:
+        t->type = SRC_QOI;
+        break;
+    default:
+        return false;
+    }
+
+    // JPEG 按 EXIF 摆正: 5~8 转 90/270 度，宽高互换
+    t->orientation = (meta.orientation >= 1 && meta.orientation <= 8) ? meta.orientation : 1;
+    t->w           = t->orientation >= 5 ? meta.h : meta.w;
+    t->h           = t->orientation >= 5 ? meta.w : meta.h;
+
+    // PNG / QOI 要整图解码才能生成金字塔，太大的不支持
+    if (t->type != SRC_JPEG && (uint64_t)t->w * t->h > TILE_FULL_DECODE_MAX_PX)
+    {
+        printf("Img Tiles: %s is %ux%u, too large to decode whole for zooming\n", t->path, t->w, t->h);
+        return false;
+    }
+    return true;
+}
+
+img_tiles_t *img_tiles_open(const char *path, img_tiles_ready_cb_t cb, void *user_data)
+{
+    img_tiles_t *t = mem_tag_calloc(MEM_TAG_IMAGE, 1, sizeof(img_tiles_t));
+    if (t == NULL)
+        return NULL;
+
+    t->path      = mem_tag_strdup(MEM_TAG_IMAGE, path);
+    t->cb        = cb;
+    t->user_data = user_data;
+    t->refcnt    = 1;
+    t->pyr_fd    = -1;
+    pthread_mutex_init(&t->pyr_lock, NULL);
+
+    if (t->path == NULL || !read_header(t))
+    {
+        printf("Img Tiles: Cannot tile %s\n", path);
+        tiles_unref(t);
+        return NULL;
+    }
+
+    // 最后一级整图不超过一个 tile
+    t->level_cnt = 1;
+    while (t->level_cnt < LEVEL_MAX &&
+           (div_ceil_pow2(t->w, t->level_cnt - 1) > TILE_SIZE || div_ceil_pow2(t->h, t->level_cnt - 1) > TILE_SIZE))
+        t->level_cnt++;
+
+    printf("Img Tiles: %s %ux%u, %d levels\n", path, t->w, t->h, t->level_cnt);
+    return t;
+}
+
+void img_tiles_close(img_tiles_t *t)
+{
+    if (t == NULL)
+        return;
+    __atomic_store_n(&t->closed, true, __ATOMIC_RELEASE);
+    tiles_unref(t);
+}
+
+void img_tiles_get_size(const img_tiles_t *t, uint32_t *w, uint32_t *h)
+{
+    *w = t->w;
+    *h = t->h;
+}
+
+void img_tiles_level_size(const img_tiles_t *t, int level, uint32_t *w, uint32_t *h)
+{
+    *w = div_ceil_pow2(t->w, level);
+    *h = div_ceil_pow2(t->h, level);
+}
+
+int img_tiles_fit_level(const img_tiles_t *t, uint32_t max_w, uint32_t max_h)
+{
+    int level = 0;
+    while (level < t->level_cnt - 1 && (div_ceil_pow2(t->w, level) > max_w || div_ceil_pow2(t->h, level) > max_h))
+        level++;
+    return level;
+}
+
+static tile_slot_t *find_slot(img_tiles_t *t, int level, uint32_t col, uint32_t row)
+{
+    for (int i = 0; i < TILE_CACHE_SIZE; i++)
+    {
+        tile_slot_t *s = &t->slots[i];
+        if (s->state != SLOT_EMPTY && s->level == level && s->col == col && s->row == row)
+            return s;
+    }
+    return NULL;
+}
+
+/**
+ * @brief 取一个空槽或淘汰最久未使用的已就绪 tile
+ */
+static tile_slot_t *alloc_slot(img_tiles_t *t)
+{
+    tile_slot_t *victim = NULL;
+    for (int i = 0; i < TILE_CACHE_SIZE; i++)
+    {
+        tile_slot_t *s = &t->slots[i];
+        if (s->state == SLOT_EMPTY)
+        {
+            victim = s;
+            break;
+        }
+        if (s->state == SLOT_READY && (victim == NULL || s->last_use < victim->last_use))
+            victim = s;
+    }
+    if (victim == NULL)
+        return NULL;
+
+    if (victim->buf == NULL)
+    {
+        victim->buf = mem_tag_alloc(MEM_TAG_IMAGE, TILE_SIZE * TILE_SIZE * sizeof(lv_color_t));
+        if (victim->buf == NULL)
+            return NULL;
+    }
+    victim->state = SLOT_EMPTY;
+    return victim;
+}
+
+void img_tiles_request(img_tiles_t *t, int level, uint32_t row, uint32_t col0, uint32_t col1, bg_prio_t prio)
+{
+    if (t == NULL || level < 0 || level >= t->level_cnt)
+        return;
+
+    uint32_t lw, lh;
+    img_tiles_level_size(t, level, &lw, &lh);
+    uint32_t cols = (lw + TILE_SIZE - 1) / TILE_SIZE;
+    uint32_t rows = (lh + TILE_SIZE - 1) / TILE_SIZE;
+    if (row >= rows || col0 >= cols)
+        return;
+    col1 = LV_MIN(col1, cols - 1);
+
+    while (col0 <= col1)
+    {
+        // 跳过已缓存或正在解码的
+        tile_slot_t *s = find_slot(t, level, col0, row);
+        if (s)
+        {
+            s->last_use = ++t->tick;
+            col0++;
+            continue;
+        }
+
+        band_job_t *job = mem_tag_calloc(MEM_TAG_IMAGE, 1, sizeof(band_job_t));
+        if (job == NULL)
+            return;
+        job->t     = t;
+        job->level = level;
+        job->row   = row;
+        job->col0  = col0;
+        job->col1  = col0;
+
+        // 一段最多 TILE_BAND_MAX 列，中间已有的 tile 不占槽位
+        for (uint32_t c = col0; c <= col1 && c - col0 < TILE_BAND_MAX; c++)
+        {
+            if (find_slot(t, level, c, row))
+                continue;
+            tile_slot_t *slot = alloc_slot(t);
+            if (slot == NULL)
+                break;
+
+            uint32_t tw, th;
+            tile_size(t, level, c, row, &tw, &th);
+            slot->state    = SLOT_PENDING;
+            slot->level    = (int8_t)level;
+            slot->col      = (uint16_t)c;
+            slot->row      = (uint16_t)row;
+            slot->last_use = ++t->tick;
+            memset(&slot->dsc, 0, sizeof(lv_img_dsc_t));
+            slot->dsc.header.cf = LV_IMG_CF_TRUE_COLOR;
+            slot->dsc.header.w  = tw;
+            slot->dsc.header.h  = th;
+            slot->dsc.data_size = tw * th * sizeof(lv_color_t);
+            slot->dsc.data      = (const uint8_t *)slot->buf;
+
+            job->slots[c - col0] = slot;
+            job->col1            = c;
+        }
+
+        if (job->slots[0] == NULL)
+        {
+            // 缓存已满 (全部在解码中)
+            mem_tag_free(job);
+            return;
+        }
+
+        __atomic_add_fetch(&t->refcnt, 1, __ATOMIC_ACQ_REL);
+        if (bg_worker_submit(prio, band_job, band_drop, job) != 0)
+        {
+            for (uint32_t i = 0; i <= job->col1 - job->col0; i++)
+            {
+                if (job->slots[i])
+                    job->slots[i]->state = SLOT_EMPTY;
+            }
+            mem_tag_free(job);
+            tiles_unref(t);
+            return;
+        }
+        col0 = job->col1 + 1;
+    }
+}
+
+const lv_img_dsc_t *img_tiles_lookup(img_tiles_t *t, int level, uint32_t col, uint32_t row)
+{
+    if (t == NULL)
+        return NULL;
+
+    tile_slot_t *s = find_slot(t, level, col, row);
+    if (s == NULL || s->state != SLOT_READY)
+        return NULL;
+
+    s->last_use = ++t->tick;
+    return &s->dsc;
+}
+
+size_t img_tiles_mem_usage(const img_tiles_t *t)
+{
+    if (t == NULL)
+        return 0;
+
+    size_t used = 0;
+    for (int i = 0; i < TILE_CACHE_SIZE; i++)
+    {
+        if (t->slots[i].buf)
+            used += TILE_SIZE * TILE_SIZE * sizeof(lv_color_t);
+    }
+    return used;
+}
+
+void img_tiles_trim(img_tiles_t *t, size_t target)
+{
+    if (t == NULL)
+        return;
+
+    size_t used = img_tiles_mem_usage(t);
+    while (used > target)
+    {
+        // 空槽上留着的缓冲先放，再按最久未用放已就绪的
+        tile_slot_t *victim = NULL;
+        for (int i = 0; i < TILE_CACHE_SIZE; i++)
+        {
+            tile_slot_t *s = &t->slots[i];
+            if (s->buf == NULL || s->state == SLOT_PENDING)
+                continue;
+            if (s->state == SLOT_EMPTY)
+            {
+                victim = s;
+                break;
+            }
+            if (victim == NULL || s->last_use < victim->last_use)
+                victim = s;
+        }
+        if (victim == NULL)
+            break;
+
+        // 重新分配后地址会变，不能让 LVGL 的图片缓存还指着旧缓冲
+        if (victim->state == SLOT_READY)
+            lv_img_cache_invalidate_src(&victim->dsc);
+        mem_tag_free(victim->buf);
+        victim->buf      = NULL;
+        victim->dsc.data = NULL;
+        victim->state    = SLOT_EMPTY;
+        used -= TILE_SIZE * TILE_SIZE * sizeof(lv_color_t);
+    }
+}
@@ -170,6 +170,7 @@ static void evdev_read_phys(void) {
 // 2. 按住超过 800ms -> 发送 LV_KEY_NEXT RELEASED, 紧接着发送 LV_KEY_PREV
 // PRESSED
 static void keypad_read_cb_v2(lv_indev_drv_t *drv, lv_indev_data_t *data) {
+  (void)drv;
   evdev_read_phys();
   uint32_t now = current_timestamp();
 
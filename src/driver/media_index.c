@@ -0,0 +1,716 @@
+#define _GNU_SOURCE // qsort_r
+#include "media_index.h"
+#include "bg_worker.h"
+#include "mem_tag.h"
+#include <ctype.h>
+#include <dirent.h> // DT_xxx
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/*
+ * 扫描线程只负责读目录、识别类型，把结果打包成批次投递给 UI 线程；
+ * 排序后的索引只在 UI 线程中读写，所以查询接口不需要加锁。
+ */
+
+#define DENTS_BUF_SIZE (64 * 1024) // 一次 getdents64 读取的目录项缓冲
+#define BATCH_FIRST    64          // 第一批尽快送到 UI
+#define BATCH_MAX      512
+#define SNIFF_LEN      12          // 识别类型需要的文件头长度
+#define WATCH_MASK     (IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE | IN_MOVED_FROM)
+
+// getdents64 返回的目录项
+struct linux_dirent64
+{
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+typedef struct
+{
+    uint32_t name_ofs; // 在字符串池中的偏移
+    uint8_t type;      // media_type_t
+} media_entry_t;
+
+struct media_index
+{
+    char *dir;
+    uint32_t type_mask;
+    media_index_cb_t cb;
+    void *user_data;
+
+    // --- UI 线程数据 ---
+    char *pool; // 所有文件名，'\0' 分隔
+    size_t pool_len;
+    size_t pool_cap;
+    media_entry_t *entries; // 只追加，删除的条目只从 order 中移除
+    uint32_t entry_cnt;
+    uint32_t entry_cap;
+    uint32_t *order; // 按自然顺序排列的 entries 下标
+    uint32_t order_cnt;
+    bool scanning;
+    bool closed;
+    int refcnt; // 创建者 + 未处理的批次
+
+    // --- 扫描线程 ---
+    pthread_t thread;
+    bool thread_started;
+    int stop_pipe[2];
+};
+
+typedef enum
+{
+    BATCH_ADD,
+    BATCH_REMOVE,
+    BATCH_DONE
+} batch_op_t;
+
+// 扫描线程 -> UI 线程的一批变化
+typedef struct
+{
+    media_index_t *idx;
+    batch_op_t op;
+    uint32_t count;
+    uint32_t cap;
+    uint32_t *ofs;
+    uint8_t *types;
+    char *pool;
+    size_t pool_len;
+    size_t pool_cap;
+} scan_batch_t;
+
+// =============================================================
+// 工具函数
+// =============================================================
+
+int media_natural_cmp(const char *a, const char *b)
+{
+    const char *pa = a;
+    const char *pb = b;
+
+    while (*pa && *pb)
+    {
+        if (isdigit((unsigned char)*pa) && isdigit((unsigned char)*pb))
+        {
+            // 数字段: 跳过前导 0 后先比长度再比内容
+            const char *sa = pa;
+            const char *sb = pb;
+            while (*sa == '0')
+                sa++;
+            while (*sb == '0')
+                sb++;
+            const char *ea = sa;
+            const char *eb = sb;
+            while (isdigit((unsigned char)*ea))
+                ea++;
+            while (isdigit((unsigned char)*eb))
+                eb++;
+
+            if (ea - sa != eb - sb)
+                return (ea - sa < eb - sb) ? -1 : 1;
+            int c = memcmp(sa, sb, ea - sa);
+            if (c)
+                return c;
+
+            pa = ea;
+            pb = eb;
+            continue;
+        }
+
+        int ca = tolower((unsigned char)*pa);
+        int cb = tolower((unsigned char)*pb);
+        if (ca != cb)
+            return ca - cb;
+        pa++;
+        pb++;
+    }
+
+    if (*pa || *pb)
+        return *pa ? 1 : -1;
+
+    // 自然顺序相同 ("a01" 与 "a1") 时按字节比较，保证是全序
+    return strcmp(a, b);
+}
+
+media_type_t media_sniff(const uint8_t *h, size_t n)
+{
+    if (n >= 7 && memcmp(h, "_SJPG__", 7) == 0)
+        return MEDIA_TYPE_SJPG;
+    if (n >= 4 && memcmp(h, "\x89PNG", 4) == 0)
+        return MEDIA_TYPE_PNG;
+    if (n >= 3 && h[0] == 0xFF && h[1] == 0xD8 && h[2] == 0xFF)
+        return MEDIA_TYPE_JPEG;
+    if (n >= 4 && memcmp(h, "GIF8", 4) == 0)
+        return MEDIA_TYPE_GIF;
+    if (n >= 4 && memcmp(h, "qoif", 4) == 0)
+        return MEDIA_TYPE_QOI;
+    if (n >= 4 && memcmp(h, "fLaC", 4) == 0)
+        return MEDIA_TYPE_FLAC;
+    if (n >= 12 && memcmp(h, "RIFF", 4) == 0 && memcmp(h + 8, "WAVE", 4) == 0)
+        return MEDIA_TYPE_WAV;
+    if (n >= 3 && memcmp(h, "ID3", 3) == 0)
+        return MEDIA_TYPE_MP3;
+    if (n >= 2 && h[0] == 0xFF && (h[1] & 0xE0) == 0xE0) // MPEG 帧同步字
+        return MEDIA_TYPE_MP3;
+    return MEDIA_TYPE_UNKNOWN;
+}
+
+static media_type_t sniff_type(int dirfd, const char *name)
+{
+    uint8_t head[SNIFF_LEN];
+    int fd = openat(dirfd, name, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return MEDIA_TYPE_UNKNOWN;
+    ssize_t n = read(fd, head, sizeof(head));
+    close(fd);
+    return n > 0 ? media_sniff(head, (size_t)n) : MEDIA_TYPE_UNKNOWN;
+}
+
+static bool stop_requested(media_index_t *idx)
+{
+    struct pollfd pfd = {idx->stop_pipe[0], POLLIN, 0};
+    return poll(&pfd, 1, 0) > 0;
+}
+
+static void index_unref(media_index_t *idx)
+{
+    if (__atomic_sub_fetch(&idx->refcnt, 1, __ATOMIC_ACQ_REL) != 0)
+        return;
+
+    mem_tag_free(idx->dir);
+    mem_tag_free(idx->pool);
+    mem_tag_free(idx->entries);
+    mem_tag_free(idx->order);
+    mem_tag_free(idx);
+}
+
+// =============================================================
+// 批次 (扫描线程创建, UI 线程消费)
+// =============================================================
+
+static scan_batch_t *batch_new(media_index_t *idx, batch_op_t op)
+{
+    scan_batch_t *b = mem_tag_calloc(MEM_TAG_INDEX, 1, sizeof(scan_batch_t));
+    if (b)
+    {
+        b->idx = idx;
+        b->op  = op;
+    }
+    return b;
+}
+
+static void batch_free(scan_batch_t *b)
+{
+    mem_tag_free(b->ofs);
+    mem_tag_free(b->types);
+    mem_tag_free(b->pool);
+    mem_tag_free(b);
+}
+
+static void batch_add(scan_batch_t *b, const char *name, media_type_t type)
+{
+    size_t len = strlen(name) + 1;
+
+    if (b->count == b->cap)
+    {
+        uint32_t cap  = b->cap ? b->cap * 2 : 64;
+        uint32_t *ofs = mem_tag_realloc(MEM_TAG_INDEX, b->ofs, cap * sizeof(uint32_t));
+        if (ofs)
+            b->ofs = ofs;
+        uint8_t *types = mem_tag_realloc(MEM_TAG_INDEX, b->types, cap);
+        if (types)
+            b->types = types;
+        if (!ofs || !types)
+            return;
+        b->cap = cap;
+    }
+    if (b->pool_len + len > b->pool_cap)
+    {
+        size_t cap = b->pool_cap ? b->pool_cap * 2 : 4096;
+        while (cap < b->pool_len + len)
+            cap *= 2;
+        char *pool = mem_tag_realloc(MEM_TAG_INDEX, b->pool, cap);
+        if (pool == NULL)
+            return;
+        b->pool     = pool;
+        b->pool_cap = cap;
+    }
+
+    memcpy(&b->pool[b->pool_len], name, len);
+    b->ofs[b->count]   = (uint32_t)b->pool_len;
+    b->types[b->count] = type;
+    b->pool_len += len;
+    b->count++;
+}
+
+static void apply_batch_cb(void *arg);
+
+static void batch_drop(void *arg)
+{
+    scan_batch_t *b    = arg;
+    media_index_t *idx = b->idx;
+    batch_free(b);
+    index_unref(idx);
+}
+
+static void batch_post(scan_batch_t *b)
+{
+    if (b == NULL)
+        return;
+    if (b->count == 0 && b->op != BATCH_DONE)
+    {
+        batch_free(b);
+        return;
+    }
+
+    __atomic_add_fetch(&b->idx->refcnt, 1, __ATOMIC_ACQ_REL);
+    if (bg_worker_post_ui(apply_batch_cb, batch_drop, b) != 0)
+        batch_drop(b);
+}
+
+// =============================================================
+// 扫描线程
+// =============================================================
+
+static bool is_regular(int dirfd, const struct linux_dirent64 *d)
+{
+    if (d->d_type == DT_REG)
+        return true;
+    if (d->d_type != DT_UNKNOWN && d->d_type != DT_LNK)
+        return false;
+
+    struct stat st;
+    return fstatat(dirfd, d->d_name, &st, 0) == 0 && S_ISREG(st.st_mode);
+}
+
+/**
+ * @brief 用 getdents64 大块读取目录，识别类型后分批投递
+ */
+static void scan_dir(media_index_t *idx, int dirfd)
+{
+    char *buf = mem_tag_alloc(MEM_TAG_INDEX, DENTS_BUF_SIZE);
+    if (buf == NULL)
+        return;
+
+    scan_batch_t *b = batch_new(idx, BATCH_ADD);
+    uint32_t limit  = BATCH_FIRST;
+    uint32_t total  = 0;
+
+    while (b && !stop_requested(idx))
+    {
+        long n = syscall(SYS_getdents64, dirfd, buf, DENTS_BUF_SIZE);
+        if (n <= 0)
+            break;
+
+        for (long pos = 0; pos < n;)
+        {
+            struct linux_dirent64 *d = (struct linux_dirent64 *)(buf + pos);
+            pos += d->d_reclen;
+
+            // 跳过 . / .. 和隐藏文件 (包括缩略图缓存)
+            if (d->d_name[0] == '.' || !is_regular(dirfd, d))
+                continue;
+
+            media_type_t type = sniff_type(dirfd, d->d_name);
+            if (!(idx->type_mask & MEDIA_MASK(type)))
+                continue;
+
+            batch_add(b, d->d_name, type);
+            total++;
+            if (b->count >= limit)
+            {
+                batch_post(b);
+                b     = batch_new(idx, BATCH_ADD);
+                limit = BATCH_MAX;
+                if (b == NULL)
+                    break;
+            }
+        }
+    }
+
+    batch_post(b);
+    batch_post(batch_new(idx, BATCH_DONE));
+    mem_tag_free(buf);
+    printf("Media Index: %s scanned, %u files.\n", idx->dir, total);
+}
+
+/**
+ * @brief 监听目录变化，增量更新
+ */
+static void watch_dir(media_index_t *idx, int dirfd, int ifd)
+{
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    struct pollfd fds[2] = {
+        {ifd, POLLIN, 0},
+        {idx->stop_pipe[0], POLLIN, 0},
+    };
+
+    for (;;)
+    {
+        if (poll(fds, 2, -1) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        if (fds[1].revents)
+            break;
+        if (!(fds[0].revents & POLLIN))
+            continue;
+
+        ssize_t len = read(ifd, buf, sizeof(buf));
+        if (len <= 0)
+            continue;
+
+        scan_batch_t *b = NULL;
+        const struct inotify_event *ev;
+        for (char *p = buf; p < buf + len; p += sizeof(struct inotify_event) + ev->len)
+        {
+            ev = (const struct inotify_event *)p;
+            if (ev->len == 0 || ev->name[0] == '.')
+                continue;
+
+            batch_op_t op     = (ev->mask & (IN_DELETE | IN_MOVED_FROM)) ? BATCH_REMOVE : BATCH_ADD;
+            media_type_t type = MEDIA_TYPE_UNKNOWN;
+            if (op == BATCH_ADD)
+            {
+                type = sniff_type(dirfd, ev->name);
+                if (!(idx->type_mask & MEDIA_MASK(type)))
+                    continue;
+            }
+
+            if (b && b->op != op)
+            {
+                batch_post(b);
+                b = NULL;
+            }
+            if (b == NULL)
+                b = batch_new(idx, op);
+            if (b)
+                batch_add(b, ev->name, type);
+        }
+        batch_post(b);
+    }
+}
+
+static void *scan_thread(void *arg)
+{
+    media_index_t *idx = arg;
+
+    int dirfd = open(idx->dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirfd < 0)
+    {
+        printf("Media Index: cannot open %s\n", idx->dir);
+        batch_post(batch_new(idx, BATCH_DONE));
+        return NULL;
+    }
+
+    // 先建立监听再扫描，扫描期间的变化不会丢 (重复的由 UI 侧去重)
+    int ifd = inotify_init1(IN_CLOEXEC);
+    if (ifd >= 0 && inotify_add_watch(ifd, idx->dir, WATCH_MASK) < 0)
+    {
+        close(ifd);
+        ifd = -1;
+    }
+
+    scan_dir(idx, dirfd);
+
+    if (ifd >= 0)
+    {
+        watch_dir(idx, dirfd, ifd);
+        close(ifd);
+    }
+    close(dirfd);
+    return NULL;
+}
+
+// =============================================================
+// UI 线程: 合并批次
+// =============================================================
+
+static const char *entry_name(const media_index_t *idx, uint32_t id)
+{
+    return &idx->pool[idx->entries[id].name_ofs];
+}
+
+/**
+ * @brief 二分查找，返回是否找到；pos 为找到的位置或应插入的位置
+ */
+static bool find_pos(const media_index_t *idx, const char *name, uint32_t *pos)
+{
+    uint32_t lo = 0;
+    uint32_t hi = idx->order_cnt;
+    while (lo < hi)
+    {
+        uint32_t mid = (lo + hi) / 2;
+        int c        = media_natural_cmp(entry_name(idx, idx->order[mid]), name);
+        if (c == 0)
+        {
+            *pos = mid;
+            return true;
+        }
+        if (c < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    *pos = lo;
+    return false;
+}
+
+static int batch_cmp(const void *a, const void *b, void *arg)
+{
+    const scan_batch_t *batch = arg;
+    return media_natural_cmp(&batch->pool[batch->ofs[*(const uint32_t *)a]], &batch->pool[batch->ofs[*(const uint32_t *)b]]);
+}
+
+static bool reserve(media_index_t *idx, uint32_t add_cnt, size_t add_len)
+{
+    if (idx->entry_cnt + add_cnt > idx->entry_cap)
+    {
+        uint32_t cap = idx->entry_cap ? idx->entry_cap : 256;
+        while (cap < idx->entry_cnt + add_cnt)
+            cap *= 2;
+        media_entry_t *entries = mem_tag_realloc(MEM_TAG_INDEX, idx->entries, cap * sizeof(media_entry_t));
+        if (entries == NULL)
+            return false;
+        idx->entries   = entries;
+        idx->entry_cap = cap;
+    }
+    if (idx->pool_len + add_len > idx->pool_cap)
+    {
+        size_t cap = idx->pool_cap ? idx->pool_cap : 16 * 1024;
+        while (cap < idx->pool_len + add_len)
+            cap *= 2;
+        char *pool = mem_tag_realloc(MEM_TAG_INDEX, idx->pool, cap);
+        if (pool == NULL)
+            return false;
+        idx->pool     = pool;
+        idx->pool_cap = cap;
+    }
+    return true;
+}
+
+static void apply_add(media_index_t *idx, scan_batch_t *b)
+{
+    uint32_t *sorted  = mem_tag_alloc(MEM_TAG_INDEX, b->count * sizeof(uint32_t));
+    uint32_t *new_ids = mem_tag_alloc(MEM_TAG_INDEX, b->count * sizeof(uint32_t));
+    if (!sorted || !new_ids || !reserve(idx, b->count, b->pool_len))
+    {
+        mem_tag_free(sorted);
+        mem_tag_free(new_ids);
+        return;
+    }
+
+    // 批内排序，去掉已存在和重复的
+    for (uint32_t i = 0; i < b->count; i++)
+        sorted[i] = i;
+    qsort_r(sorted, b->count, sizeof(uint32_t), batch_cmp, b);
+
+    uint32_t new_cnt = 0;
+    const char *prev = NULL;
+    for (uint32_t k = 0; k < b->count; k++)
+    {
+        const char *name = &b->pool[b->ofs[sorted[k]]];
+        uint32_t pos;
+        if ((prev && strcmp(prev, name) == 0) || find_pos(idx, name, &pos))
+            continue;
+        prev = name;
+
+        size_t len                             = strlen(name) + 1;
+        idx->entries[idx->entry_cnt].name_ofs = (uint32_t)idx->pool_len;
+        idx->entries[idx->entry_cnt].type     = b->types[sorted[k]];
+        memcpy(&idx->pool[idx->pool_len], name, len);
+        idx->pool_len += len;
+        new_ids[new_cnt++] = idx->entry_cnt++;
+    }
+
+    if (new_cnt > 0)
+    {
+        // 两个有序序列归并
+        uint32_t *merged = mem_tag_alloc(MEM_TAG_INDEX, (idx->order_cnt + new_cnt) * sizeof(uint32_t));
+        if (merged)
+        {
+            uint32_t i = 0, j = 0, k = 0;
+            while (i < idx->order_cnt && j < new_cnt)
+            {
+                if (media_natural_cmp(entry_name(idx, idx->order[i]), entry_name(idx, new_ids[j])) < 0)
+                    merged[k++] = idx->order[i++];
+                else
+                    merged[k++] = new_ids[j++];
+            }
+            while (i < idx->order_cnt)
+                merged[k++] = idx->order[i++];
+            while (j < new_cnt)
+                merged[k++] = new_ids[j++];
+
+            mem_tag_free(idx->order);
+            idx->order     = merged;
+            idx->order_cnt = k;
+
+            if (idx->cb)
+            {
+                for (uint32_t n = 0; n < new_cnt; n++)
+                    idx->cb(idx, MEDIA_EVENT_ADDED, entry_name(idx, new_ids[n]), idx->user_data);
+                idx->cb(idx, MEDIA_EVENT_UPDATED, NULL, idx->user_data);
+            }
+        }
+        else
+        {
+            idx->entry_cnt -= new_cnt; // 放弃本批
+        }
+    }
+
+    mem_tag_free(sorted);
+    mem_tag_free(new_ids);
+}
+
+static void apply_remove(media_index_t *idx, scan_batch_t *b)
+{
+    bool changed = false;
+    for (uint32_t k = 0; k < b->count; k++)
+    {
+        const char *name = &b->pool[b->ofs[k]];
+        uint32_t pos;
+        if (!find_pos(idx, name, &pos))
+            continue;
+
+        memmove(&idx->order[pos], &idx->order[pos + 1], (idx->order_cnt - pos - 1) * sizeof(uint32_t));
+        idx->order_cnt--;
+        changed = true;
+        if (idx->cb)
+            idx->cb(idx, MEDIA_EVENT_REMOVED, name, idx->user_data);
+    }
+
+    if (changed && idx->cb)
+        idx->cb(idx, MEDIA_EVENT_UPDATED, NULL, idx->user_data);
+}
+
+static void apply_batch_cb(void *arg)
+{
+    scan_batch_t *b    = arg;
+    media_index_t *idx = b->idx;
+
+    if (!idx->closed)
+    {
+        switch (b->op)
+        {
+            case BATCH_ADD:
+                apply_add(idx, b);
+                break;
+            case BATCH_REMOVE:
+                apply_remove(idx, b);
+                break;
+            case BATCH_DONE:
+                idx->scanning = false;
+                if (idx->cb)
+                    idx->cb(idx, MEDIA_EVENT_SCAN_DONE, NULL, idx->user_data);
+                break;
+        }
+    }
+
+    batch_free(b);
+    index_unref(idx);
+}
+
+// =============================================================
+// 公共接口
+// =============================================================
+
+media_index_t *media_index_create(const char *dir, uint32_t type_mask, media_index_cb_t cb, void *user_data)
+{
+    media_index_t *idx = mem_tag_calloc(MEM_TAG_INDEX, 1, sizeof(media_index_t));
+    if (idx == NULL)
+        return NULL;
+
+    idx->dir       = mem_tag_strdup(MEM_TAG_INDEX, dir);
+    idx->type_mask = type_mask;
+    idx->cb        = cb;
+    idx->user_data = user_data;
+    idx->scanning  = true;
+    idx->refcnt    = 1;
+
+    if (idx->dir == NULL || pipe2(idx->stop_pipe, O_CLOEXEC) != 0)
+    {
+        mem_tag_free(idx->dir);
+        mem_tag_free(idx);
+        return NULL;
+    }
+
+    if (pthread_create(&idx->thread, NULL, scan_thread, idx) == 0)
+        idx->thread_started = true;
+    else
+    {
+        printf("Media Index: Failed to start scan thread.\n");
+        idx->scanning = false;
+    }
+
+    return idx;
+}
+
+void media_index_destroy(media_index_t *idx)
+{
+    if (idx == NULL)
+        return;
+
+    if (idx->thread_started)
+    {
+        if (write(idx->stop_pipe[1], "x", 1) < 0)
+            perror("Media Index: stop");
+        pthread_join(idx->thread, NULL);
+    }
+    close(idx->stop_pipe[0]);
+    close(idx->stop_pipe[1]);
+
+    // 还在 UI 队列中的批次持有引用，最后一个释放时才真正 free
+    idx->closed = true;
+    index_unref(idx);
+}
+
+uint32_t media_index_count(const media_index_t *idx)
+{
+    return idx ? idx->order_cnt : 0;
+}
+
+const char *media_index_name(const media_index_t *idx, uint32_t i)
+{
+    if (idx == NULL || i >= idx->order_cnt)
+        return NULL;
+    return entry_name(idx, idx->order[i]);
+}
+
+media_type_t media_index_type(const media_index_t *idx, uint32_t i)
+{
+    if (idx == NULL || i >= idx->order_cnt)
+        return MEDIA_TYPE_UNKNOWN;
+    return (media_type_t)idx->entries[idx->order[i]].type;
+}
+
+int media_index_find(const media_index_t *idx, const char *name)
+{
+    uint32_t pos;
+    if (idx == NULL || name == NULL || !find_pos(idx, name, &pos))
+        return -1;
+    return (int)pos;
+}
+
+const char *media_index_dir(const media_index_t *idx)
+{
+    return idx->dir;
+}
+
+bool media_index_is_scanning(const media_index_t *idx)
+{
+    return idx && idx->scanning;
+}
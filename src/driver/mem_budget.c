@@ -0,0 +1,366 @@
+#include "mem_budget.h"
+#include "bg_worker.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <malloc.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define PSI_PATH     "/proc/pressure/memory"
+#define MEMINFO_PATH "/proc/meminfo"
+
+// PSI 触发器: 1 秒窗口内有任务因内存不足累计阻塞 150ms 就唤醒监控线程
+#define PSI_TRIGGER "some 150000 1000000"
+// 没有触发事件时也定期检查 MemAvailable (内核不支持 PSI 时只能靠这个)
+#define POLL_MS 1000
+// 压力持续期间重复释放的间隔 (缓存可能又被填满了)
+#define REPEAT_MS 5000
+// PSI 10 秒平均阻塞比例 (百分比 x100): some 超过 10% 算紧张, full 超过 10% 算严重
+#define PSI_SOME_MODERATE 1000
+#define PSI_FULL_CRITICAL 1000
+// 每次至少腾出的空间，避免在水位线附近反复一点点地释放
+#define TRIM_MIN_BYTES (4 * 1024 * 1024)
+
+typedef struct
+{
+    const char *name;
+    mem_prio_t prio;
+    mem_usage_cb_t usage_cb;
+    mem_trim_cb_t trim_cb;
+    size_t trimmed; // 累计释放的字节数
+} mem_cache_t;
+
+// 一次采样的结果
+typedef struct
+{
+    long avail_kb; // MemAvailable, -1 表示读取失败
+    int some10;    // PSI some avg10 x100, -1 表示不支持
+    int full10;    // PSI full avg10 x100
+} mem_sample_t;
+
+// --- 静态变量 ---
+// 缓存列表只在 UI 线程访问
+static mem_cache_t caches[MEM_BUDGET_MAX_CACHES];
+static int cache_count = 0;
+
+// 监控线程
+static pthread_t monitor_thread;
+static bool monitor_running = false;
+static int stop_pipe[2]     = {-1, -1};
+
+// 监控线程写、其他线程读 (__atomic)
+static int cur_level       = MEM_PRESSURE_NONE;
+static int pending_level   = MEM_PRESSURE_NONE; // 投递给 UI 线程的释放请求
+static long pending_need   = 0;
+static long last_avail_kb  = -1;
+static int last_some10     = -1;
+static int last_full10     = -1;
+
+static const char *level_name(mem_pressure_t level)
+{
+    static const char *names[] = {"none", "moderate", "critical"};
+    return names[level];
+}
+
+static uint32_t now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
+/**
+ * @brief 读取 MemAvailable (KB)
+ */
+static long read_mem_available(void)
+{
+    FILE *f = fopen(MEMINFO_PATH, "r");
+    if (f == NULL)
+        return -1;
+
+    char line[128];
+    long kb = -1;
+    while (fgets(line, sizeof(line), f))
+    {
+        if (sscanf(line, "MemAvailable: %ld kB", &kb) == 1)
+            break;
+    }
+    fclose(f);
+    return kb;
+}
+
+/**
+ * @brief 读取 PSI 的 10 秒平均值: "some avg10=1.23 ..." / "full avg10=0.00 ..."
+ */
+static void read_psi(int *some10, int *full10)
+{
+    *some10 = *full10 = -1;
+    FILE *f = fopen(PSI_PATH, "r");
+    if (f == NULL)
+        return;
+
+    char line[128];
+    unsigned int whole, frac;
+    while (fgets(line, sizeof(line), f))
+    {
+        if (sscanf(line, "some avg10=%u.%u", &whole, &frac) == 2)
+            *some10 = (int)(whole * 100 + frac);
+        else if (sscanf(line, "full avg10=%u.%u", &whole, &frac) == 2)
+            *full10 = (int)(whole * 100 + frac);
+    }
+    fclose(f);
+}
+
+/**
+ * @brief 注册 PSI 触发器，内核不支持 (没有 CONFIG_PSI 或没有权限) 时返回 -1
+ */
+static int open_psi_trigger(void)
+{
+    int fd = open(PSI_PATH, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0)
+        return -1;
+    if (write(fd, PSI_TRIGGER, strlen(PSI_TRIGGER) + 1) < 0)
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * @brief 根据采样结果和触发器事件判断压力等级
+ */
+static mem_pressure_t classify(const mem_sample_t *s, bool triggered)
+{
+    if ((s->avail_kb >= 0 && s->avail_kb < MEM_CRITICAL_KB) || s->full10 >= PSI_FULL_CRITICAL)
+        return MEM_PRESSURE_CRITICAL;
+    if ((s->avail_kb >= 0 && s->avail_kb < MEM_LOW_KB) || s->some10 >= PSI_SOME_MODERATE || triggered)
+        return MEM_PRESSURE_MODERATE;
+    return MEM_PRESSURE_NONE;
+}
+
+/**
+ * @brief UI 线程: 执行监控线程请求的释放
+ */
+static void trim_ui_cb(void *arg)
+{
+    (void)arg;
+    mem_pressure_t level = (mem_pressure_t)__atomic_load_n(&pending_level, __ATOMIC_ACQUIRE);
+    long need            = __atomic_load_n(&pending_need, __ATOMIC_RELAXED);
+    if (level != MEM_PRESSURE_NONE)
+        mem_budget_trim(level, (size_t)need);
+}
+
+/**
+ * @brief 监控线程: 等待 PSI 事件或超时，采样后决定是否请求释放
+ */
+static void *monitor_main(void *param)
+{
+    (void)param;
+
+    int psi_fd = open_psi_trigger();
+    printf("Mem Budget: %s\n", psi_fd >= 0 ? "PSI trigger armed" : "PSI unavailable, polling " MEMINFO_PATH);
+
+    mem_pressure_t posted = MEM_PRESSURE_NONE;
+    uint32_t posted_ms    = 0;
+    while (1)
+    {
+        struct pollfd fds[2] = {
+            {.fd = stop_pipe[0], .events = POLLIN},
+            {.fd = psi_fd, .events = POLLPRI},
+        };
+        int n = poll(fds, psi_fd >= 0 ? 2 : 1, POLL_MS);
+        if (n < 0 && errno != EINTR)
+            break;
+        if (fds[0].revents)
+            break; // mem_budget_deinit
+
+        bool triggered = false;
+        if (psi_fd >= 0 && (fds[1].revents & (POLLERR | POLLNVAL)))
+        {
+            // 触发器失效 (cgroup 被删除等)，退回轮询
+            close(psi_fd);
+            psi_fd = -1;
+        }
+        else if (psi_fd >= 0 && (fds[1].revents & POLLPRI))
+        {
+            triggered = true;
+        }
+
+        mem_sample_t s;
+        s.avail_kb = read_mem_available();
+        read_psi(&s.some10, &s.full10);
+        __atomic_store_n(&last_avail_kb, s.avail_kb, __ATOMIC_RELAXED);
+        __atomic_store_n(&last_some10, s.some10, __ATOMIC_RELAXED);
+        __atomic_store_n(&last_full10, s.full10, __ATOMIC_RELAXED);
+
+        mem_pressure_t level = classify(&s, triggered);
+        __atomic_store_n(&cur_level, level, __ATOMIC_RELAXED);
+
+        // 压力上升时立即释放，持续期间每隔 REPEAT_MS 再释放一次
+        if (level != MEM_PRESSURE_NONE && (level > posted || now_ms() - posted_ms >= REPEAT_MS))
+        {
+            long need = (s.avail_kb >= 0 && s.avail_kb < MEM_LOW_KB) ? (MEM_LOW_KB - s.avail_kb) * 1024 : 0;
+            if (need < TRIM_MIN_BYTES)
+                need = TRIM_MIN_BYTES;
+            __atomic_store_n(&pending_need, need, __ATOMIC_RELAXED);
+            __atomic_store_n(&pending_level, level, __ATOMIC_RELEASE);
+            bg_worker_post_ui(trim_ui_cb, NULL, NULL);
+            posted_ms = now_ms();
+        }
+        if (level != posted)
+            printf("Mem Budget: pressure %s (MemAvailable %ld KB)\n", level_name(level), s.avail_kb);
+        posted = level;
+    }
+
+    if (psi_fd >= 0)
+        close(psi_fd);
+    return NULL;
+}
+
+int mem_budget_init(void)
+{
+    if (monitor_running)
+        return 0;
+
+    if (pipe(stop_pipe) != 0)
+        return -1;
+    if (pthread_create(&monitor_thread, NULL, monitor_main, NULL) != 0)
+    {
+        printf("Mem Budget: Failed to create monitor thread.\n");
+        close(stop_pipe[0]);
+        close(stop_pipe[1]);
+        stop_pipe[0] = stop_pipe[1] = -1;
+        return -1;
+    }
+    monitor_running = true;
+    return 0;
+}
+
+void mem_budget_deinit(void)
+{
+    if (!monitor_running)
+        return;
+
+    char c = 0;
+    if (write(stop_pipe[1], &c, 1) < 0)
+        perror("Mem Budget");
+    pthread_join(monitor_thread, NULL);
+    close(stop_pipe[0]);
+    close(stop_pipe[1]);
+    stop_pipe[0] = stop_pipe[1] = -1;
+    monitor_running = false;
+}
+
+int mem_budget_register(const char *name, mem_prio_t prio, mem_usage_cb_t usage_cb, mem_trim_cb_t trim_cb)
+{
+    mem_cache_t *c = NULL;
+    for (int i = 0; i < cache_count; i++)
+    {
+        if (strcmp(caches[i].name, name) == 0)
+            c = &caches[i];
+    }
+    if (c == NULL)
+    {
+        if (cache_count >= MEM_BUDGET_MAX_CACHES)
+            return -1;
+        c = &caches[cache_count++];
+        memset(c, 0, sizeof(mem_cache_t));
+    }
+
+    c->name     = name;
+    c->prio     = prio;
+    c->usage_cb = usage_cb;
+    c->trim_cb  = trim_cb;
+    return 0;
+}
+
+void mem_budget_unregister(const char *name)
+{
+    for (int i = 0; i < cache_count; i++)
+    {
+        if (strcmp(caches[i].name, name) == 0)
+        {
+            caches[i] = caches[--cache_count];
+            return;
+        }
+    }
+}
+
+mem_pressure_t mem_budget_pressure(void)
+{
+    return (mem_pressure_t)__atomic_load_n(&cur_level, __ATOMIC_RELAXED);
+}
+
+void mem_budget_trim(mem_pressure_t level, size_t need)
+{
+    if (level == MEM_PRESSURE_NONE)
+        return;
+
+    // 按优先级从低到高释放，MODERATE 腾出 need 字节就停下
+    size_t freed = 0;
+    for (mem_prio_t prio = MEM_PRIO_PREFETCH; prio <= MEM_PRIO_CORE; prio++)
+    {
+        for (int i = 0; i < cache_count; i++)
+        {
+            mem_cache_t *c = &caches[i];
+            if (c->prio != prio || c->trim_cb == NULL)
+                continue;
+            if (level != MEM_PRESSURE_CRITICAL && freed >= need)
+                break;
+
+            size_t before = c->usage_cb();
+            size_t want   = need - freed;
+            size_t target = (level == MEM_PRESSURE_CRITICAL || before <= want) ? 0 : before - want;
+            c->trim_cb(target);
+
+            size_t after = c->usage_cb();
+            if (after < before)
+            {
+                c->trimmed += before - after;
+                freed += before - after;
+            }
+        }
+    }
+
+    // 除了超过 mmap 阈值的大块，释放的内存只是回到 malloc 的空闲链表，MemAvailable 不会变: 把空闲的整页交还内核
+#ifdef __GLIBC__
+    if (freed > 0)
+        malloc_trim(0);
+#endif
+
+    printf("Mem Budget: %s pressure, freed %zu KB\n", level_name(level), freed / 1024);
+    mem_budget_report();
+}
+
+void mem_budget_report(void)
+{
+    long avail = __atomic_load_n(&last_avail_kb, __ATOMIC_RELAXED);
+    int some10 = __atomic_load_n(&last_some10, __ATOMIC_RELAXED);
+    int full10 = __atomic_load_n(&last_full10, __ATOMIC_RELAXED);
+    if (avail < 0)
+        avail = read_mem_available();
+
+    if (some10 >= 0)
+        printf("Mem Budget: MemAvailable %ld KB, PSI some %d.%02d%% full %d.%02d%%\n", avail, some10 / 100,
+               some10 % 100, full10 / 100, full10 % 100);
+    else
+        printf("Mem Budget: MemAvailable %ld KB\n", avail);
+
+    size_t total = 0;
+    printf("  %-12s %4s %10s %10s\n", "cache", "prio", "used KB", "freed KB");
+    for (int i = 0; i < cache_count; i++)
+    {
+        const mem_cache_t *c = &caches[i];
+        size_t used          = c->usage_cb();
+        total += used;
+        printf("  %-12s %4d %10zu %10zu\n", c->name, c->prio, used / 1024, c->trimmed / 1024);
+    }
+    printf("  %-12s %4s %10zu\n", "total", "", total / 1024);
+}
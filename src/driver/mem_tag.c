@@ -0,0 +1,234 @@
+#include "mem_tag.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define HDR_MAGIC  0x4D544147u // "MTAG"
+#define HDR_FREED  0x46524545u // "FREE": 重复释放时能认出来
+
+// 块头: 大小与 max_align_t 对齐，返回给调用者的指针保持 malloc 的对齐
+typedef union
+{
+    struct
+    {
+        size_t size;
+        uint32_t tag;
+        uint32_t magic;
+    } h;
+    max_align_t align;
+} mem_hdr_t;
+
+// --- 静态变量 (全部用 __atomic 访问) ---
+static mem_tag_stats_t stats[MEM_TAG_COUNT];
+static __thread mem_tag_t scope_tag = MEM_TAG_LVGL;
+
+static const char *tag_names[MEM_TAG_COUNT] = {"lvgl", "image", "font", "text", "audio", "index"};
+
+/**
+ * @brief 直方图的桶: 16 字节以内为 0，之后每翻一倍加一
+ */
+static int hist_bucket(size_t size)
+{
+    if (size <= 16)
+        return 0;
+    int bucket = (int)(sizeof(unsigned long long) * 8) - __builtin_clzll((unsigned long long)size - 1) - 4;
+    return bucket < MEM_TAG_HIST_BUCKETS ? bucket : MEM_TAG_HIST_BUCKETS - 1;
+}
+
+static void account_alloc(mem_tag_t tag, size_t size)
+{
+    mem_tag_stats_t *s = &stats[tag];
+    size_t live        = __atomic_add_fetch(&s->live, size, __ATOMIC_RELAXED);
+    size_t peak        = __atomic_load_n(&s->peak, __ATOMIC_RELAXED);
+    while (live > peak && !__atomic_compare_exchange_n(&s->peak, &peak, live, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+    {
+    }
+    __atomic_add_fetch(&s->allocs, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&s->hist[hist_bucket(size)], 1, __ATOMIC_RELAXED);
+}
+
+static void account_free(mem_tag_t tag, size_t size)
+{
+    __atomic_sub_fetch(&stats[tag].live, size, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&stats[tag].frees, 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief 取出块头，不是 mem_tag 分配的指针返回 NULL
+ */
+static mem_hdr_t *get_hdr(void *p)
+{
+    mem_hdr_t *hdr = (mem_hdr_t *)p - 1;
+    if (hdr->h.magic == HDR_MAGIC && hdr->h.tag < MEM_TAG_COUNT)
+        return hdr;
+    printf("Mem Tag: %s %p\n", hdr->h.magic == HDR_FREED ? "double free of" : "foreign pointer", p);
+    return NULL;
+}
+
+void *mem_tag_alloc(mem_tag_t tag, size_t size)
+{
+    if (size > SIZE_MAX - sizeof(mem_hdr_t))
+        return NULL;
+    mem_hdr_t *hdr = malloc(sizeof(mem_hdr_t) + size);
+    if (hdr == NULL)
+        return NULL;
+
+    hdr->h.size  = size;
+    hdr->h.tag   = tag;
+    hdr->h.magic = HDR_MAGIC;
+    account_alloc(tag, size);
+    return hdr + 1;
+}
+
+void *mem_tag_calloc(mem_tag_t tag, size_t n, size_t size)
+{
+    if (size && n > SIZE_MAX / size)
+        return NULL;
+    void *p = mem_tag_alloc(tag, n * size);
+    if (p)
+        memset(p, 0, n * size);
+    return p;
+}
+
+void *mem_tag_realloc(mem_tag_t tag, void *p, size_t size)
+{
+    if (p == NULL)
+        return mem_tag_alloc(tag, size);
+
+    mem_hdr_t *hdr = get_hdr(p);
+    if (hdr == NULL || size > SIZE_MAX - sizeof(mem_hdr_t))
+        return NULL;
+
+    // realloc 失败时原块不变，成功后才更新统计
+    mem_tag_t old_tag = (mem_tag_t)hdr->h.tag;
+    size_t old_size   = hdr->h.size;
+    mem_hdr_t *n      = realloc(hdr, sizeof(mem_hdr_t) + size);
+    if (n == NULL)
+        return NULL;
+
+    n->h.size = size;
+    account_free(old_tag, old_size);
+    account_alloc(old_tag, size);
+    return n + 1;
+}
+
+char *mem_tag_strdup(mem_tag_t tag, const char *s)
+{
+    size_t len = strlen(s) + 1;
+    char *p    = mem_tag_alloc(tag, len);
+    if (p)
+        memcpy(p, s, len);
+    return p;
+}
+
+void mem_tag_free(void *p)
+{
+    if (p == NULL)
+        return;
+
+    mem_hdr_t *hdr = get_hdr(p);
+    if (hdr == NULL)
+        return; // 宁可泄漏也不把错误的指针交给 free
+
+    account_free((mem_tag_t)hdr->h.tag, hdr->h.size);
+    hdr->h.magic = HDR_FREED;
+    free(hdr);
+}
+
+mem_tag_t mem_tag_scope_begin(mem_tag_t tag)
+{
+    mem_tag_t prev = scope_tag;
+    scope_tag      = tag;
+    return prev;
+}
+
+void mem_tag_scope_end(mem_tag_t prev)
+{
+    scope_tag = prev;
+}
+
+void *mem_tag_lv_alloc(size_t size)
+{
+    return mem_tag_alloc(scope_tag, size);
+}
+
+void mem_tag_lv_free(void *p)
+{
+    mem_tag_free(p);
+}
+
+void *mem_tag_lv_realloc(void *p, size_t size)
+{
+    return mem_tag_realloc(scope_tag, p, size);
+}
+
+void mem_tag_get_stats(mem_tag_t tag, mem_tag_stats_t *out)
+{
+    const mem_tag_stats_t *s = &stats[tag];
+    out->live                = __atomic_load_n(&s->live, __ATOMIC_RELAXED);
+    out->peak                = __atomic_load_n(&s->peak, __ATOMIC_RELAXED);
+    out->allocs              = __atomic_load_n(&s->allocs, __ATOMIC_RELAXED);
+    out->frees               = __atomic_load_n(&s->frees, __ATOMIC_RELAXED);
+    for (int i = 0; i < MEM_TAG_HIST_BUCKETS; i++)
+        out->hist[i] = __atomic_load_n(&s->hist[i], __ATOMIC_RELAXED);
+}
+
+void mem_tag_report(void)
+{
+    mem_tag_stats_t s[MEM_TAG_COUNT];
+    size_t live = 0;
+    printf("Mem Tag: %-6s %10s %10s %10s %10s\n", "tag", "live KB", "peak KB", "allocs", "frees");
+    for (int t = 0; t < MEM_TAG_COUNT; t++)
+    {
+        mem_tag_get_stats((mem_tag_t)t, &s[t]);
+        live += s[t].live;
+        printf("         %-6s %10zu %10zu %10zu %10zu\n", tag_names[t], s[t].live / 1024, s[t].peak / 1024, s[t].allocs,
+               s[t].frees);
+    }
+    printf("         %-6s %10zu\n", "total", live / 1024);
+
+    // 直方图: 每行一个桶，只打印有分配的桶
+    printf("Mem Tag: size histogram (allocations)\n         %-8s", "<=");
+    for (int t = 0; t < MEM_TAG_COUNT; t++)
+        printf(" %8s", tag_names[t]);
+    printf("\n");
+    for (int b = 0; b < MEM_TAG_HIST_BUCKETS; b++)
+    {
+        size_t sum = 0;
+        for (int t = 0; t < MEM_TAG_COUNT; t++)
+            sum += s[t].hist[b];
+        if (sum == 0)
+            continue;
+
+        char label[16];
+        size_t limit = (size_t)16 << b;
+        if (b == MEM_TAG_HIST_BUCKETS - 1)
+            snprintf(label, sizeof(label), ">%zuK", (limit >> 1) / 1024);
+        else if (limit >= 1024)
+            snprintf(label, sizeof(label), "%zuK", limit / 1024);
+        else
+            snprintf(label, sizeof(label), "%zu", limit);
+        printf("         %-8s", label);
+        for (int t = 0; t < MEM_TAG_COUNT; t++)
+            printf(" %8zu", s[t].hist[b]);
+        printf("\n");
+    }
+}
+
+void mem_tag_leak_report(void)
+{
+    int leaked = 0;
+    for (int t = 0; t < MEM_TAG_COUNT; t++)
+    {
+        mem_tag_stats_t s;
+        mem_tag_get_stats((mem_tag_t)t, &s);
+        if (s.live == 0 && s.allocs == s.frees)
+            continue;
+        printf("Mem Tag: %-6s still holds %zu bytes in %zu blocks at exit\n", tag_names[t], s.live, s.allocs - s.frees);
+        leaked++;
+    }
+    if (leaked == 0)
+        printf("Mem Tag: no leaks\n");
+}
@@ -0,0 +1,320 @@
+#include "music_cover.h"
+#include "hash_table.h"
+#include "img_loader.h"
+#include "mem_tag.h"
+#include "music_lib.h"
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+ * pack 文件布局与缩略图 pack 相同:
+ *   [pack_header_t][pack_entry_t x COVER_CAPACITY] ... 页对齐 ... [tile x COVER_CAPACITY]
+ * 条目用开放寻址哈希表存放，第 i 个条目对应第 i 个 tile，w/h 为 0 表示这首歌没有封面。
+ * 写入方 (后台线程) 用 seq 做顺序锁: 奇数表示正在写，读取方 (UI 线程) 读到奇数或前后不一致就当作未命中。
+ * 槽位探测满了会覆盖别的歌的封面，所以 UI 不直接显示 mmap 里的 tile，而是在 seq 的保护下拷到自己的缓冲里。
+ */
+
+#define PACK_MAGIC   0x52564F43 // "COVR"
+#define PACK_VERSION 1
+#define PROBE_MAX    8 // 最多探测的槽位数
+#define TILE_BYTES   (COVER_SIZE * COVER_SIZE * sizeof(lv_color_t))
+#define PAGE_ALIGN(x) (((x) + 4095) & ~(size_t)4095)
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t version;
+    uint16_t tile_w;
+    uint16_t tile_h;
+    uint32_t capacity;
+} pack_header_t;
+
+typedef struct
+{
+    uint64_t key;   // 路径哈希, 0 表示空槽
+    int64_t mtime;  // 歌曲文件修改时间
+    uint64_t size;  // 歌曲文件大小
+    uint16_t w;     // 封面实际尺寸 (<= COVER_SIZE x COVER_SIZE), 0 表示没有封面
+    uint16_t h;
+    uint32_t seq;   // 奇数: 写入中, 偶数: 稳定 (只增不减)
+} pack_entry_t;
+
+// --- 静态变量 ---
+static int pack_fd           = -1;
+static uint8_t *pack_base    = NULL;
+static size_t pack_size      = 0;
+static pack_entry_t *entries = NULL;
+static uint8_t *tiles        = NULL;
+static pthread_mutex_t write_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief 在 seq 一致的前提下判断条目是否与 key/mtime/size 匹配
+ * pixels 不为 NULL 时顺便把封面拷出来，拷贝期间被改写也算不匹配
+ */
+static bool entry_matches(pack_entry_t *e, uint64_t key, const struct stat *st, uint16_t *w, uint16_t *h,
+                          lv_color_t *pixels)
+{
+    uint32_t seq;
+    if (!hash_table_read_begin(&e->seq, &seq))
+        return false;
+
+    bool match = e->key == key && e->mtime == (int64_t)st->st_mtime && e->size == (uint64_t)st->st_size;
+    *w = e->w;
+    *h = e->h;
+    if (match && pixels && *w > 0 && *h > 0 && *w <= COVER_SIZE && *h <= COVER_SIZE)
+        memcpy(pixels, &tiles[(size_t)(e - entries) * TILE_BYTES], (size_t)*w * *h * sizeof(lv_color_t));
+
+    return match && hash_table_read_end(&e->seq, seq);
+}
+
+/**
+ * @brief 查找有效条目，返回索引，未命中返回 -1
+ */
+static int find_entry(uint64_t key, const struct stat *st, uint16_t *w, uint16_t *h, lv_color_t *pixels)
+{
+    for (int i = 0; i < PROBE_MAX; i++)
+    {
+        uint32_t idx = hash_table_probe(key, i, COVER_CAPACITY);
+        if (entry_matches(&entries[idx], key, st, w, h, pixels))
+            return (int)idx;
+    }
+    return -1;
+}
+
+/**
+ * @brief 写入条目，img 为 NULL 时记为没有封面
+ */
+static void store(uint64_t key, const struct stat *st, const img_buf_t *img)
+{
+    pthread_mutex_lock(&write_lock);
+
+    uint32_t slot   = hash_table_pick(entries, sizeof(pack_entry_t), COVER_CAPACITY, PROBE_MAX, key, NULL);
+    pack_entry_t *e = &entries[slot];
+    uint32_t seq    = hash_table_write_begin(&e->seq);
+
+    if (img)
+        memcpy(&tiles[(size_t)slot * TILE_BYTES], img->data, (size_t)img->w * img->h * sizeof(lv_color_t));
+    e->key   = key;
+    e->mtime = st->st_mtime;
+    e->size  = st->st_size;
+    e->w     = img ? img->w : 0;
+    e->h     = img ? img->h : 0;
+    hash_table_write_end(&e->seq, seq);
+
+    pthread_mutex_unlock(&write_lock);
+}
+
+int music_cover_open(const char *pack_path)
+{
+    if (pack_base)
+        return 0;
+
+    size_t tiles_ofs = PAGE_ALIGN(sizeof(pack_header_t) + COVER_CAPACITY * sizeof(pack_entry_t));
+    size_t total     = tiles_ofs + (size_t)COVER_CAPACITY * TILE_BYTES;
+
+    pack_fd = open(pack_path, O_RDWR | O_CREAT, 0644);
+    if (pack_fd < 0)
+    {
+        perror("Cover: cannot open pack file");
+        return -1;
+    }
+
+    struct stat st;
+    fstat(pack_fd, &st);
+    bool fresh = (size_t)st.st_size != total;
+    if (fresh)
+    {
+        // 新建或尺寸不符: 重建为稀疏文件，未使用的 tile 不占磁盘
+        if (ftruncate(pack_fd, 0) != 0 || ftruncate(pack_fd, total) != 0)
+        {
+            perror("Cover: cannot resize pack file");
+            close(pack_fd);
+            pack_fd = -1;
+            return -1;
+        }
+    }
+
+    pack_base = mmap(NULL, total, PROT_READ | PROT_WRITE, MAP_SHARED, pack_fd, 0);
+    if (pack_base == MAP_FAILED)
+    {
+        perror("Cover: mmap failed");
+        pack_base = NULL;
+        close(pack_fd);
+        pack_fd = -1;
+        return -1;
+    }
+    pack_size = total;
+
+    pack_header_t *hdr = (pack_header_t *)pack_base;
+    entries            = (pack_entry_t *)(pack_base + sizeof(pack_header_t));
+    tiles              = pack_base + tiles_ofs;
+
+    if (fresh || hdr->magic != PACK_MAGIC || hdr->version != PACK_VERSION ||
+        hdr->tile_w != COVER_SIZE || hdr->tile_h != COVER_SIZE || hdr->capacity != COVER_CAPACITY)
+    {
+        memset(entries, 0, COVER_CAPACITY * sizeof(pack_entry_t));
+        hdr->magic    = PACK_MAGIC;
+        hdr->version  = PACK_VERSION;
+        hdr->tile_w   = COVER_SIZE;
+        hdr->tile_h   = COVER_SIZE;
+        hdr->capacity = COVER_CAPACITY;
+        printf("Cover: New pack %s\n", pack_path);
+    }
+
+    return 0;
+}
+
+void music_cover_close(void)
+{
+    if (pack_base)
+    {
+        msync(pack_base, pack_size, MS_SYNC);
+        munmap(pack_base, pack_size);
+        pack_base = NULL;
+        entries   = NULL;
+        tiles     = NULL;
+    }
+    if (pack_fd >= 0)
+    {
+        close(pack_fd);
+        pack_fd = -1;
+    }
+}
+
+size_t music_cover_mem_usage(void)
+{
+    if (pack_base == NULL)
+        return 0;
+
+    // 按块查询驻留的页，不用为整个文件分配向量
+    unsigned char vec[256];
+    size_t used = 0;
+    for (size_t ofs = 0; ofs < pack_size; ofs += sizeof(vec) * 4096)
+    {
+        size_t len   = LV_MIN(pack_size - ofs, sizeof(vec) * 4096);
+        size_t pages = (len + 4095) / 4096;
+        if (mincore(pack_base + ofs, len, vec) != 0)
+            return used;
+        for (size_t i = 0; i < pages; i++)
+            used += (vec[i] & 1) ? 4096 : 0;
+    }
+    return used;
+}
+
+void music_cover_trim(size_t target)
+{
+    if (pack_base == NULL || music_cover_mem_usage() <= target)
+        return;
+
+    // 共享映射: 写回后解除映射再让内核丢掉干净的页，数据都在文件里
+    msync(pack_base, pack_size, MS_SYNC);
+    madvise(pack_base, pack_size, MADV_DONTNEED);
+    posix_fadvise(pack_fd, 0, 0, POSIX_FADV_DONTNEED);
+}
+
+music_cover_state_t music_cover_lookup(const char *path, lv_img_dsc_t *dsc, lv_color_t *pixels)
+{
+    if (pack_base == NULL)
+        return MUSIC_COVER_MISS;
+
+    struct stat st;
+    if (stat(path, &st) != 0)
+        return MUSIC_COVER_MISS;
+
+    uint16_t w, h;
+    int idx = find_entry(hash_table_key(path), &st, &w, &h, pixels);
+    if (idx < 0)
+        return MUSIC_COVER_MISS;
+    if (w == 0 || h == 0 || w > COVER_SIZE || h > COVER_SIZE)
+        return MUSIC_COVER_NONE;
+
+    memset(dsc, 0, sizeof(lv_img_dsc_t));
+    dsc->header.cf = LV_IMG_CF_TRUE_COLOR;
+    dsc->header.w  = w;
+    dsc->header.h  = h;
+    dsc->data_size = (uint32_t)w * h * sizeof(lv_color_t);
+    dsc->data      = (const uint8_t *)pixels;
+    return MUSIC_COVER_READY;
+}
+
+int music_cover_generate(const char *path)
+{
+    if (pack_base == NULL)
+        return -1;
+
+    struct stat st;
+    if (stat(path, &st) != 0)
+        return -1;
+
+    uint64_t key = hash_table_key(path);
+    uint16_t w, h;
+    if (find_entry(key, &st, &w, &h, NULL) >= 0)
+        return 0;
+
+    // 只读标签里的图片数据，JPEG 按目标尺寸做 DCT 缩放解码，不会先解出整张大图
+    uint8_t *data;
+    size_t size;
+    img_buf_t img;
+    bool ok = false;
+    if (music_lib_read_cover(path, &data, &size) == 0)
+    {
+        ok = img_loader_decode_mem(data, size, COVER_SIZE, COVER_SIZE, &img) == 0;
+        mem_tag_free(data);
+    }
+
+    store(key, &st, ok ? &img : NULL);
+    if (ok)
+        img_buf_free(&img);
+    return 0;
+}
+
+// 后台提取
+typedef struct
+{
+    music_cover_cb_t cb;
+    void *user_data;
+    int res;
+    char path[]; // 柔性数组
+} cover_job_t;
+
+static void cover_job_free(void *arg)
+{
+    mem_tag_free(arg);
+}
+
+static void cover_done_cb(void *arg)
+{
+    cover_job_t *job = arg;
+    job->cb(job->path, job->res == 0, job->user_data);
+    mem_tag_free(job);
+}
+
+static void cover_job(void *arg)
+{
+    cover_job_t *job = arg;
+    job->res         = music_cover_generate(job->path);
+    if (job->cb == NULL || bg_worker_post_ui(cover_done_cb, cover_job_free, job) != 0)
+        mem_tag_free(job);
+}
+
+int music_cover_request(const char *path, bg_prio_t prio, music_cover_cb_t cb, void *user_data)
+{
+    size_t len       = strlen(path) + 1;
+    cover_job_t *job = mem_tag_alloc(MEM_TAG_IMAGE, sizeof(cover_job_t) + len);
+    if (job == NULL)
+        return -1;
+    job->cb        = cb;
+    job->user_data = user_data;
+    memcpy(job->path, path, len);
+    if (bg_worker_submit(prio, cover_job, cover_job_free, job) != 0)
+    {
+        mem_tag_free(job);
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,1442 @@
+#include "music_lib.h"
+#include "bg_worker.h"
+#include "hash_table.h"
+#include "mem_tag.h"
+#include <fcntl.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+ * 索引文件布局:
+ *   [lib_header_t][lib_entry_t x MUSIC_LIB_CAPACITY][字符串区 MUSIC_LIB_HEAP_SIZE]
+ * 条目与图片头索引一样用开放寻址哈希表存放，按路径哈希 + mtime + 文件大小匹配，seq 做顺序锁。
+ * 标题/艺术家/专辑以 "title\0artist\0album\0" 的形式追加到字符串区，条目里只记偏移，
+ * 没有标签的歌曲不占字符串区。条目被覆盖后旧字符串不回收，字符串区写满时整个索引清空重建。
+ * 响度分析的结果 (音轨增益、峰值) 直接改写已有条目，不另占空间。
+ */
+
+#define LIB_MAGIC      0x42494C4D // "MLIB"
+#define LIB_VERSION    3
+#define PROBE_MAX      64           // 线性探测，1 万首 (装填率 0.6) 时偶尔有长簇，16 不够
+#define TEXT_FRAME_MAX 1024         // 超过这个长度的文本帧不读 (正常的标题远小于它)
+#define ID3_UNSYNC_MAX (256 * 1024) // 整体反同步的 ID3v2 最多读入这么多 (后面多半是封面)
+#define VORBIS_MAX     (64 * 1024)  // Vorbis comment / LIST 块最多读入这么多
+#define SYNC_SCAN_MAX  (64 * 1024)  // 找第一个 MPEG 帧最多扫描的字节数
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t capacity;
+    uint32_t heap_size;
+    uint32_t heap_used; // 只在 write_lock 下修改
+    uint32_t reserved[3];
+} lib_header_t;
+
+typedef struct
+{
+    uint64_t key;   // 路径哈希, 0 表示空槽
+    int64_t mtime;  // 源文件修改时间
+    uint64_t size;  // 源文件大小
+    uint32_t duration_ms;
+    uint32_t sample_rate;
+    uint32_t text_ofs; // 字符串区中的偏移
+    uint16_t text_len; // 0 表示没有标签
+    uint16_t track;
+    uint16_t bitrate;
+    int16_t gain_cdb;
+    int16_t peak_cdb;
+    uint8_t format;    // media_type_t
+    uint8_t channels;
+    uint8_t gain_source; // music_gain_source_t
+    uint8_t reserved[3];
+    uint32_t seq;      // 奇数: 写入中, 偶数: 稳定 (只增不减，清空时也只是加 2)
+} lib_entry_t;
+
+// --- 静态变量 ---
+static int lib_fd            = -1;
+static uint8_t *lib_base     = NULL;
+static size_t lib_size       = 0;
+static lib_header_t *lib_hdr = NULL;
+static lib_entry_t *entries  = NULL;
+static char *heap            = NULL;
+static pthread_mutex_t write_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static uint32_t be32(const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static uint32_t be24(const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 16) | ((uint32_t)p[1] << 8) | p[2];
+}
+
+static uint32_t le32(const uint8_t *p)
+{
+    return p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint16_t le16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t syncsafe32(const uint8_t *p)
+{
+    return ((uint32_t)(p[0] & 0x7F) << 21) | ((uint32_t)(p[1] & 0x7F) << 14) | ((uint32_t)(p[2] & 0x7F) << 7) |
+           (p[3] & 0x7F);
+}
+
+// =============================================================
+// 索引
+// =============================================================
+
+/**
+ * @brief 把 "a\0b\0c\0" 拆回三个字段，每个字段截断到 MUSIC_TAG_LEN
+ */
+static void unpack_text(const char *text, uint32_t len, music_info_t *info)
+{
+    char *fields[3] = {info->title, info->artist, info->album};
+    uint32_t pos    = 0;
+    for (int f = 0; f < 3; f++)
+    {
+        uint32_t n = 0;
+        while (pos < len && text[pos] != '\0')
+        {
+            if (n < MUSIC_TAG_LEN - 1)
+                fields[f][n++] = text[pos];
+            pos++;
+        }
+        fields[f][n] = '\0';
+        pos++;
+    }
+}
+
+/**
+ * @brief 在 seq 一致的前提下复制条目，st 不为 NULL 时同时比较 mtime 和大小
+ */
+static bool entry_read(lib_entry_t *e, uint64_t key, const struct stat *st, music_info_t *info)
+{
+    uint32_t seq;
+    if (!hash_table_read_begin(&e->seq, &seq))
+        return false;
+
+    bool match = e->key == key;
+    if (st)
+        match = match && e->mtime == (int64_t)st->st_mtime && e->size == (uint64_t)st->st_size;
+    if (!match)
+        return false;
+
+    info->format      = (media_type_t)e->format;
+    info->duration_ms = e->duration_ms;
+    info->sample_rate = e->sample_rate;
+    info->bitrate     = e->bitrate;
+    info->track       = e->track;
+    info->channels    = e->channels;
+    info->gain_source = e->gain_source;
+    info->gain_cdb    = e->gain_cdb;
+    info->peak_cdb    = e->peak_cdb;
+    uint32_t ofs      = e->text_ofs;
+    uint32_t len      = e->text_len;
+    if (len > 0 && ofs <= MUSIC_LIB_HEAP_SIZE && len <= MUSIC_LIB_HEAP_SIZE - ofs)
+        unpack_text(heap + ofs, len, info);
+    else
+        info->title[0] = info->artist[0] = info->album[0] = '\0';
+
+    return hash_table_read_end(&e->seq, seq);
+}
+
+static bool lookup(const char *path, const struct stat *st, music_info_t *info)
+{
+    if (lib_base == NULL)
+        return false;
+
+    uint64_t key = hash_table_key(path);
+    for (int i = 0; i < PROBE_MAX; i++)
+    {
+        if (entry_read(&entries[hash_table_probe(key, i, MUSIC_LIB_CAPACITY)], key, st, info))
+            return true;
+    }
+    return false;
+}
+
+/**
+ * @brief 字符串区写满: 清空所有条目 (调用者持有 write_lock)
+ * 读取方正在读的条目 seq 会变化，读到的内容会被丢弃
+ */
+static void wipe_locked(void)
+{
+    for (uint32_t i = 0; i < MUSIC_LIB_CAPACITY; i++)
+    {
+        lib_entry_t *e = &entries[i];
+        if (e->key == 0)
+            continue;
+        uint32_t seq = hash_table_write_begin(&e->seq);
+        e->key       = 0;
+        hash_table_write_end(&e->seq, seq);
+    }
+    lib_hdr->heap_used = 0;
+    printf("Music Lib: string heap full, index cleared\n");
+}
+
+static void store(const char *path, const struct stat *st, const music_info_t *info)
+{
+    if (lib_base == NULL)
+        return;
+
+    size_t lt = strlen(info->title), la = strlen(info->artist), lb = strlen(info->album);
+    uint32_t text_len = (lt || la || lb) ? (uint32_t)(lt + la + lb + 3) : 0;
+    uint64_t key      = hash_table_key(path);
+    pthread_mutex_lock(&write_lock);
+
+    uint32_t text_ofs = lib_hdr->heap_used;
+    if (text_len > MUSIC_LIB_HEAP_SIZE - text_ofs)
+    {
+        wipe_locked();
+        text_ofs = 0;
+    }
+    if (text_len)
+    {
+        char *dst = heap + text_ofs;
+        memcpy(dst, info->title, lt + 1);
+        memcpy(dst + lt + 1, info->artist, la + 1);
+        memcpy(dst + lt + la + 2, info->album, lb + 1);
+        lib_hdr->heap_used = text_ofs + text_len;
+    }
+
+    lib_entry_t *e = &entries[hash_table_pick(entries, sizeof(lib_entry_t), MUSIC_LIB_CAPACITY, PROBE_MAX, key, NULL)];
+    uint32_t seq   = hash_table_write_begin(&e->seq);
+    e->key         = key;
+    e->mtime       = st->st_mtime;
+    e->size        = st->st_size;
+    e->duration_ms = info->duration_ms;
+    e->sample_rate = info->sample_rate;
+    e->text_ofs    = text_ofs;
+    e->text_len    = (uint16_t)text_len;
+    e->track       = info->track;
+    e->bitrate     = info->bitrate;
+    e->format      = (uint8_t)info->format;
+    e->channels    = info->channels;
+    e->gain_source = info->gain_source;
+    e->gain_cdb    = info->gain_cdb;
+    e->peak_cdb    = info->peak_cdb;
+    hash_table_write_end(&e->seq, seq);
+
+    pthread_mutex_unlock(&write_lock);
+}
+
+// =============================================================
+// 文本转换: 结果都是 UTF-8，按字符边界截断到 MUSIC_TAG_LEN
+// =============================================================
+
+static void put_utf8(char *dst, size_t *n, uint32_t cp)
+{
+    char buf[4];
+    size_t len;
+    if (cp < 0x80)
+    {
+        buf[0] = (char)cp;
+        len    = 1;
+    }
+    else if (cp < 0x800)
+    {
+        buf[0] = (char)(0xC0 | (cp >> 6));
+        buf[1] = (char)(0x80 | (cp & 0x3F));
+        len    = 2;
+    }
+    else if (cp < 0x10000)
+    {
+        buf[0] = (char)(0xE0 | (cp >> 12));
+        buf[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+        buf[2] = (char)(0x80 | (cp & 0x3F));
+        len    = 3;
+    }
+    else
+    {
+        buf[0] = (char)(0xF0 | (cp >> 18));
+        buf[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+        buf[2] = (char)(0x80 | ((cp >> 6) & 0x3F));
+        buf[3] = (char)(0x80 | (cp & 0x3F));
+        len    = 4;
+    }
+    if (*n + len < MUSIC_TAG_LEN)
+    {
+        memcpy(dst + *n, buf, len);
+        *n += len;
+    }
+    else
+    {
+        *n = MUSIC_TAG_LEN; // 放不下: 后面的字符都丢掉，保证不会把一个字符截成两半
+    }
+}
+
+/**
+ * @brief 去掉结尾的空格 (ID3v1 用空格或 0 填充)
+ */
+static void finish_text(char *dst, size_t n)
+{
+    if (n > MUSIC_TAG_LEN - 1)
+        n = MUSIC_TAG_LEN - 1;
+    while (n > 0 && dst[n - 1] == ' ')
+        n--;
+    dst[n] = '\0';
+}
+
+static void latin1_to_utf8(char *dst, const uint8_t *src, size_t len)
+{
+    size_t n = 0;
+    for (size_t i = 0; i < len && src[i] && n < MUSIC_TAG_LEN; i++)
+        put_utf8(dst, &n, src[i]);
+    finish_text(dst, n);
+}
+
+static void utf16_to_utf8(char *dst, const uint8_t *src, size_t len, bool big_endian)
+{
+    size_t n = 0;
+    for (size_t i = 0; i + 1 < len && n < MUSIC_TAG_LEN; i += 2)
+    {
+        uint32_t c = big_endian ? (uint32_t)((src[i] << 8) | src[i + 1]) : (uint32_t)(src[i] | (src[i + 1] << 8));
+        if (c == 0)
+            break;
+        if (c >= 0xD800 && c < 0xDC00 && i + 3 < len)
+        {
+            uint32_t lo = big_endian ? (uint32_t)((src[i + 2] << 8) | src[i + 3]) : (uint32_t)(src[i + 2] | (src[i + 3] << 8));
+            if (lo >= 0xDC00 && lo < 0xE000)
+            {
+                c = 0x10000 + ((c - 0xD800) << 10) + (lo - 0xDC00);
+                i += 2;
+            }
+        }
+        put_utf8(dst, &n, c);
+    }
+    finish_text(dst, n);
+}
+
+/**
+ * @brief 已经是 UTF-8: 复制到第一个 0 为止，截断时退到字符边界
+ */
+static void utf8_copy(char *dst, const uint8_t *src, size_t len)
+{
+    size_t n = 0;
+    while (n < len && src[n])
+        n++;
+    if (n > MUSIC_TAG_LEN - 1)
+    {
+        n = MUSIC_TAG_LEN - 1;
+        while (n > 0 && (src[n] & 0xC0) == 0x80)
+            n--;
+    }
+    memcpy(dst, src, n);
+    finish_text(dst, n);
+}
+
+static bool is_utf8(const uint8_t *s, size_t len)
+{
+    size_t i = 0;
+    while (i < len && s[i])
+    {
+        int extra = s[i] < 0x80 ? 0 : (s[i] & 0xE0) == 0xC0 ? 1 : (s[i] & 0xF0) == 0xE0 ? 2 : (s[i] & 0xF8) == 0xF0 ? 3 : -1;
+        if (extra < 0 || i + extra >= len)
+            return false;
+        for (int k = 1; k <= extra; k++)
+        {
+            if ((s[i + k] & 0xC0) != 0x80)
+                return false;
+        }
+        i += extra + 1;
+    }
+    return true;
+}
+
+// 标签里的字段 (先解析到的来源优先: ID3v2 > ID3v1)
+typedef enum
+{
+    FIELD_NONE,
+    FIELD_TITLE,
+    FIELD_ARTIST,
+    FIELD_ALBUM,
+    FIELD_TRACK,
+    FIELD_USER,    // ID3v2 的 TXXX: 描述 + 值，按描述再分
+    FIELD_RG_GAIN, // REPLAYGAIN_TRACK_GAIN, 例如 "-6.52 dB"
+    FIELD_RG_PEAK  // REPLAYGAIN_TRACK_PEAK, 线性值, 例如 "0.988312"
+} tag_field_t;
+
+/**
+ * @brief 转成 UTF-8 写入 dst (MUSIC_TAG_LEN 字节)
+ * enc: 0 Latin-1, 1 带 BOM 的 UTF-16, 2 UTF-16BE, 3 UTF-8 (与 ID3v2 的编码字节相同)
+ */
+static void decode_text(char *dst, int enc, const uint8_t *src, size_t len)
+{
+    switch (enc)
+    {
+        case 0:
+            latin1_to_utf8(dst, src, len);
+            break;
+        case 1:
+            if (len >= 2 && src[0] == 0xFE && src[1] == 0xFF)
+                utf16_to_utf8(dst, src + 2, len - 2, true);
+            else if (len >= 2 && src[0] == 0xFF && src[1] == 0xFE)
+                utf16_to_utf8(dst, src + 2, len - 2, false);
+            else
+                utf16_to_utf8(dst, src, len, false);
+            break;
+        case 2:
+            utf16_to_utf8(dst, src, len, true);
+            break;
+        default:
+            utf8_copy(dst, src, len);
+            break;
+    }
+}
+
+/**
+ * @brief dB 换算成 0.01 dB，限制在 int16_t 的范围内 (INT16_MIN 留给 MUSIC_PEAK_UNKNOWN)
+ */
+static int16_t to_cdb(double db)
+{
+    double c = db * 100.0;
+    if (c > INT16_MAX)
+        return INT16_MAX;
+    if (c <= INT16_MIN)
+        return INT16_MIN + 1;
+    return (int16_t)lrint(c);
+}
+
+/**
+ * @brief 设置字段，已有值时保留; 音轨号取 "3/12" 的前半部分，增益忽略后面的 "dB"，峰值换算成 dBFS
+ */
+static void set_field(music_info_t *info, tag_field_t field, int enc, const uint8_t *src, size_t len)
+{
+    char tmp[MUSIC_TAG_LEN];
+    char *dst = field == FIELD_TITLE ? info->title : field == FIELD_ARTIST ? info->artist : field == FIELD_ALBUM ? info->album : tmp;
+    if (field == FIELD_NONE || field == FIELD_USER || (dst != tmp && dst[0]) || (field == FIELD_TRACK && info->track) ||
+        (field == FIELD_RG_GAIN && info->gain_source != MUSIC_GAIN_NONE) || (field == FIELD_RG_PEAK && info->peak_cdb != MUSIC_PEAK_UNKNOWN))
+        return;
+    decode_text(dst, enc, src, len);
+
+    char *end;
+    if (field == FIELD_TRACK)
+    {
+        info->track = (uint16_t)atoi(tmp);
+    }
+    else if (field == FIELD_RG_GAIN)
+    {
+        double db = strtod(tmp, &end);
+        if (end != tmp)
+        {
+            info->gain_cdb    = to_cdb(db);
+            info->gain_source = MUSIC_GAIN_TAG;
+        }
+    }
+    else if (field == FIELD_RG_PEAK)
+    {
+        double peak = strtod(tmp, &end);
+        if (end != tmp && peak > 0)
+            info->peak_cdb = to_cdb(20.0 * log10(peak));
+    }
+}
+
+// =============================================================
+// ID3v1 / ID3v2
+// =============================================================
+
+// ID3v2 帧的读取来源: 文件 (常见情况，大帧直接跳过) 或反同步后的内存
+typedef struct
+{
+    FILE *fp;
+    const uint8_t *mem;
+    size_t len;
+    size_t pos;
+} tag_src_t;
+
+static bool src_read(tag_src_t *s, void *buf, size_t n)
+{
+    if (s->mem == NULL)
+        return fread(buf, 1, n, s->fp) == n;
+    if (n > s->len - s->pos)
+        return false;
+    memcpy(buf, s->mem + s->pos, n);
+    s->pos += n;
+    return true;
+}
+
+static bool src_skip(tag_src_t *s, size_t n)
+{
+    if (s->mem == NULL)
+        return fseek(s->fp, (long)n, SEEK_CUR) == 0;
+    if (n > s->len - s->pos)
+        return false;
+    s->pos += n;
+    return true;
+}
+
+/**
+ * @brief 去掉反同步插入的 0 (FF 00 -> FF)，返回新长度
+ */
+static size_t deunsync(uint8_t *buf, size_t len)
+{
+    size_t out = 0;
+    for (size_t i = 0; i < len; i++)
+    {
+        buf[out++] = buf[i];
+        if (buf[i] == 0xFF && i + 1 < len && buf[i + 1] == 0x00)
+            i++;
+    }
+    return out;
+}
+
+static tag_field_t id3_field(const char *id, int ver)
+{
+    if (ver == 2)
+    {
+        if (memcmp(id, "TT2", 3) == 0)
+            return FIELD_TITLE;
+        if (memcmp(id, "TP1", 3) == 0)
+            return FIELD_ARTIST;
+        if (memcmp(id, "TAL", 3) == 0)
+            return FIELD_ALBUM;
+        if (memcmp(id, "TRK", 3) == 0)
+            return FIELD_TRACK;
+        if (memcmp(id, "TXX", 3) == 0)
+            return FIELD_USER;
+        return FIELD_NONE;
+    }
+    if (memcmp(id, "TIT2", 4) == 0)
+        return FIELD_TITLE;
+    if (memcmp(id, "TPE1", 4) == 0)
+        return FIELD_ARTIST;
+    if (memcmp(id, "TALB", 4) == 0)
+        return FIELD_ALBUM;
+    if (memcmp(id, "TRCK", 4) == 0)
+        return FIELD_TRACK;
+    if (memcmp(id, "TXXX", 4) == 0)
+        return FIELD_USER;
+    return FIELD_NONE;
+}
+
+/**
+ * @brief TXXX/TXX 帧: 编码字节 + 描述 + 值，只取 ReplayGain 的音轨增益和峰值
+ */
+static void id3_user_text(music_info_t *info, const uint8_t *p, size_t len)
+{
+    if (len < 2)
+        return;
+    int enc = p[0];
+
+    // 描述: UTF-16 以 00 00 结尾 (按两字节对齐)，其他编码以 00 结尾
+    size_t pos = 1;
+    if (enc == 1 || enc == 2)
+    {
+        while (pos + 1 < len && (p[pos] || p[pos + 1]))
+            pos += 2;
+        if (pos + 1 >= len)
+            return;
+    }
+    else
+    {
+        while (pos < len && p[pos])
+            pos++;
+        if (pos >= len)
+            return;
+    }
+    char desc[MUSIC_TAG_LEN];
+    decode_text(desc, enc, p + 1, pos - 1);
+    pos += (enc == 1 || enc == 2) ? 2 : 1;
+
+    tag_field_t field = strcasecmp(desc, "REPLAYGAIN_TRACK_GAIN") == 0   ? FIELD_RG_GAIN
+                        : strcasecmp(desc, "REPLAYGAIN_TRACK_PEAK") == 0 ? FIELD_RG_PEAK
+                                                                         : FIELD_NONE;
+    set_field(info, field, enc, p + pos, len - pos); // UTF-16 的值有自己的 BOM
+}
+
+// 逐帧读取 ID3v2 的状态
+typedef struct
+{
+    tag_src_t src;
+    uint8_t *whole;     // 整体反同步时还原后的标签
+    uint32_t remaining; // 还没读的字节数
+    uint32_t total;     // 标签总长 (音频数据的起点)，没有标签为 0
+    int ver;
+} id3_reader_t;
+
+/**
+ * @brief 读取文件开头的 ID3v2 头和扩展头，返回 false 表示没有可读的帧 (r->total 仍然有效)
+ */
+static bool id3_begin(FILE *fp, id3_reader_t *r)
+{
+    memset(r, 0, sizeof(id3_reader_t));
+    uint8_t h[10];
+    if (fseek(fp, 0, SEEK_SET) != 0 || fread(h, 1, 10, fp) != 10 || memcmp(h, "ID3", 3) != 0)
+        return false;
+
+    uint8_t flags = h[5];
+    uint32_t size = syncsafe32(h + 6);
+    r->ver        = h[3];
+    r->total      = 10 + size + ((flags & 0x10) ? 10 : 0);
+    r->src.fp     = fp;
+    if (r->ver < 2 || r->ver > 4)
+        return false;
+
+    if ((flags & 0x80) && r->ver < 4)
+    {
+        // v2.2/v2.3 的整体反同步: 读进内存还原后再解析
+        size_t n = size < ID3_UNSYNC_MAX ? size : ID3_UNSYNC_MAX;
+        r->whole = mem_tag_alloc(MEM_TAG_INDEX, n);
+        if (r->whole == NULL || fread(r->whole, 1, n, fp) != n)
+        {
+            mem_tag_free(r->whole);
+            r->whole = NULL;
+            return false;
+        }
+        r->src.mem = r->whole;
+        r->src.len = deunsync(r->whole, n);
+        size       = (uint32_t)r->src.len;
+    }
+
+    r->remaining = size;
+    if ((flags & 0x40) && r->ver >= 3)
+    {
+        // 扩展头: v2.3 的长度不含自身 4 字节, v2.4 的长度含自身且为 syncsafe
+        uint8_t e[4];
+        if (!src_read(&r->src, e, 4))
+            return false;
+        uint32_t ext = r->ver == 3 ? be32(e) + 4 : syncsafe32(e);
+        if (ext < 4 || ext > r->remaining || !src_skip(&r->src, ext - 4))
+            return false;
+        r->remaining -= ext;
+    }
+    return true;
+}
+
+/**
+ * @brief 读下一个帧头 (v2.2 为 6 字节，之后为 10 字节)，读完或遇到填充区返回 false
+ * 调用者必须读取或跳过 *fsize 字节的帧内容
+ */
+static bool id3_next_frame(id3_reader_t *r, uint8_t fh[10], uint32_t *fsize)
+{
+    uint32_t hdr_len = r->ver == 2 ? 6 : 10;
+    if (r->remaining < hdr_len || !src_read(&r->src, fh, hdr_len) || fh[0] == 0) // 0 开头是填充区
+        return false;
+    r->remaining -= hdr_len;
+
+    *fsize = r->ver == 2 ? be24(fh + 3) : r->ver == 3 ? be32(fh + 4) : syncsafe32(fh + 4);
+    if (*fsize > r->remaining)
+        return false;
+    r->remaining -= *fsize;
+    return true;
+}
+
+/**
+ * @brief 帧是否压缩或加密 (不支持，直接跳过)
+ */
+static bool id3_frame_unreadable(const id3_reader_t *r, const uint8_t fh[10])
+{
+    if (r->ver == 3)
+        return fh[9] & 0xC0;
+    if (r->ver == 4)
+        return fh[9] & 0x0C;
+    return false;
+}
+
+/**
+ * @brief 还原 v2.4 单帧反同步、去掉数据长度指示 (4 字节)，返回帧内容的新长度
+ */
+static size_t id3_frame_payload(const id3_reader_t *r, const uint8_t fh[10], uint8_t *body, size_t len,
+                                const uint8_t **payload)
+{
+    *payload = body;
+    if (r->ver != 4)
+        return len;
+    if (fh[9] & 0x02)
+        len = deunsync(body, len);
+    if (fh[9] & 0x01)
+    {
+        if (len < 4)
+            return 0;
+        *payload += 4;
+        len -= 4;
+    }
+    return len;
+}
+
+static void id3_end(id3_reader_t *r)
+{
+    mem_tag_free(r->whole);
+    r->whole = NULL;
+}
+
+/**
+ * @brief 解析文件开头的 ID3v2，返回标签总长 (音频数据的起点)，没有标签返回 0
+ */
+static uint32_t parse_id3v2(FILE *fp, music_info_t *info)
+{
+    id3_reader_t r;
+    if (!id3_begin(fp, &r))
+    {
+        id3_end(&r);
+        return r.total;
+    }
+
+    uint8_t fh[10];
+    uint32_t fsize;
+    uint8_t body[TEXT_FRAME_MAX];
+    while (id3_next_frame(&r, fh, &fsize))
+    {
+        tag_field_t field = id3_field((const char *)fh, r.ver);
+        if (field == FIELD_NONE || fsize < 2 || fsize > TEXT_FRAME_MAX || id3_frame_unreadable(&r, fh))
+        {
+            if (!src_skip(&r.src, fsize))
+                break;
+            continue;
+        }
+
+        if (!src_read(&r.src, body, fsize))
+            break;
+        const uint8_t *txt;
+        size_t len = id3_frame_payload(&r, fh, body, fsize, &txt);
+        if (field == FIELD_USER)
+            id3_user_text(info, txt, len);
+        else if (len >= 1)
+            set_field(info, field, txt[0], txt + 1, len - 1);
+    }
+
+    id3_end(&r);
+    return r.total;
+}
+
+/**
+ * @brief 文件末尾的 ID3v1，返回它占用的字节数 (128 或 0)
+ */
+static uint32_t parse_id3v1(FILE *fp, long file_size, music_info_t *info)
+{
+    uint8_t t[128];
+    if (file_size < 128 || fseek(fp, file_size - 128, SEEK_SET) != 0 || fread(t, 1, 128, fp) != 128 ||
+        memcmp(t, "TAG", 3) != 0)
+        return 0;
+
+    set_field(info, FIELD_TITLE, 0, t + 3, 30);
+    set_field(info, FIELD_ARTIST, 0, t + 33, 30);
+    set_field(info, FIELD_ALBUM, 0, t + 63, 30);
+    if (t[125] == 0 && t[126] != 0 && info->track == 0) // ID3v1.1: 注释的最后一个字节是音轨号
+        info->track = t[126];
+    return 128;
+}
+
+// =============================================================
+// MP3: 第一帧的 Xing/Info/VBRI 头给出总帧数，没有时按 CBR 估算
+// =============================================================
+
+static const uint16_t mp3_bitrates[2][3][15] = {
+    {
+        // MPEG-1: Layer I, II, III
+        {0, 32, 64, 96, 128, 160, 192, 224, 256, 288, 320, 352, 384, 416, 448},
+        {0, 32, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384},
+        {0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320},
+    },
+    {
+        // MPEG-2 / 2.5
+        {0, 32, 48, 56, 64, 80, 96, 112, 128, 144, 160, 176, 192, 224, 256},
+        {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160},
+        {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160},
+    },
+};
+
+static const uint16_t mp3_rates[3][3] = {
+    {44100, 48000, 32000}, // MPEG-1
+    {22050, 24000, 16000}, // MPEG-2
+    {11025, 12000, 8000},  // MPEG-2.5
+};
+
+typedef struct
+{
+    uint32_t rate;
+    uint32_t kbps;
+    uint32_t samples;   // 每帧样本数
+    uint32_t frame_len; // 字节
+    uint32_t side_len;  // 帧头之后的 side info 长度 (Layer III)
+    uint8_t channels;
+} mp3_frame_t;
+
+static bool mp3_parse_header(const uint8_t *p, mp3_frame_t *f)
+{
+    if (p[0] != 0xFF || (p[1] & 0xE0) != 0xE0)
+        return false;
+    int ver   = (p[1] >> 3) & 3; // 0: 2.5, 2: 2, 3: 1
+    int layer = (p[1] >> 1) & 3; // 1: III, 2: II, 3: I
+    int br    = p[2] >> 4;
+    int sr    = (p[2] >> 2) & 3;
+    int pad   = (p[2] >> 1) & 1;
+    if (ver == 1 || layer == 0 || br == 0 || br == 15 || sr == 3)
+        return false;
+
+    bool v1     = ver == 3;
+    int l       = 3 - layer; // 0: I, 1: II, 2: III
+    f->rate     = mp3_rates[v1 ? 0 : (ver == 2 ? 1 : 2)][sr];
+    f->kbps     = mp3_bitrates[v1 ? 0 : 1][l][br];
+    f->channels = ((p[3] >> 6) == 3) ? 1 : 2;
+    if (l == 0)
+    {
+        f->samples   = 384;
+        f->frame_len = (12 * f->kbps * 1000 / f->rate + pad) * 4;
+    }
+    else
+    {
+        f->samples   = (l == 2 && !v1) ? 576 : 1152;
+        f->frame_len = f->samples / 8 * f->kbps * 1000 / f->rate + pad;
+    }
+    f->side_len = v1 ? (f->channels == 1 ? 17 : 32) : (f->channels == 1 ? 9 : 17);
+    return f->frame_len >= 4;
+}
+
+static int parse_mp3(FILE *fp, long file_size, uint32_t audio_start, uint32_t tail, music_info_t *info)
+{
+    uint8_t buf[4096];
+    long pos = audio_start;
+    mp3_frame_t f;
+
+    // 找第一个帧头，后一帧的帧头也要对得上，避免把数据里的 FF Ex 当成帧
+    while (pos < (long)audio_start + SYNC_SCAN_MAX)
+    {
+        if (fseek(fp, pos, SEEK_SET) != 0)
+            return -1;
+        size_t n = fread(buf, 1, sizeof(buf), fp);
+        if (n < 4)
+            return -1;
+
+        size_t i;
+        for (i = 0; i + 4 <= n; i++)
+        {
+            if (!mp3_parse_header(buf + i, &f))
+                continue;
+            mp3_frame_t next;
+            if (i + f.frame_len + 4 <= n && !mp3_parse_header(buf + i + f.frame_len, &next))
+                continue;
+            break;
+        }
+        if (i + 4 <= n)
+        {
+            pos += (long)i;
+            break;
+        }
+        pos += (long)n - 3;
+        if (n < sizeof(buf))
+            return -1;
+    }
+    if (pos >= (long)audio_start + SYNC_SCAN_MAX)
+        return -1;
+
+    // 重新从帧头处读，保证 Xing/VBRI 头完整在缓冲里
+    if (fseek(fp, pos, SEEK_SET) != 0)
+        return -1;
+    size_t n = fread(buf, 1, 4 + 32 + 120, fp);
+    mp3_parse_header(buf, &f);
+    info->sample_rate = f.rate;
+    info->channels    = f.channels;
+
+    uint64_t frames = 0;
+    size_t x        = 4 + f.side_len;
+    if (n >= x + 12 && (memcmp(buf + x, "Xing", 4) == 0 || memcmp(buf + x, "Info", 4) == 0))
+    {
+        if (be32(buf + x + 4) & 1)
+            frames = be32(buf + x + 8);
+    }
+    else if (n >= 4 + 32 + 18 && memcmp(buf + 36, "VBRI", 4) == 0)
+    {
+        frames = be32(buf + 36 + 14);
+    }
+
+    uint64_t audio_bytes = (uint64_t)(file_size - pos - tail);
+    if (frames > 0)
+    {
+        info->duration_ms = (uint32_t)(frames * f.samples * 1000 / f.rate);
+        info->bitrate     = info->duration_ms ? (uint16_t)(audio_bytes * 8 / info->duration_ms) : 0;
+    }
+    else
+    {
+        info->duration_ms = (uint32_t)(audio_bytes * 8 / f.kbps); // 字节 * 8 / kbps = 毫秒
+        info->bitrate     = (uint16_t)f.kbps;
+    }
+    return 0;
+}
+
+// =============================================================
+// FLAC: STREAMINFO + VORBIS_COMMENT
+// =============================================================
+
+/**
+ * @brief Vorbis comment: "KEY=value" 列表，KEY 不区分大小写
+ */
+static void parse_vorbis_comment(const uint8_t *p, size_t len, music_info_t *info)
+{
+    if (len < 8)
+        return;
+    size_t pos      = 0;
+    uint32_t vendor = le32(p);
+    if (vendor > len - 8)
+        return;
+    pos            = 4 + vendor;
+    uint32_t count = le32(p + pos);
+    pos += 4;
+
+    static const struct
+    {
+        const char *key;
+        tag_field_t field;
+    } keys[] = {{"TITLE=", FIELD_TITLE}, {"ARTIST=", FIELD_ARTIST}, {"ALBUM=", FIELD_ALBUM}, {"TRACKNUMBER=", FIELD_TRACK},
+                {"REPLAYGAIN_TRACK_GAIN=", FIELD_RG_GAIN}, {"REPLAYGAIN_TRACK_PEAK=", FIELD_RG_PEAK}};
+
+    for (uint32_t c = 0; c < count && pos + 4 <= len; c++)
+    {
+        uint32_t clen = le32(p + pos);
+        pos += 4;
+        if (clen > len - pos)
+            break;
+        const char *s = (const char *)(p + pos);
+        for (size_t k = 0; k < sizeof(keys) / sizeof(keys[0]); k++)
+        {
+            size_t kl = strlen(keys[k].key);
+            if (clen > kl && strncasecmp(s, keys[k].key, kl) == 0)
+            {
+                set_field(info, keys[k].field, 3, p + pos + kl, clen - kl);
+                break;
+            }
+        }
+        pos += clen;
+    }
+}
+
+static int parse_flac(FILE *fp, long file_size, uint32_t start, music_info_t *info)
+{
+    uint8_t h[4];
+    if (fseek(fp, start, SEEK_SET) != 0 || fread(h, 1, 4, fp) != 4 || memcmp(h, "fLaC", 4) != 0)
+        return -1;
+
+    uint64_t total_samples = 0;
+    bool last              = false;
+    while (!last)
+    {
+        if (fread(h, 1, 4, fp) != 4)
+            return -1;
+        last         = h[0] & 0x80;
+        int type     = h[0] & 0x7F;
+        uint32_t len = be24(h + 1);
+
+        if (type == 0 && len >= 18)
+        {
+            uint8_t si[18];
+            if (fread(si, 1, 18, fp) != 18 || fseek(fp, len - 18, SEEK_CUR) != 0)
+                return -1;
+            info->sample_rate = ((uint32_t)si[10] << 12) | ((uint32_t)si[11] << 4) | (si[12] >> 4);
+            info->channels    = ((si[12] >> 1) & 7) + 1;
+            total_samples     = ((uint64_t)(si[13] & 0x0F) << 32) | be32(si + 14);
+        }
+        else if (type == 4 && len <= VORBIS_MAX)
+        {
+            uint8_t *vc = mem_tag_alloc(MEM_TAG_INDEX, len);
+            if (vc == NULL || fread(vc, 1, len, fp) != len)
+            {
+                mem_tag_free(vc);
+                return -1;
+            }
+            parse_vorbis_comment(vc, len, info);
+            mem_tag_free(vc);
+        }
+        else if (fseek(fp, len, SEEK_CUR) != 0)
+        {
+            return -1;
+        }
+    }
+
+    if (info->sample_rate == 0)
+        return -1;
+    info->duration_ms = (uint32_t)(total_samples * 1000 / info->sample_rate);
+    if (info->duration_ms)
+        info->bitrate = (uint16_t)((uint64_t)(file_size - ftell(fp)) * 8 / info->duration_ms);
+    return 0;
+}
+
+// =============================================================
+// WAV: fmt / data / LIST-INFO
+// =============================================================
+
+static void parse_riff_info(const uint8_t *p, size_t len, music_info_t *info)
+{
+    size_t pos = 4; // 跳过 "INFO"
+    while (pos + 8 <= len)
+    {
+        uint32_t clen = le32(p + pos + 4);
+        if (clen > len - pos - 8)
+            break;
+        const char *id    = (const char *)(p + pos);
+        tag_field_t field = memcmp(id, "INAM", 4) == 0   ? FIELD_TITLE
+                            : memcmp(id, "IART", 4) == 0 ? FIELD_ARTIST
+                            : memcmp(id, "IPRD", 4) == 0 ? FIELD_ALBUM
+                            : memcmp(id, "ITRK", 4) == 0 ? FIELD_TRACK
+                                                         : FIELD_NONE;
+        const uint8_t *v  = p + pos + 8;
+        set_field(info, field, is_utf8(v, clen) ? 3 : 0, v, clen);
+        pos += 8 + clen + (clen & 1);
+    }
+}
+
+static int parse_wav(FILE *fp, music_info_t *info)
+{
+    uint8_t h[12];
+    if (fseek(fp, 0, SEEK_SET) != 0 || fread(h, 1, 12, fp) != 12)
+        return -1;
+
+    uint32_t byte_rate = 0;
+    uint64_t data_len  = 0;
+    uint8_t c[8];
+    while (fread(c, 1, 8, fp) == 8)
+    {
+        uint32_t len = le32(c + 4);
+        long next    = ftell(fp) + len + (len & 1);
+        if (memcmp(c, "fmt ", 4) == 0 && len >= 16)
+        {
+            uint8_t fmt[16];
+            if (fread(fmt, 1, 16, fp) != 16)
+                return -1;
+            info->channels    = (uint8_t)le16(fmt + 2);
+            info->sample_rate = le32(fmt + 4);
+            byte_rate         = le32(fmt + 8);
+        }
+        else if (memcmp(c, "data", 4) == 0)
+        {
+            data_len = len;
+        }
+        else if (memcmp(c, "LIST", 4) == 0 && len >= 4 && len <= VORBIS_MAX)
+        {
+            uint8_t *list = mem_tag_alloc(MEM_TAG_INDEX, len);
+            if (list && fread(list, 1, len, fp) == len && memcmp(list, "INFO", 4) == 0)
+                parse_riff_info(list, len, info);
+            mem_tag_free(list);
+        }
+        if (fseek(fp, next, SEEK_SET) != 0)
+            break;
+    }
+
+    if (byte_rate == 0)
+        return -1;
+    info->duration_ms = (uint32_t)(data_len * 1000 / byte_rate);
+    info->bitrate     = (uint16_t)(byte_rate * 8 / 1000);
+    return 0;
+}
+
+// =============================================================
+// 内嵌封面: ID3v2 APIC/PIC 帧、FLAC PICTURE 块
+// =============================================================
+
+#define PIC_FRONT_COVER 3 // 图片类型: 封面 (front cover)
+
+/**
+ * @brief 解析 APIC/PIC 帧内容，得到图片类型和图片数据的位置
+ */
+static bool id3_picture(const uint8_t *p, size_t len, int ver, int *type, const uint8_t **img, size_t *img_len)
+{
+    if (len < 1)
+        return false;
+    int enc    = p[0];
+    size_t pos = 1;
+    if (ver == 2)
+    {
+        pos += 3; // 图片格式 "JPG"/"PNG"
+    }
+    else
+    {
+        while (pos < len && p[pos]) // MIME 类型, Latin-1 以 0 结尾
+            pos++;
+        pos++;
+    }
+    if (pos >= len)
+        return false;
+    *type = p[pos++];
+
+    // 描述: UTF-16 以 00 00 结尾，其他编码以 00 结尾
+    if (enc == 1 || enc == 2)
+    {
+        while (pos + 1 < len && (p[pos] || p[pos + 1]))
+            pos += 2;
+        pos += 2;
+    }
+    else
+    {
+        while (pos < len && p[pos])
+            pos++;
+        pos++;
+    }
+    if (pos >= len)
+        return false;
+    *img     = p + pos;
+    *img_len = len - pos;
+    return true;
+}
+
+// 读取过程中暂存的最佳候选: 有封面类型的就用它，否则用第一张
+typedef struct
+{
+    uint8_t *buf;
+    size_t len;
+    bool front;
+} cover_pick_t;
+
+/**
+ * @brief 候选图片在 buf 内的 img 处，取用时把数据挪到 buf 开头，不要的 buf 直接释放
+ */
+static void cover_offer(cover_pick_t *pick, uint8_t *buf, const uint8_t *img, size_t len, int type)
+{
+    if (pick->buf && type != PIC_FRONT_COVER)
+    {
+        mem_tag_free(buf);
+        return;
+    }
+    mem_tag_free(pick->buf);
+    memmove(buf, img, len);
+    pick->buf   = buf;
+    pick->len   = len;
+    pick->front = type == PIC_FRONT_COVER;
+}
+
+/**
+ * @brief 在 ID3v2 中找封面，只读标签本身；返回标签总长
+ */
+static uint32_t id3_read_cover(FILE *fp, cover_pick_t *pick)
+{
+    id3_reader_t r;
+    if (!id3_begin(fp, &r))
+    {
+        id3_end(&r);
+        return r.total;
+    }
+
+    uint8_t fh[10];
+    uint32_t fsize;
+    while (!pick->front && id3_next_frame(&r, fh, &fsize))
+    {
+        bool pic = r.ver == 2 ? memcmp(fh, "PIC", 3) == 0 : memcmp(fh, "APIC", 4) == 0;
+        if (!pic || fsize < 4 || fsize > MUSIC_COVER_MAX || id3_frame_unreadable(&r, fh))
+        {
+            if (!src_skip(&r.src, fsize))
+                break;
+            continue;
+        }
+
+        uint8_t *body = mem_tag_alloc(MEM_TAG_IMAGE, fsize);
+        if (body == NULL || !src_read(&r.src, body, fsize))
+        {
+            mem_tag_free(body);
+            break;
+        }
+        const uint8_t *p, *img;
+        size_t img_len;
+        int type;
+        size_t len = id3_frame_payload(&r, fh, body, fsize, &p);
+        if (id3_picture(p, len, r.ver, &type, &img, &img_len))
+            cover_offer(pick, body, img, img_len, type);
+        else
+            mem_tag_free(body);
+    }
+
+    id3_end(&r);
+    return r.total;
+}
+
+/**
+ * @brief 在 FLAC 元数据块中找 PICTURE (类型 6)，遇到最后一个元数据块就停，不读音频帧
+ */
+static void flac_read_cover(FILE *fp, uint32_t start, cover_pick_t *pick)
+{
+    uint8_t h[4];
+    if (fseek(fp, start, SEEK_SET) != 0 || fread(h, 1, 4, fp) != 4 || memcmp(h, "fLaC", 4) != 0)
+        return;
+
+    bool last = false;
+    while (!last && !pick->front)
+    {
+        if (fread(h, 1, 4, fp) != 4)
+            return;
+        last         = h[0] & 0x80;
+        int type     = h[0] & 0x7F;
+        uint32_t len = be24(h + 1);
+        if (type != 6 || len < 32 || len > MUSIC_COVER_MAX)
+        {
+            if (fseek(fp, len, SEEK_CUR) != 0)
+                return;
+            continue;
+        }
+
+        uint8_t *p = mem_tag_alloc(MEM_TAG_IMAGE, len);
+        if (p == NULL || fread(p, 1, len, fp) != len)
+        {
+            mem_tag_free(p);
+            return;
+        }
+        // 类型, MIME 长度 + MIME, 描述长度 + 描述, 宽, 高, 色深, 颜色数, 数据长度 + 数据
+        uint32_t pic_type = be32(p);
+        uint32_t mime_len = be32(p + 4);
+        size_t pos        = 8;
+        if (mime_len > len - pos - 4)
+        {
+            mem_tag_free(p);
+            continue;
+        }
+        pos += mime_len;
+        uint32_t desc_len = be32(p + pos);
+        pos += 4;
+        if (desc_len > len - pos || len - pos - desc_len < 20)
+        {
+            mem_tag_free(p);
+            continue;
+        }
+        pos += (size_t)desc_len + 16;
+        uint32_t data_len = be32(p + pos);
+        pos += 4;
+        if (data_len == 0 || data_len > len - pos)
+        {
+            mem_tag_free(p);
+            continue;
+        }
+        cover_offer(pick, p, p + pos, data_len, (int)pic_type);
+    }
+}
+
+// =============================================================
+// 公共接口
+// =============================================================
+
+int music_lib_probe(const char *path, music_info_t *info)
+{
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL)
+        return -1;
+
+    memset(info, 0, sizeof(music_info_t));
+    info->peak_cdb = MUSIC_PEAK_UNKNOWN;
+    fseek(fp, 0, SEEK_END);
+    long file_size = ftell(fp);
+
+    // ID3v2 也可能出现在 FLAC 前面，先跳过它再看魔数
+    uint32_t start = parse_id3v2(fp, info);
+    uint8_t head[12];
+    size_t n = 0;
+    if (fseek(fp, start, SEEK_SET) == 0)
+        n = fread(head, 1, sizeof(head), fp);
+    if (start > 0) // 有 ID3v2 的不是 FLAC 就是 MP3 (标签后面可能还有一段填充，魔数认不出来)
+        info->format = n >= 4 && memcmp(head, "fLaC", 4) == 0 ? MEDIA_TYPE_FLAC : MEDIA_TYPE_MP3;
+    else
+        info->format = media_sniff(head, n);
+
+    int res = -1;
+    switch (info->format)
+    {
+        case MEDIA_TYPE_MP3:
+        {
+            uint32_t tail = parse_id3v1(fp, file_size, info);
+            res           = parse_mp3(fp, file_size, start, tail, info);
+            break;
+        }
+        case MEDIA_TYPE_FLAC:
+            res = parse_flac(fp, file_size, start, info);
+            break;
+        case MEDIA_TYPE_WAV:
+            res = parse_wav(fp, info);
+            break;
+        default:
+            break;
+    }
+    fclose(fp);
+    return res;
+}
+
+int music_lib_read_cover(const char *path, uint8_t **data, size_t *size)
+{
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL)
+        return -1;
+
+    cover_pick_t pick = {NULL, 0, false};
+    uint32_t start    = id3_read_cover(fp, &pick);
+    if (pick.buf == NULL)
+        flac_read_cover(fp, start, &pick);
+    fclose(fp);
+
+    if (pick.buf == NULL)
+        return -1;
+    *data = pick.buf;
+    *size = pick.len;
+    return 0;
+}
+
+int music_lib_open(const char *index_path)
+{
+    if (lib_base)
+        return 0;
+
+    size_t total = sizeof(lib_header_t) + MUSIC_LIB_CAPACITY * sizeof(lib_entry_t) + MUSIC_LIB_HEAP_SIZE;
+
+    lib_fd = open(index_path, O_RDWR | O_CREAT, 0644);
+    if (lib_fd < 0)
+    {
+        perror("Music Lib: cannot open index file");
+        return -1;
+    }
+
+    struct stat st;
+    fstat(lib_fd, &st);
+    bool fresh = (size_t)st.st_size != total;
+    if (fresh && (ftruncate(lib_fd, 0) != 0 || ftruncate(lib_fd, total) != 0))
+    {
+        perror("Music Lib: cannot resize index file");
+        close(lib_fd);
+        lib_fd = -1;
+        return -1;
+    }
+
+    lib_base = mmap(NULL, total, PROT_READ | PROT_WRITE, MAP_SHARED, lib_fd, 0);
+    if (lib_base == MAP_FAILED)
+    {
+        perror("Music Lib: mmap failed");
+        lib_base = NULL;
+        close(lib_fd);
+        lib_fd = -1;
+        return -1;
+    }
+    lib_size = total;
+
+    lib_hdr = (lib_header_t *)lib_base;
+    entries = (lib_entry_t *)(lib_base + sizeof(lib_header_t));
+    heap    = (char *)(entries + MUSIC_LIB_CAPACITY);
+
+    if (fresh || lib_hdr->magic != LIB_MAGIC || lib_hdr->version != LIB_VERSION ||
+        lib_hdr->capacity != MUSIC_LIB_CAPACITY || lib_hdr->heap_size != MUSIC_LIB_HEAP_SIZE ||
+        lib_hdr->heap_used > MUSIC_LIB_HEAP_SIZE)
+    {
+        memset(entries, 0, MUSIC_LIB_CAPACITY * sizeof(lib_entry_t));
+        lib_hdr->magic     = LIB_MAGIC;
+        lib_hdr->version   = LIB_VERSION;
+        lib_hdr->capacity  = MUSIC_LIB_CAPACITY;
+        lib_hdr->heap_size = MUSIC_LIB_HEAP_SIZE;
+        lib_hdr->heap_used = 0;
+        printf("Music Lib: New index %s\n", index_path);
+    }
+    return 0;
+}
+
+void music_lib_close(void)
+{
+    if (lib_base)
+    {
+        msync(lib_base, lib_size, MS_SYNC);
+        munmap(lib_base, lib_size);
+        lib_base = NULL;
+        lib_hdr  = NULL;
+        entries  = NULL;
+        heap     = NULL;
+    }
+    if (lib_fd >= 0)
+    {
+        close(lib_fd);
+        lib_fd = -1;
+    }
+}
+
+bool music_lib_lookup(const char *path, music_info_t *info)
+{
+    return lookup(path, NULL, info);
+}
+
+int music_lib_get(const char *path, music_info_t *info)
+{
+    struct stat st;
+    if (stat(path, &st) != 0)
+        return -1;
+    if (lookup(path, &st, info))
+        return 0;
+
+    if (music_lib_probe(path, info) != 0)
+        return -1;
+    store(path, &st, info);
+    return 0;
+}
+
+int music_lib_set_gain(const char *path, int16_t gain_cdb, int16_t peak_cdb)
+{
+    struct stat st;
+    music_info_t info;
+    if (stat(path, &st) != 0 || music_lib_get(path, &info) != 0 || lib_base == NULL)
+        return -1;
+
+    // 只改这三个字段，标签字符串不动 (不用再往字符串区追加一份)
+    uint64_t key = hash_table_key(path);
+    int res      = -1;
+    pthread_mutex_lock(&write_lock);
+    for (int i = 0; i < PROBE_MAX && res != 0; i++)
+    {
+        lib_entry_t *e = &entries[hash_table_probe(key, i, MUSIC_LIB_CAPACITY)];
+        if (e->key != key || e->mtime != (int64_t)st.st_mtime || e->size != (uint64_t)st.st_size)
+            continue;
+        uint32_t seq   = hash_table_write_begin(&e->seq);
+        e->gain_source = MUSIC_GAIN_SCAN;
+        e->gain_cdb    = gain_cdb;
+        e->peak_cdb    = peak_cdb;
+        hash_table_write_end(&e->seq, seq);
+        res = 0;
+    }
+    pthread_mutex_unlock(&write_lock);
+    return res;
+}
+
+// 后台读取
+typedef struct
+{
+    music_lib_cb_t cb;
+    void *user_data;
+    int res;
+    music_info_t info;
+    char path[]; // 柔性数组
+} lib_job_t;
+
+static void lib_job_free(void *arg)
+{
+    mem_tag_free(arg);
+}
+
+static void lib_done_cb(void *arg)
+{
+    lib_job_t *job = arg;
+    job->cb(job->path, job->res == 0 ? &job->info : NULL, job->user_data);
+    mem_tag_free(job);
+}
+
+static void lib_job(void *arg)
+{
+    lib_job_t *job = arg;
+    job->res       = music_lib_get(job->path, &job->info);
+    if (job->cb == NULL || bg_worker_post_ui(lib_done_cb, lib_job_free, job) != 0)
+        mem_tag_free(job);
+}
+
+int music_lib_request(const char *path, music_lib_cb_t cb, void *user_data)
+{
+    size_t len     = strlen(path) + 1;
+    lib_job_t *job = mem_tag_alloc(MEM_TAG_INDEX, sizeof(lib_job_t) + len);
+    if (job == NULL)
+        return -1;
+    job->cb        = cb;
+    job->user_data = user_data;
+    memcpy(job->path, path, len);
+    if (bg_worker_submit(BG_PRIO_LOW, lib_job, lib_job_free, job) != 0)
+    {
+        mem_tag_free(job);
+        return -1;
+    }
+    return 0;
+}
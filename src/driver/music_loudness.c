@@ -0,0 +1,564 @@
+#include "music_loudness.h"
+#include "bg_worker.h"
+#include "mem_tag.h"
+#include "miniaudio.h"
+#include "music_lib.h"
+#include <math.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define MAX_CHANNELS  8
+#define STEP_MS       100     // 块的步长
+#define BLOCK_STEPS   4       // 一块 400ms = 4 个步长
+#define GATE_ABS_LUFS (-70.0) // 绝对门限
+#define GATE_REL_LU   (-10.0) // 相对门限 (相对于绝对门限以上所有块的平均响度)
+#define HIST_STEP     0.1     // 块响度直方图一格的宽度 (LU)，按格累加能量，不用保存每一块
+#define HIST_BINS     800     // -70 ~ +10 LUFS，更响的块都记在最后一格
+#define TP_MAX_PHASES 4       // 真峰值最多过采样的倍数
+#define TP_TAPS       12      // 插值滤波器每相的抽头数 (4 倍时共 48 阶)
+#define PEAK_FLOOR_DB (-100.0f)
+#define CHUNK_FRAMES  1024  // 每次解码的帧数
+#define SLICE_MS      10000 // 后台分析时每段解码的音频时长
+#define QUEUE_LEN     8     // 排队等分析的歌曲数
+
+typedef struct
+{
+    double b0, b1, b2, a1, a2;
+} biquad_t;
+
+// 一首歌的测量状态
+typedef struct
+{
+    uint32_t channels;
+    uint32_t sample_rate;
+    biquad_t shelf;            // K 计权第一级: 高架 (+4dB，模拟头部的声学效应)
+    biquad_t hp;               // 第二级: RLB 高通 (约 38Hz)
+    double z[MAX_CHANNELS][4]; // 两级滤波的状态 (转置直接 II 型)
+    double weight[MAX_CHANNELS];
+    double step_energy[BLOCK_STEPS]; // 最近 4 个步长各自的计权平方和
+    double acc;                      // 当前步长的计权平方和
+    uint32_t step_frames;
+    uint32_t step_pos;
+    uint64_t steps;
+    uint32_t hist_count[HIST_BINS];
+    double hist_energy[HIST_BINS];
+    uint32_t tp_phases; // 1 表示不过采样
+    float tp_coef[TP_MAX_PHASES][TP_TAPS];
+    float tp_hist[MAX_CHANNELS][TP_TAPS * 2]; // 输入历史写两份，总能取到连续的 TP_TAPS 个
+    uint32_t tp_pos;
+    float peak;
+    uint64_t frames;
+} meter_t;
+
+// 正在分析的歌曲
+typedef struct
+{
+    ma_decoder decoder;
+    meter_t meter;
+    float buf[CHUNK_FRAMES * MAX_CHANNELS];
+    char path[]; // 柔性数组
+} scan_t;
+
+// --- 静态变量 ---
+static pthread_mutex_t queue_lock = PTHREAD_MUTEX_INITIALIZER;
+static char *queue[QUEUE_LEN]; // 排队的路径 (环形)
+static uint32_t queue_head  = 0;
+static uint32_t queue_count = 0;
+static scan_t *active       = NULL;  // 正在分析的，只有分段任务修改 (持有 queue_lock)
+static bool running         = false; // 分段任务已经在后台队列中或正在执行
+static music_loudness_stats_t stats;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void *audio_malloc(size_t size, void *user_data)
+{
+    (void)user_data;
+    return mem_tag_alloc(MEM_TAG_AUDIO, size);
+}
+
+static void *audio_realloc(void *p, size_t size, void *user_data)
+{
+    (void)user_data;
+    return mem_tag_realloc(MEM_TAG_AUDIO, p, size);
+}
+
+static void audio_free(void *p, void *user_data)
+{
+    (void)user_data;
+    mem_tag_free(p);
+}
+
+// =============================================================
+// 测量 (BS.1770-4)
+// =============================================================
+
+/**
+ * @brief 声道权重: LFE 不计，环绕声道 1.41 (+1.5dB); 单声道当作两个喇叭放同样的内容
+ */
+static double channel_weight(ma_channel pos, uint32_t channels)
+{
+    if (channels == 1)
+        return 2.0;
+    switch (pos)
+    {
+        case MA_CHANNEL_LFE:
+            return 0.0;
+        case MA_CHANNEL_SIDE_LEFT:
+        case MA_CHANNEL_SIDE_RIGHT:
+        case MA_CHANNEL_BACK_LEFT:
+        case MA_CHANNEL_BACK_RIGHT:
+            return 1.41;
+        default:
+            return 1.0;
+    }
+}
+
+static void meter_init(meter_t *m, uint32_t channels, uint32_t sample_rate, const ma_channel *map)
+{
+    memset(m, 0, sizeof(meter_t));
+    m->channels    = channels;
+    m->sample_rate = sample_rate;
+    m->step_frames = sample_rate * STEP_MS / 1000;
+    for (uint32_t c = 0; c < channels; c++)
+        m->weight[c] = channel_weight(map[c], channels);
+
+    // K 计权: 标准只给出 48kHz 的系数，这里按它们对应的模拟原型 (中心频率、增益、Q) 换算到任意采样率
+    double fs   = sample_rate;
+    double f0   = 1681.974450955533;
+    double q    = 0.7071752369554196;
+    double k    = tan(M_PI * f0 / fs);
+    double vh   = pow(10.0, 3.999843853973347 / 20.0);
+    double vb   = pow(vh, 0.4996667741545416);
+    double a0   = 1.0 + k / q + k * k;
+    m->shelf.b0 = (vh + vb * k / q + k * k) / a0;
+    m->shelf.b1 = 2.0 * (k * k - vh) / a0;
+    m->shelf.b2 = (vh - vb * k / q + k * k) / a0;
+    m->shelf.a1 = 2.0 * (k * k - 1.0) / a0;
+    m->shelf.a2 = (1.0 - k / q + k * k) / a0;
+
+    f0       = 38.13547087602444;
+    q        = 0.5003270373238773;
+    k        = tan(M_PI * f0 / fs);
+    a0       = 1.0 + k / q + k * k;
+    m->hp.b0 = 1.0;
+    m->hp.b1 = -2.0;
+    m->hp.b2 = 1.0;
+    m->hp.a1 = 2.0 * (k * k - 1.0) / a0;
+    m->hp.a2 = (1.0 - k / q + k * k) / a0;
+
+    // 真峰值: 加 Blackman 窗的 sinc 插值，按相拆开 (每相对应一个不同的小数延迟)，每相归一化到直流增益 1
+    m->tp_phases = sample_rate < 96000 ? 4 : sample_rate < 192000 ? 2 : 1;
+    if (m->tp_phases == 1)
+        return;
+    uint32_t n = m->tp_phases * TP_TAPS;
+    for (uint32_t p = 0; p < m->tp_phases; p++)
+    {
+        double sum = 0.0;
+        for (uint32_t j = 0; j < TP_TAPS; j++)
+        {
+            uint32_t i = p + m->tp_phases * j;
+            double t   = ((double)i - (n - 1) / 2.0) / m->tp_phases;
+            double h   = t == 0.0 ? 1.0 : sin(M_PI * t) / (M_PI * t);
+            h *= 0.42 - 0.5 * cos(2 * M_PI * i / (n - 1)) + 0.08 * cos(4 * M_PI * i / (n - 1));
+            m->tp_coef[p][j] = (float)h;
+            sum += h;
+        }
+        for (uint32_t j = 0; j < TP_TAPS; j++)
+            m->tp_coef[p][j] = (float)(m->tp_coef[p][j] / sum);
+    }
+}
+
+/**
+ * @brief 一个步长结束: 凑够 4 个步长后得到一块 (400ms)，超过绝对门限的记入直方图
+ */
+static void meter_step(meter_t *m)
+{
+    m->step_energy[m->steps % BLOCK_STEPS] = m->acc;
+    m->acc                                 = 0.0;
+    m->step_pos                            = 0;
+    if (++m->steps < BLOCK_STEPS)
+        return;
+
+    double z = 0.0;
+    for (int i = 0; i < BLOCK_STEPS; i++)
+        z += m->step_energy[i];
+    z /= (double)m->step_frames * BLOCK_STEPS;
+    if (z <= 0.0)
+        return;
+    double l = -0.691 + 10.0 * log10(z);
+    if (l <= GATE_ABS_LUFS)
+        return;
+    int bin = (int)((l - GATE_ABS_LUFS) / HIST_STEP);
+    if (bin >= HIST_BINS)
+        bin = HIST_BINS - 1;
+    m->hist_count[bin]++;
+    m->hist_energy[bin] += z;
+}
+
+/**
+ * @brief 采样峰值和过采样后的峰值 (每个声道各自一段历史)
+ */
+static void meter_peak(meter_t *m, const float *pcm, uint32_t frames)
+{
+    uint32_t ch  = m->channels;
+    float peak   = m->peak;
+    uint32_t pos = m->tp_pos;
+    for (uint32_t c = 0; c < ch; c++)
+    {
+        float *hist = m->tp_hist[c];
+        pos         = m->tp_pos;
+        for (uint32_t i = 0; i < frames; i++)
+        {
+            float x = pcm[(size_t)i * ch + c];
+            if (fabsf(x) > peak)
+                peak = fabsf(x);
+            if (m->tp_phases == 1)
+                continue;
+
+            // 倒着写: hist[pos + j] 是 j 帧之前的样本
+            pos                 = (pos + TP_TAPS - 1) % TP_TAPS;
+            hist[pos]           = x;
+            hist[pos + TP_TAPS] = x;
+            const float *w      = hist + pos;
+            for (uint32_t p = 0; p < m->tp_phases; p++)
+            {
+                const float *h = m->tp_coef[p];
+                float y        = 0.0f;
+                for (int j = 0; j < TP_TAPS; j++)
+                    y += h[j] * w[j];
+                if (fabsf(y) > peak)
+                    peak = fabsf(y);
+            }
+        }
+    }
+    m->tp_pos = pos;
+    m->peak   = peak;
+}
+
+static void meter_feed(meter_t *m, const float *pcm, uint32_t frames)
+{
+    uint32_t ch = m->channels;
+    for (uint32_t i = 0; i < frames; i++)
+    {
+        const float *f = pcm + (size_t)i * ch;
+        double e       = 0.0;
+        for (uint32_t c = 0; c < ch; c++)
+        {
+            double x  = f[c];
+            double *z = m->z[c];
+            double y  = m->shelf.b0 * x + z[0];
+            z[0]      = m->shelf.b1 * x - m->shelf.a1 * y + z[1];
+            z[1]      = m->shelf.b2 * x - m->shelf.a2 * y;
+            double w  = m->hp.b0 * y + z[2];
+            z[2]      = m->hp.b1 * y - m->hp.a1 * w + z[3];
+            z[3]      = m->hp.b2 * y - m->hp.a2 * w;
+            e += m->weight[c] * w * w;
+        }
+        m->acc += e;
+        if (++m->step_pos == m->step_frames)
+            meter_step(m);
+    }
+    meter_peak(m, pcm, frames);
+    m->frames += frames;
+}
+
+/**
+ * @brief 综合响度: 绝对门限以上所有块的平均能量定出相对门限，再对相对门限以上的块求平均
+ * 直方图按格比较，相对门限落在格中间时整格算进去 (门限位置误差不超过 0.1 LU)
+ */
+static void meter_result(const meter_t *m, music_loudness_t *out)
+{
+    out->lufs    = (float)GATE_ABS_LUFS;
+    out->peak_db = m->peak > 0.0f ? 20.0f * log10f(m->peak) : PEAK_FLOOR_DB;
+    if (out->peak_db < PEAK_FLOOR_DB)
+        out->peak_db = PEAK_FLOOR_DB;
+    out->frames = m->frames;
+
+    double sum = 0.0;
+    uint64_t n = 0;
+    for (int i = 0; i < HIST_BINS; i++)
+    {
+        sum += m->hist_energy[i];
+        n += m->hist_count[i];
+    }
+    if (n == 0)
+        return;
+
+    double gate = -0.691 + 10.0 * log10(sum / n) + GATE_REL_LU;
+    int first   = (int)floor((gate - GATE_ABS_LUFS) / HIST_STEP);
+    if (first < 0)
+        first = 0;
+    sum = 0.0;
+    n   = 0;
+    for (int i = first; i < HIST_BINS; i++)
+    {
+        sum += m->hist_energy[i];
+        n += m->hist_count[i];
+    }
+    if (n > 0)
+        out->lufs = (float)(-0.691 + 10.0 * log10(sum / n));
+}
+
+// =============================================================
+// 解码
+// =============================================================
+
+/**
+ * @brief 按文件本身的采样率和声道解码 (不重采样，也不混成立体声)
+ */
+static scan_t *scan_open(const char *path)
+{
+    size_t len = strlen(path) + 1;
+    scan_t *s  = mem_tag_alloc(MEM_TAG_AUDIO, sizeof(scan_t) + len);
+    if (s == NULL)
+        return NULL;
+    memcpy(s->path, path, len);
+
+    ma_decoder_config config             = ma_decoder_config_init(ma_format_f32, 0, 0);
+    config.allocationCallbacks.onMalloc  = audio_malloc;
+    config.allocationCallbacks.onRealloc = audio_realloc;
+    config.allocationCallbacks.onFree    = audio_free;
+    if (ma_decoder_init_file(path, &config, &s->decoder) != MA_SUCCESS)
+    {
+        mem_tag_free(s);
+        return NULL;
+    }
+
+    ma_uint32 channels, sample_rate;
+    ma_channel map[MAX_CHANNELS];
+    if (ma_decoder_get_data_format(&s->decoder, NULL, &channels, &sample_rate, map, MAX_CHANNELS) != MA_SUCCESS ||
+        channels == 0 || channels > MAX_CHANNELS || sample_rate < 8000)
+    {
+        ma_decoder_uninit(&s->decoder);
+        mem_tag_free(s);
+        return NULL;
+    }
+    meter_init(&s->meter, channels, sample_rate, map);
+    return s;
+}
+
+/**
+ * @brief 最多解码 max_frames 帧，读到结尾 (或解码出错) 返回 true
+ */
+static bool scan_run(scan_t *s, uint64_t max_frames)
+{
+    uint64_t done = 0;
+    while (done < max_frames)
+    {
+        ma_uint64 n   = 0;
+        ma_result res = ma_decoder_read_pcm_frames(&s->decoder, s->buf, CHUNK_FRAMES, &n);
+        if (n > 0)
+            meter_feed(&s->meter, s->buf, (uint32_t)n);
+        if (res != MA_SUCCESS || n == 0)
+            return true;
+        done += n;
+    }
+    return false;
+}
+
+static void scan_close(scan_t *s)
+{
+    if (s == NULL)
+        return;
+    ma_decoder_uninit(&s->decoder);
+    mem_tag_free(s);
+}
+
+int music_loudness_scan(const char *path, music_loudness_t *out)
+{
+    scan_t *s = scan_open(path);
+    if (s == NULL)
+        return -1;
+    while (!scan_run(s, UINT64_MAX))
+        ;
+    meter_result(&s->meter, out);
+    scan_close(s);
+    return 0;
+}
+
+float music_loudness_gain_db(const music_loudness_t *res)
+{
+    if (res->lufs <= (float)GATE_ABS_LUFS)
+        return 0.0f;
+    return MUSIC_LOUDNESS_REF_LUFS - res->lufs;
+}
+
+// =============================================================
+// 后台分析
+// =============================================================
+
+/**
+ * @brief 取出下一首要分析的歌曲，已经有增益的直接跳过
+ */
+static scan_t *next_scan(void)
+{
+    for (;;)
+    {
+        pthread_mutex_lock(&queue_lock);
+        char *path = NULL;
+        if (queue_count > 0)
+        {
+            path       = queue[queue_head];
+            queue_head = (queue_head + 1) % QUEUE_LEN;
+            queue_count--;
+        }
+        pthread_mutex_unlock(&queue_lock);
+        if (path == NULL)
+            return NULL;
+
+        // 顺便把标签读进索引: 有 ReplayGain 标签的歌曲不用解码
+        music_info_t info;
+        scan_t *s = NULL;
+        if (music_lib_get(path, &info) != 0)
+            __atomic_add_fetch(&stats.failed, 1, __ATOMIC_RELAXED);
+        else if (info.gain_source != MUSIC_GAIN_NONE)
+            __atomic_add_fetch(&stats.skipped, 1, __ATOMIC_RELAXED);
+        else if ((s = scan_open(path)) == NULL)
+            __atomic_add_fetch(&stats.failed, 1, __ATOMIC_RELAXED);
+        mem_tag_free(path);
+        if (s)
+            return s;
+    }
+}
+
+static void finish_scan(scan_t *s)
+{
+    music_loudness_t res;
+    meter_result(&s->meter, &res);
+    float gain = music_loudness_gain_db(&res);
+    music_lib_set_gain(s->path, (int16_t)lrintf(gain * 100.0f), (int16_t)lrintf(res.peak_db * 100.0f));
+    printf("Loudness: %s %.1f LUFS, peak %.1f dBTP, gain %+.2f dB\n", s->path, res.lufs, res.peak_db, gain);
+
+    __atomic_add_fetch(&stats.scanned, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&stats.audio_ms, res.frames * 1000 / s->meter.sample_rate, __ATOMIC_RELAXED);
+}
+
+static void slice_job(void *arg);
+
+/**
+ * @brief 还有要分析的就再提交一段; running 在 queue_lock 下和队列一起判断，不会漏掉刚加入的请求
+ */
+static void schedule(void)
+{
+    pthread_mutex_lock(&queue_lock);
+    running   = active != NULL || queue_count > 0;
+    bool more = running;
+    pthread_mutex_unlock(&queue_lock);
+    if (more && bg_worker_submit(BG_PRIO_LOW, slice_job, NULL, NULL) != 0)
+    {
+        pthread_mutex_lock(&queue_lock);
+        running = false; // 下一次请求时接着分析
+        pthread_mutex_unlock(&queue_lock);
+    }
+}
+
+/**
+ * @brief 分析一段 (约 SLICE_MS 的音频) 就让出线程: 整首一口气分析完要占住一个后台线程好几秒，
+ * 期间缩略图、预加载等任务只剩一个线程可用
+ */
+static void slice_job(void *arg)
+{
+    (void)arg;
+    uint64_t start = now_ns();
+    if (active == NULL)
+    {
+        scan_t *s = next_scan();
+        pthread_mutex_lock(&queue_lock);
+        active = s;
+        pthread_mutex_unlock(&queue_lock);
+    }
+
+    if (active && scan_run(active, (uint64_t)active->meter.sample_rate * SLICE_MS / 1000))
+    {
+        finish_scan(active);
+        pthread_mutex_lock(&queue_lock);
+        scan_t *done = active;
+        active       = NULL;
+        pthread_mutex_unlock(&queue_lock);
+        scan_close(done);
+    }
+    __atomic_add_fetch(&stats.busy_ns, now_ns() - start, __ATOMIC_RELAXED);
+    schedule();
+}
+
+int music_loudness_request(const char *path)
+{
+    size_t len = strlen(path) + 1;
+    pthread_mutex_lock(&queue_lock);
+    bool dup = active && strcmp(active->path, path) == 0;
+    for (uint32_t i = 0; i < queue_count && !dup; i++)
+        dup = strcmp(queue[(queue_head + i) % QUEUE_LEN], path) == 0;
+    if (dup)
+    {
+        pthread_mutex_unlock(&queue_lock);
+        return 0;
+    }
+
+    char *copy = queue_count < QUEUE_LEN ? mem_tag_alloc(MEM_TAG_AUDIO, len) : NULL;
+    if (copy == NULL)
+    {
+        pthread_mutex_unlock(&queue_lock);
+        return -1;
+    }
+    memcpy(copy, path, len);
+    queue[(queue_head + queue_count) % QUEUE_LEN] = copy;
+    queue_count++;
+    bool start = !running;
+    running    = true;
+    pthread_mutex_unlock(&queue_lock);
+
+    if (start && bg_worker_submit(BG_PRIO_LOW, slice_job, NULL, NULL) != 0)
+    {
+        pthread_mutex_lock(&queue_lock);
+        running = false;
+        pthread_mutex_unlock(&queue_lock);
+    }
+    return 0;
+}
+
+void music_loudness_close(void)
+{
+    pthread_mutex_lock(&queue_lock);
+    while (queue_count > 0)
+    {
+        mem_tag_free(queue[queue_head]);
+        queue_head = (queue_head + 1) % QUEUE_LEN;
+        queue_count--;
+    }
+    scan_close(active);
+    active  = NULL;
+    running = false;
+    pthread_mutex_unlock(&queue_lock);
+}
+
+void music_loudness_get_stats(music_loudness_stats_t *out)
+{
+    out->scanned  = __atomic_load_n(&stats.scanned, __ATOMIC_RELAXED);
+    out->skipped  = __atomic_load_n(&stats.skipped, __ATOMIC_RELAXED);
+    out->failed   = __atomic_load_n(&stats.failed, __ATOMIC_RELAXED);
+    out->audio_ms = __atomic_load_n(&stats.audio_ms, __ATOMIC_RELAXED);
+    out->busy_ns  = __atomic_load_n(&stats.busy_ns, __ATOMIC_RELAXED);
+}
+
+void music_loudness_report(void)
+{
+    music_loudness_stats_t s;
+    music_loudness_get_stats(&s);
+    pthread_mutex_lock(&queue_lock);
+    uint32_t pending = queue_count + (active ? 1 : 0);
+    pthread_mutex_unlock(&queue_lock);
+
+    printf("Loudness: %u scanned, %u skipped (already have gain), %u failed, %u pending\n", s.scanned, s.skipped,
+           s.failed, pending);
+    if (s.busy_ns > 0 && s.audio_ms > 0)
+        printf("Loudness: %.1f min of audio in %.1f s (%.0fx realtime)\n", s.audio_ms / 60000.0, s.busy_ns / 1e9,
+               s.audio_ms * 1e6 / s.busy_ns);
+}
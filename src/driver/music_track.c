@@ -0,0 +1,549 @@
+#define _GNU_SOURCE // pthread_setaffinity_np
+#include "music_track.h"
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#define DECODE_CHUNK   2048 // 解码线程每次解码的帧数 (48kHz 约 43ms)
+#define PREFILL_MS     200  // 打开时同步解码的时长，开始播放不用等解码线程
+#define URGENT_MS      500  // 缓冲低于它时连续解码，高于它时每块之间让出 CPU 给 UI
+#define TOPUP_SLEEP_US 2000
+
+struct music_track
+{
+    ma_data_source_base base; // 必须是第一个成员
+    ma_decoder decoder;
+    uint32_t id;
+    ma_uint64 length; // 总帧数 (打开时读取，之后解码器只由一个线程使用)
+    float gain;       // 响度归一化的增益，音频线程读取时直接乘到样本上，链上切歌时同一个周期里换成下一首的
+    ma_bool32 started;
+    ma_allocation_callbacks alloc;
+    ma_uint32 channels;
+    ma_uint32 sample_rate;
+
+    // 环形缓冲 (rb_frames 为 0 表示直接在音频线程中解码)
+    ma_pcm_rb rb;
+    ma_uint32 rb_frames;
+    ma_uint64 consumed;    // 音频线程已读出的帧数 (即播放位置)，只由音频线程写
+    ma_uint64 seek_target; // 音频线程请求的跳转位置
+    uint32_t seek_req;     // 音频线程每请求一次跳转加一
+    uint32_t seek_done;    // 解码线程处理完的跳转请求
+    uint32_t eof;          // 解码线程已解码到结尾 (之前的数据都已提交)
+    uint32_t primed;       // 缓冲填满过，之后的剩余量才计入最低水位
+    uint32_t wake_sent;    // 已经唤醒过解码线程，解码线程处理时清零
+    music_track_t *next_reg; // 解码线程的歌曲链表 (tracks_lock)
+};
+
+static music_track_start_cb_t start_cb;
+static void *start_user_data;
+
+// --- 解码线程 ---
+static pthread_t decode_thread;
+static bool decoder_running = false;
+static uint32_t decode_stop = 0;
+static sem_t wake_sem;
+static pthread_mutex_t tracks_lock = PTHREAD_MUTEX_INITIALIZER;
+static music_track_t *tracks       = NULL; // 环形缓冲模式的歌曲
+static music_decoder_config_t dec_cfg;
+static char sched_desc[32]         = "-"; // 实际拿到的调度方式
+static music_decoder_stats_t stats = {0, 0, UINT32_MAX};
+
+// =============================================================
+// 歌曲数据源
+// =============================================================
+
+/**
+ * @brief 音频线程: 把这一首的增益乘到读出的样本上 (补的静音不用管)
+ */
+static void apply_gain(const music_track_t *t, float *out, ma_uint64 frames)
+{
+    float gain;
+    __atomic_load(&t->gain, &gain, __ATOMIC_RELAXED);
+    if (gain == 1.0f)
+        return;
+    ma_uint64 n = frames * t->channels;
+    for (ma_uint64 i = 0; i < n; i++)
+        out[i] *= gain;
+}
+
+static void track_started(music_track_t *t)
+{
+    t->started = MA_TRUE;
+    if (start_cb)
+        start_cb(t->id, start_user_data);
+}
+
+/**
+ * @brief 音频线程: 从环形缓冲拷贝，读空时补静音 (解码到结尾时才返回 MA_AT_END，链上随即切到下一首)
+ */
+static ma_result track_read_rb(music_track_t *t, float *out, ma_uint64 frame_count, ma_uint64 *frames_read)
+{
+    ma_uint32 ch = t->channels;
+    if (t->seek_req != __atomic_load_n(&t->seek_done, __ATOMIC_ACQUIRE))
+    {
+        // 解码线程还在跳转
+        memset(out, 0, (size_t)frame_count * ch * sizeof(float));
+        *frames_read = frame_count;
+        return MA_SUCCESS;
+    }
+
+    bool eof        = __atomic_load_n(&t->eof, __ATOMIC_ACQUIRE); // 先读 eof，之后看到的缓冲一定包含全部剩余数据
+    ma_uint32 avail = ma_pcm_rb_available_read(&t->rb);
+    if (__atomic_load_n(&t->primed, __ATOMIC_RELAXED) && !eof)
+    {
+        uint32_t ms = (uint32_t)((ma_uint64)avail * 1000 / t->sample_rate);
+        if (ms < __atomic_load_n(&stats.low_water_ms, __ATOMIC_RELAXED))
+            __atomic_store_n(&stats.low_water_ms, ms, __ATOMIC_RELAXED);
+    }
+
+    ma_uint64 done = 0;
+    while (done < frame_count)
+    {
+        ma_uint64 want = frame_count - done;
+        ma_uint32 n    = want > t->rb_frames ? t->rb_frames : (ma_uint32)want;
+        void *src;
+        ma_pcm_rb_acquire_read(&t->rb, &n, &src);
+        if (n == 0)
+            break;
+        memcpy(out + done * ch, src, (size_t)n * ch * sizeof(float));
+        ma_pcm_rb_commit_read(&t->rb, n);
+        done += n;
+    }
+    apply_gain(t, out, done);
+    __atomic_store_n(&t->consumed, t->consumed + done, __ATOMIC_RELAXED);
+    if (!t->started && done > 0)
+        track_started(t);
+
+    if (done < frame_count && eof)
+    {
+        *frames_read = done;
+        return MA_AT_END;
+    }
+    if (done < frame_count)
+    {
+        memset(out + done * ch, 0, (size_t)(frame_count - done) * ch * sizeof(float));
+        __atomic_fetch_add(&stats.underruns, 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&stats.silence_frames, frame_count - done, __ATOMIC_RELAXED);
+    }
+    *frames_read = frame_count;
+
+    // 剩余不到一半时唤醒解码线程 (sem_post 不会阻塞)
+    if (!eof && ma_pcm_rb_available_read(&t->rb) < t->rb_frames / 2 &&
+        __atomic_exchange_n(&t->wake_sent, 1, __ATOMIC_ACQ_REL) == 0)
+        sem_post(&wake_sem);
+    return MA_SUCCESS;
+}
+
+static ma_result track_read(ma_data_source *ds, void *out, ma_uint64 frame_count, ma_uint64 *frames_read)
+{
+    music_track_t *t = (music_track_t *)ds;
+    if (t->rb_frames)
+        return track_read_rb(t, out, frame_count, frames_read);
+
+    ma_result res = ma_decoder_read_pcm_frames(&t->decoder, out, frame_count, frames_read);
+    apply_gain(t, out, *frames_read);
+    __atomic_store_n(&t->consumed, t->consumed + *frames_read, __ATOMIC_RELAXED);
+    if (!t->started && *frames_read > 0)
+        track_started(t);
+    return res;
+}
+
+static ma_result track_seek(ma_data_source *ds, ma_uint64 frame)
+{
+    music_track_t *t = (music_track_t *)ds;
+    if (t->rb_frames == 0)
+    {
+        ma_result res = ma_decoder_seek_to_pcm_frame(&t->decoder, frame);
+        if (res == MA_SUCCESS)
+            __atomic_store_n(&t->consumed, frame, __ATOMIC_RELAXED);
+        return res;
+    }
+
+    // 链上切到这一首时会先跳到 0: 还没读过就什么都不做，保留已经解码好的数据
+    bool busy = t->seek_req != __atomic_load_n(&t->seek_done, __ATOMIC_ACQUIRE);
+    if (!busy && frame == t->consumed)
+        return MA_SUCCESS;
+
+    // 交给解码线程: 它清空缓冲并重新定位，期间 track_read_rb 输出静音
+    __atomic_store_n(&t->seek_target, frame, __ATOMIC_RELAXED);
+    __atomic_store_n(&t->seek_req, t->seek_req + 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&t->consumed, frame, __ATOMIC_RELAXED);
+    sem_post(&wake_sem);
+    return MA_SUCCESS;
+}
+
+static ma_result track_get_format(ma_data_source *ds, ma_format *format, ma_uint32 *channels, ma_uint32 *sample_rate,
+                                  ma_channel *channel_map, size_t channel_map_cap)
+{
+    return ma_decoder_get_data_format(&((music_track_t *)ds)->decoder, format, channels, sample_rate, channel_map,
+                                      channel_map_cap);
+}
+
+static ma_result track_get_cursor(ma_data_source *ds, ma_uint64 *cursor)
+{
+    *cursor = music_track_cursor((music_track_t *)ds);
+    return MA_SUCCESS;
+}
+
+static ma_result track_get_length(ma_data_source *ds, ma_uint64 *length)
+{
+    *length = ((music_track_t *)ds)->length;
+    return MA_SUCCESS;
+}
+
+static ma_data_source_vtable track_vtable = {
+    track_read, track_seek, track_get_format, track_get_cursor, track_get_length, NULL, 0,
+};
+
+// =============================================================
+// 解码线程
+// =============================================================
+
+/**
+ * @brief 解码一块写入环形缓冲 (解码线程，或者打开时还没交给解码线程的调用者)
+ * 返回写入的帧数，缓冲已满或已到结尾时返回 0
+ */
+static ma_uint32 fill_chunk(music_track_t *t)
+{
+    uint32_t req = __atomic_load_n(&t->seek_req, __ATOMIC_ACQUIRE);
+    if (req != t->seek_done)
+    {
+        // 音频线程此时不读缓冲，可以直接清空
+        ma_pcm_rb_reset(&t->rb);
+        ma_uint64 target = __atomic_load_n(&t->seek_target, __ATOMIC_RELAXED);
+        bool ok          = ma_decoder_seek_to_pcm_frame(&t->decoder, target) == MA_SUCCESS;
+        __atomic_store_n(&t->eof, !ok, __ATOMIC_RELAXED);
+        __atomic_store_n(&t->primed, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&t->seek_done, req, __ATOMIC_RELEASE);
+    }
+    if (__atomic_load_n(&t->eof, __ATOMIC_RELAXED))
+        return 0;
+
+    __atomic_store_n(&t->wake_sent, 0, __ATOMIC_RELEASE);
+    ma_uint32 n = DECODE_CHUNK;
+    void *dst;
+    ma_pcm_rb_acquire_write(&t->rb, &n, &dst);
+    if (n == 0)
+        return 0;
+
+    ma_uint64 got = 0;
+    ma_result res = ma_decoder_read_pcm_frames(&t->decoder, dst, n, &got);
+    ma_pcm_rb_commit_write(&t->rb, (ma_uint32)got);
+    if (res != MA_SUCCESS || got < n)
+        __atomic_store_n(&t->eof, 1, __ATOMIC_RELEASE); // 解码出错也当作结尾，不让这一首卡住整条链
+    else if (ma_pcm_rb_available_write(&t->rb) == 0)
+        __atomic_store_n(&t->primed, 1, __ATOMIC_RELAXED);
+    return (ma_uint32)got;
+}
+
+static void *decode_main(void *arg)
+{
+    (void)arg;
+    if (dec_cfg.cpu >= 0)
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(dec_cfg.cpu, &set);
+        if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+            printf("Music: Cannot bind decode thread to CPU %d\n", dec_cfg.cpu);
+    }
+
+    // 实时调度要 root 或 CAP_SYS_NICE，拿不到时退而求其次调 nice
+    struct sched_param sp = {.sched_priority = dec_cfg.rt_priority};
+    if (dec_cfg.rt_priority > 0 && pthread_setschedparam(pthread_self(), SCHED_FIFO, &sp) == 0)
+        snprintf(sched_desc, sizeof(sched_desc), "SCHED_FIFO %d", dec_cfg.rt_priority);
+    else if (setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), dec_cfg.nice) == 0)
+        snprintf(sched_desc, sizeof(sched_desc), "nice %d", dec_cfg.nice);
+    else
+        snprintf(sched_desc, sizeof(sched_desc), "default");
+
+    while (!__atomic_load_n(&decode_stop, __ATOMIC_ACQUIRE))
+    {
+        // 每次只解码缓冲最少的那一首 (有跳转请求的优先)
+        pthread_mutex_lock(&tracks_lock);
+        music_track_t *best = NULL;
+        ma_uint32 best_fill = 0;
+        for (music_track_t *t = tracks; t; t = t->next_reg)
+        {
+            bool seek = __atomic_load_n(&t->seek_req, __ATOMIC_ACQUIRE) != t->seek_done;
+            if (!seek && (__atomic_load_n(&t->eof, __ATOMIC_RELAXED) || ma_pcm_rb_available_write(&t->rb) == 0))
+                continue;
+            ma_uint32 fill = seek ? 0 : ma_pcm_rb_available_read(&t->rb);
+            if (best == NULL || fill < best_fill)
+            {
+                best      = t;
+                best_fill = fill;
+            }
+        }
+        ma_uint32 urgent = best ? (ma_uint32)((ma_uint64)best->sample_rate * URGENT_MS / 1000) : 0;
+        if (best)
+            fill_chunk(best);
+        pthread_mutex_unlock(&tracks_lock);
+
+        if (best == NULL)
+            sem_wait(&wake_sem); // 全部填满: 等音频线程读掉一半
+        else if (best_fill >= urgent)
+            usleep(TOPUP_SLEEP_US); // 不急: 实时线程不主动让出 CPU，UI 会一直抢不到
+    }
+    return NULL;
+}
+
+music_decoder_config_t music_decoder_config_default(void)
+{
+    music_decoder_config_t cfg;
+    cfg.buffer_ms   = 3000;
+    cfg.rt_priority = 40;
+    cfg.nice        = -10;
+    cfg.cpu         = -1;
+    return cfg;
+}
+
+void music_decoder_config_from_env(music_decoder_config_t *cfg)
+{
+    const char *s;
+    if ((s = getenv("AUDIO_BUFFER_MS")) != NULL)
+        cfg->buffer_ms = (uint32_t)strtoul(s, NULL, 10);
+    if ((s = getenv("AUDIO_DECODE_PRIO")) != NULL)
+        cfg->rt_priority = atoi(s);
+    if ((s = getenv("AUDIO_DECODE_NICE")) != NULL)
+        cfg->nice = atoi(s);
+    if ((s = getenv("AUDIO_DECODE_CPU")) != NULL)
+        cfg->cpu = atoi(s);
+}
+
+int music_decoder_start(const music_decoder_config_t *cfg)
+{
+    if (decoder_running)
+        return 0;
+    if (cfg->buffer_ms == 0)
+        return -1; // 不要缓冲: 在音频线程中解码
+
+    dec_cfg     = *cfg;
+    decode_stop = 0;
+    stats       = (music_decoder_stats_t){0, 0, UINT32_MAX};
+    if (sem_init(&wake_sem, 0, 0) != 0)
+        return -1;
+    if (pthread_create(&decode_thread, NULL, decode_main, NULL) != 0)
+    {
+        perror("Music: Cannot create decode thread");
+        sem_destroy(&wake_sem);
+        return -1;
+    }
+    decoder_running = true;
+    return 0;
+}
+
+void music_decoder_stop(void)
+{
+    if (!decoder_running)
+        return;
+    __atomic_store_n(&decode_stop, 1, __ATOMIC_RELEASE);
+    sem_post(&wake_sem);
+    pthread_join(decode_thread, NULL);
+    sem_destroy(&wake_sem);
+    decoder_running = false;
+}
+
+void music_decoder_get_stats(music_decoder_stats_t *out)
+{
+    out->underruns      = __atomic_load_n(&stats.underruns, __ATOMIC_RELAXED);
+    out->silence_frames = __atomic_load_n(&stats.silence_frames, __ATOMIC_RELAXED);
+    out->low_water_ms   = __atomic_load_n(&stats.low_water_ms, __ATOMIC_RELAXED);
+}
+
+void music_decoder_report(void)
+{
+    if (!decoder_running)
+    {
+        printf("Music: decode thread not running (decoding in the audio callback)\n");
+        return;
+    }
+
+    music_decoder_stats_t s;
+    music_decoder_get_stats(&s);
+    char low[16] = "-";
+    if (s.low_water_ms != UINT32_MAX)
+        snprintf(low, sizeof(low), "%u ms", s.low_water_ms);
+    printf("Music: decode thread %s, cpu %d, buffer %u ms, %llu underruns (%llu frames of silence), low water %s\n",
+           sched_desc, dec_cfg.cpu, dec_cfg.buffer_ms, (unsigned long long)s.underruns,
+           (unsigned long long)s.silence_frames, low);
+}
+
+// =============================================================
+// 打开和关闭
+// =============================================================
+
+void music_track_set_start_cb(music_track_start_cb_t cb, void *user_data)
+{
+    start_cb        = cb;
+    start_user_data = user_data;
+}
+
+music_track_t *music_track_open(const char *path, uint32_t id, ma_uint32 channels, ma_uint32 sample_rate,
+                                const ma_allocation_callbacks *alloc)
+{
+    music_track_t *t = ma_malloc(sizeof(music_track_t), alloc);
+    if (t == NULL)
+        return NULL;
+    memset(t, 0, sizeof(*t));
+    if (alloc)
+        t->alloc = *alloc;
+    t->channels    = channels;
+    t->sample_rate = sample_rate;
+    t->gain        = 1.0f;
+
+    ma_data_source_config ds_config = ma_data_source_config_init();
+    ds_config.vtable                = &track_vtable;
+    ma_decoder_config dec_config    = ma_decoder_config_init(ma_format_f32, channels, sample_rate);
+    if (alloc)
+        dec_config.allocationCallbacks = *alloc;
+
+    if (ma_data_source_init(&ds_config, &t->base) != MA_SUCCESS)
+    {
+        ma_free(t, alloc);
+        return NULL;
+    }
+    if (ma_decoder_init_file(path, &dec_config, &t->decoder) != MA_SUCCESS)
+    {
+        ma_data_source_uninit(&t->base);
+        ma_free(t, alloc);
+        return NULL;
+    }
+
+    // 长度未知 (部分流式格式) 时为 0，进度条不动但不影响播放
+    if (ma_decoder_get_length_in_pcm_frames(&t->decoder, &t->length) != MA_SUCCESS)
+        t->length = 0;
+    t->id = id;
+
+    if (decoder_running)
+    {
+        ma_uint32 frames = (ma_uint32)((ma_uint64)sample_rate * dec_cfg.buffer_ms / 1000);
+        if (ma_pcm_rb_init(ma_format_f32, channels, frames, NULL, alloc, &t->rb) == MA_SUCCESS)
+        {
+            // 还没交给解码线程，可以直接写缓冲
+            t->rb_frames      = frames;
+            ma_uint32 prefill = (ma_uint32)((ma_uint64)sample_rate * PREFILL_MS / 1000);
+            while (ma_pcm_rb_available_read(&t->rb) < prefill && fill_chunk(t) > 0)
+                ;
+
+            pthread_mutex_lock(&tracks_lock);
+            t->next_reg = tracks;
+            tracks      = t;
+            pthread_mutex_unlock(&tracks_lock);
+            sem_post(&wake_sem);
+        }
+    }
+    return t;
+}
+
+void music_track_close(music_track_t *t)
+{
+    if (t == NULL)
+        return;
+    if (t->rb_frames)
+    {
+        // 拿到锁就说明解码线程不在处理这一首
+        pthread_mutex_lock(&tracks_lock);
+        for (music_track_t **p = &tracks; *p; p = &(*p)->next_reg)
+        {
+            if (*p == t)
+            {
+                *p = t->next_reg;
+                break;
+            }
+        }
+        pthread_mutex_unlock(&tracks_lock);
+        ma_pcm_rb_uninit(&t->rb);
+    }
+    ma_decoder_uninit(&t->decoder);
+    ma_data_source_uninit(&t->base);
+    ma_allocation_callbacks alloc = t->alloc;
+    ma_free(t, alloc.onFree ? &alloc : NULL);
+}
+
+ma_data_source *music_track_ds(music_track_t *t)
+{
+    return &t->base;
+}
+
+uint32_t music_track_id(const music_track_t *t)
+{
+    return t->id;
+}
+
+void music_track_set_gain(music_track_t *t, float gain)
+{
+    __atomic_store(&t->gain, &gain, __ATOMIC_RELAXED);
+}
+
+ma_uint64 music_track_cursor(const music_track_t *t)
+{
+    return __atomic_load_n(&t->consumed, __ATOMIC_RELAXED);
+}
+
+ma_uint64 music_track_length(const music_track_t *t)
+{
+    return t->length;
+}
+
+// =============================================================
+// 链头
+// =============================================================
+
+static ma_result chain_read(ma_data_source *ds, void *out, ma_uint64 frame_count, ma_uint64 *frames_read)
+{
+    (void)ds;
+    (void)out;
+    (void)frame_count;
+    *frames_read = 0;
+    return MA_AT_END; // ma_data_source_read_pcm_frames 随即切到 pNext，同一次读取中就拿到第一首的数据
+}
+
+static ma_result chain_seek(ma_data_source *ds, ma_uint64 frame)
+{
+    (void)ds;
+    return frame == 0 ? MA_SUCCESS : MA_INVALID_OPERATION;
+}
+
+static ma_result chain_get_format(ma_data_source *ds, ma_format *format, ma_uint32 *channels, ma_uint32 *sample_rate,
+                                  ma_channel *channel_map, size_t channel_map_cap)
+{
+    music_chain_t *c = (music_chain_t *)ds;
+    *format          = ma_format_f32;
+    *channels        = c->channels;
+    *sample_rate     = c->sample_rate;
+    ma_channel_map_init_standard(ma_standard_channel_map_default, channel_map, channel_map_cap, c->channels);
+    return MA_SUCCESS;
+}
+
+static ma_result chain_get_zero(ma_data_source *ds, ma_uint64 *value)
+{
+    (void)ds;
+    *value = 0;
+    return MA_SUCCESS;
+}
+
+static ma_data_source_vtable chain_vtable = {
+    chain_read, chain_seek, chain_get_format, chain_get_zero, chain_get_zero, NULL, 0,
+};
+
+ma_result music_chain_init(music_chain_t *chain, ma_uint32 channels, ma_uint32 sample_rate)
+{
+    ma_data_source_config config = ma_data_source_config_init();
+    config.vtable                = &chain_vtable;
+    ma_result res                = ma_data_source_init(&config, &chain->base);
+    chain->channels              = channels;
+    chain->sample_rate           = sample_rate;
+    return res;
+}
+
+void music_chain_uninit(music_chain_t *chain)
+{
+    ma_data_source_uninit(&chain->base);
+}
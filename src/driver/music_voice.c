@@ -0,0 +1,171 @@
+#include "music_voice.h"
+#include <stdio.h>
+#include <string.h>
+
+#define STOP_GRACE_MS 250 // 淡出结束后再停止 (要长于一个设备周期)
+
+struct music_voice
+{
+    ma_sound sound;       // 数据源是 chain
+    music_chain_t chain;  // chain -> track -> next
+    music_track_t *track; // 正在播放 (或等待开始时间) 的歌曲
+    music_track_t *next;  // 无缝接在 track 后面的下一首
+    uint32_t seq;         // 本次播放的序号，结束通知带上它，过期的通知由调用者丢弃
+    bool busy;
+    bool inited;
+};
+
+// --- 静态变量 ---
+static music_voice_t voices[MUSIC_VOICE_COUNT];
+static ma_engine *voice_engine = NULL;
+static ma_node *voice_output   = NULL;
+static music_voice_end_cb_t end_cb;
+static void *end_user_data;
+static uint32_t seq_counter = 0;
+
+// 音频线程: 链读完了
+static void on_sound_end(void *user_data, ma_sound *snd)
+{
+    (void)snd;
+    music_voice_t *v = user_data;
+    if (end_cb)
+        end_cb(v->seq, end_user_data);
+}
+
+int music_voice_pool_init(ma_engine *engine, ma_node *output, music_voice_end_cb_t cb, void *user_data)
+{
+    voice_engine  = engine;
+    voice_output  = output;
+    end_cb        = cb;
+    end_user_data = user_data;
+
+    // 歌曲已经是引擎的采样率，不需要变调重采样器 (它会带来一帧延迟并吃掉最后一帧); 音乐也不需要 3D 定位
+    ma_sound_config config = ma_sound_config_init_2(engine);
+    config.flags           = MA_SOUND_FLAG_NO_PITCH | MA_SOUND_FLAG_NO_SPATIALIZATION;
+    for (int i = 0; i < MUSIC_VOICE_COUNT; i++)
+    {
+        music_voice_t *v = &voices[i];
+        memset(v, 0, sizeof(*v));
+        music_chain_init(&v->chain, ma_engine_get_channels(engine), ma_engine_get_sample_rate(engine));
+        config.pDataSource = &v->chain;
+        if (ma_sound_init_ex(engine, &config, &v->sound) != MA_SUCCESS)
+        {
+            printf("Voice: Failed to create sound %d\n", i);
+            music_chain_uninit(&v->chain);
+            music_voice_pool_uninit();
+            return -1;
+        }
+        ma_sound_set_end_callback(&v->sound, on_sound_end, v);
+        ma_node_detach_output_bus(&v->sound, 0); // 空闲时不在节点图上
+        v->inited = true;
+    }
+    return 0;
+}
+
+void music_voice_pool_uninit(void)
+{
+    for (int i = 0; i < MUSIC_VOICE_COUNT; i++)
+    {
+        music_voice_t *v = &voices[i];
+        if (!v->inited)
+            continue;
+        music_voice_release(v);
+        ma_sound_uninit(&v->sound);
+        music_chain_uninit(&v->chain);
+        v->inited = false;
+    }
+    voice_engine = NULL;
+    voice_output = NULL;
+}
+
+music_voice_t *music_voice_acquire(void)
+{
+    for (int i = 0; i < MUSIC_VOICE_COUNT; i++)
+    {
+        if (voices[i].inited && !voices[i].busy)
+        {
+            voices[i].busy = true;
+            return &voices[i];
+        }
+    }
+    return NULL;
+}
+
+uint32_t music_voice_start(music_voice_t *v, music_track_t *t, ma_uint64 start_at, ma_uint64 fade)
+{
+    // 声部空闲时不在节点图上，这里改链和状态不会和音频线程冲突
+    if (++seq_counter == 0)
+        seq_counter = 1;
+    v->seq   = seq_counter;
+    v->track = t;
+    v->next  = NULL;
+    ma_data_source_set_current(&v->chain, &v->chain);
+    ma_data_source_set_next(&v->chain, music_track_ds(t));
+
+    // 清掉上次留下的停止时间和淡出
+    ma_sound_set_stop_time_in_pcm_frames(&v->sound, ~(ma_uint64)0);
+    ma_sound_set_start_time_in_pcm_frames(&v->sound, start_at);
+    if (fade > 0)
+        ma_sound_set_fade_start_in_pcm_frames(&v->sound, 0.0f, 1.0f, fade, start_at);
+    else
+        ma_sound_set_fade_in_pcm_frames(&v->sound, 1.0f, 1.0f, 0);
+
+    ma_node_attach_output_bus(&v->sound, 0, voice_output, 0);
+    ma_sound_start(&v->sound); // 到结尾的声部会先回到链头
+    return v->seq;
+}
+
+void music_voice_fade_out(music_voice_t *v, ma_uint64 fade_at, ma_uint64 fade)
+{
+    // miniaudio 从含停止时间的那个周期起就整个周期不再读，直接在淡出结束时停止会丢掉最后一个周期 (音量掉一下)
+    // 所以停止时间往后留一点，淡出结束后音量保持为 0; 长度准确时歌曲在淡出结束时正好读完
+    ma_sound_set_fade_start_in_pcm_frames(&v->sound, -1.0f, 0.0f, fade, fade_at);
+    ma_sound_set_stop_time_in_pcm_frames(&v->sound,
+                                         fade_at + fade + (ma_uint64)STOP_GRACE_MS * ma_engine_get_sample_rate(voice_engine) / 1000);
+}
+
+void music_voice_chain(music_voice_t *v, music_track_t *t)
+{
+    v->next = t;
+    ma_data_source_set_next(music_track_ds(v->track), music_track_ds(t));
+}
+
+void music_voice_advance(music_voice_t *v)
+{
+    music_track_close(v->track); // 音频线程已经离开它
+    v->track = v->next;
+    v->next  = NULL;
+}
+
+void music_voice_release(music_voice_t *v)
+{
+    if (v == NULL || !v->busy)
+        return;
+    ma_sound_stop(&v->sound);
+    ma_node_detach_output_bus(&v->sound, 0); // 返回时音频线程已经不再读这个声部
+    music_track_close(v->next);
+    music_track_close(v->track);
+    v->next  = NULL;
+    v->track = NULL;
+    v->busy  = false;
+}
+
+music_track_t *music_voice_track(const music_voice_t *v)
+{
+    return v->track;
+}
+
+music_track_t *music_voice_next(const music_voice_t *v)
+{
+    return v->next;
+}
+
+uint32_t music_voice_seq(const music_voice_t *v)
+{
+    return v->seq;
+}
+
+bool music_voice_done(const music_voice_t *v)
+{
+    return !ma_sound_is_playing(&v->sound) || ma_sound_at_end(&v->sound);
+}
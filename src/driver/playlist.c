@@ -0,0 +1,455 @@
+#include "playlist.h"
+#include "mem_tag.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define POOL_INIT      (16 * 1024)
+#define ENTRIES_INIT   256
+#define FEISTEL_ROUNDS 4
+#define QUEUE_TAG      "#QUEUE:"
+#define SAVE_BUF_SIZE  (64 * 1024)
+
+struct playlist
+{
+    char *pool; // 所有路径，'\0' 分隔
+    size_t pool_len;
+    size_t pool_cap;
+    uint32_t *ofs; // 每条路径在字符串池中的偏移
+    uint32_t count;
+    uint32_t cap;
+
+    uint32_t pos; // 当前在播放顺序中的位置 (可能 >= count，使用时截断到最后一条)
+    bool shuffle;
+    uint32_t seed;
+    playlist_repeat_t repeat;
+};
+
+// 播放队列文件里 "#QUEUE:" 行的内容
+typedef struct
+{
+    bool valid;
+    uint32_t pos;
+    int shuffle;
+    uint32_t seed;
+    int repeat;
+    int follow;
+} queue_state_t;
+
+// =============================================================
+// 随机顺序: 定义域为 4^h >= count 的 Feistel 网络，结果超出 count 时再置换一次 (cycle walking)
+// 定义域最多是 count 的 4 倍，平均不到 4 次就落回范围内
+// =============================================================
+
+static uint32_t round_fn(uint32_t x, uint32_t key)
+{
+    x ^= key;
+    x *= 0x9E3779B1u;
+    x ^= x >> 15;
+    x *= 0x85EBCA77u;
+    x ^= x >> 13;
+    return x;
+}
+
+static uint32_t half_bits(uint32_t n)
+{
+    uint32_t h = 1;
+    while (((uint64_t)1 << (2 * h)) < n)
+        h++;
+    return h;
+}
+
+static uint32_t feistel(uint32_t x, uint32_t h, uint32_t seed, bool inverse)
+{
+    uint32_t mask = (1u << h) - 1;
+    uint32_t l    = x >> h;
+    uint32_t r    = x & mask;
+    if (!inverse)
+    {
+        for (int i = 0; i < FEISTEL_ROUNDS; i++)
+        {
+            uint32_t t = l ^ (round_fn(r, seed + i * 0x6D2B79F5u) & mask);
+            l          = r;
+            r          = t;
+        }
+    }
+    else
+    {
+        for (int i = FEISTEL_ROUNDS - 1; i >= 0; i--)
+        {
+            uint32_t t = r ^ (round_fn(l, seed + i * 0x6D2B79F5u) & mask);
+            r          = l;
+            l          = t;
+        }
+    }
+    return (l << h) | r;
+}
+
+/**
+ * @brief 播放顺序中的位置 -> 条目号
+ */
+static uint32_t order_to_entry(const playlist_t *pl, uint32_t pos)
+{
+    if (!pl->shuffle)
+        return pos;
+    uint32_t h = half_bits(pl->count);
+    uint32_t x = pos;
+    do
+        x = feistel(x, h, pl->seed, false);
+    while (x >= pl->count);
+    return x;
+}
+
+/**
+ * @brief 条目号 -> 播放顺序中的位置
+ */
+static uint32_t entry_to_order(const playlist_t *pl, uint32_t entry)
+{
+    if (!pl->shuffle)
+        return entry;
+    uint32_t h = half_bits(pl->count);
+    uint32_t x = entry;
+    do
+        x = feistel(x, h, pl->seed, true);
+    while (x >= pl->count);
+    return x;
+}
+
+/**
+ * @brief 走 step 步后在播放顺序中的位置，走出列表且不循环时返回 -1
+ */
+static int64_t step_pos(const playlist_t *pl, int step, bool user)
+{
+    if (pl->count == 0)
+        return -1;
+    int64_t n = pl->count;
+    int64_t p = pl->pos < pl->count ? pl->pos : n - 1;
+    if (!user && pl->repeat == PLAYLIST_REPEAT_ONE)
+        return p;
+
+    int64_t q = p + step;
+    if (q < 0 || q >= n)
+    {
+        if (pl->repeat == PLAYLIST_REPEAT_OFF)
+            return -1;
+        q = ((q % n) + n) % n;
+    }
+    return q;
+}
+
+// =============================================================
+// 条目
+// =============================================================
+
+playlist_t *playlist_create(void)
+{
+    return mem_tag_calloc(MEM_TAG_INDEX, 1, sizeof(playlist_t));
+}
+
+void playlist_destroy(playlist_t *pl)
+{
+    if (pl == NULL)
+        return;
+    mem_tag_free(pl->pool);
+    mem_tag_free(pl->ofs);
+    mem_tag_free(pl);
+}
+
+void playlist_clear(playlist_t *pl)
+{
+    pl->pool_len = 0;
+    pl->count    = 0;
+}
+
+int playlist_add(playlist_t *pl, const char *path)
+{
+    size_t len = strlen(path) + 1;
+    if (len > PLAYLIST_PATH_MAX || pl->count == UINT32_MAX)
+        return -1;
+
+    if (pl->count == pl->cap)
+    {
+        uint32_t cap  = pl->cap ? pl->cap * 2 : ENTRIES_INIT;
+        uint32_t *ofs = mem_tag_realloc(MEM_TAG_INDEX, pl->ofs, cap * sizeof(uint32_t));
+        if (ofs == NULL)
+            return -1;
+        pl->ofs = ofs;
+        pl->cap = cap;
+    }
+    if (pl->pool_len + len > pl->pool_cap)
+    {
+        size_t cap = pl->pool_cap ? pl->pool_cap * 2 : POOL_INIT;
+        while (cap < pl->pool_len + len)
+            cap *= 2;
+        if (cap > UINT32_MAX)
+            return -1;
+        char *pool = mem_tag_realloc(MEM_TAG_INDEX, pl->pool, cap);
+        if (pool == NULL)
+            return -1;
+        pl->pool     = pool;
+        pl->pool_cap = cap;
+    }
+
+    memcpy(&pl->pool[pl->pool_len], path, len);
+    pl->ofs[pl->count] = (uint32_t)pl->pool_len;
+    pl->pool_len += len;
+    return (int)pl->count++;
+}
+
+uint32_t playlist_count(const playlist_t *pl)
+{
+    return pl->count;
+}
+
+const char *playlist_path(const playlist_t *pl, uint32_t i)
+{
+    return i < pl->count ? &pl->pool[pl->ofs[i]] : NULL;
+}
+
+int playlist_find(const playlist_t *pl, const char *path)
+{
+    for (uint32_t i = 0; i < pl->count; i++)
+    {
+        if (strcmp(&pl->pool[pl->ofs[i]], path) == 0)
+            return (int)i;
+    }
+    return -1;
+}
+
+// =============================================================
+// 播放顺序
+// =============================================================
+
+int playlist_current(const playlist_t *pl)
+{
+    if (pl->count == 0)
+        return -1;
+    return (int)order_to_entry(pl, pl->pos < pl->count ? pl->pos : pl->count - 1);
+}
+
+void playlist_jump(playlist_t *pl, uint32_t i)
+{
+    if (i < pl->count)
+        pl->pos = entry_to_order(pl, i);
+}
+
+int playlist_peek(const playlist_t *pl, int step, bool user)
+{
+    int64_t q = step_pos(pl, step, user);
+    return q < 0 ? -1 : (int)order_to_entry(pl, (uint32_t)q);
+}
+
+int playlist_step(playlist_t *pl, int step, bool user)
+{
+    int64_t q = step_pos(pl, step, user);
+    if (q < 0)
+        return -1;
+    pl->pos = (uint32_t)q;
+    return (int)order_to_entry(pl, pl->pos);
+}
+
+void playlist_set_shuffle(playlist_t *pl, bool on, uint32_t seed)
+{
+    int cur     = playlist_current(pl);
+    pl->shuffle = on;
+    pl->seed    = seed;
+    if (cur >= 0)
+        pl->pos = entry_to_order(pl, (uint32_t)cur);
+}
+
+bool playlist_get_shuffle(const playlist_t *pl)
+{
+    return pl->shuffle;
+}
+
+void playlist_set_repeat(playlist_t *pl, playlist_repeat_t mode)
+{
+    if (mode < _PLAYLIST_REPEAT_NUM)
+        pl->repeat = mode;
+}
+
+playlist_repeat_t playlist_get_repeat(const playlist_t *pl)
+{
+    return pl->repeat;
+}
+
+// =============================================================
+// M3U / M3U8
+// =============================================================
+
+/**
+ * @brief 解析一行，返回要加入的路径 (可能写入 buf)，注释和不支持的行返回 NULL
+ */
+static const char *m3u_line(char *s, const char *dir, size_t dir_len, char *buf, queue_state_t *state)
+{
+    // 去掉首尾空白 (包括 Windows 换行的 '\r')
+    while (*s == ' ' || *s == '\t')
+        s++;
+    size_t len = strlen(s);
+    while (len > 0 && (s[len - 1] == '\r' || s[len - 1] == ' ' || s[len - 1] == '\t'))
+        s[--len] = '\0';
+    if (len == 0)
+        return NULL;
+
+    if (s[0] == '#')
+    {
+        if (state && strncmp(s, QUEUE_TAG, strlen(QUEUE_TAG)) == 0)
+        {
+            state->valid = sscanf(s + strlen(QUEUE_TAG), "pos=%u,shuffle=%d,seed=%u,repeat=%d,follow=%d", &state->pos,
+                                  &state->shuffle, &state->seed, &state->repeat, &state->follow) == 5;
+        }
+        return NULL;
+    }
+
+    if (strncmp(s, "file://", 7) == 0)
+        s += 7;
+    else if (strstr(s, "://"))
+        return NULL; // 网络流
+
+    if (s[0] == '/')
+        return s;
+
+    // 相对路径: 拼上列表所在目录，Windows 风格的分隔符换成 '/'
+    len = strlen(s);
+    if (dir_len + 1 + len + 1 > PLAYLIST_PATH_MAX)
+        return NULL;
+    memcpy(buf, dir, dir_len);
+    buf[dir_len] = '/';
+    for (size_t i = 0; i <= len; i++)
+        buf[dir_len + 1 + i] = s[i] == '\\' ? '/' : s[i];
+    return buf;
+}
+
+/**
+ * @brief 整个文件读进内存后逐行解析 (一次 read，没有逐行的 IO)
+ */
+static int load_m3u(playlist_t *pl, const char *path, queue_state_t *state)
+{
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL)
+        return -1;
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    rewind(fp);
+    if (size < 0)
+    {
+        fclose(fp);
+        return -1;
+    }
+
+    char *text = mem_tag_alloc(MEM_TAG_INDEX, (size_t)size + 1);
+    if (text == NULL || fread(text, 1, (size_t)size, fp) != (size_t)size)
+    {
+        mem_tag_free(text);
+        fclose(fp);
+        return -1;
+    }
+    fclose(fp);
+    text[size] = '\0';
+
+    const char *slash = strrchr(path, '/');
+    const char *dir   = slash ? path : ".";
+    size_t dir_len    = slash ? (size_t)(slash - path) : 1;
+    char buf[PLAYLIST_PATH_MAX];
+
+    char *s = text;
+    if ((uint8_t)s[0] == 0xEF && (uint8_t)s[1] == 0xBB && (uint8_t)s[2] == 0xBF)
+        s += 3; // UTF-8 BOM
+
+    int added = 0;
+    char *end = text + size;
+    while (s < end)
+    {
+        char *nl = memchr(s, '\n', (size_t)(end - s));
+        if (nl)
+            *nl = '\0';
+        const char *entry = m3u_line(s, dir, dir_len, buf, state);
+        if (entry && playlist_add(pl, entry) >= 0)
+            added++;
+        if (nl == NULL)
+            break;
+        s = nl + 1;
+    }
+
+    mem_tag_free(text);
+    return added;
+}
+
+static int save_m3u(const playlist_t *pl, const char *path, const queue_state_t *state)
+{
+    char tmp[PLAYLIST_PATH_MAX + 8];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE *fp = fopen(tmp, "wb");
+    if (fp == NULL)
+        return -1;
+    setvbuf(fp, NULL, _IOFBF, SAVE_BUF_SIZE);
+
+    fputs("#EXTM3U\n", fp);
+    if (state)
+    {
+        fprintf(fp, QUEUE_TAG "pos=%u,shuffle=%d,seed=%u,repeat=%d,follow=%d\n", state->pos, state->shuffle,
+                state->seed, state->repeat, state->follow);
+    }
+    for (uint32_t i = 0; i < pl->count; i++)
+    {
+        fputs(&pl->pool[pl->ofs[i]], fp);
+        fputc('\n', fp);
+    }
+
+    bool ok = fflush(fp) == 0 && fsync(fileno(fp)) == 0;
+    ok      = fclose(fp) == 0 && ok;
+    if (!ok || rename(tmp, path) != 0)
+    {
+        unlink(tmp);
+        return -1;
+    }
+    return 0;
+}
+
+int playlist_load_m3u(playlist_t *pl, const char *path)
+{
+    return load_m3u(pl, path, NULL);
+}
+
+int playlist_save_m3u(const playlist_t *pl, const char *path)
+{
+    return save_m3u(pl, path, NULL);
+}
+
+int playlist_save_queue(const playlist_t *pl, const char *path, bool follow_dir)
+{
+    queue_state_t state = {
+        .valid   = true,
+        .pos     = pl->pos,
+        .shuffle = pl->shuffle,
+        .seed    = pl->seed,
+        .repeat  = pl->repeat,
+        .follow  = follow_dir,
+    };
+    return save_m3u(pl, path, &state);
+}
+
+int playlist_load_queue(playlist_t *pl, const char *path, bool *follow_dir)
+{
+    queue_state_t state = {0};
+    playlist_clear(pl);
+    pl->pos = 0;
+    if (load_m3u(pl, path, &state) < 0)
+        return -1;
+
+    *follow_dir = false;
+    if (state.valid)
+    {
+        pl->shuffle = state.shuffle != 0;
+        pl->seed    = state.seed;
+        pl->pos     = state.pos;
+        playlist_set_repeat(pl, (playlist_repeat_t)state.repeat);
+        *follow_dir = state.follow != 0;
+    }
+    else
+    {
+        playlist_jump(pl, 0); // 普通列表从第一首开始，播放模式不变
+    }
+    return (int)pl->count;
+}
@@ -0,0 +1,299 @@
+#include "spectrum.h"
+#include "mem_tag.h"
+#include <math.h>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define SPECTRUM_USE_NEON 1
+#include <arm_neon.h>
+#else
+#define SPECTRUM_USE_NEON 0
+#endif
+
+/*
+ * N 点实数 FFT 用 N/2 点复数 FFT 实现: 偶数样本作实部、奇数样本作虚部，
+ * 做完复数 FFT 后再拆分出实数序列的频谱。复数 FFT 是基 2 时间抽取，
+ * 输入在加窗时直接按位反转顺序写入，实部和虚部分开存放，方便 NEON 一次处理 4 (浮点) / 8 (定点) 个蝶形。
+ */
+
+#define M         (SPECTRUM_FFT_SIZE / 2) // 复数 FFT 长度
+#define F_LOW     50.0f
+#define F_HIGH    16000.0f
+#define FALL_STEP 0.04f // 每次更新最多回落的高度 (满高为 1)，30fps 下约 0.8 秒落到底
+
+#if SPECTRUM_FIXED_POINT
+typedef int16_t sample_t;
+#else
+typedef float sample_t;
+#endif
+
+struct spectrum
+{
+    uint32_t bars;
+    uint16_t band_lo[SPECTRUM_MAX_BARS + 1]; // 第 b 个频段为 [band_lo[b], band_lo[b + 1]) 的频点
+    float level[SPECTRUM_MAX_BARS];          // 当前显示高度 0~1
+    uint16_t bitrev[M];
+    // 第 h 级 (半长 h = 1, 2, 4 ...) 的旋转因子从 tw[h - 1] 开始连续存放: exp(-i * pi * j / h)
+    sample_t tw_re[M];
+    sample_t tw_im[M];
+    sample_t window[SPECTRUM_FFT_SIZE];
+    sample_t re[M];
+    sample_t im[M];
+    float split_re[M]; // 拆分实数频谱用的 exp(-2 * pi * i * k / N)
+    float split_im[M];
+    float db[SPECTRUM_BINS];
+};
+
+#if SPECTRUM_FIXED_POINT
+#define Q15_ONE 32767
+#define Q14_ONE 16384 // 输入用 Q14，加上一级蝶形的增益仍不会溢出 int16
+
+/**
+ * @brief Q15 乘法，舍入方式与 NEON 的 vqrdmulh 一致 (两种实现结果逐位相同)
+ */
+static inline int16_t mul_q15(int16_t a, int16_t b)
+{
+    return (int16_t)(((int32_t)a * b + (1 << 14)) >> 15);
+}
+
+static int16_t to_sample(float v)
+{
+    return (int16_t)lrintf(v * Q15_ONE);
+}
+
+/**
+ * @brief 复数 FFT 各级蝶形，每级结果除以 2，总增益 1/M
+ */
+static void fft_stages(spectrum_t *s)
+{
+    int16_t *re = s->re;
+    int16_t *im = s->im;
+    for (uint32_t h = 1; h < M; h <<= 1)
+    {
+        const int16_t *wr = &s->tw_re[h - 1];
+        const int16_t *wi = &s->tw_im[h - 1];
+        for (uint32_t i = 0; i < M; i += 2 * h)
+        {
+            uint32_t j = 0;
+#if SPECTRUM_USE_NEON
+            for (; j + 8 <= h; j += 8)
+            {
+                int16x8_t ar = vld1q_s16(&re[i + j]);
+                int16x8_t ai = vld1q_s16(&im[i + j]);
+                int16x8_t xr = vld1q_s16(&re[i + j + h]);
+                int16x8_t xi = vld1q_s16(&im[i + j + h]);
+                int16x8_t cr = vld1q_s16(&wr[j]);
+                int16x8_t ci = vld1q_s16(&wi[j]);
+                int16x8_t br = vsubq_s16(vqrdmulhq_s16(xr, cr), vqrdmulhq_s16(xi, ci));
+                int16x8_t bi = vaddq_s16(vqrdmulhq_s16(xr, ci), vqrdmulhq_s16(xi, cr));
+                vst1q_s16(&re[i + j], vhaddq_s16(ar, br));
+                vst1q_s16(&im[i + j], vhaddq_s16(ai, bi));
+                vst1q_s16(&re[i + j + h], vhsubq_s16(ar, br));
+                vst1q_s16(&im[i + j + h], vhsubq_s16(ai, bi));
+            }
+#endif
+            for (; j < h; j++)
+            {
+                int32_t ar    = re[i + j];
+                int32_t ai    = im[i + j];
+                int16_t xr    = re[i + j + h];
+                int16_t xi    = im[i + j + h];
+                int32_t br    = (int16_t)(mul_q15(xr, wr[j]) - mul_q15(xi, wi[j]));
+                int32_t bi    = (int16_t)(mul_q15(xr, wi[j]) + mul_q15(xi, wr[j]));
+                re[i + j]     = (int16_t)((ar + br) >> 1);
+                im[i + j]     = (int16_t)((ai + bi) >> 1);
+                re[i + j + h] = (int16_t)((ar - br) >> 1);
+                im[i + j + h] = (int16_t)((ai - bi) >> 1);
+            }
+        }
+    }
+}
+
+static void load_input(spectrum_t *s, const float *samples)
+{
+    for (uint32_t n = 0; n < M; n++)
+    {
+        float e = samples[2 * n];
+        float o = samples[2 * n + 1];
+        e       = e > 1.0f ? 1.0f : (e < -1.0f ? -1.0f : e);
+        o       = o > 1.0f ? 1.0f : (o < -1.0f ? -1.0f : o);
+        // 窗函数 Q15 乘 Q14 样本，结果仍是 Q14
+        uint16_t r = s->bitrev[n];
+        s->re[r]   = mul_q15((int16_t)lrintf(e * Q14_ONE), s->window[2 * n]);
+        s->im[r]   = mul_q15((int16_t)lrintf(o * Q14_ONE), s->window[2 * n + 1]);
+    }
+}
+
+// 定点结果换回浮点: 输入放大了 Q14_ONE 倍，蝶形缩小了 M 倍
+#define OUT_SCALE ((float)M / Q14_ONE)
+#define SAMPLE(v) ((float)(v) * OUT_SCALE)
+
+#else
+
+static float to_sample(float v)
+{
+    return v;
+}
+
+static void fft_stages(spectrum_t *s)
+{
+    float *re = s->re;
+    float *im = s->im;
+    for (uint32_t h = 1; h < M; h <<= 1)
+    {
+        const float *wr = &s->tw_re[h - 1];
+        const float *wi = &s->tw_im[h - 1];
+        for (uint32_t i = 0; i < M; i += 2 * h)
+        {
+            uint32_t j = 0;
+#if SPECTRUM_USE_NEON
+            for (; j + 4 <= h; j += 4)
+            {
+                float32x4_t ar = vld1q_f32(&re[i + j]);
+                float32x4_t ai = vld1q_f32(&im[i + j]);
+                float32x4_t xr = vld1q_f32(&re[i + j + h]);
+                float32x4_t xi = vld1q_f32(&im[i + j + h]);
+                float32x4_t cr = vld1q_f32(&wr[j]);
+                float32x4_t ci = vld1q_f32(&wi[j]);
+                float32x4_t br = vmlsq_f32(vmulq_f32(xr, cr), xi, ci);
+                float32x4_t bi = vmlaq_f32(vmulq_f32(xr, ci), xi, cr);
+                vst1q_f32(&re[i + j], vaddq_f32(ar, br));
+                vst1q_f32(&im[i + j], vaddq_f32(ai, bi));
+                vst1q_f32(&re[i + j + h], vsubq_f32(ar, br));
+                vst1q_f32(&im[i + j + h], vsubq_f32(ai, bi));
+            }
+#endif
+            for (; j < h; j++)
+            {
+                float ar      = re[i + j];
+                float ai      = im[i + j];
+                float xr      = re[i + j + h];
+                float xi      = im[i + j + h];
+                float br      = xr * wr[j] - xi * wi[j];
+                float bi      = xr * wi[j] + xi * wr[j];
+                re[i + j]     = ar + br;
+                im[i + j]     = ai + bi;
+                re[i + j + h] = ar - br;
+                im[i + j + h] = ai - bi;
+            }
+        }
+    }
+}
+
+static void load_input(spectrum_t *s, const float *samples)
+{
+    for (uint32_t n = 0; n < M; n++)
+    {
+        uint16_t r = s->bitrev[n];
+        s->re[r]   = samples[2 * n] * s->window[2 * n];
+        s->im[r]   = samples[2 * n + 1] * s->window[2 * n + 1];
+    }
+}
+
+#define SAMPLE(v) (v)
+
+#endif
+
+spectrum_t *spectrum_create(uint32_t sample_rate, uint32_t bars)
+{
+    if (bars == 0 || bars > SPECTRUM_MAX_BARS || sample_rate == 0)
+        return NULL;
+    spectrum_t *s = mem_tag_calloc(MEM_TAG_AUDIO, 1, sizeof(spectrum_t));
+    if (s == NULL)
+        return NULL;
+    s->bars = bars;
+
+    uint32_t bits = 0;
+    while ((1u << bits) < M)
+        bits++;
+    for (uint32_t n = 0; n < M; n++)
+    {
+        uint32_t r = 0;
+        for (uint32_t b = 0; b < bits; b++)
+            r |= ((n >> b) & 1) << (bits - 1 - b);
+        s->bitrev[n] = (uint16_t)r;
+    }
+
+    for (uint32_t h = 1; h < M; h <<= 1)
+    {
+        for (uint32_t j = 0; j < h; j++)
+        {
+            double a            = -M_PI * j / h;
+            s->tw_re[h - 1 + j] = to_sample((float)cos(a));
+            s->tw_im[h - 1 + j] = to_sample((float)sin(a));
+        }
+    }
+    for (uint32_t n = 0; n < SPECTRUM_FFT_SIZE; n++)
+        s->window[n] = to_sample((float)(0.5 - 0.5 * cos(2 * M_PI * n / SPECTRUM_FFT_SIZE)));
+    for (uint32_t k = 0; k < M; k++)
+    {
+        s->split_re[k] = (float)cos(2 * M_PI * k / SPECTRUM_FFT_SIZE);
+        s->split_im[k] = (float)-sin(2 * M_PI * k / SPECTRUM_FFT_SIZE);
+    }
+
+    // 对数频段，每段至少一个频点 (低频段比频点窄时向后顺延)
+    float f_high = F_HIGH < sample_rate / 2.0f ? F_HIGH : sample_rate / 2.0f;
+    for (uint32_t b = 0; b <= bars; b++)
+    {
+        float f      = F_LOW * powf(f_high / F_LOW, (float)b / bars);
+        uint32_t bin = (uint32_t)lrintf(f * SPECTRUM_FFT_SIZE / sample_rate);
+        if (b > 0 && bin <= s->band_lo[b - 1])
+            bin = s->band_lo[b - 1] + 1;
+        s->band_lo[b] = (uint16_t)(bin < SPECTRUM_BINS ? bin : SPECTRUM_BINS);
+    }
+    return s;
+}
+
+void spectrum_destroy(spectrum_t *s)
+{
+    mem_tag_free(s);
+}
+
+void spectrum_analyze(spectrum_t *s, const float *samples, float *db)
+{
+    load_input(s, samples);
+    fft_stages(s);
+
+    // 拆分: X[k] = E[k] + W^k * O[k]
+    // E = (Z[k] + conj(Z[M-k])) / 2, O = (Z[k] - conj(Z[M-k])) / 2i
+    // 满幅正弦加 Hann 窗后峰值为 N/4，以它为 0dB
+    const float ref = 1.0f / ((float)SPECTRUM_FFT_SIZE / 4 * SPECTRUM_FFT_SIZE / 4);
+    for (uint32_t k = 0; k < M; k++)
+    {
+        uint32_t m = (M - k) & (M - 1);
+        float ar   = SAMPLE(s->re[k]);
+        float ai   = SAMPLE(s->im[k]);
+        float br   = SAMPLE(s->re[m]);
+        float bi   = -SAMPLE(s->im[m]);
+        float er   = (ar + br) * 0.5f;
+        float ei   = (ai + bi) * 0.5f;
+        float or_  = (ai - bi) * 0.5f;
+        float oi   = -(ar - br) * 0.5f;
+        float xr   = er + s->split_re[k] * or_ - s->split_im[k] * oi;
+        float xi   = ei + s->split_re[k] * oi + s->split_im[k] * or_;
+        float pow  = (xr * xr + xi * xi) * ref;
+        db[k]      = pow > 1e-12f ? 10.0f * log10f(pow) : -120.0f;
+    }
+}
+
+void spectrum_update(spectrum_t *s, const float *samples, uint8_t *levels)
+{
+    if (samples)
+        spectrum_analyze(s, samples, s->db);
+
+    for (uint32_t b = 0; b < s->bars; b++)
+    {
+        float target = 0;
+        if (samples)
+        {
+            float peak = -120.0f;
+            for (uint32_t k = s->band_lo[b]; k < s->band_lo[b + 1]; k++)
+                peak = s->db[k] > peak ? s->db[k] : peak;
+            target = (peak + SPECTRUM_FLOOR_DB) / SPECTRUM_FLOOR_DB;
+            target = target < 0 ? 0 : (target > 1 ? 1 : target);
+        }
+
+        float level = s->level[b] - FALL_STEP;
+        s->level[b] = target > level ? target : (level > 0 ? level : 0);
+        levels[b]   = (uint8_t)lrintf(s->level[b] * 255);
+    }
+}
@@ -8,13 +8,41 @@
 #include "app_image.h"
 #include "app_text.h"
 #include "app_music.h"
+#include "audio_eq.h"
+#include "audio_out.h"
+#include "bg_worker.h"
+#include "img_meta.h"
+#include "img_thumb.h"
+#include "mem_budget.h"
+#include "mem_tag.h"
+#include "music_cover.h"
+#include "music_lib.h"
+#include "music_loudness.h"
+#include "music_track.h"
+
+// 主循环最长睡眠时间 (lv_timer_handler 没有就绪的定时器时返回 LV_NO_TIMER_READY)
+#define MAIN_LOOP_MAX_SLEEP_MS 100
 
 static volatile sig_atomic_t keep_running = 1;
-void int_handler(int dummy) { keep_running = 0; }
+static volatile sig_atomic_t dump_memory  = 0;
+void int_handler(int dummy) { (void)dummy; keep_running = 0; }
+void usr1_handler(int dummy) { (void)dummy; dump_memory = 1; } // kill -USR1 打印内存占用和音频输出统计
+
+/**
+ * @brief SJPG 的分片交给后台线程解码 (高优先级: 屏幕正在等这些分片)
+ * 内存紧张时不预取，分片等到绘制时再解码
+ */
+static lv_res_t sjpg_post(lv_split_jpeg_job_cb_t job_cb, lv_split_jpeg_job_cb_t drop_cb, void *job)
+{
+    if (mem_budget_pressure() != MEM_PRESSURE_NONE)
+        return LV_RES_INV;
+    return bg_worker_submit(BG_PRIO_HIGH, job_cb, drop_cb, job) == 0 ? LV_RES_OK : LV_RES_INV;
+}
 
 int main(void)
 {
     signal(SIGINT, int_handler);
+    signal(SIGUSR1, usr1_handler);
 
     // LVGL 核心初始化
     lv_init();
@@ -22,6 +50,15 @@ int main(void)
     lv_port_disp_init();  // 初始化显示驱动
     lv_port_indev_init(); // 初始化输入按键
 
+    // 后台线程池 (缩略图生成等耗时任务)
+    bg_worker_init(BG_WORKER_THREADS);
+    lv_split_jpeg_set_worker(sjpg_post);
+
+    // 内存预算: 系统内存紧张时按顺序释放各模块的缓存 (SJPG 分片 -> 解码的整图 -> 字形)
+    mem_budget_init();
+    mem_budget_register("sjpg", MEM_PRIO_PREFETCH, lv_split_jpeg_cache_usage, lv_split_jpeg_cache_trim);
+    mem_budget_register("freetype", MEM_PRIO_CORE, lv_freetype_cache_usage, lv_freetype_cache_trim);
+
     // 创建一个全局 Group (用于按键导航)
     lv_group_t *g = lv_group_create();
 
@@ -53,13 +90,37 @@ int main(void)
 
     while (keep_running)
     {
+        // 睡到下一个定时器到期 (GIF 帧间隔、按键轮询等)，空闲时不再每 5ms 空转一次
+        // 后台线程投递结果时提前醒来，在这里执行 UI 回调
         uint32_t time_until_next = lv_timer_handler();
-        if (time_until_next > 5)
-            time_until_next = 5;
-        usleep(time_until_next * 1000);
+        if (time_until_next > MAIN_LOOP_MAX_SLEEP_MS)
+            time_until_next = MAIN_LOOP_MAX_SLEEP_MS;
+        bg_worker_wait_ui(time_until_next);
+
+        if (dump_memory)
+        {
+            dump_memory = 0;
+            mem_budget_report();
+            mem_tag_report();
+            audio_out_report();
+            music_decoder_report();
+            audio_eq_report();
+            music_loudness_report();
+        }
     }
 
+    mem_budget_deinit();
+    bg_worker_deinit();
+    music_loudness_close();
+    img_thumb_close();
+    img_meta_close();
+    music_lib_close();
+    music_cover_close();
     lv_port_disp_deinit();
 
+    // LVGL 的控件和样式不会逐个释放，lvgl 一栏的剩余是正常的
+    mem_tag_report();
+    mem_tag_leak_report();
+
     return 0;
 }
\ No newline at end of file
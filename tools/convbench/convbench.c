@@ -0,0 +1,255 @@
+/*
+ * convbench: 检查 lv_color_conv 的 SIMD 内核 (NEON / SSE2) 与标量参考实现逐位一致，并对比两者的速度 (make bench)
+ *
+ * 用法: convbench [-n 次数] [-p 像素数]
+ *   先用随机数据对每个转换函数、每种标志组合、0~67 的各种长度和不对齐的地址做比较 (含原地转换)，
+ *   有不一致时打印第一个不同的字节并返回 1; 全部一致再测速度，默认 480x272 的一帧转换 200 次
+ */
+#include "lvgl.h"
+#include "lv_color_conv.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define DEFAULT_ROUNDS 200
+#define DEFAULT_PIXELS (480 * 272)
+#define CHECK_LEN_MAX  67 // 覆盖 NEON 16 像素 / SSE2 8 像素一组之外的各种尾巴
+#define CHECK_OFFSETS  4  // 源和目标地址各错开 0~3 字节
+
+// 被测的转换
+typedef enum
+{
+    CONV_RGBA_565,
+    CONV_RGBA_565_ALPHA,
+    CONV_RGBA_565A8,
+    CONV_RGB_565,
+    CONV_LERP,
+    _CONV_NUM
+} conv_kind_t;
+
+static const char *conv_names[_CONV_NUM] = {"rgba8888->rgb565", "rgba8888->rgb565+a", "rgba8888->rgb565a8", "rgb888->rgb565", "rgb565 lerp"};
+
+// 每种转换的目标像素字节数 (rgb565a8 的 alpha 平面另算)
+static const uint8_t dst_bpp[_CONV_NUM] = {2, 3, 2, 2, 2};
+
+static uint32_t rng_state = 0x12345678;
+
+static uint32_t rng(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static uint64_t now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/*
+ * 随机数据里混进全透明、全不透明和 0/255 的通道值，让预乘和 alpha 汇总的边界情况都出现
+ */
+static void fill_random(uint8_t *buf, uint32_t size)
+{
+    for (uint32_t i = 0; i < size; i++)
+    {
+        uint32_t r = rng();
+        switch (r & 7)
+        {
+            case 0: buf[i] = 0; break;
+            case 1: buf[i] = 0xFF; break;
+            default: buf[i] = (uint8_t)(r >> 8); break;
+        }
+    }
+}
+
+/**
+ * @brief 执行一次转换
+ * @param dst   目标 (CONV_RGBA_565A8 时是颜色平面)
+ * @param alpha CONV_RGBA_565A8 的 alpha 平面
+ * @param src   源 (CONV_LERP 时是 from)
+ * @param src2  CONV_LERP 的 to
+ * @return rgba 转换返回的 alpha 汇总, 其余为 0
+ */
+static uint8_t run_conv(conv_kind_t kind, uint8_t *dst, uint8_t *alpha, const uint8_t *src, const uint8_t *src2, uint32_t px, uint32_t flags, uint16_t mix)
+{
+    switch (kind)
+    {
+        case CONV_RGBA_565: return lv_color_conv_rgba8888_to_rgb565(dst, src, px, flags);
+        case CONV_RGBA_565_ALPHA: return lv_color_conv_rgba8888_to_rgb565_alpha(dst, src, px, flags);
+        case CONV_RGBA_565A8: return lv_color_conv_rgba8888_to_rgb565a8(dst, alpha, src, px, flags);
+        case CONV_RGB_565: lv_color_conv_rgb888_to_rgb565(dst, src, px, flags); return 0;
+        case CONV_LERP: lv_color_conv_rgb565_lerp(dst, src, src2, px, mix, flags); return 0;
+        default: return 0;
+    }
+}
+
+static int report_diff(conv_kind_t kind, const char *what, uint32_t px, uint32_t flags, const uint8_t *a, const uint8_t *b, uint32_t size)
+{
+    for (uint32_t i = 0; i < size; i++)
+    {
+        if (a[i] != b[i])
+        {
+            printf("MISMATCH %s %s: px %u flags 0x%x byte %u: simd %02x scalar %02x\n", conv_names[kind], what, px, flags, i, a[i], b[i]);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief 对一种转换比较 SIMD 与标量的输出
+ * @return 不一致的情况数
+ */
+static int check_kind(conv_kind_t kind)
+{
+    const uint32_t max_flags = (kind == CONV_LERP) ? LV_COLOR_CONV_SWAP : (LV_COLOR_CONV_BGR | LV_COLOR_CONV_SWAP | LV_COLOR_CONV_PREMULT);
+    const uint32_t src_max   = CHECK_LEN_MAX * 4 + CHECK_OFFSETS;
+    uint8_t *src             = malloc(src_max);
+    uint8_t *src2            = malloc(src_max);
+    uint8_t *ref             = malloc(src_max);
+    uint8_t *out             = malloc(src_max);
+    uint8_t *ref_a           = malloc(src_max);
+    uint8_t *out_a           = malloc(src_max);
+    int bad                  = 0;
+
+    for (uint32_t flags = 0; flags <= max_flags; flags++)
+    {
+        if (kind == CONV_LERP && flags != 0 && flags != LV_COLOR_CONV_SWAP)
+            continue;
+        for (uint32_t px = 0; px <= CHECK_LEN_MAX; px++)
+        {
+            uint32_t so      = rng() % CHECK_OFFSETS, doff = rng() % CHECK_OFFSETS;
+            uint32_t dsize   = px * dst_bpp[kind];
+            uint16_t mix     = (uint16_t)(rng() % 257);
+            uint8_t ref_and  = 0, out_and = 0;
+            fill_random(src, src_max);
+            fill_random(src2, src_max);
+
+            // 目标先填成相同的内容，超出 dsize 的部分被写到也能发现
+            memset(ref, 0xA5, src_max);
+            memset(out, 0xA5, src_max);
+            memset(ref_a, 0x5A, src_max);
+            memset(out_a, 0x5A, src_max);
+
+            lv_color_conv_set_simd(false);
+            ref_and = run_conv(kind, ref + doff, ref_a + doff, src + so, src2 + so, px, flags, mix);
+            lv_color_conv_set_simd(true);
+            out_and = run_conv(kind, out + doff, out_a + doff, src + so, src2 + so, px, flags, mix);
+
+            bad += report_diff(kind, "output", px, flags, out, ref, src_max);
+            if (kind == CONV_RGBA_565A8)
+                bad += report_diff(kind, "alpha plane", px, flags, out_a, ref_a, src_max);
+            if (ref_and != out_and)
+            {
+                printf("MISMATCH %s alpha and: px %u flags 0x%x: simd %02x scalar %02x\n", conv_names[kind], px, flags, out_and, ref_and);
+                bad++;
+            }
+
+            // 原地转换 (rgb565a8 的平面不能与源重叠，跳过)
+            if (kind == CONV_RGBA_565A8)
+                continue;
+            memcpy(out, src, src_max);
+            out_and = run_conv(kind, out + so, NULL, out + so, src2 + so, px, flags, mix);
+            bad += report_diff(kind, "in place", px, flags, out + so, ref + doff, dsize);
+            if (kind != CONV_LERP && kind != CONV_RGB_565 && ref_and != out_and)
+            {
+                printf("MISMATCH %s in place alpha and: px %u flags 0x%x\n", conv_names[kind], px, flags);
+                bad++;
+            }
+        }
+    }
+
+    free(src);
+    free(src2);
+    free(ref);
+    free(out);
+    free(ref_a);
+    free(out_a);
+    return bad;
+}
+
+/**
+ * @brief 转换 rounds 次 px 个像素
+ * @return 平均每次的微秒数
+ */
+static uint64_t bench_kind(conv_kind_t kind, bool simd, uint32_t px, int rounds, uint8_t *src, uint8_t *src2, uint8_t *dst, uint8_t *alpha)
+{
+    lv_color_conv_set_simd(simd);
+    uint64_t t0 = now_us();
+    for (int i = 0; i < rounds; i++)
+        run_conv(kind, dst, alpha, src, src2, px, LV_COLOR_CONV_NATIVE, (uint16_t)(i & 0xFF));
+    uint64_t cost = (now_us() - t0) / rounds;
+    lv_color_conv_set_simd(true);
+    return cost ? cost : 1;
+}
+
+int main(int argc, char *argv[])
+{
+    int rounds = DEFAULT_ROUNDS;
+    long px    = DEFAULT_PIXELS;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:p:")) != -1)
+    {
+        if (opt == 'n' && atoi(optarg) > 0)
+            rounds = atoi(optarg);
+        else if (opt == 'p' && atol(optarg) > 0)
+            px = atol(optarg);
+        else
+        {
+            fprintf(stderr, "usage: %s [-n rounds] [-p pixels]\n", argv[0]);
+            return 1;
+        }
+    }
+
+#if LV_COLOR_CONV_USE_NEON
+    const char *simd_name = "neon";
+#elif LV_COLOR_CONV_USE_SSE2
+    const char *simd_name = "sse2";
+#else
+    const char *simd_name = "none";
+#endif
+    printf("simd kernels: %s\n", simd_name);
+
+    int bad = 0;
+    for (int k = 0; k < _CONV_NUM; k++)
+    {
+        int n = check_kind((conv_kind_t)k);
+        printf("%-20s bit-exact: %s\n", conv_names[k], n ? "FAIL" : "ok");
+        bad += n;
+    }
+    if (bad)
+        return 1;
+
+    uint8_t *src   = malloc((size_t)px * 4);
+    uint8_t *src2  = malloc((size_t)px * 4);
+    uint8_t *dst   = malloc((size_t)px * 4);
+    uint8_t *alpha = malloc((size_t)px);
+    if (!src || !src2 || !dst || !alpha)
+    {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    fill_random(src, (uint32_t)px * 4);
+    fill_random(src2, (uint32_t)px * 4);
+
+    printf("\n%-20s %9s %9s %9s %7s\n", "conversion", "pixels", "scalar us", "simd us", "speedup");
+    for (int k = 0; k < _CONV_NUM; k++)
+    {
+        uint64_t scalar_us = bench_kind((conv_kind_t)k, false, (uint32_t)px, rounds, src, src2, dst, alpha);
+        uint64_t simd_us   = bench_kind((conv_kind_t)k, true, (uint32_t)px, rounds, src, src2, dst, alpha);
+        printf("%-20s %9ld %9llu %9llu %6.2fx\n", conv_names[k], px, (unsigned long long)scalar_us, (unsigned long long)simd_us,
+               (double)scalar_us / simd_us);
+    }
+
+    free(src);
+    free(src2);
+    free(dst);
+    free(alpha);
+    return 0;
+}
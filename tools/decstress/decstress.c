@@ -0,0 +1,191 @@
+/*
+ * decstress: 解码线程的压力测试，UI 线程长时间卡住时音乐不能断 (make bench)
+ *
+ * 用法: decstress [-d 临时目录] [-s 卡顿毫秒] [-c 占满 CPU 的线程数] [-n]
+ *   生成一首 10 秒的 WAV，通过 audio_out 正常播放，同时模拟最坏的情况:
+ *     - 主线程 (相当于 UI 线程解一张 1200 万像素的 PNG) 忙等 -s 毫秒，默认 2000
+ *     - -c 个线程 (默认 4) 一直占满 CPU
+ *     - fread 每读 512KB 卡 300ms (慢 SD 卡)
+ *   结束后检查解码线程的读空次数和音频回调的超时 / 断流次数，都为 0 返回 0
+ *   -n 不启动解码线程 (退回到在音频线程中解码)，用来对比
+ *   解码线程的参数照常从环境变量读取 (AUDIO_BUFFER_MS、AUDIO_DECODE_PRIO 等)
+ */
+#define _GNU_SOURCE
+#define MINIAUDIO_IMPLEMENTATION
+#include "miniaudio.h"
+#include "audio_out.h"
+#include "music_track.h"
+#include <dlfcn.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#define SAMPLE_RATE     48000
+#define CHANNELS        2
+#define TRACK_SECONDS   10
+#define SLOW_READ_CHUNK (512 * 1024) // 每读这么多字节
+#define SLOW_READ_US    300000       // 卡这么久
+#define PLAY_BEFORE_US  1000000      // 卡顿前先正常播放 1 秒 (让缓冲填满)
+#define PLAY_AFTER_US   5000000      // 卡顿后再播放 5 秒
+#define HOGS_MAX        16
+
+static size_t total_read;
+static volatile int hog_stop;
+
+/*
+ * 替换 libc 的 fread 模拟慢 SD 卡 (miniaudio 的默认 VFS 用 stdio 读文件)
+ */
+size_t fread(void *ptr, size_t size, size_t n, FILE *fp)
+{
+    static size_t (*real_fread)(void *, size_t, size_t, FILE *);
+    if (!real_fread)
+        real_fread = (size_t (*)(void *, size_t, size_t, FILE *))dlsym(RTLD_NEXT, "fread");
+
+    size_t before = __atomic_fetch_add(&total_read, size * n, __ATOMIC_RELAXED);
+    if (before / SLOW_READ_CHUNK != (before + size * n) / SLOW_READ_CHUNK)
+        usleep(SLOW_READ_US);
+    return real_fread(ptr, size, n, fp);
+}
+
+static void *hog_thread(void *arg)
+{
+    (void)arg;
+    volatile uint32_t x = 0;
+    while (!hog_stop)
+        x++;
+    return NULL;
+}
+
+static void busy_wait_ms(uint32_t ms)
+{
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    do
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+    while ((t1.tv_sec - t0.tv_sec) * 1000L + (t1.tv_nsec - t0.tv_nsec) / 1000000L < (long)ms);
+}
+
+static int write_tone(const char *path)
+{
+    ma_encoder_config cfg = ma_encoder_config_init(ma_encoding_format_wav, ma_format_s16, CHANNELS, SAMPLE_RATE);
+    ma_encoder enc;
+    if (ma_encoder_init_file(path, &cfg, &enc) != MA_SUCCESS)
+        return -1;
+    for (uint32_t i = 0; i < TRACK_SECONDS * SAMPLE_RATE; i++)
+    {
+        int16_t v = (int16_t)(8000 * sin(2.0 * M_PI * 440.0 * i / SAMPLE_RATE));
+        int16_t s[CHANNELS];
+        for (int c = 0; c < CHANNELS; c++)
+            s[c] = v;
+        ma_encoder_write_pcm_frames(&enc, s, 1, NULL);
+    }
+    ma_encoder_uninit(&enc);
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *dir    = "/tmp";
+    uint32_t stall_ms  = 2000;
+    int hogs           = 4;
+    bool decode_thread = true;
+    int opt;
+    while ((opt = getopt(argc, argv, "d:s:c:n")) != -1)
+    {
+        if (opt == 'd')
+            dir = optarg;
+        else if (opt == 's' && atoi(optarg) >= 0)
+            stall_ms = (uint32_t)atoi(optarg);
+        else if (opt == 'c' && atoi(optarg) >= 0 && atoi(optarg) <= HOGS_MAX)
+            hogs = atoi(optarg);
+        else if (opt == 'n')
+            decode_thread = false;
+        else
+        {
+            fprintf(stderr, "usage: %s [-d tmpdir] [-s stall_ms] [-c hog_threads] [-n]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    char path[512];
+    snprintf(path, sizeof(path), "%s/decstress.wav", dir);
+    if (write_tone(path) != 0)
+    {
+        fprintf(stderr, "cannot write %s\n", path);
+        return 1;
+    }
+
+    static ma_engine engine;
+    ma_allocation_callbacks alloc = {0}; // 全 0: miniaudio 的默认分配器
+    audio_out_config_t out_cfg = audio_out_config_default();
+    audio_out_config_from_env(&out_cfg);
+    if (audio_out_open(&out_cfg, &engine, &alloc) != 0)
+    {
+        fprintf(stderr, "cannot open audio output\n");
+        return 1;
+    }
+    if (decode_thread)
+    {
+        music_decoder_config_t dec_cfg = music_decoder_config_default();
+        music_decoder_config_from_env(&dec_cfg);
+        if (music_decoder_start(&dec_cfg) != 0)
+            fprintf(stderr, "decode thread not started, decoding in the audio thread\n");
+    }
+    ma_engine_config ecfg = ma_engine_config_init();
+    ecfg.pDevice          = audio_out_device();
+    if (ma_engine_init(&ecfg, &engine) != MA_SUCCESS)
+    {
+        fprintf(stderr, "engine init failed\n");
+        return 1;
+    }
+
+    music_chain_t chain;
+    music_chain_init(&chain, ma_engine_get_channels(&engine), ma_engine_get_sample_rate(&engine));
+    music_track_t *track = music_track_open(path, 1, chain.channels, chain.sample_rate, NULL);
+    if (!track)
+    {
+        fprintf(stderr, "cannot open %s\n", path);
+        return 1;
+    }
+    ma_data_source_set_next(&chain, music_track_ds(track));
+    ma_sound sound;
+    ma_sound_init_from_data_source(&engine, &chain, MA_SOUND_FLAG_NO_PITCH | MA_SOUND_FLAG_NO_SPATIALIZATION, NULL, &sound);
+    ma_sound_start(&sound);
+
+    pthread_t hog[HOGS_MAX];
+    for (int i = 0; i < hogs; i++)
+        pthread_create(&hog[i], NULL, hog_thread, NULL);
+
+    usleep(PLAY_BEFORE_US);
+    printf("blocking the UI thread for %u ms with %d busy threads\n", stall_ms, hogs);
+    busy_wait_ms(stall_ms);
+    usleep(PLAY_AFTER_US);
+
+    hog_stop = 1;
+    for (int i = 0; i < hogs; i++)
+        pthread_join(hog[i], NULL);
+
+    music_decoder_stats_t dec;
+    audio_out_stats_t out;
+    music_decoder_get_stats(&dec);
+    audio_out_get_stats(&out);
+    printf("played %.2f s\n", (double)music_track_cursor(track) / chain.sample_rate);
+    audio_out_report();
+    if (decode_thread)
+        music_decoder_report();
+
+    ma_sound_uninit(&sound);
+    music_track_close(track);
+    music_chain_uninit(&chain);
+    ma_engine_uninit(&engine);
+    audio_out_close();
+    music_decoder_stop();
+    remove(path);
+
+    bool ok = dec.underruns == 0 && out.late == 0 && out.stalls == 0 && out.xruns == 0;
+    printf("dropouts: %s\n", ok ? "none" : "FAIL");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,201 @@
+/*
+ * gaptest: 检查两首歌在播放链上无缝衔接 (make bench)
+ *
+ * 用法: gaptest [-d 临时目录] [-o 输出.wav]
+ *   生成两段相位连续的 440Hz 正弦波 WAV，像 app_music 一样挂在链头上，第一首播放途中才接上第二首，
+ *   用没有设备的引擎离线渲染，逐帧与原始正弦波比较: 衔接处多出或少了一帧、补了静音都会对不上
+ *   第二首带响度归一化的增益 GAIN_B，它必须正好从衔接处的那一帧开始生效
+ *   同时检查两首的开始回调和整条链的结束回调，全部通过返回 0，-o 把渲染结果写成 WAV 以便试听
+ */
+#define MINIAUDIO_IMPLEMENTATION
+#include "miniaudio.h"
+#include "music_track.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define SAMPLE_RATE 48000
+#define CHANNELS    2
+#define TONE_HZ     440.0
+#define AMPLITUDE   0.5
+#define FRAMES_A    (SAMPLE_RATE + 123) // 故意不是块大小的整数倍
+#define FRAMES_B    (SAMPLE_RATE / 2 + 77)
+#define TAIL_FRAMES (SAMPLE_RATE / 10) // 链结束后多渲染的静音
+#define CHUNK       480                // 每次渲染 10ms，与声卡周期相当
+#define LINK_AT     (SAMPLE_RATE / 2)  // 第一首播放到这里才接上第二首
+#define GAIN_B      0.5f
+#define TOLERANCE   1e-5f
+
+static uint32_t started[4];
+static int started_num;
+static volatile int chain_ended;
+
+static void on_track_start(uint32_t id, void *user_data)
+{
+    (void)user_data;
+    if (started_num < 4)
+        started[started_num] = id;
+    started_num++;
+}
+
+static void on_chain_end(void *user_data, ma_sound *sound)
+{
+    (void)user_data;
+    (void)sound;
+    chain_ended = 1;
+}
+
+static float tone(uint64_t frame)
+{
+    return (float)(AMPLITUDE * sin(2.0 * M_PI * TONE_HZ * (double)frame / SAMPLE_RATE));
+}
+
+/**
+ * @brief 写一段正弦波，first 是这一段在整条链上的起始帧 (保证两段相位连续)
+ */
+static int write_tone(const char *path, uint64_t first, uint64_t frames)
+{
+    ma_encoder_config cfg = ma_encoder_config_init(ma_encoding_format_wav, ma_format_f32, CHANNELS, SAMPLE_RATE);
+    ma_encoder enc;
+    if (ma_encoder_init_file(path, &cfg, &enc) != MA_SUCCESS)
+        return -1;
+    for (uint64_t i = 0; i < frames; i++)
+    {
+        float s[CHANNELS];
+        for (int c = 0; c < CHANNELS; c++)
+            s[c] = tone(first + i);
+        ma_encoder_write_pcm_frames(&enc, s, 1, NULL);
+    }
+    ma_encoder_uninit(&enc);
+    return 0;
+}
+
+/**
+ * @brief 逐帧比较渲染结果
+ * @return 第一处不一致的帧号，全部一致返回 -1
+ */
+static long check_output(const float *buf, long total)
+{
+    for (long i = 0; i < total; i++)
+    {
+        float want = (i < FRAMES_A) ? tone((uint64_t)i) : (i < FRAMES_A + FRAMES_B) ? tone((uint64_t)i) * GAIN_B : 0.0f;
+        for (int c = 0; c < CHANNELS; c++)
+        {
+            if (fabsf(buf[i * CHANNELS + c] - want) > TOLERANCE)
+                return i;
+        }
+    }
+    return -1;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *dir = "/tmp";
+    const char *out = NULL;
+    int opt;
+    while ((opt = getopt(argc, argv, "d:o:")) != -1)
+    {
+        if (opt == 'd')
+            dir = optarg;
+        else if (opt == 'o')
+            out = optarg;
+        else
+        {
+            fprintf(stderr, "usage: %s [-d tmpdir] [-o out.wav]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    char path_a[512], path_b[512];
+    snprintf(path_a, sizeof(path_a), "%s/gaptest_a.wav", dir);
+    snprintf(path_b, sizeof(path_b), "%s/gaptest_b.wav", dir);
+    if (write_tone(path_a, 0, FRAMES_A) || write_tone(path_b, FRAMES_A, FRAMES_B))
+    {
+        fprintf(stderr, "cannot write %s\n", path_a);
+        return 1;
+    }
+
+    ma_engine_config ecfg = ma_engine_config_init();
+    ecfg.noDevice         = MA_TRUE;
+    ecfg.channels         = CHANNELS;
+    ecfg.sampleRate       = SAMPLE_RATE;
+    ma_engine engine;
+    if (ma_engine_init(&ecfg, &engine) != MA_SUCCESS)
+    {
+        fprintf(stderr, "engine init failed\n");
+        return 1;
+    }
+
+    music_chain_t chain;
+    music_chain_init(&chain, CHANNELS, SAMPLE_RATE);
+    music_track_set_start_cb(on_track_start, NULL);
+    music_track_t *a = music_track_open(path_a, 1, CHANNELS, SAMPLE_RATE, NULL);
+    music_track_t *b = music_track_open(path_b, 2, CHANNELS, SAMPLE_RATE, NULL);
+    if (!a || !b)
+    {
+        fprintf(stderr, "cannot open test tracks\n");
+        return 1;
+    }
+    music_track_set_gain(b, GAIN_B);
+    ma_data_source_set_next(&chain, music_track_ds(a));
+
+    ma_sound sound;
+    ma_sound_init_from_data_source(&engine, &chain, MA_SOUND_FLAG_NO_SPATIALIZATION | MA_SOUND_FLAG_NO_PITCH, NULL, &sound);
+    ma_sound_set_end_callback(&sound, on_chain_end, NULL);
+    ma_sound_start(&sound);
+
+    long total = FRAMES_A + FRAMES_B + TAIL_FRAMES;
+    float *buf = calloc((size_t)total * CHANNELS, sizeof(float));
+    if (!buf)
+        return 1;
+    for (long pos = 0; pos < total; pos += CHUNK)
+    {
+        long n = (total - pos < CHUNK) ? total - pos : CHUNK;
+        ma_engine_read_pcm_frames(&engine, buf + pos * CHANNELS, (ma_uint64)n, NULL);
+        // 模拟 UI 线程: 第一首已经在播放时才预先打开并接上下一首
+        if (pos >= LINK_AT && ma_data_source_get_next(music_track_ds(a)) == NULL)
+            ma_data_source_set_next(music_track_ds(a), music_track_ds(b));
+    }
+
+    if (out)
+    {
+        ma_encoder_config cfg = ma_encoder_config_init(ma_encoding_format_wav, ma_format_f32, CHANNELS, SAMPLE_RATE);
+        ma_encoder enc;
+        if (ma_encoder_init_file(out, &cfg, &enc) == MA_SUCCESS)
+        {
+            ma_encoder_write_pcm_frames(&enc, buf, (ma_uint64)total, NULL);
+            ma_encoder_uninit(&enc);
+        }
+    }
+
+    long bad = check_output(buf, total);
+    int fail = 0;
+    printf("tracks: %d + %d frames, boundary at frame %d\n", FRAMES_A, FRAMES_B, FRAMES_A);
+    if (bad >= 0)
+    {
+        printf("output:       FAIL at frame %ld (%+ld from boundary)\n", bad, bad - FRAMES_A);
+        fail = 1;
+    }
+    else
+        printf("output:       ok (0 frames of gap)\n");
+    if (started_num != 2 || started[0] != 1 || started[1] != 2)
+    {
+        printf("start cb:     FAIL (%d calls)\n", started_num);
+        fail = 1;
+    }
+    else
+        printf("start cb:     ok\n");
+    printf("end cb:       %s\n", chain_ended ? "ok" : "FAIL");
+    fail |= !chain_ended;
+
+    ma_sound_uninit(&sound);
+    music_track_close(a);
+    music_track_close(b);
+    music_chain_uninit(&chain);
+    ma_engine_uninit(&engine);
+    free(buf);
+    remove(path_a);
+    remove(path_b);
+    return fail;
+}
@@ -0,0 +1,448 @@
+/*
+ * imgpack: 主机端工具，把 PNG/JPEG 预先转换成 RGB565 (有透明度时为 RGB565A8) 并打包成 .lvpk
+ *
+ * 板子上由 lv_imgpack 解码器 mmap 整个包，未压缩的图直接返回映射里的指针 (零拷贝、零分配)。
+ * 格式见 3rdparty/lvgl/src/extra/libs/imgpack/lv_imgpack_fmt.h
+ *
+ * 用法: imgpack [-z] [-t rows] -o out.lvpk a.png b.jpg ...
+ *   -z       按 tile 做 LZ4 压缩 (压缩后不变小的图仍然原样存放)
+ *   -t rows  每个 tile 的行数 (默认 16)
+ * 图在包里的名字是去掉目录和扩展名的文件名，例如 "S:res/ui.lvpk/icon_play"
+ */
+#include "../../3rdparty/lvgl/src/extra/libs/imgpack/lv_imgpack_fmt.h"
+#include <stdio.h> // jpeglib.h 需要先包含 stdio.h
+#include <jpeglib.h>
+#include <png.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define DEFAULT_TILE_ROWS 16
+#define HASH_BITS 14
+
+typedef struct
+{
+    lv_imgpack_entry_t e;
+    uint8_t *data; // 要写入的数据 (原始像素或压缩后的 tile)
+} image_t;
+
+// --- 解码 ---
+
+/**
+ * @brief PNG 解码为 RGBA8888
+ */
+static uint8_t *load_png(const char *path, uint32_t *w, uint32_t *h)
+{
+    png_image img;
+    memset(&img, 0, sizeof(img));
+    img.version = PNG_IMAGE_VERSION;
+    if (!png_image_begin_read_from_file(&img, path))
+        return NULL;
+
+    img.format   = PNG_FORMAT_RGBA;
+    uint8_t *buf = malloc(PNG_IMAGE_SIZE(img));
+    if (buf == NULL || !png_image_finish_read(&img, NULL, buf, 0, NULL))
+    {
+        fprintf(stderr, "%s: %s\n", path, img.message);
+        png_image_free(&img);
+        free(buf);
+        return NULL;
+    }
+    *w = img.width;
+    *h = img.height;
+    return buf;
+}
+
+/**
+ * @brief JPEG 解码为 RGBA8888 (alpha 全为 255)
+ */
+static uint8_t *load_jpeg(const char *path, uint32_t *w, uint32_t *h)
+{
+    FILE *f = fopen(path, "rb");
+    if (f == NULL)
+        return NULL;
+
+    struct jpeg_decompress_struct cinfo;
+    struct jpeg_error_mgr jerr;
+    cinfo.err = jpeg_std_error(&jerr); // 出错时 libjpeg 直接退出进程，对主机工具足够
+    jpeg_create_decompress(&cinfo);
+    jpeg_stdio_src(&cinfo, f);
+    jpeg_read_header(&cinfo, TRUE);
+    cinfo.out_color_space = JCS_EXT_RGBA;
+    jpeg_start_decompress(&cinfo);
+
+    *w           = cinfo.output_width;
+    *h           = cinfo.output_height;
+    uint8_t *buf = malloc((size_t)*w * *h * 4);
+    while (buf && cinfo.output_scanline < cinfo.output_height)
+    {
+        uint8_t *row = buf + (size_t)cinfo.output_scanline * *w * 4;
+        jpeg_read_scanlines(&cinfo, &row, 1);
+    }
+    if (buf)
+        jpeg_finish_decompress(&cinfo);
+    jpeg_destroy_decompress(&cinfo);
+    fclose(f);
+    return buf;
+}
+
+static uint8_t *load_image(const char *path, uint32_t *w, uint32_t *h)
+{
+    uint8_t magic[4] = {0};
+    FILE *f          = fopen(path, "rb");
+    if (f == NULL)
+    {
+        perror(path);
+        return NULL;
+    }
+    size_t n = fread(magic, 1, sizeof(magic), f);
+    fclose(f);
+
+    if (n == 4 && magic[0] == 0x89 && memcmp(magic + 1, "PNG", 3) == 0)
+        return load_png(path, w, h);
+    if (n >= 3 && magic[0] == 0xFF && magic[1] == 0xD8 && magic[2] == 0xFF)
+        return load_jpeg(path, w, h);
+
+    fprintf(stderr, "%s: unsupported format\n", path);
+    return NULL;
+}
+
+// --- LZ4 ---
+
+static void put_len(uint8_t **op, uint32_t len)
+{
+    for (; len >= 255; len -= 255)
+        *(*op)++ = 255;
+    *(*op)++ = (uint8_t)len;
+}
+
+/**
+ * @brief 写一个序列: 字面量 + 匹配 (match_len == 0 表示最后只有字面量的序列)
+ */
+static uint8_t *lz4_emit(uint8_t *op, const uint8_t *lit, uint32_t lit_len, uint32_t offset, uint32_t match_len)
+{
+    uint8_t *token = op++;
+    *token         = (uint8_t)((lit_len >= 15 ? 15 : lit_len) << 4);
+    if (lit_len >= 15)
+        put_len(&op, lit_len - 15);
+    memcpy(op, lit, lit_len);
+    op += lit_len;
+
+    if (match_len)
+    {
+        *op++ = offset & 0xFF;
+        *op++ = offset >> 8;
+        uint32_t ml = match_len - 4;
+        *token |= (uint8_t)(ml >= 15 ? 15 : ml);
+        if (ml >= 15)
+            put_len(&op, ml - 15);
+    }
+    return op;
+}
+
+static uint32_t read32(const uint8_t *p)
+{
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+/**
+ * @brief 贪心 LZ4 块压缩，dst 至少 n + n / 255 + 16 字节
+ * 遵守块格式的结尾约束: 最后 5 字节一定是字面量，最后一个匹配距结尾至少 12 字节
+ */
+static uint32_t lz4_compress(const uint8_t *src, uint32_t n, uint8_t *dst)
+{
+    static int32_t table[1 << HASH_BITS];
+    memset(table, 0xFF, sizeof(table));
+
+    uint8_t *op     = dst;
+    uint32_t anchor = 0;
+    uint32_t ip     = 0;
+
+    while (n >= 13 && ip + 12 < n)
+    {
+        uint32_t seq  = read32(src + ip);
+        uint32_t hash = (seq * 2654435761u) >> (32 - HASH_BITS);
+        int32_t cand  = table[hash];
+        table[hash]   = (int32_t)ip;
+
+        if (cand < 0 || ip - (uint32_t)cand > 65535 || read32(src + cand) != seq)
+        {
+            ip++;
+            continue;
+        }
+
+        uint32_t len = 4;
+        while (ip + len < n - 5 && src[cand + len] == src[ip + len])
+            len++;
+
+        op     = lz4_emit(op, src + anchor, ip - anchor, ip - (uint32_t)cand, len);
+        ip    += len;
+        anchor = ip;
+    }
+
+    op = lz4_emit(op, src + anchor, n - anchor, 0, 0);
+    return (uint32_t)(op - dst);
+}
+
+// --- 转换 ---
+
+/**
+ * @brief 转成 LVGL 的平面格式: w * h 个 RGB565 (LV_COLOR_16_SWAP 0), 有透明度时后面跟 w * h 个 alpha
+ */
+static uint8_t *convert(const uint8_t *rgba, uint32_t w, uint32_t h, bool alpha)
+{
+    size_t px    = (size_t)w * h;
+    uint8_t *out = malloc(px * (alpha ? 3 : 2));
+    if (out == NULL)
+        return NULL;
+
+    uint16_t *c = (uint16_t *)out;
+    uint8_t *a  = out + px * 2;
+    for (size_t i = 0; i < px; i++)
+    {
+        const uint8_t *p = rgba + i * 4;
+        c[i]             = (uint16_t)(((p[0] & 0xF8) << 8) | ((p[1] & 0xFC) << 3) | (p[2] >> 3));
+        if (alpha)
+            a[i] = p[3];
+    }
+    return out;
+}
+
+/**
+ * @brief 按 tile 压缩: 每个 tile 内部也是 "颜色平面 + alpha 平面"
+ * @return 压缩后不变小时返回 false，调用方按未压缩存放
+ */
+static bool compress_tiles(image_t *img, const uint8_t *planar, uint16_t tile_rows)
+{
+    lv_imgpack_entry_t *e = &img->e;
+    uint32_t w            = e->w;
+    uint32_t px_size      = (e->cf == LV_IMGPACK_CF_RGB565A8) ? 3 : 2;
+    uint32_t tile_cnt     = (e->h + tile_rows - 1) / tile_rows;
+    uint32_t table_size   = (tile_cnt + 1) * sizeof(uint32_t);
+    uint32_t tile_max     = tile_rows * w * px_size;
+
+    uint8_t *tile = malloc(tile_max);
+    uint8_t *out  = malloc(table_size + (size_t)tile_cnt * (tile_max + tile_max / 255 + 16));
+    if (tile == NULL || out == NULL)
+    {
+        free(tile);
+        free(out);
+        return false;
+    }
+
+    uint32_t *ofs    = (uint32_t *)out;
+    uint32_t pos     = table_size;
+    const uint8_t *a = planar + (size_t)w * e->h * 2;
+    for (uint32_t t = 0; t < tile_cnt; t++)
+    {
+        uint32_t y0   = t * tile_rows;
+        uint32_t rows = (e->h - y0 < tile_rows) ? e->h - y0 : tile_rows;
+        memcpy(tile, planar + (size_t)y0 * w * 2, rows * w * 2);
+        if (px_size == 3)
+            memcpy(tile + rows * w * 2, a + (size_t)y0 * w, rows * w);
+
+        ofs[t] = pos;
+        pos   += lz4_compress(tile, rows * w * px_size, out + pos);
+    }
+    ofs[tile_cnt] = pos;
+    free(tile);
+
+    if (pos >= e->raw_size)
+    {
+        free(out);
+        return false;
+    }
+
+    img->data    = out;
+    e->comp      = LV_IMGPACK_COMP_LZ4;
+    e->tile_rows = tile_rows;
+    e->data_size = pos;
+    return true;
+}
+
+static int add_image(image_t *img, const char *path, bool lz4, uint16_t tile_rows)
+{
+    const char *base = strrchr(path, '/');
+    base             = base ? base + 1 : path;
+    const char *dot  = strrchr(base, '.');
+    size_t name_len  = dot ? (size_t)(dot - base) : strlen(base);
+    if (name_len == 0 || name_len >= LV_IMGPACK_NAME_MAX)
+    {
+        fprintf(stderr, "%s: name must be 1..%d characters\n", path, LV_IMGPACK_NAME_MAX - 1);
+        return -1;
+    }
+
+    uint32_t w, h;
+    uint8_t *rgba = load_image(path, &w, &h);
+    if (rgba == NULL)
+        return -1;
+    if (w == 0 || h == 0 || w > LV_IMGPACK_SIZE_MAX || h > LV_IMGPACK_SIZE_MAX)
+    {
+        fprintf(stderr, "%s: invalid size %ux%u\n", path, w, h);
+        free(rgba);
+        return -1;
+    }
+
+    bool alpha = false;
+    for (size_t i = 0; i < (size_t)w * h && !alpha; i++)
+        alpha = rgba[i * 4 + 3] != 0xFF;
+
+    lv_imgpack_entry_t *e = &img->e;
+    memset(e, 0, sizeof(*e));
+    memcpy(e->name, base, name_len);
+    e->cf       = alpha ? LV_IMGPACK_CF_RGB565A8 : LV_IMGPACK_CF_RGB565;
+    e->w        = (uint16_t)w;
+    e->h        = (uint16_t)h;
+    e->raw_size = w * h * (alpha ? 3 : 2);
+
+    uint8_t *planar = convert(rgba, w, h, alpha);
+    free(rgba);
+    if (planar == NULL)
+        return -1;
+
+    if (lz4 && compress_tiles(img, planar, tile_rows))
+    {
+        free(planar);
+    }
+    else
+    {
+        e->comp      = LV_IMGPACK_COMP_NONE;
+        e->data_size = e->raw_size;
+        img->data    = planar;
+    }
+
+    printf("%-*s %5ux%-5u %-8s %8u -> %8u\n", LV_IMGPACK_NAME_MAX, e->name, w, h, alpha ? "RGB565A8" : "RGB565",
+           e->raw_size, e->data_size);
+    return 0;
+}
+
+static int cmp_image(const void *a, const void *b)
+{
+    return strcmp(((const image_t *)a)->e.name, ((const image_t *)b)->e.name);
+}
+
+static uint32_t align_up(uint32_t v)
+{
+    return (v + LV_IMGPACK_ALIGN - 1) / LV_IMGPACK_ALIGN * LV_IMGPACK_ALIGN;
+}
+
+static int write_pack(const char *out_path, image_t *imgs, uint32_t count)
+{
+    FILE *f = fopen(out_path, "wb");
+    if (f == NULL)
+    {
+        perror(out_path);
+        return -1;
+    }
+
+    lv_imgpack_header_t hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, LV_IMGPACK_MAGIC, 4);
+    hdr.version   = LV_IMGPACK_VERSION;
+    hdr.count     = (uint16_t)count;
+    hdr.index_ofs = sizeof(hdr);
+
+    // 先排好每张图的位置 (页对齐)
+    uint64_t pos = align_up(sizeof(hdr) + count * sizeof(lv_imgpack_entry_t));
+    for (uint32_t i = 0; i < count; i++)
+    {
+        imgs[i].e.data_ofs = (uint32_t)pos;
+        pos                = align_up((uint32_t)(pos + imgs[i].e.data_size));
+        if (pos > 0xFFFFFFFFu)
+        {
+            fprintf(stderr, "pack too large\n");
+            fclose(f);
+            return -1;
+        }
+    }
+
+    fwrite(&hdr, sizeof(hdr), 1, f);
+    for (uint32_t i = 0; i < count; i++)
+        fwrite(&imgs[i].e, sizeof(lv_imgpack_entry_t), 1, f);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        fseek(f, imgs[i].e.data_ofs, SEEK_SET);
+        fwrite(imgs[i].data, 1, imgs[i].e.data_size, f);
+    }
+
+    long end = ftell(f);
+    if (fclose(f) != 0)
+    {
+        perror(out_path);
+        return -1;
+    }
+    printf("%s: %u images, %ld bytes\n", out_path, count, end);
+    return 0;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "usage: %s [-z] [-t rows] -o out.lvpk image...\n", prog);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *out_path = NULL;
+    bool lz4             = false;
+    int tile_rows        = DEFAULT_TILE_ROWS;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "o:zt:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'o':
+                out_path = optarg;
+                break;
+            case 'z':
+                lz4 = true;
+                break;
+            case 't':
+                tile_rows = atoi(optarg);
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+
+    uint32_t count = argc - optind;
+    if (out_path == NULL || count == 0 || count > 0xFFFF || tile_rows < 1 || tile_rows > 0xFFFF)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    image_t *imgs = calloc(count, sizeof(image_t));
+    if (imgs == NULL)
+        return 1;
+
+    int ret = 0;
+    for (uint32_t i = 0; i < count && ret == 0; i++)
+        ret = add_image(&imgs[i], argv[optind + i], lz4, (uint16_t)tile_rows);
+
+    if (ret == 0)
+    {
+        // 解码器按名字二分查找
+        qsort(imgs, count, sizeof(image_t), cmp_image);
+        for (uint32_t i = 1; i < count && ret == 0; i++)
+        {
+            if (strcmp(imgs[i - 1].e.name, imgs[i].e.name) == 0)
+            {
+                fprintf(stderr, "duplicate name: %s\n", imgs[i].e.name);
+                ret = -1;
+            }
+        }
+    }
+
+    if (ret == 0)
+        ret = write_pack(out_path, imgs, count);
+
+    for (uint32_t i = 0; i < count; i++)
+        free(imgs[i].data);
+    free(imgs);
+    return ret == 0 ? 0 : 1;
+}
@@ -0,0 +1,272 @@
+/*
+ * jpg2sjpg: 主机端批量转换工具，JPEG -> SJPG (LVGL 的分片 JPEG)
+ *
+ * 整图解码后每 16 行重新编码成一个独立的 JPEG 分片，板子上只需要解码屏幕上可见的分片，
+ * 内存占用与图片高度无关，多个分片还可以在后台线程中并行解码。
+ * 分片是重新压缩的 (有损)，质量用 -q 指定。
+ *
+ * 用法: jpg2sjpg [-q 质量] [-d outdir] a.jpg b.jpg ...
+ *   输出文件名把 .jpg 换成 .sjpg，默认与输入放在同一目录
+ */
+#include <setjmp.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <jpeglib.h>
+
+#define SJPG_BLOCK_H    16   // 分片高度 (LVGL 的转换脚本也是 16)
+#define SJPG_HEADER_LEN 22
+#define IMG_MAX_SIZE    2047 // LVGL 图片头的宽高只有 11 位
+#define DEFAULT_QUALITY 90
+
+typedef struct
+{
+    struct jpeg_error_mgr pub;
+    jmp_buf jump;
+} jpeg_err_t;
+
+static void jpeg_error_exit(j_common_ptr cinfo)
+{
+    jpeg_err_t *err = (jpeg_err_t *)cinfo->err;
+    char msg[JMSG_LENGTH_MAX];
+    err->pub.format_message(cinfo, msg);
+    fprintf(stderr, "JPEG error: %s\n", msg);
+    longjmp(err->jump, 1);
+}
+
+static void put_u16_le(uint8_t *p, uint32_t v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+}
+
+/**
+ * @brief 解码为 RGB888
+ * @return w * h * 3 字节，失败返回 NULL
+ */
+static uint8_t *decode_rgb(const char *path, uint32_t *w, uint32_t *h)
+{
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL)
+    {
+        perror(path);
+        return NULL;
+    }
+
+    struct jpeg_decompress_struct cinfo;
+    jpeg_err_t jerr;
+    uint8_t *volatile rgb = NULL;
+    cinfo.err           = jpeg_std_error(&jerr.pub);
+    jerr.pub.error_exit = jpeg_error_exit;
+    jpeg_create_decompress(&cinfo);
+
+    if (setjmp(jerr.jump) == 0)
+    {
+        jpeg_stdio_src(&cinfo, fp);
+        jpeg_read_header(&cinfo, TRUE);
+        cinfo.out_color_space = JCS_RGB;
+        jpeg_start_decompress(&cinfo);
+
+        *w  = cinfo.output_width;
+        *h  = cinfo.output_height;
+        rgb = malloc((size_t)*w * *h * 3);
+        while (rgb && cinfo.output_scanline < cinfo.output_height)
+        {
+            JSAMPROW row = rgb + (size_t)cinfo.output_scanline * *w * 3;
+            jpeg_read_scanlines(&cinfo, &row, 1);
+        }
+        jpeg_finish_decompress(&cinfo);
+    }
+    else
+    {
+        free(rgb);
+        rgb = NULL;
+    }
+
+    jpeg_destroy_decompress(&cinfo);
+    fclose(fp);
+    return rgb;
+}
+
+/**
+ * @brief 把 rows 行 RGB888 编码成一个完整的 JPEG
+ * @return 编码后的字节数, 0 表示失败; *out 用 free() 释放
+ */
+static unsigned long encode_block(const uint8_t *rgb, uint32_t w, uint32_t rows, int quality, unsigned char **out)
+{
+    struct jpeg_compress_struct cinfo;
+    jpeg_err_t jerr;
+    unsigned long size = 0;
+    *out               = NULL;
+
+    cinfo.err           = jpeg_std_error(&jerr.pub);
+    jerr.pub.error_exit = jpeg_error_exit;
+    jpeg_create_compress(&cinfo);
+
+    if (setjmp(jerr.jump) == 0)
+    {
+        jpeg_mem_dest(&cinfo, out, &size);
+        cinfo.image_width      = w;
+        cinfo.image_height     = rows;
+        cinfo.input_components = 3;
+        cinfo.in_color_space   = JCS_RGB;
+        jpeg_set_defaults(&cinfo);
+        jpeg_set_quality(&cinfo, quality, TRUE);
+        jpeg_start_compress(&cinfo, TRUE);
+        while (cinfo.next_scanline < rows)
+        {
+            JSAMPROW row = (JSAMPROW)(rgb + (size_t)cinfo.next_scanline * w * 3);
+            jpeg_write_scanlines(&cinfo, &row, 1);
+        }
+        jpeg_finish_compress(&cinfo);
+    }
+    else
+    {
+        size = 0;
+    }
+
+    jpeg_destroy_compress(&cinfo);
+    return size;
+}
+
+/**
+ * @brief 输出路径: outdir (或输入所在目录) + 文件名, 后缀换成 .sjpg
+ */
+static void make_out_path(char *buf, size_t size, const char *in, const char *outdir)
+{
+    const char *base = strrchr(in, '/');
+    base             = base ? base + 1 : in;
+    const char *dot  = strrchr(base, '.');
+    int name_len     = dot ? (int)(dot - base) : (int)strlen(base);
+
+    if (outdir)
+        snprintf(buf, size, "%s/%.*s.sjpg", outdir, name_len, base);
+    else
+        snprintf(buf, size, "%.*s%.*s.sjpg", (int)(base - in), in, name_len, base);
+}
+
+static int convert(const char *in, const char *outdir, int quality)
+{
+    uint32_t w, h;
+    uint8_t *rgb = decode_rgb(in, &w, &h);
+    if (rgb == NULL)
+        return -1;
+
+    if (w > IMG_MAX_SIZE || h > IMG_MAX_SIZE)
+    {
+        fprintf(stderr, "%s: %ux%u is larger than %dx%d\n", in, w, h, IMG_MAX_SIZE, IMG_MAX_SIZE);
+        free(rgb);
+        return -1;
+    }
+
+    uint32_t frames         = (h + SJPG_BLOCK_H - 1) / SJPG_BLOCK_H;
+    unsigned char **blocks  = calloc(frames, sizeof(unsigned char *));
+    unsigned long *sizes    = calloc(frames, sizeof(unsigned long));
+    int ret                 = (blocks && sizes) ? 0 : -1;
+    unsigned long data_size = 0;
+
+    for (uint32_t i = 0; i < frames && ret == 0; i++)
+    {
+        uint32_t rows = (i == frames - 1) ? h - i * SJPG_BLOCK_H : SJPG_BLOCK_H;
+        sizes[i]      = encode_block(rgb + (size_t)i * SJPG_BLOCK_H * w * 3, w, rows, quality, &blocks[i]);
+        // 分片长度在文件头中只有 16 位
+        if (sizes[i] == 0 || sizes[i] > 0xFFFF)
+        {
+            fprintf(stderr, "%s: cannot encode block %u\n", in, i);
+            ret = -1;
+        }
+        data_size += sizes[i];
+    }
+    free(rgb);
+
+    char out[1024];
+    FILE *f = NULL;
+    if (ret == 0)
+    {
+        make_out_path(out, sizeof(out), in, outdir);
+        f   = fopen(out, "wb");
+        ret = f ? 0 : -1;
+        if (f == NULL)
+            perror(out);
+    }
+
+    if (ret == 0)
+    {
+        // 文件头: 魔数 + 版本 + 宽高 + 分片数 + 分片高度 + 每个分片的长度
+        uint8_t header[SJPG_HEADER_LEN];
+        memset(header, 0, sizeof(header));
+        memcpy(header, "_SJPG__", 8);
+        memcpy(header + 8, "V1.00", 6);
+        put_u16_le(header + 14, w);
+        put_u16_le(header + 16, h);
+        put_u16_le(header + 18, frames);
+        put_u16_le(header + 20, SJPG_BLOCK_H);
+        if (fwrite(header, 1, sizeof(header), f) != sizeof(header))
+            ret = -1;
+
+        for (uint32_t i = 0; i < frames && ret == 0; i++)
+        {
+            uint8_t len[2];
+            put_u16_le(len, sizes[i]);
+            if (fwrite(len, 1, 2, f) != 2)
+                ret = -1;
+        }
+        for (uint32_t i = 0; i < frames && ret == 0; i++)
+        {
+            if (fwrite(blocks[i], 1, sizes[i], f) != sizes[i])
+                ret = -1;
+        }
+        if (ret != 0)
+            perror(out);
+    }
+    if (f && fclose(f) != 0)
+        ret = -1;
+
+    for (uint32_t i = 0; blocks && i < frames; i++)
+        free(blocks[i]);
+    free(blocks);
+    free(sizes);
+
+    if (ret == 0)
+        printf("%s -> %s (%ux%u, %u blocks, %lu bytes)\n", in, out, w, h, frames,
+               SJPG_HEADER_LEN + frames * 2 + data_size);
+    return ret;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *outdir = NULL;
+    int quality        = DEFAULT_QUALITY;
+    int opt;
+    while ((opt = getopt(argc, argv, "q:d:")) != -1)
+    {
+        if (opt == 'q' && atoi(optarg) > 0 && atoi(optarg) <= 100)
+        {
+            quality = atoi(optarg);
+        }
+        else if (opt == 'd')
+        {
+            outdir = optarg;
+        }
+        else
+        {
+            fprintf(stderr, "usage: %s [-q quality] [-d outdir] image.jpg...\n", argv[0]);
+            return 1;
+        }
+    }
+    if (optind >= argc)
+    {
+        fprintf(stderr, "usage: %s [-q quality] [-d outdir] image.jpg...\n", argv[0]);
+        return 1;
+    }
+
+    int failed = 0;
+    for (int i = optind; i < argc; i++)
+    {
+        if (convert(argv[i], outdir, quality) != 0)
+            failed++;
+    }
+    return failed ? 1 : 0;
+}
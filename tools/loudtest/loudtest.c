@@ -0,0 +1,418 @@
+/*
+ * loudtest: 检查响度分析 (EBU R128) 和 ReplayGain 标签的读取 (make bench)
+ *
+ * 用法: loudtest [-d 临时目录]
+ *   - 生成 EBU Tech 3341 式的测试信号 (1kHz 正弦、门限、单声道、左声道、真峰值、静音、不同采样率)，
+ *     综合响度误差不超过 ±0.1 LU，真峰值在 -0.4 ~ +0.2 dB 之内
+ *   - 生成带 ReplayGain 标签的 MP3 (ID3v2 TXXX，Latin-1 和 UTF-16) 和 FLAC (Vorbis comment)，
+ *     检查读出的增益和峰值; 只有增益没有峰值的歌曲峰值必须是 MUSIC_PEAK_UNKNOWN
+ *   - 用排队的 bg_worker 替身走一遍后台分析: 分析结果写进索引，已有标签增益的歌曲跳过
+ *   全部通过返回 0
+ */
+#define MINIAUDIO_IMPLEMENTATION
+#include "miniaudio.h"
+#include "bg_worker.h"
+#include "music_lib.h"
+#include "music_loudness.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define LUFS_TOL    0.1
+#define TP_TOL_LOW  0.4
+#define TP_TOL_HIGH 0.2
+#define QUEUE_MAX   64
+
+static const char *tmp_dir = "/tmp";
+static int failures;
+
+// --- bg_worker 替身: 任务排队，由 drain_jobs 在主线程中依次执行 ---
+static bg_job_cb_t queue_cb[QUEUE_MAX];
+static void *queue_arg[QUEUE_MAX];
+static int queue_len;
+
+int bg_worker_submit(bg_prio_t prio, bg_job_cb_t cb, bg_job_cb_t drop, void *arg)
+{
+    (void)prio;
+    (void)drop;
+    if (queue_len == QUEUE_MAX)
+        return -1;
+    queue_cb[queue_len]  = cb;
+    queue_arg[queue_len] = arg;
+    queue_len++;
+    return 0;
+}
+
+int bg_worker_post_ui(bg_job_cb_t cb, bg_job_cb_t drop, void *arg)
+{
+    (void)drop;
+    cb(arg);
+    return 0;
+}
+
+static int drain_jobs(void)
+{
+    int jobs = 0;
+    while (queue_len > 0)
+    {
+        bg_job_cb_t cb = queue_cb[0];
+        void *arg      = queue_arg[0];
+        queue_len--;
+        memmove(queue_cb, queue_cb + 1, queue_len * sizeof(queue_cb[0]));
+        memmove(queue_arg, queue_arg + 1, queue_len * sizeof(queue_arg[0]));
+        cb(arg);
+        jobs++;
+    }
+    return jobs;
+}
+
+static void check(bool ok, const char *what)
+{
+    printf("%-48s %s\n", what, ok ? "ok" : "FAIL");
+    failures += !ok;
+}
+
+static const char *tmp_path(const char *name)
+{
+    static char buf[4][512];
+    static int n;
+    char *p = buf[n++ & 3];
+    snprintf(p, sizeof(buf[0]), "%s/loudtest_%s", tmp_dir, name);
+    return p;
+}
+
+// =============================================================
+// 测试信号
+// =============================================================
+
+typedef float (*signal_t)(int ch, uint64_t i, uint32_t rate);
+
+static float sine_1k(uint64_t i, uint32_t rate, double dbfs)
+{
+    return (float)(pow(10.0, dbfs / 20.0) * sin(2.0 * M_PI * 1000.0 * (double)i / rate));
+}
+
+static float sig_m23(int ch, uint64_t i, uint32_t rate)
+{
+    (void)ch;
+    return sine_1k(i, rate, -23.0);
+}
+
+static float sig_m33(int ch, uint64_t i, uint32_t rate)
+{
+    (void)ch;
+    return sine_1k(i, rate, -33.0);
+}
+
+// 10 秒 -36、60 秒 -23、10 秒 -36: 两段 -36 被相对门限去掉，结果是 -23
+static float sig_gate(int ch, uint64_t i, uint32_t rate)
+{
+    (void)ch;
+    double t = (double)i / rate;
+    return sine_1k(i, rate, (t < 10.0 || t >= 70.0) ? -36.0 : -23.0);
+}
+
+// 只有左声道 -20: 比两个声道都有时小 3dB
+static float sig_left(int ch, uint64_t i, uint32_t rate)
+{
+    return ch == 0 ? sine_1k(i, rate, -20.0) : 0.0f;
+}
+
+// fs/4 正弦、相位 45 度: 采样点都落在 0.354，真峰值是 0.5 (-6.02 dBTP)
+static float sig_tp(int ch, uint64_t i, uint32_t rate)
+{
+    (void)ch;
+    (void)rate;
+    return (float)(0.5 * sin(M_PI / 2.0 * (double)i + M_PI / 4.0));
+}
+
+static float sig_silence(int ch, uint64_t i, uint32_t rate)
+{
+    (void)ch;
+    (void)i;
+    (void)rate;
+    return 0.0f;
+}
+
+static int write_wav(const char *path, int channels, uint32_t rate, double seconds, signal_t sig)
+{
+    ma_encoder_config cfg = ma_encoder_config_init(ma_encoding_format_wav, ma_format_f32, (ma_uint32)channels, rate);
+    ma_encoder enc;
+    if (ma_encoder_init_file(path, &cfg, &enc) != MA_SUCCESS)
+        return -1;
+    uint64_t frames = (uint64_t)(seconds * rate);
+    for (uint64_t i = 0; i < frames; i++)
+    {
+        float s[2];
+        for (int c = 0; c < channels; c++)
+            s[c] = sig(c, i, rate);
+        ma_encoder_write_pcm_frames(&enc, s, 1, NULL);
+    }
+    ma_encoder_uninit(&enc);
+    return 0;
+}
+
+typedef struct
+{
+    const char *name;
+    int channels;
+    uint32_t rate;
+    double seconds;
+    signal_t sig;
+    double lufs; // NAN: 不检查
+    double tp;   // NAN: 不检查
+} scan_case_t;
+
+static const scan_case_t scan_cases[] = {
+    {"stereo 1k -23 dBFS 48k", 2, 48000, 20, sig_m23, -23.0, -23.0},
+    {"stereo 1k -23 dBFS 44.1k", 2, 44100, 20, sig_m23, -23.0, -23.0},
+    {"stereo 1k -23 dBFS 96k", 2, 96000, 10, sig_m23, -23.0, -23.0},
+    {"stereo 1k -33 dBFS", 2, 48000, 20, sig_m33, -33.0, -33.0},
+    {"mono 1k -23 dBFS (dual mono)", 1, 48000, 20, sig_m23, -23.0, -23.0},
+    {"gating -36/-23/-36", 2, 48000, 80, sig_gate, -23.0, -23.0},
+    {"left only 1k -20 dBFS", 2, 48000, 20, sig_left, -23.0, -20.0},
+    {"true peak fs/4 48k", 2, 48000, 5, sig_tp, NAN, -6.02},
+    {"true peak fs/4 44.1k", 2, 44100, 5, sig_tp, NAN, -6.02},
+    {"silence", 2, 48000, 5, sig_silence, -70.0, NAN},
+};
+
+static void check_scans(void)
+{
+    for (size_t k = 0; k < sizeof(scan_cases) / sizeof(scan_cases[0]); k++)
+    {
+        const scan_case_t *c = &scan_cases[k];
+        const char *path     = tmp_path("scan.wav");
+        music_loudness_t res;
+        bool ok = write_wav(path, c->channels, c->rate, c->seconds, c->sig) == 0 && music_loudness_scan(path, &res) == 0;
+        if (ok && !isnan(c->lufs))
+            ok = fabs(res.lufs - c->lufs) <= LUFS_TOL;
+        if (ok && !isnan(c->tp))
+            ok = res.peak_db >= c->tp - TP_TOL_LOW && res.peak_db <= c->tp + TP_TOL_HIGH;
+        char what[96];
+        snprintf(what, sizeof(what), "%s: %.2f LUFS %.2f dBTP", c->name, ok ? res.lufs : 0.0, ok ? res.peak_db : 0.0);
+        check(ok, what);
+        remove(path);
+    }
+}
+
+// =============================================================
+// ReplayGain 标签
+// =============================================================
+
+static void put_be32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)(v >> 24);
+    p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >> 8);
+    p[3] = (uint8_t)v;
+}
+
+static void put_le32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+/**
+ * @brief 追加一个 ID3v2.3 TXXX 帧，utf16 为 true 时用带 BOM 的 UTF-16LE
+ * @return 帧的总字节数
+ */
+static size_t id3_txxx(uint8_t *out, bool utf16, const char *desc, const char *value)
+{
+    uint8_t *body = out + 10;
+    size_t n      = 0;
+    body[n++]     = utf16 ? 1 : 0;
+    const char *parts[2] = {desc, value};
+    for (int k = 0; k < 2; k++)
+    {
+        if (utf16)
+        {
+            body[n++] = 0xFF;
+            body[n++] = 0xFE;
+            for (const char *q = parts[k]; *q; q++)
+            {
+                body[n++] = (uint8_t)*q;
+                body[n++] = 0;
+            }
+            if (k == 0)
+            {
+                body[n++] = 0;
+                body[n++] = 0;
+            }
+        }
+        else
+        {
+            size_t len = strlen(parts[k]) + (k == 0); // 描述以 0 结尾
+            memcpy(body + n, parts[k], len);
+            n += len;
+        }
+    }
+    memcpy(out, "TXXX", 4);
+    put_be32(out + 4, (uint32_t)n);
+    out[8] = out[9] = 0;
+    return n + 10;
+}
+
+/**
+ * @brief ID3v2.3 标签 + 40 个空的 MPEG-1 Layer III 帧，gain/peak 为 NULL 时不写这个字段
+ */
+static int write_mp3(const char *path, bool utf16, const char *gain, const char *peak)
+{
+    uint8_t tag[2048];
+    size_t n = 10;
+    n += id3_txxx(tag + n, utf16, "MusicBrainz Album Id", "x");
+    if (gain)
+        n += id3_txxx(tag + n, utf16, "replaygain_track_gain", gain);
+    if (peak)
+        n += id3_txxx(tag + n, utf16, "REPLAYGAIN_TRACK_PEAK", peak);
+    uint32_t size = (uint32_t)(n - 10);
+    memcpy(tag, "ID3\x03\x00\x00", 6);
+    tag[6] = (uint8_t)((size >> 21) & 0x7F);
+    tag[7] = (uint8_t)((size >> 14) & 0x7F);
+    tag[8] = (uint8_t)((size >> 7) & 0x7F);
+    tag[9] = (uint8_t)(size & 0x7F);
+
+    FILE *fp = fopen(path, "wb");
+    if (fp == NULL)
+        return -1;
+    fwrite(tag, 1, n, fp);
+    uint8_t frame[417] = {0xFF, 0xFB, 0x90, 0x00}; // 128kbps 44.1kHz
+    for (int i = 0; i < 40; i++)
+        fwrite(frame, 1, sizeof(frame), fp);
+    fclose(fp);
+    return 0;
+}
+
+/**
+ * @brief 只有 STREAMINFO 和 Vorbis comment 的 FLAC (10 秒 44.1kHz 立体声)
+ */
+static int write_flac(const char *path, const char *gain, const char *peak)
+{
+    uint8_t info[38] = {0x00, 0, 0, 34};
+    uint32_t rate    = 44100, frames = 441000;
+    info[4 + 10]     = (uint8_t)(rate >> 12);
+    info[4 + 11]     = (uint8_t)(rate >> 4);
+    info[4 + 12]     = (uint8_t)(((rate & 15) << 4) | (1 << 1)); // 2 声道
+    put_be32(info + 4 + 14, frames);
+
+    char c1[128], c2[128];
+    snprintf(c1, sizeof(c1), "REPLAYGAIN_TRACK_GAIN=%s", gain);
+    snprintf(c2, sizeof(c2), "replaygain_track_peak=%s", peak);
+    uint8_t vc[512];
+    size_t n = 0;
+    put_le32(vc + n, 3);
+    memcpy(vc + n + 4, "abc", 3); // vendor
+    n += 7;
+    put_le32(vc + n, 2);
+    n += 4;
+    const char *comments[2] = {c1, c2};
+    for (int k = 0; k < 2; k++)
+    {
+        size_t len = strlen(comments[k]);
+        put_le32(vc + n, (uint32_t)len);
+        memcpy(vc + n + 4, comments[k], len);
+        n += 4 + len;
+    }
+    uint8_t hdr[4] = {0x84, 0, (uint8_t)(n >> 8), (uint8_t)n}; // 最后一个块, VORBIS_COMMENT
+
+    FILE *fp = fopen(path, "wb");
+    if (fp == NULL)
+        return -1;
+    fwrite("fLaC", 1, 4, fp);
+    fwrite(info, 1, sizeof(info), fp);
+    fwrite(hdr, 1, sizeof(hdr), fp);
+    fwrite(vc, 1, n, fp);
+    fclose(fp);
+    return 0;
+}
+
+static void check_tag(const char *name, int written, uint8_t source, int16_t gain_cdb, int16_t peak_cdb)
+{
+    const char *path = tmp_path(name);
+    music_info_t info;
+    bool ok = written == 0 && music_lib_probe(path, &info) == 0;
+    ok      = ok && info.gain_source == source && info.gain_cdb == gain_cdb && info.peak_cdb == peak_cdb;
+    char what[96];
+    snprintf(what, sizeof(what), "tag %s: gain %d peak %d cdb", name, ok ? info.gain_cdb : 0, ok ? info.peak_cdb : 0);
+    check(ok, what);
+    remove(path);
+}
+
+static void check_tags(void)
+{
+    check_tag("rg_latin1.mp3", write_mp3(tmp_path("rg_latin1.mp3"), false, "-6.52 dB", "0.988312"), MUSIC_GAIN_TAG, -652, -10);
+    check_tag("rg_utf16.mp3", write_mp3(tmp_path("rg_utf16.mp3"), true, "+3.10 dB", "0.5"), MUSIC_GAIN_TAG, 310, -602);
+    check_tag("rg_nopeak.mp3", write_mp3(tmp_path("rg_nopeak.mp3"), false, "-4.00 dB", NULL), MUSIC_GAIN_TAG, -400,
+              MUSIC_PEAK_UNKNOWN);
+    check_tag("rg_none.mp3", write_mp3(tmp_path("rg_none.mp3"), false, NULL, NULL), MUSIC_GAIN_NONE, 0, MUSIC_PEAK_UNKNOWN);
+    check_tag("rg.flac", write_flac(tmp_path("rg.flac"), "-8.00 dB", "1.122018"), MUSIC_GAIN_TAG, -800, 100);
+}
+
+// =============================================================
+// 后台分析
+// =============================================================
+
+static void check_background(void)
+{
+    const char *index = tmp_path("lib.idx");
+    const char *wav   = tmp_path("bg.wav");
+    const char *flac  = tmp_path("bg.flac");
+    remove(index);
+    if (music_lib_open(index) != 0 || write_wav(wav, 2, 48000, 20, sig_m23) != 0 || write_flac(flac, "-8.00 dB", "1.122018") != 0)
+    {
+        check(false, "background: setup");
+        return;
+    }
+
+    music_loudness_request(wav);
+    music_loudness_request(flac);
+    music_loudness_request(wav); // 重复的忽略
+    drain_jobs();
+
+    music_info_t info;
+    bool ok = music_lib_lookup(wav, &info) && info.gain_source == MUSIC_GAIN_SCAN && abs(info.gain_cdb - 500) <= 10 &&
+              abs(info.peak_cdb + 2300) <= 10;
+    check(ok, "background: scan result stored in the index");
+    ok = music_lib_lookup(flac, &info) && info.gain_source == MUSIC_GAIN_TAG && info.gain_cdb == -800;
+    check(ok, "background: tagged track keeps its tag gain");
+
+    music_loudness_stats_t before, after;
+    music_loudness_get_stats(&before);
+    music_loudness_request(wav);
+    drain_jobs();
+    music_loudness_get_stats(&after);
+    check(after.scanned == before.scanned && after.skipped == before.skipped + 1, "background: analysed track is skipped");
+    check(before.scanned == 1 && before.failed == 0, "background: stats");
+
+    music_loudness_close();
+    music_lib_close();
+    remove(index);
+    remove(wav);
+    remove(flac);
+}
+
+int main(int argc, char *argv[])
+{
+    int opt;
+    while ((opt = getopt(argc, argv, "d:")) != -1)
+    {
+        if (opt == 'd')
+            tmp_dir = optarg;
+        else
+        {
+            fprintf(stderr, "usage: %s [-d tmpdir]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    check_scans();
+    check_tags();
+    check_background();
+    music_loudness_report();
+    printf("%s\n", failures ? "FAILED" : "all passed");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,228 @@
+/*
+ * png2qoi: 主机端批量转换工具，PNG -> QOI
+ *
+ * QOI 无损、单遍、无熵编码，文件比 PNG 稍大，但板子上解码快得多 (lv_qoi 直接输出 RGB565/RGB565A8)。
+ * 全部像素不透明时输出 3 通道，否则 4 通道 (LVGL 中对应 TRUE_COLOR / RGB565A8)。
+ *
+ * 用法: png2qoi [-d outdir] a.png b.png ...
+ *   输出文件名把 .png 换成 .qoi，默认与输入放在同一目录
+ */
+#include <png.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define QOI_OP_INDEX 0x00
+#define QOI_OP_DIFF  0x40
+#define QOI_OP_LUMA  0x80
+#define QOI_OP_RUN   0xC0
+#define QOI_OP_RGB   0xFE
+#define QOI_OP_RGBA  0xFF
+#define QOI_RUN_MAX  62
+
+#define QOI_HASH(p) (((p)[0] * 3 + (p)[1] * 5 + (p)[2] * 7 + (p)[3] * 11) & 63)
+
+static void put_u32_be(uint8_t *p, uint32_t v)
+{
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+/**
+ * @brief 按 QOI 规范编码，out 至少 w * h * (channels + 1) + 22 字节
+ * @return 编码后的字节数
+ */
+static size_t qoi_encode(const uint8_t *rgba, uint32_t w, uint32_t h, uint8_t channels, uint8_t *out)
+{
+    uint8_t *op = out;
+    memcpy(op, "qoif", 4);
+    put_u32_be(op + 4, w);
+    put_u32_be(op + 8, h);
+    op[12] = channels;
+    op[13] = 0; // sRGB + 线性 alpha
+    op += 14;
+
+    uint8_t index[64][4];
+    memset(index, 0, sizeof(index));
+    uint8_t prev[4] = {0, 0, 0, 255};
+    uint32_t run    = 0;
+    size_t px_cnt   = (size_t)w * h;
+
+    for (size_t i = 0; i < px_cnt; i++)
+    {
+        const uint8_t *px = rgba + i * 4;
+
+        if (memcmp(px, prev, 4) == 0)
+        {
+            run++;
+            if (run == QOI_RUN_MAX || i == px_cnt - 1)
+            {
+                *op++ = QOI_OP_RUN | (run - 1);
+                run   = 0;
+            }
+            continue;
+        }
+
+        if (run > 0)
+        {
+            *op++ = QOI_OP_RUN | (run - 1);
+            run   = 0;
+        }
+
+        int hash = QOI_HASH(px);
+        if (memcmp(index[hash], px, 4) == 0)
+        {
+            *op++ = QOI_OP_INDEX | hash;
+        }
+        else
+        {
+            memcpy(index[hash], px, 4);
+
+            if (px[3] == prev[3])
+            {
+                int8_t vr   = (int8_t)(px[0] - prev[0]);
+                int8_t vg   = (int8_t)(px[1] - prev[1]);
+                int8_t vb   = (int8_t)(px[2] - prev[2]);
+                int8_t vg_r = vr - vg;
+                int8_t vg_b = vb - vg;
+
+                if (vr > -3 && vr < 2 && vg > -3 && vg < 2 && vb > -3 && vb < 2)
+                {
+                    *op++ = QOI_OP_DIFF | (vr + 2) << 4 | (vg + 2) << 2 | (vb + 2);
+                }
+                else if (vg_r > -9 && vg_r < 8 && vg > -33 && vg < 32 && vg_b > -9 && vg_b < 8)
+                {
+                    *op++ = QOI_OP_LUMA | (vg + 32);
+                    *op++ = (vg_r + 8) << 4 | (vg_b + 8);
+                }
+                else
+                {
+                    *op++ = QOI_OP_RGB;
+                    *op++ = px[0];
+                    *op++ = px[1];
+                    *op++ = px[2];
+                }
+            }
+            else
+            {
+                *op++ = QOI_OP_RGBA;
+                memcpy(op, px, 4);
+                op += 4;
+            }
+        }
+        memcpy(prev, px, 4);
+    }
+
+    // 结束标记
+    static const uint8_t end[8] = {0, 0, 0, 0, 0, 0, 0, 1};
+    memcpy(op, end, sizeof(end));
+    op += sizeof(end);
+    return (size_t)(op - out);
+}
+
+/**
+ * @brief 输出路径: outdir (或输入所在目录) + 文件名, 后缀换成 .qoi
+ */
+static void make_out_path(char *buf, size_t size, const char *in, const char *outdir)
+{
+    const char *base = strrchr(in, '/');
+    base             = base ? base + 1 : in;
+    const char *dot  = strrchr(base, '.');
+    int name_len     = dot ? (int)(dot - base) : (int)strlen(base);
+
+    if (outdir)
+        snprintf(buf, size, "%s/%.*s.qoi", outdir, name_len, base);
+    else
+        snprintf(buf, size, "%.*s%.*s.qoi", (int)(base - in), in, name_len, base);
+}
+
+static int convert(const char *in, const char *outdir)
+{
+    png_image img;
+    memset(&img, 0, sizeof(img));
+    img.version = PNG_IMAGE_VERSION;
+    if (!png_image_begin_read_from_file(&img, in))
+    {
+        fprintf(stderr, "%s: %s\n", in, img.message);
+        return -1;
+    }
+
+    img.format    = PNG_FORMAT_RGBA;
+    uint8_t *rgba = malloc(PNG_IMAGE_SIZE(img));
+    if (rgba == NULL || !png_image_finish_read(&img, NULL, rgba, 0, NULL))
+    {
+        fprintf(stderr, "%s: %s\n", in, img.message);
+        png_image_free(&img);
+        free(rgba);
+        return -1;
+    }
+
+    size_t px_cnt = (size_t)img.width * img.height;
+    bool alpha    = false;
+    for (size_t i = 0; i < px_cnt && !alpha; i++)
+        alpha = rgba[i * 4 + 3] != 0xFF;
+    uint8_t channels = alpha ? 4 : 3;
+
+    uint8_t *qoi = malloc(px_cnt * (channels + 1) + 22);
+    if (qoi == NULL)
+    {
+        free(rgba);
+        return -1;
+    }
+    size_t qoi_size = qoi_encode(rgba, img.width, img.height, channels, qoi);
+    free(rgba);
+
+    char out[1024];
+    make_out_path(out, sizeof(out), in, outdir);
+    FILE *f = fopen(out, "wb");
+    int ret = -1;
+    if (f == NULL)
+        perror(out);
+    else if (fwrite(qoi, 1, qoi_size, f) != qoi_size)
+        perror(out);
+    else
+        ret = 0;
+    if (f && fclose(f) != 0)
+        ret = -1;
+    free(qoi);
+
+    if (ret == 0)
+        printf("%s -> %s (%ux%u, %d ch, %zu bytes)\n", in, out, img.width, img.height, channels, qoi_size);
+    return ret;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *outdir = NULL;
+    int opt;
+    while ((opt = getopt(argc, argv, "d:")) != -1)
+    {
+        if (opt == 'd')
+        {
+            outdir = optarg;
+        }
+        else
+        {
+            fprintf(stderr, "usage: %s [-d outdir] image.png...\n", argv[0]);
+            return 1;
+        }
+    }
+    if (optind >= argc)
+    {
+        fprintf(stderr, "usage: %s [-d outdir] image.png...\n", argv[0]);
+        return 1;
+    }
+
+    int failed = 0;
+    for (int i = optind; i < argc; i++)
+    {
+        if (convert(argv[i], outdir) != 0)
+            failed++;
+    }
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,155 @@
+/*
+ * qoibench: 在板子上对比 lv_png 与 lv_qoi 的解码速度 (make bench, 用交叉编译器编译)
+ *
+ * 用法: qoibench [-n 次数] a.png b.png ...
+ *   每个 x.png 旁边需要有 png2qoi 生成的 x.qoi
+ *   文件先整个读进内存，以 C 数组的形式交给 LVGL 的解码器，只测解码本身，不含文件读取
+ */
+#include "lvgl.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define DEFAULT_ROUNDS 10
+
+typedef struct
+{
+    uint8_t *data;
+    uint32_t size;
+} file_buf_t;
+
+static uint64_t now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int read_all(const char *path, file_buf_t *out)
+{
+    FILE *f = fopen(path, "rb");
+    if (f == NULL)
+        return -1;
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    rewind(f);
+
+    out->data = (size > 0) ? malloc(size) : NULL;
+    out->size = (uint32_t)size;
+    int ret   = (out->data && fread(out->data, 1, size, f) == (size_t)size) ? 0 : -1;
+    fclose(f);
+    if (ret != 0)
+    {
+        free(out->data);
+        out->data = NULL;
+    }
+    return ret;
+}
+
+/**
+ * @brief 用 LVGL 的解码器链解码 rounds 次
+ * @return 平均每次的微秒数, 0 表示失败
+ */
+static uint64_t bench_decode(const file_buf_t *file, int rounds, lv_img_header_t *header)
+{
+    lv_img_dsc_t src;
+    memset(&src, 0, sizeof(src)); // cf/w/h 为 0: 让解码器从数据中读取
+    src.data      = file->data;
+    src.data_size = file->size;
+
+    if (lv_img_decoder_get_info(&src, header) != LV_RES_OK)
+        return 0;
+
+    uint64_t sum = 0;
+    for (int i = 0; i < rounds; i++)
+    {
+        lv_img_decoder_dsc_t dsc;
+        uint64_t t0   = now_us();
+        lv_res_t res  = lv_img_decoder_open(&dsc, &src, lv_color_black(), 0);
+        uint64_t cost = now_us() - t0;
+        bool decoded  = res == LV_RES_OK && dsc.img_data != NULL;
+        if (res == LV_RES_OK)
+            lv_img_decoder_close(&dsc);
+        if (!decoded)
+            return 0;
+
+        sum += cost;
+    }
+    return sum / rounds ? sum / rounds : 1;
+}
+
+int main(int argc, char *argv[])
+{
+    int rounds = DEFAULT_ROUNDS;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:")) != -1)
+    {
+        if (opt == 'n' && atoi(optarg) > 0)
+        {
+            rounds = atoi(optarg);
+        }
+        else
+        {
+            fprintf(stderr, "usage: %s [-n rounds] image.png...\n", argv[0]);
+            return 1;
+        }
+    }
+    if (optind >= argc)
+    {
+        fprintf(stderr, "usage: %s [-n rounds] image.png...\n", argv[0]);
+        return 1;
+    }
+
+    lv_init(); // 注册 lv_png / lv_qoi 解码器, 不需要显示驱动
+
+    printf("%-24s %9s %9s %9s %9s %9s %7s\n", "image", "pixels", "png B", "qoi B", "png us", "qoi us", "speedup");
+    uint64_t png_total = 0, qoi_total = 0;
+    int failed         = 0;
+
+    for (int i = optind; i < argc; i++)
+    {
+        const char *png_path = argv[i];
+        char qoi_path[512];
+        const char *dot = strrchr(png_path, '.');
+        snprintf(qoi_path, sizeof(qoi_path), "%.*s.qoi", dot ? (int)(dot - png_path) : (int)strlen(png_path), png_path);
+
+        file_buf_t png = {0}, qoi = {0};
+        if (read_all(png_path, &png) != 0 || read_all(qoi_path, &qoi) != 0)
+        {
+            printf("%-24s missing %s\n", png_path, png.data ? qoi_path : png_path);
+            free(png.data);
+            free(qoi.data);
+            failed++;
+            continue;
+        }
+
+        lv_img_header_t png_hdr, qoi_hdr;
+        uint64_t png_us = bench_decode(&png, rounds, &png_hdr);
+        uint64_t qoi_us = bench_decode(&qoi, rounds, &qoi_hdr);
+
+        const char *name = strrchr(png_path, '/');
+        name             = name ? name + 1 : png_path;
+        if (png_us == 0 || qoi_us == 0 || png_hdr.w != qoi_hdr.w || png_hdr.h != qoi_hdr.h)
+        {
+            printf("%-24s decode failed (png %s, qoi %s)\n", name, png_us ? "ok" : "fail", qoi_us ? "ok" : "fail");
+            failed++;
+        }
+        else
+        {
+            printf("%-24s %9u %9u %9u %9llu %9llu %6.2fx\n", name, (unsigned)(png_hdr.w * png_hdr.h), png.size, qoi.size,
+                   (unsigned long long)png_us, (unsigned long long)qoi_us, (double)png_us / qoi_us);
+            png_total += png_us;
+            qoi_total += qoi_us;
+        }
+
+        free(png.data);
+        free(qoi.data);
+    }
+
+    if (qoi_total)
+        printf("total: png %llu us, qoi %llu us, %.2fx\n", (unsigned long long)png_total, (unsigned long long)qoi_total,
+               (double)png_total / qoi_total);
+    return failed ? 1 : 0;
+}